@@ -0,0 +1,139 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+#include <null_device.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace toy::bench
+{
+	// Benchmarks compile their shaders with the compiler given on the command line, the fake one next to the binary otherwise
+	inline void set_compiler_path(int argc, char **argv, int argument_index)
+	{
+#if defined(FAKE_DXCOMPILER_PATH)
+		std::string_view compiler_path = FAKE_DXCOMPILER_PATH;
+#else
+		std::string_view compiler_path = "dxcompiler.dll";
+#endif
+		if (argc > argument_index && std::string_view(argv[argument_index]) != "-") {
+			compiler_path = argv[argument_index];
+		}
+		DxcInStance::get().set_compiler_path(compiler_path);
+	}
+
+	inline uint32_t query_count_argument(int argc, char **argv, int argument_index, uint32_t default_count)
+	{
+		if (argc <= argument_index) {
+			return default_count;
+		}
+		return static_cast<uint32_t>(std::stoul(argv[argument_index]));
+	}
+
+	// Shader sources are written to the temp directory, effects compile from file paths
+	inline std::filesystem::path write_shader_file(std::string_view file_name, std::string_view source)
+	{
+		const auto shader_directory = std::filesystem::temp_directory_path() / "dxc_research_bench";
+		std::filesystem::create_directories(shader_directory);
+		const auto shader_path = shader_directory / file_name;
+		// Processes running at the same time share the directory, the file is written aside and renamed so no compile reads it half written
+		const auto staging_path = shader_directory / std::format("{}.{:08x}.tmp", file_name, std::random_device{}());
+		{
+			std::ofstream shader_file{ staging_path, std::ios::binary | std::ios::trunc };
+			shader_file.write(source.data(), static_cast<std::streamsize>(source.size()));
+		}
+		std::error_code error_code{};
+		std::filesystem::rename(staging_path, shader_path, error_code);
+		if (error_code) {
+			std::filesystem::remove(staging_path, error_code);
+		}
+		return shader_path;
+	}
+
+	inline constexpr std::string_view s_common_source = R"(
+cbuffer CBPerObject : register(b0)
+{
+	float4x4 g_World;
+	float4x4 g_WorldInvTranspose;
+	float4 g_Color;
+}
+
+cbuffer CBPerFrame : register(b1)
+{
+	float4x4 g_ViewProj;
+	float3 g_EyePosW;
+	float g_Time;
+}
+
+struct VertexIn
+{
+	float3 pos : POSITION;
+	float3 normal : NORMAL;
+	float2 tex : TEXCOORD0;
+};
+
+struct VertexOut
+{
+	float4 pos : SV_Position;
+	float3 normal : NORMAL;
+	float2 tex : TEXCOORD0;
+};
+)";
+
+	inline constexpr std::string_view s_vertex_source = R"(
+
+VertexOut VS(VertexIn vertex_in)
+{
+	VertexOut vertex_out;
+	float4 pos_w = mul(float4(vertex_in.pos, 1.0f), g_World);
+	vertex_out.pos = mul(pos_w, g_ViewProj);
+	vertex_out.normal = mul(vertex_in.normal, (float3x3)g_WorldInvTranspose);
+	vertex_out.tex = vertex_in.tex;
+	return vertex_out;
+}
+)";
+
+	inline constexpr std::string_view s_pixel_source = R"(
+
+Texture2D g_Albedo : register(t0);
+SamplerState g_LinearSampler : register(s0);
+
+float4 PS(VertexOut pixel_in) : SV_Target
+{
+	return g_Albedo.Sample(g_LinearSampler, pixel_in.tex) * g_Color;
+}
+)";
+
+	// Geometry effect with a per object cbuffer holding g_World, g_WorldInvTranspose and g_Color and a g_Albedo texture
+	inline std::shared_ptr<const EffectPrototype> create_geometry_prototype(ID3D11Device *device)
+	{
+		// Sources are self contained, includes would resolve against the repo's shader search path
+		const auto vs_path = write_shader_file("bench_geometry_vs.hlsl", std::string(s_common_source) + std::string(s_vertex_source)).wstring();
+		const auto ps_path = write_shader_file("bench_geometry_ps.hlsl", std::string(s_common_source) + std::string(s_pixel_source)).wstring();
+		GraphicsPipelineStateObject pipeline_state_object{};
+		pipeline_state_object.vs_path = vs_path;
+		pipeline_state_object.ps_path = ps_path;
+		auto prototype = EffectPrototype::create(pipeline_state_object, device);
+		if (prototype == nullptr || GraphicsEffect{ prototype, device }.query_constant_buffer_accessor("g_World") == nullptr) {
+			std::cout << std::format("Failed to create the benchmark effect\n");
+			return nullptr;
+		}
+		return prototype;
+	}
+
+	struct Stopwatch
+	{
+	private:
+		std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	public:
+		[[nodiscard]] double query_elapsed_ms() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+		}
+	};
+}
@@ -0,0 +1,92 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <bench_common.h>
+#include <pass.h>
+#include <limits>
+
+// Render graph compile cost on a synthetic chain of passes, compile never touches a device
+// Usage: GraphCompileBench [chain length ...]
+
+namespace toy
+{
+	// Every pass renders one target and reads the previous one, every fourth also reads the one before that
+	// Every tenth target also feeds a dead end pass that nothing reads, those are culled
+	static void build_synthetic_chain(RenderGraph &render_graph, uint32_t chain_length, uint64_t &executed_pass_count)
+	{
+		render_graph.clear();
+		const uint32_t back_buffer = render_graph.import_resource("back_buffer", {});
+		std::vector<uint32_t> chain_resources{};
+		chain_resources.reserve(chain_length);
+		for (uint32_t chain_index = 0; chain_index < chain_length; ++chain_index)
+		{
+			RenderGraphResourceDesc resource_desc{};
+			resource_desc.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+			resource_desc.width = chain_index % 3 == 0 ? 960 : 1920;
+			resource_desc.height = chain_index % 3 == 0 ? 540 : 1080;
+			const uint32_t chain_resource = render_graph.create_resource("chain", resource_desc);
+			chain_resources.emplace_back(chain_resource);
+
+			auto &&chain_pass = render_graph.add_pass("chain", [&executed_pass_count](ID3D11DeviceContext *, const RenderGraph &) { ++executed_pass_count; });
+			if (chain_index > 0) {
+				chain_pass.read(chain_resources[chain_index - 1]);
+			}
+			if (chain_index > 1 && chain_index % 4 == 0) {
+				chain_pass.read(chain_resources[chain_index - 2]);
+			}
+			chain_pass.write_render_target(chain_resource);
+
+			if (chain_index % 10 == 9) {
+				const uint32_t dead_resource = render_graph.create_resource("dead_end", resource_desc);
+				render_graph.add_pass("dead_end", {}).read(chain_resource).write_render_target(dead_resource);
+			}
+		}
+		render_graph.add_pass("present", {}).read(chain_resources.back()).write_render_target(back_buffer);
+	}
+
+	static void run_chain(uint32_t chain_length, uint32_t repetition_count)
+	{
+		// Compile only, no device behind the graph
+		uint64_t executed_pass_count = 0;
+		RenderGraph render_graph{ nullptr };
+		double best_compile_ms = std::numeric_limits<double>::max();
+		for (uint32_t repetition = 0; repetition < repetition_count; ++repetition)
+		{
+			build_synthetic_chain(render_graph, chain_length, executed_pass_count);
+			const bench::Stopwatch stopwatch{};
+			render_graph.compile();
+			best_compile_ms = (std::min)(best_compile_ms, stopwatch.query_elapsed_ms());
+		}
+		render_graph.print();
+		std::cout << std::format("Compile of {} passes: {:.3f} ms, best of {}\n", render_graph.get_stats().pass_count, best_compile_ms, repetition_count);
+
+		// Execute once on the null device to check the aliasing holds for real resources
+		auto null_device = NullDevice::create();
+		RenderGraph executed_graph{ null_device.Get() };
+		build_synthetic_chain(executed_graph, chain_length, executed_pass_count);
+		executed_graph.execute(null_device->get_immediate_context());
+		auto &&device_stats = null_device->get_stats();
+		std::cout << std::format("Null device: {} passes executed, {} textures alive, {} texture bytes\n\n", executed_pass_count,
+								 device_stats.query_objects_alive(NullObjectType::Texture), device_stats.texture_bytes_alive.load());
+	}
+}
+
+int main(int argc, char **argv)
+{
+	using namespace toy;
+
+	std::vector<uint32_t> chain_lengths{ 1000, 4000 };
+	if (argc > 1) {
+		chain_lengths.clear();
+		for (int argument_index = 1; argument_index < argc; ++argument_index)
+		{
+			chain_lengths.emplace_back(bench::query_count_argument(argc, argv, argument_index, 0));
+		}
+	}
+	for (auto &&chain_length : chain_lengths)
+	{
+		run_chain((std::max)(chain_length, 1u), 20);
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <bench_common.h>
+#include <constant_buffer_pool.h>
+#include <job_system.h>
+#include <pass.h>
+#include <thread>
+
+// Render graph recording on deferred contexts against serial recording, every pass draws through pooled constant buffers
+// Usage: ParallelRecordBench [compiler path] [pass count] [frame count]
+
+namespace toy
+{
+	static constexpr uint32_t s_draws_per_pass = 8;
+	static constexpr uint32_t s_passes_per_command_list = 8;
+
+	struct PassEffect
+	{
+		std::unique_ptr<GraphicsEffect> effect = nullptr;
+		ConstantBufferAccessor *world_accessor = nullptr;
+		std::array<float, 16> world_matrix{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	};
+
+	// Every pass owns its effect, effects are not shared between passes recorded at the same time
+	static void build_synthetic_frame(RenderGraph &render_graph, std::vector<PassEffect> &pass_effects, std::atomic<uint64_t> &draw_count)
+	{
+		for (auto &&pass_effect : pass_effects)
+		{
+			RenderGraphResourceDesc resource_desc{};
+			resource_desc.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			resource_desc.width = 256;
+			resource_desc.height = 256;
+			const uint32_t target = render_graph.create_resource("target", resource_desc);
+			render_graph.add_pass("draw", [&pass_effect, &draw_count](ID3D11DeviceContext *device_context, const RenderGraph &)
+			{
+				for (uint32_t draw_index = 0; draw_index < s_draws_per_pass; ++draw_index)
+				{
+					pass_effect.world_matrix[12] += 0.001f;
+					pass_effect.world_accessor->set_float_matrix(pass_effect.world_matrix.data(), 4, 4);
+					pass_effect.effect->emit_pipeline(device_context);
+					device_context->DrawIndexed(36, 0, 0);
+				}
+				draw_count.fetch_add(s_draws_per_pass, std::memory_order_relaxed);
+			}).write_render_target(target).set_side_effect(true);
+		}
+		render_graph.compile();
+	}
+
+	template <typename RecordFrame>
+	static double measure_frames(uint32_t frame_count, RecordFrame &&record_frame)
+	{
+		// One warm up frame creates the physical resources, deferred contexts and transient rings
+		record_frame();
+		const bench::Stopwatch stopwatch{};
+		for (uint32_t frame_index = 0; frame_index < frame_count; ++frame_index)
+		{
+			record_frame();
+		}
+		return stopwatch.query_elapsed_ms() / frame_count;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	using namespace toy;
+
+	bench::set_compiler_path(argc, argv, 1);
+	const uint32_t pass_count = (std::max)(bench::query_count_argument(argc, argv, 2, 2000), 1u);
+	const uint32_t frame_count = (std::max)(bench::query_count_argument(argc, argv, 3, 20), 1u);
+
+	auto null_device = NullDevice::create();
+	auto prototype = bench::create_geometry_prototype(null_device.Get());
+	if (prototype == nullptr) {
+		return 1;
+	}
+
+	ConstantBufferPool constant_buffer_pool{ null_device.Get() };
+	std::vector<PassEffect> pass_effects(pass_count);
+	for (auto &&pass_effect : pass_effects)
+	{
+		pass_effect.effect = std::make_unique<GraphicsEffect>(prototype, null_device.Get(), &constant_buffer_pool);
+		pass_effect.world_accessor = pass_effect.effect->query_constant_buffer_accessor("g_World");
+	}
+
+	std::atomic<uint64_t> draw_count{ 0 };
+	RenderGraph render_graph{ null_device.Get() };
+	build_synthetic_frame(render_graph, pass_effects, draw_count);
+	auto immediate_context = null_device->get_immediate_context();
+
+	std::cout << std::format("Recording {} passes of {} draws, {} passes per command list, averaged over {} frames\n", pass_count, s_draws_per_pass, s_passes_per_command_list,
+							 frame_count);
+	const double serial_ms = measure_frames(frame_count, [&]() { render_graph.execute(immediate_context); });
+	std::cout << std::format("{:<24} {:>9.3f} ms/frame\n", "serial", serial_ms);
+
+	std::vector<uint32_t> worker_counts{ 1, 2, 4 };
+	const uint32_t hardware_worker_count = (std::max)(std::thread::hardware_concurrency(), 2u) - 1;
+	if (hardware_worker_count > 4) {
+		worker_counts.emplace_back(hardware_worker_count);
+	}
+	for (auto &&worker_count : worker_counts)
+	{
+		JobSystem job_system{ worker_count };
+		auto &&device_stats = null_device->get_stats();
+		device_stats.reset();
+		draw_count = 0;
+		const double parallel_ms = measure_frames(frame_count, [&]() { render_graph.execute_parallel(immediate_context, job_system, s_passes_per_command_list); });
+		std::cout << std::format("{:<24} {:>9.3f} ms/frame {:>6.2f}x {:>8} draws {:>6} command lists\n", std::format("parallel, {} workers", worker_count), parallel_ms,
+								 serial_ms / parallel_ms, draw_count.load() / (frame_count + 1),
+								 device_stats.query_call_count(NullDeviceCall::ExecuteCommandList) / (frame_count + 1));
+	}
+	constant_buffer_pool.print();
+	std::cout << std::format("Hardware threads: {}\n", std::thread::hardware_concurrency());
+	return 0;
+}
@@ -0,0 +1,285 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <bench_common.h>
+#include <constant_buffer_pool.h>
+#include <draw_queue.h>
+#include <random>
+
+// Cpu cost of submitting draws through graphics effects, measured on the null device
+// Usage: SubmissionBench [compiler path] [draw count] [frame count]
+
+namespace toy
+{
+	struct SubmissionScene
+	{
+		ComPtr<NullDevice> device = nullptr;
+		ID3D11DeviceContext *device_context = nullptr;
+		std::shared_ptr<const EffectPrototype> prototype = nullptr;
+		std::vector<ComPtr<ID3D11ShaderResourceView>> albedo_views = {};
+		std::array<ComPtr<ID3D11Buffer>, 3> vertex_buffers = {};
+		ComPtr<ID3D11Buffer> index_buffer = nullptr;
+		std::vector<std::array<float, 16>> world_matrices = {};
+	};
+
+	static ComPtr<ID3D11Buffer> create_static_buffer(ID3D11Device *device, uint32_t size_in_bytes, uint32_t bind_flags)
+	{
+		const D3D11_BUFFER_DESC buffer_desc{
+			.ByteWidth = size_in_bytes,
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = bind_flags,
+			.CPUAccessFlags = 0,
+			.MiscFlags = 0,
+			.StructureByteStride = 0,
+		};
+		ComPtr<ID3D11Buffer> buffer = nullptr;
+		device->CreateBuffer(&buffer_desc, nullptr, buffer.GetAddressOf());
+		return buffer;
+	}
+
+	static bool create_scene(SubmissionScene &scene, uint32_t draw_count, uint32_t texture_count)
+	{
+		scene.device = NullDevice::create();
+		scene.device_context = scene.device->get_immediate_context();
+
+		scene.prototype = bench::create_geometry_prototype(scene.device.Get());
+		if (scene.prototype == nullptr) {
+			return false;
+		}
+
+		const D3D11_TEXTURE2D_DESC texture_desc{
+			.Width = 4,
+			.Height = 4,
+			.MipLevels = 1,
+			.ArraySize = 1,
+			.Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+			.SampleDesc = { 1, 0 },
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+			.CPUAccessFlags = 0,
+			.MiscFlags = 0,
+		};
+		for (uint32_t texture_index = 0; texture_index < texture_count; ++texture_index)
+		{
+			ComPtr<ID3D11Texture2D> texture = nullptr;
+			scene.device->CreateTexture2D(&texture_desc, nullptr, texture.GetAddressOf());
+			auto &&albedo_view = scene.albedo_views.emplace_back();
+			scene.device->CreateShaderResourceView(texture.Get(), nullptr, albedo_view.GetAddressOf());
+		}
+
+		constexpr std::array<uint32_t, 3> vertex_strides{ 12, 12, 8 };
+		for (uint32_t stream = 0; stream < vertex_strides.size(); ++stream)
+		{
+			scene.vertex_buffers[stream] = create_static_buffer(scene.device.Get(), vertex_strides[stream] * 24, D3D11_BIND_VERTEX_BUFFER);
+		}
+		scene.index_buffer = create_static_buffer(scene.device.Get(), 36 * sizeof(uint32_t), D3D11_BIND_INDEX_BUFFER);
+
+		std::mt19937 random_engine{ 7 };
+		std::uniform_real_distribution<float> position_distribution{ -100.0f, 100.0f };
+		scene.world_matrices.resize(draw_count);
+		for (auto &&world_matrix : scene.world_matrices)
+		{
+			world_matrix = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+			world_matrix[12] = position_distribution(random_engine);
+			world_matrix[13] = position_distribution(random_engine);
+			world_matrix[14] = position_distribution(random_engine);
+		}
+		return true;
+	}
+
+	static void bind_geometry(SubmissionScene &scene)
+	{
+		constexpr std::array<uint32_t, 3> vertex_strides{ 12, 12, 8 };
+		constexpr std::array<uint32_t, 3> vertex_offsets{ 0, 0, 0 };
+		std::array<ID3D11Buffer *, 3> vertex_buffers{ scene.vertex_buffers[0].Get(), scene.vertex_buffers[1].Get(), scene.vertex_buffers[2].Get() };
+		scene.device_context->IASetVertexBuffers(0, 3, vertex_buffers.data(), vertex_strides.data(), vertex_offsets.data());
+		scene.device_context->IASetIndexBuffer(scene.index_buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		scene.device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+
+	struct ObjectEffect
+	{
+		std::unique_ptr<GraphicsEffect> effect = nullptr;
+		ConstantBufferAccessor *world_accessor = nullptr;
+		ConstantBufferAccessor *world_inv_transpose_accessor = nullptr;
+		ConstantBufferAccessor *color_accessor = nullptr;
+	};
+
+	static std::vector<ObjectEffect> create_object_effects(SubmissionScene &scene, ConstantBufferPool *constant_buffer_pool)
+	{
+		std::vector<ObjectEffect> object_effects(scene.world_matrices.size());
+		for (size_t object_index = 0; object_index < object_effects.size(); ++object_index)
+		{
+			auto &&object_effect = object_effects[object_index];
+			object_effect.effect = std::make_unique<GraphicsEffect>(scene.prototype, scene.device.Get(), constant_buffer_pool);
+			object_effect.world_accessor = object_effect.effect->query_constant_buffer_accessor("g_World");
+			object_effect.world_inv_transpose_accessor = object_effect.effect->query_constant_buffer_accessor("g_WorldInvTranspose");
+			object_effect.color_accessor = object_effect.effect->query_constant_buffer_accessor("g_Color");
+			object_effect.effect->bind_shader_resource_view("g_Albedo", scene.albedo_views[object_index % scene.albedo_views.size()].Get());
+		}
+		return object_effects;
+	}
+
+	static void update_object_constants(ObjectEffect &object_effect, std::array<float, 16> &world_matrix, uint32_t frame_index)
+	{
+		world_matrix[13] += 0.001f;
+		std::array<float, 4> color{ 1.0f, 1.0f, 1.0f, static_cast<float>(frame_index & 1) };
+		object_effect.world_accessor->set_float_matrix(world_matrix.data(), 4, 4);
+		object_effect.world_inv_transpose_accessor->set_float_matrix(world_matrix.data(), 4, 4);
+		object_effect.color_accessor->set_float_vector(color);
+	}
+
+	struct SubmissionResult
+	{
+		double frame_ms = 0.0;
+		double draw_ns = 0.0;
+		uint64_t maps_per_frame = 0;
+		uint64_t bytes_mapped_per_frame = 0;
+		uint64_t slots_bound_per_frame = 0;
+	};
+
+	template <typename RecordFrame>
+	static SubmissionResult measure_frames(SubmissionScene &scene, uint32_t frame_count, RecordFrame &&record_frame)
+	{
+		// One warm up frame so first use costs stay out of the numbers
+		record_frame(0u);
+		auto &&device_stats = scene.device->get_stats();
+		device_stats.reset();
+
+		const bench::Stopwatch stopwatch{};
+		for (uint32_t frame_index = 1; frame_index <= frame_count; ++frame_index)
+		{
+			record_frame(frame_index);
+		}
+		const double elapsed_ms = stopwatch.query_elapsed_ms();
+
+		SubmissionResult result{};
+		result.frame_ms = elapsed_ms / frame_count;
+		result.draw_ns = result.frame_ms * 1.0e6 / static_cast<double>(scene.world_matrices.size());
+		result.maps_per_frame = device_stats.query_call_count(NullDeviceCall::Map) / frame_count;
+		result.bytes_mapped_per_frame = device_stats.bytes_mapped.load() / frame_count;
+		result.slots_bound_per_frame = device_stats.slots_bound.load() / frame_count;
+		return result;
+	}
+
+	static void print_result(std::string_view scenario_name, const SubmissionResult &result)
+	{
+		std::cout << std::format("{:<28} {:>9.3f} ms/frame {:>8.1f} ns/draw {:>8} maps {:>12} bytes mapped {:>8} slots bound\n", scenario_name, result.frame_ms, result.draw_ns,
+								 result.maps_per_frame, result.bytes_mapped_per_frame, result.slots_bound_per_frame);
+	}
+
+	// Every object owns a dynamic constant buffer, updated and emitted one draw at a time
+	static SubmissionResult run_standalone(SubmissionScene &scene, uint32_t frame_count)
+	{
+		auto object_effects = create_object_effects(scene, nullptr);
+		return measure_frames(scene, frame_count, [&](uint32_t frame_index) {
+			bind_geometry(scene);
+			for (size_t object_index = 0; object_index < object_effects.size(); ++object_index)
+			{
+				auto &&object_effect = object_effects[object_index];
+				update_object_constants(object_effect, scene.world_matrices[object_index], frame_index);
+				object_effect.effect->emit_pipeline(scene.device_context);
+				scene.device_context->DrawIndexed(36, 0, 0);
+			}
+		});
+	}
+
+	// Constant buffers are slots of the pool, updated and emitted one draw at a time
+	static SubmissionResult run_pooled(SubmissionScene &scene, uint32_t frame_count)
+	{
+		ConstantBufferPool constant_buffer_pool{ scene.device.Get() };
+		auto object_effects = create_object_effects(scene, &constant_buffer_pool);
+		return measure_frames(scene, frame_count, [&](uint32_t frame_index) {
+			bind_geometry(scene);
+			for (size_t object_index = 0; object_index < object_effects.size(); ++object_index)
+			{
+				auto &&object_effect = object_effects[object_index];
+				update_object_constants(object_effect, scene.world_matrices[object_index], frame_index);
+				object_effect.effect->emit_pipeline(scene.device_context);
+				scene.device_context->DrawIndexed(36, 0, 0);
+			}
+		});
+	}
+
+	// Constants of every object are staged first and the pool flushed once before the draws
+	static SubmissionResult run_pooled_staged(SubmissionScene &scene, uint32_t frame_count)
+	{
+		ConstantBufferPool constant_buffer_pool{ scene.device.Get() };
+		auto object_effects = create_object_effects(scene, &constant_buffer_pool);
+		return measure_frames(scene, frame_count, [&](uint32_t frame_index) {
+			for (size_t object_index = 0; object_index < object_effects.size(); ++object_index)
+			{
+				auto &&object_effect = object_effects[object_index];
+				update_object_constants(object_effect, scene.world_matrices[object_index], frame_index);
+				object_effect.effect->stage_constant_buffers();
+			}
+			constant_buffer_pool.flush(scene.device_context);
+
+			bind_geometry(scene);
+			for (auto &&object_effect : object_effects)
+			{
+				object_effect.effect->emit_pipeline(scene.device_context);
+				scene.device_context->DrawIndexed(36, 0, 0);
+			}
+		});
+	}
+
+	// Draws sorted by the draw queue, a few materials share effects and only resource sets change between most draws
+	static SubmissionResult run_draw_queue(SubmissionScene &scene, uint32_t frame_count, uint32_t material_count)
+	{
+		ConstantBufferPool constant_buffer_pool{ scene.device.Get() };
+		std::vector<std::unique_ptr<GraphicsEffect>> material_effects{};
+		DrawQueue draw_queue{};
+		std::vector<uint32_t> effect_ids{};
+		for (uint32_t material_index = 0; material_index < material_count; ++material_index)
+		{
+			auto &&material_effect = material_effects.emplace_back(std::make_unique<GraphicsEffect>(scene.prototype, scene.device.Get(), &constant_buffer_pool));
+			effect_ids.emplace_back(draw_queue.register_effect(material_effect.get()));
+		}
+		std::vector<uint32_t> resource_set_ids{};
+		for (auto &&albedo_view : scene.albedo_views)
+		{
+			resource_set_ids.emplace_back(draw_queue.register_resource_set({ DrawResourceBinding{ "g_Albedo", albedo_view.Get() } }));
+		}
+		DrawGeometry draw_geometry{};
+		draw_geometry.vertex_buffers = { scene.vertex_buffers[0].Get(), scene.vertex_buffers[1].Get(), scene.vertex_buffers[2].Get() };
+		draw_geometry.vertex_strides = { 12, 12, 8 };
+		draw_geometry.vertex_offsets = { 0, 0, 0 };
+		draw_geometry.index_buffer = scene.index_buffer.Get();
+		const uint32_t geometry_id = draw_queue.register_geometry(std::move(draw_geometry));
+
+		const auto draw_count = static_cast<uint32_t>(scene.world_matrices.size());
+		draw_queue.reserve(draw_count);
+		return measure_frames(scene, frame_count, [&](uint32_t) {
+			for (uint32_t draw_index = 0; draw_index < draw_count; ++draw_index)
+			{
+				const float normalized_depth = (scene.world_matrices[draw_index][14] + 100.0f) / 200.0f;
+				draw_queue.push(effect_ids[draw_index % material_count], resource_set_ids[draw_index % resource_set_ids.size()], normalized_depth, geometry_id,
+								DrawArguments{ .element_count = 36 });
+			}
+			draw_queue.submit(scene.device_context);
+		});
+	}
+}
+
+int main(int argc, char **argv)
+{
+	using namespace toy;
+
+	bench::set_compiler_path(argc, argv, 1);
+	const uint32_t draw_count = (std::max)(bench::query_count_argument(argc, argv, 2, 10000), 1u);
+	const uint32_t frame_count = (std::max)(bench::query_count_argument(argc, argv, 3, 100), 1u);
+
+	SubmissionScene scene{};
+	if (!create_scene(scene, draw_count, 64)) {
+		return 1;
+	}
+
+	std::cout << std::format("Submission of {} draws, averaged over {} frames\n", draw_count, frame_count);
+	print_result("standalone constant buffers", run_standalone(scene, frame_count));
+	print_result("pooled, update per draw", run_pooled(scene, frame_count));
+	print_result("pooled, staged then flushed", run_pooled_staged(scene, frame_count));
+	print_result("draw queue, 16 materials", run_draw_queue(scene, frame_count, 16));
+	return 0;
+}
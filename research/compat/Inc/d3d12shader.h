@@ -0,0 +1,18 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+// The research code includes <Inc/d3d12shader.h> as on windows, the shipped directory is dxc/inc
+
+#include <inc/d3d12shader.h>
+
+// DECLSPEC_UUID carries the ids on windows, here they come from the header's own DEFINE_GUIDs
+template <> inline constexpr GUID compat::uuid_of<ID3D12ShaderReflectionType> = IID_ID3D12ShaderReflectionType;
+template <> inline constexpr GUID compat::uuid_of<ID3D12ShaderReflectionVariable> = IID_ID3D12ShaderReflectionVariable;
+template <> inline constexpr GUID compat::uuid_of<ID3D12ShaderReflectionConstantBuffer> = IID_ID3D12ShaderReflectionConstantBuffer;
+template <> inline constexpr GUID compat::uuid_of<ID3D12ShaderReflection> = IID_ID3D12ShaderReflection;
+template <> inline constexpr GUID compat::uuid_of<ID3D12LibraryReflection> = IID_ID3D12LibraryReflection;
+template <> inline constexpr GUID compat::uuid_of<ID3D12FunctionReflection> = IID_ID3D12FunctionReflection;
+template <> inline constexpr GUID compat::uuid_of<ID3D12FunctionParameterReflection> = IID_ID3D12FunctionParameterReflection;
@@ -0,0 +1,9 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+// The research code includes <Inc/dxcapi.h> as on windows, the shipped directory is dxc/inc
+
+#include <inc/dxcapi.h>
@@ -0,0 +1,250 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+// Win32 and COM base types for building the research code without the windows sdk,
+// laid out like dxc's own WinAdapter.h so objects can be passed to and from libdxcompiler.so
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Base types
+typedef int32_t HRESULT;
+typedef int BOOL;
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef float FLOAT;
+typedef size_t SIZE_T;
+typedef void *HANDLE;
+typedef void *LPVOID;
+typedef const void *LPCVOID;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+typedef wchar_t WCHAR;
+typedef wchar_t *LPWSTR;
+typedef const wchar_t *LPCWSTR;
+typedef wchar_t *BSTR;
+
+typedef struct tagRECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+} RECT;
+
+#define TRUE 1
+#define FALSE 0
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_ABORT ((HRESULT)0x80004004L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+
+#define STDMETHODCALLTYPE
+#define __stdcall
+#define interface struct
+#define DECLSPEC_UUID(x)
+#define STDMETHOD(method) virtual HRESULT STDMETHODCALLTYPE method
+#define STDMETHOD_(type, method) virtual type STDMETHODCALLTYPE method
+#define PURE = 0
+#define THIS_
+#define THIS void
+#define DECLARE_INTERFACE(iface) struct iface
+#define DECLARE_INTERFACE_(iface, base) struct iface : public base
+
+// Source annotations
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _In_count_(x)
+#define _In_opt_count_(x)
+#define _In_bytecount_(x)
+#define _In_reads_(x)
+#define _In_reads_opt_(x)
+#define _In_reads_bytes_(x)
+#define _In_reads_bytes_opt_(x)
+#define _Inout_
+#define _Inout_opt_
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(x)
+#define _Out_writes_opt_(x)
+#define _Out_writes_bytes_(x)
+#define _Out_writes_bytes_opt_(x)
+#define _Outptr_
+#define _Outptr_opt_
+#define _Outptr_result_z_
+#define _Outptr_opt_result_z_
+#define _Outptr_result_maybenull_
+#define _Outptr_opt_result_maybenull_
+#define _Outptr_result_nullonfailure_
+#define _Outptr_result_bytebuffer_(x)
+#define _COM_Outptr_
+#define _COM_Outptr_opt_
+#define _COM_Outptr_result_maybenull_
+#define _COM_Outptr_opt_result_maybenull_
+#define _Maybenull_
+#define _Check_return_
+#define _Field_size_(x)
+#define _Field_size_opt_(x)
+#define _Field_size_bytes_(x)
+#define _Field_size_full_(x)
+#define _Field_size_bytes_full_(x)
+#define _Always_(x)
+#define _Ret_maybenull_
+#define _Use_decl_annotations_
+
+// Guid
+struct GUID
+{
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+};
+
+typedef GUID IID;
+typedef GUID CLSID;
+typedef const GUID &REFGUID;
+typedef const GUID &REFIID;
+typedef const GUID &REFCLSID;
+
+constexpr bool operator==(const GUID &lhs, const GUID &rhs)
+{
+	if (lhs.Data1 != rhs.Data1 || lhs.Data2 != rhs.Data2 || lhs.Data3 != rhs.Data3) {
+		return false;
+	}
+	for (size_t index = 0; index < 8; ++index)
+	{
+		if (lhs.Data4[index] != rhs.Data4[index]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+	inline constexpr GUID name = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+namespace compat
+{
+	constexpr uint32_t parse_hex(std::string_view spec, size_t offset, size_t digit_count)
+	{
+		uint32_t value = 0;
+		for (size_t index = offset; index < offset + digit_count; ++index)
+		{
+			const char digit = spec[index];
+			value = value * 16 + static_cast<uint32_t>(digit <= '9' ? digit - '0' : (digit | 0x20) - 'a' + 10);
+		}
+		return value;
+	}
+
+	// "8BA5FB08-5195-40e2-AC58-0D989C3A0102"
+	constexpr GUID parse_guid(std::string_view spec)
+	{
+		GUID guid{ parse_hex(spec, 0, 8), static_cast<uint16_t>(parse_hex(spec, 9, 4)), static_cast<uint16_t>(parse_hex(spec, 14, 4)), {} };
+		guid.Data4[0] = static_cast<uint8_t>(parse_hex(spec, 19, 2));
+		guid.Data4[1] = static_cast<uint8_t>(parse_hex(spec, 21, 2));
+		for (size_t index = 2; index < 8; ++index)
+		{
+			guid.Data4[index] = static_cast<uint8_t>(parse_hex(spec, 24 + (index - 2) * 2, 2));
+		}
+		return guid;
+	}
+
+	// Interfaces without a published id get one hashed from their name, stable across builds and modules
+	template <typename T>
+	constexpr GUID make_name_guid()
+	{
+		const std::string_view name = __PRETTY_FUNCTION__;
+		uint64_t hash_low = 0xcbf29ce484222325ULL;
+		uint64_t hash_high = 0x84222325cbf29ce4ULL;
+		for (const char character : name)
+		{
+			hash_low = (hash_low ^ static_cast<uint8_t>(character)) * 0x100000001b3ULL;
+			hash_high = (hash_high ^ static_cast<uint8_t>(character)) * 0x100000001b3ULL + 1;
+		}
+		GUID guid{ static_cast<uint32_t>(hash_low), static_cast<uint16_t>(hash_low >> 32), static_cast<uint16_t>(hash_low >> 48), {} };
+		for (size_t index = 0; index < 8; ++index)
+		{
+			guid.Data4[index] = static_cast<uint8_t>(hash_high >> (index * 8));
+		}
+		return guid;
+	}
+
+	template <typename T>
+	inline constexpr GUID uuid_of = make_name_guid<T>();
+
+	template <typename T>
+	constexpr const GUID &query_uuid(T **)
+	{
+		return uuid_of<T>;
+	}
+}
+
+#define CROSS_PLATFORM_UUIDOF(interface, spec) \
+	struct interface; \
+	template <> inline constexpr GUID compat::uuid_of<interface> = compat::parse_guid(spec);
+
+#define __uuidof(T) compat::uuid_of<std::remove_cv_t<T>>
+#define IID_PPV_ARGS(pp) compat::query_uuid(pp), reinterpret_cast<void **>(pp)
+
+// Com base interfaces, the virtual destructor keeps the vtable in line with dxc's IUnknown
+CROSS_PLATFORM_UUIDOF(IUnknown, "00000000-0000-0000-C000-000000000046")
+struct IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **object) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+	virtual ~IUnknown() = default;
+};
+
+CROSS_PLATFORM_UUIDOF(IMalloc, "00000002-0000-0000-C000-000000000046")
+struct IMalloc : public IUnknown
+{
+	virtual void *STDMETHODCALLTYPE Alloc(SIZE_T size_in_bytes) = 0;
+	virtual void *STDMETHODCALLTYPE Realloc(void *block, SIZE_T size_in_bytes) = 0;
+	virtual void STDMETHODCALLTYPE Free(void *block) = 0;
+	virtual SIZE_T STDMETHODCALLTYPE GetSize(void *block) = 0;
+	virtual int STDMETHODCALLTYPE DidAlloc(void *block) = 0;
+	virtual void STDMETHODCALLTYPE HeapMinimize() = 0;
+};
+
+CROSS_PLATFORM_UUIDOF(ISequentialStream, "0C733A30-2A1C-11CE-ADE5-00AA0044773D")
+struct ISequentialStream : public IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE Read(void *data, ULONG size_in_bytes, ULONG *bytes_read) = 0;
+	virtual HRESULT STDMETHODCALLTYPE Write(const void *data, ULONG size_in_bytes, ULONG *bytes_written) = 0;
+};
+
+CROSS_PLATFORM_UUIDOF(IStream, "0000000c-0000-0000-C000-000000000046")
+struct IStream : public ISequentialStream
+{
+
+};
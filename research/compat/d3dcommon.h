@@ -0,0 +1,185 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+// The d3dcommon.h subset d3d12shader.h and the research code use, values match the windows sdk
+
+#include <WinAdapter.h>
+
+typedef enum D3D_FEATURE_LEVEL
+{
+	D3D_FEATURE_LEVEL_11_0 = 0xb000,
+	D3D_FEATURE_LEVEL_11_1 = 0xb100
+} D3D_FEATURE_LEVEL;
+
+typedef enum D3D_PRIMITIVE_TOPOLOGY
+{
+	D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+	D3D_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+	D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+	D3D_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+	D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED,
+	D3D11_PRIMITIVE_TOPOLOGY_POINTLIST = D3D_PRIMITIVE_TOPOLOGY_POINTLIST,
+	D3D11_PRIMITIVE_TOPOLOGY_LINELIST = D3D_PRIMITIVE_TOPOLOGY_LINELIST,
+	D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP = D3D_PRIMITIVE_TOPOLOGY_LINESTRIP,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP
+} D3D_PRIMITIVE_TOPOLOGY;
+
+typedef enum D3D_PRIMITIVE
+{
+	D3D_PRIMITIVE_UNDEFINED = 0,
+	D3D_PRIMITIVE_POINT = 1,
+	D3D_PRIMITIVE_LINE = 2,
+	D3D_PRIMITIVE_TRIANGLE = 3
+} D3D_PRIMITIVE;
+
+typedef enum D3D_SRV_DIMENSION
+{
+	D3D_SRV_DIMENSION_UNKNOWN = 0,
+	D3D_SRV_DIMENSION_BUFFER = 1,
+	D3D_SRV_DIMENSION_TEXTURE1D = 2,
+	D3D_SRV_DIMENSION_TEXTURE1DARRAY = 3,
+	D3D_SRV_DIMENSION_TEXTURE2D = 4,
+	D3D_SRV_DIMENSION_TEXTURE2DARRAY = 5,
+	D3D_SRV_DIMENSION_TEXTURE2DMS = 6,
+	D3D_SRV_DIMENSION_TEXTURE2DMSARRAY = 7,
+	D3D_SRV_DIMENSION_TEXTURE3D = 8,
+	D3D_SRV_DIMENSION_TEXTURECUBE = 9,
+	D3D_SRV_DIMENSION_TEXTURECUBEARRAY = 10,
+	D3D_SRV_DIMENSION_BUFFEREX = 11,
+	D3D11_SRV_DIMENSION_UNKNOWN = D3D_SRV_DIMENSION_UNKNOWN,
+	D3D11_SRV_DIMENSION_BUFFER = D3D_SRV_DIMENSION_BUFFER,
+	D3D11_SRV_DIMENSION_TEXTURE1D = D3D_SRV_DIMENSION_TEXTURE1D,
+	D3D11_SRV_DIMENSION_TEXTURE1DARRAY = D3D_SRV_DIMENSION_TEXTURE1DARRAY,
+	D3D11_SRV_DIMENSION_TEXTURE2D = D3D_SRV_DIMENSION_TEXTURE2D,
+	D3D11_SRV_DIMENSION_TEXTURE2DARRAY = D3D_SRV_DIMENSION_TEXTURE2DARRAY,
+	D3D11_SRV_DIMENSION_TEXTURE2DMS = D3D_SRV_DIMENSION_TEXTURE2DMS,
+	D3D11_SRV_DIMENSION_TEXTURE2DMSARRAY = D3D_SRV_DIMENSION_TEXTURE2DMSARRAY,
+	D3D11_SRV_DIMENSION_TEXTURE3D = D3D_SRV_DIMENSION_TEXTURE3D,
+	D3D11_SRV_DIMENSION_TEXTURECUBE = D3D_SRV_DIMENSION_TEXTURECUBE,
+	D3D11_SRV_DIMENSION_TEXTURECUBEARRAY = D3D_SRV_DIMENSION_TEXTURECUBEARRAY,
+	D3D11_SRV_DIMENSION_BUFFEREX = D3D_SRV_DIMENSION_BUFFEREX
+} D3D_SRV_DIMENSION;
+
+typedef enum D3D_SHADER_INPUT_TYPE
+{
+	D3D_SIT_CBUFFER = 0,
+	D3D_SIT_TBUFFER = 1,
+	D3D_SIT_TEXTURE = 2,
+	D3D_SIT_SAMPLER = 3,
+	D3D_SIT_UAV_RWTYPED = 4,
+	D3D_SIT_STRUCTURED = 5,
+	D3D_SIT_UAV_RWSTRUCTURED = 6,
+	D3D_SIT_BYTEADDRESS = 7,
+	D3D_SIT_UAV_RWBYTEADDRESS = 8,
+	D3D_SIT_UAV_APPEND_STRUCTURED = 9,
+	D3D_SIT_UAV_CONSUME_STRUCTURED = 10,
+	D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER = 11,
+	D3D_SIT_RTACCELERATIONSTRUCTURE = 12,
+	D3D_SIT_UAV_FEEDBACKTEXTURE = 13
+} D3D_SHADER_INPUT_TYPE;
+
+typedef enum D3D_SHADER_CBUFFER_FLAGS
+{
+	D3D_CBF_USERPACKED = 1
+} D3D_SHADER_CBUFFER_FLAGS;
+
+typedef enum D3D_CBUFFER_TYPE
+{
+	D3D_CT_CBUFFER = 0,
+	D3D_CT_TBUFFER = 1,
+	D3D_CT_INTERFACE_POINTERS = 2,
+	D3D_CT_RESOURCE_BIND_INFO = 3
+} D3D_CBUFFER_TYPE;
+
+typedef enum D3D_RESOURCE_RETURN_TYPE
+{
+	D3D_RETURN_TYPE_UNORM = 1,
+	D3D_RETURN_TYPE_SNORM = 2,
+	D3D_RETURN_TYPE_SINT = 3,
+	D3D_RETURN_TYPE_UINT = 4,
+	D3D_RETURN_TYPE_FLOAT = 5,
+	D3D_RETURN_TYPE_MIXED = 6,
+	D3D_RETURN_TYPE_DOUBLE = 7,
+	D3D_RETURN_TYPE_CONTINUED = 8
+} D3D_RESOURCE_RETURN_TYPE;
+
+typedef enum D3D_REGISTER_COMPONENT_TYPE
+{
+	D3D_REGISTER_COMPONENT_UNKNOWN = 0,
+	D3D_REGISTER_COMPONENT_UINT32 = 1,
+	D3D_REGISTER_COMPONENT_SINT32 = 2,
+	D3D_REGISTER_COMPONENT_FLOAT32 = 3
+} D3D_REGISTER_COMPONENT_TYPE;
+
+typedef enum D3D_NAME
+{
+	D3D_NAME_UNDEFINED = 0,
+	D3D_NAME_POSITION = 1,
+	D3D_NAME_CLIP_DISTANCE = 2,
+	D3D_NAME_CULL_DISTANCE = 3,
+	D3D_NAME_RENDER_TARGET_ARRAY_INDEX = 4,
+	D3D_NAME_VIEWPORT_ARRAY_INDEX = 5,
+	D3D_NAME_VERTEX_ID = 6,
+	D3D_NAME_PRIMITIVE_ID = 7,
+	D3D_NAME_INSTANCE_ID = 8,
+	D3D_NAME_IS_FRONT_FACE = 9,
+	D3D_NAME_SAMPLE_INDEX = 10,
+	D3D_NAME_TARGET = 64,
+	D3D_NAME_DEPTH = 65
+} D3D_NAME;
+
+typedef enum D3D_MIN_PRECISION
+{
+	D3D_MIN_PRECISION_DEFAULT = 0
+} D3D_MIN_PRECISION;
+
+typedef enum D3D_SHADER_VARIABLE_CLASS
+{
+	D3D_SVC_SCALAR = 0,
+	D3D_SVC_VECTOR = 1,
+	D3D_SVC_MATRIX_ROWS = 2,
+	D3D_SVC_MATRIX_COLUMNS = 3,
+	D3D_SVC_OBJECT = 4,
+	D3D_SVC_STRUCT = 5
+} D3D_SHADER_VARIABLE_CLASS;
+
+typedef enum D3D_SHADER_VARIABLE_TYPE
+{
+	D3D_SVT_VOID = 0,
+	D3D_SVT_BOOL = 1,
+	D3D_SVT_INT = 2,
+	D3D_SVT_FLOAT = 3,
+	D3D_SVT_UINT = 19,
+	D3D_SVT_DOUBLE = 39
+} D3D_SHADER_VARIABLE_TYPE;
+
+typedef enum D3D_TESSELLATOR_DOMAIN
+{
+	D3D_TESSELLATOR_DOMAIN_UNDEFINED = 0
+} D3D_TESSELLATOR_DOMAIN;
+
+typedef enum D3D_TESSELLATOR_PARTITIONING
+{
+	D3D_TESSELLATOR_PARTITIONING_UNDEFINED = 0
+} D3D_TESSELLATOR_PARTITIONING;
+
+typedef enum D3D_TESSELLATOR_OUTPUT_PRIMITIVE
+{
+	D3D_TESSELLATOR_OUTPUT_UNDEFINED = 0
+} D3D_TESSELLATOR_OUTPUT_PRIMITIVE;
+
+typedef enum D3D_INTERPOLATION_MODE
+{
+	D3D_INTERPOLATION_UNDEFINED = 0
+} D3D_INTERPOLATION_MODE;
+
+typedef enum D3D_PARAMETER_FLAGS
+{
+	D3D_PF_NONE = 0
+} D3D_PARAMETER_FLAGS;
@@ -0,0 +1,212 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+// Microsoft::WRL::ComPtr, the members the research code uses
+
+#include <WinAdapter.h>
+
+namespace Microsoft::WRL
+{
+	template <typename T>
+	class ComPtr
+	{
+	private:
+		template <typename U>
+		friend class ComPtr;
+
+		T *ptr = nullptr;
+
+	public:
+		using InterfaceType = T;
+
+		ComPtr() = default;
+
+		ComPtr(std::nullptr_t)
+		{
+
+		}
+
+		template <typename U>
+		ComPtr(U *other)
+		: ptr(other)
+		{
+			internal_add_ref();
+		}
+
+		ComPtr(const ComPtr &other)
+		: ptr(other.ptr)
+		{
+			internal_add_ref();
+		}
+
+		template <typename U>
+		ComPtr(const ComPtr<U> &other)
+		: ptr(other.ptr)
+		{
+			internal_add_ref();
+		}
+
+		ComPtr(ComPtr &&other) noexcept
+		: ptr(other.ptr)
+		{
+			other.ptr = nullptr;
+		}
+
+		template <typename U>
+		ComPtr(ComPtr<U> &&other) noexcept
+		: ptr(other.ptr)
+		{
+			other.ptr = nullptr;
+		}
+
+		~ComPtr()
+		{
+			internal_release();
+		}
+
+		ComPtr &operator=(std::nullptr_t)
+		{
+			internal_release();
+			return *this;
+		}
+
+		ComPtr &operator=(T *other)
+		{
+			if (ptr != other) {
+				ComPtr(other).Swap(*this);
+			}
+			return *this;
+		}
+
+		ComPtr &operator=(const ComPtr &other)
+		{
+			if (ptr != other.ptr) {
+				ComPtr(other).Swap(*this);
+			}
+			return *this;
+		}
+
+		template <typename U>
+		ComPtr &operator=(const ComPtr<U> &other)
+		{
+			ComPtr(other).Swap(*this);
+			return *this;
+		}
+
+		ComPtr &operator=(ComPtr &&other) noexcept
+		{
+			ComPtr(static_cast<ComPtr &&>(other)).Swap(*this);
+			return *this;
+		}
+
+		template <typename U>
+		ComPtr &operator=(ComPtr<U> &&other) noexcept
+		{
+			ComPtr(static_cast<ComPtr<U> &&>(other)).Swap(*this);
+			return *this;
+		}
+
+		void Swap(ComPtr &other)
+		{
+			T *temporary = ptr;
+			ptr = other.ptr;
+			other.ptr = temporary;
+		}
+
+		explicit operator bool() const { return ptr != nullptr; }
+
+		T *Get() const { return ptr; }
+
+		T *operator->() const { return ptr; }
+
+		T *const *GetAddressOf() const { return &ptr; }
+
+		T **GetAddressOf() { return &ptr; }
+
+		T **ReleaseAndGetAddressOf()
+		{
+			internal_release();
+			return &ptr;
+		}
+
+		T *Detach()
+		{
+			T *detached = ptr;
+			ptr = nullptr;
+			return detached;
+		}
+
+		void Attach(T *other)
+		{
+			internal_release();
+			ptr = other;
+		}
+
+		unsigned long Reset()
+		{
+			internal_release();
+			return 0;
+		}
+
+		HRESULT CopyTo(T **other) const
+		{
+			internal_add_ref();
+			*other = ptr;
+			return S_OK;
+		}
+
+		template <typename U>
+		HRESULT CopyTo(U **other) const
+		{
+			return ptr->QueryInterface(__uuidof(U), reinterpret_cast<void **>(other));
+		}
+
+		template <typename U>
+		HRESULT As(ComPtr<U> *other) const
+		{
+			return ptr->QueryInterface(__uuidof(U), reinterpret_cast<void **>(other->ReleaseAndGetAddressOf()));
+		}
+
+	private:
+		void internal_add_ref() const
+		{
+			if (ptr != nullptr) {
+				ptr->AddRef();
+			}
+		}
+
+		void internal_release()
+		{
+			T *released = ptr;
+			if (released != nullptr) {
+				ptr = nullptr;
+				released->Release();
+			}
+		}
+	};
+
+	template <typename T, typename U>
+	bool operator==(const ComPtr<T> &lhs, const ComPtr<U> &rhs)
+	{
+		return lhs.Get() == rhs.Get();
+	}
+
+	template <typename T>
+	bool operator==(const ComPtr<T> &lhs, std::nullptr_t)
+	{
+		return lhs.Get() == nullptr;
+	}
+}
+
+namespace compat
+{
+	// IID_PPV_ARGS(&com_ptr) as with the real ComPtr
+	template <typename T>
+	constexpr const GUID &query_uuid(Microsoft::WRL::ComPtr<T> *)
+	{
+		return uuid_of<T>;
+	}
+}
@@ -0,0 +1,133 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+// Microsoft::WRL::RuntimeClass and Make for classic com objects, interface ids are compared by value
+// so objects handed to libdxcompiler.so answer the ids it asks for
+
+#include <wrl/client.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace Microsoft::WRL
+{
+	enum RuntimeClassType
+	{
+		WinRt = 1,
+		ClassicCom = 2,
+		WinRtClassicComMix = 3
+	};
+
+	template <unsigned int flags>
+	struct RuntimeClassFlags
+	{
+
+	};
+
+	// The first interface is implemented, the others are bases of it that QueryInterface answers as well
+	template <typename I0, typename... Bases>
+	struct ChainInterfaces : I0
+	{
+
+	};
+
+	namespace Details
+	{
+		template <typename Interface>
+		struct InterfaceTraits
+		{
+			template <typename Self>
+			static bool query(Self *self, REFIID riid, void **object)
+			{
+				if (riid == __uuidof(Interface)) {
+					*object = static_cast<Interface *>(self);
+					return true;
+				}
+				return false;
+			}
+		};
+
+		template <typename I0, typename... Bases>
+		struct InterfaceTraits<ChainInterfaces<I0, Bases...>>
+		{
+			template <typename Self>
+			static bool query(Self *self, REFIID riid, void **object)
+			{
+				auto chained = static_cast<I0 *>(static_cast<ChainInterfaces<I0, Bases...> *>(self));
+				if (riid == __uuidof(I0)) {
+					*object = chained;
+					return true;
+				}
+				return ((riid == __uuidof(Bases) ? (*object = static_cast<Bases *>(chained), true) : false) || ...);
+			}
+		};
+
+		template <typename First, typename... Rest>
+		struct FirstInterface
+		{
+			using Type = First;
+		};
+
+		template <typename I0, typename... Bases, typename... Rest>
+		struct FirstInterface<ChainInterfaces<I0, Bases...>, Rest...>
+		{
+			using Type = I0;
+		};
+	}
+
+	template <typename Flags, typename... Interfaces>
+	class RuntimeClass : public Interfaces...
+	{
+	private:
+		std::atomic<ULONG> reference_count{ 1 };
+
+	public:
+		RuntimeClass() = default;
+
+		RuntimeClass(const RuntimeClass &) = delete;
+		RuntimeClass &operator=(const RuntimeClass &) = delete;
+
+		~RuntimeClass() override = default;
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **object) override
+		{
+			if (object == nullptr) {
+				return E_POINTER;
+			}
+			*object = nullptr;
+			if (riid == __uuidof(IUnknown)) {
+				using FirstInterface = typename Details::FirstInterface<Interfaces...>::Type;
+				*object = static_cast<IUnknown *>(static_cast<FirstInterface *>(this));
+			} else if (!(Details::InterfaceTraits<Interfaces>::query(this, riid, object) || ...)) {
+				return E_NOINTERFACE;
+			}
+			AddRef();
+			return S_OK;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return reference_count.fetch_add(1, std::memory_order_relaxed) + 1;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			const ULONG remaining = reference_count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+			if (remaining == 0) {
+				delete this;
+			}
+			return remaining;
+		}
+	};
+
+	template <typename T, typename... Args>
+	ComPtr<T> Make(Args &&...args)
+	{
+		ComPtr<T> object{};
+		object.Attach(new (std::nothrow) T(std::forward<Args>(args)...));
+		return object;
+	}
+}
@@ -0,0 +1,375 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+// Stand-in for libdxcompiler.so where the real one isn't installed, loaded through DxcInStance::set_compiler_path
+// It compiles nothing, the "bytecode" is the preprocessed source, but reflection, include handling, shader hashes
+// and DxcCreateInstance2 allocation behave like dxc so the effect layer runs unchanged on top of it
+
+#include <hlsl_reflection.h>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <wrl/implements.h>
+
+namespace toy
+{
+	using Microsoft::WRL::ComPtr;
+
+	static constexpr std::string_view s_bytecode_magic = "DXIL";
+
+	// Blob memory comes from the IMalloc the creating object was given, like dxc's own blobs
+	struct FakeBlob final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+		Microsoft::WRL::ChainInterfaces<IDxcBlobUtf8, IDxcBlobEncoding, IDxcBlob>>
+	{
+	private:
+		ComPtr<IMalloc> allocator = nullptr;
+		char *data = nullptr;
+		size_t size_in_bytes = 0;
+
+	public:
+		FakeBlob(IMalloc *input_allocator, std::string_view content)
+		: allocator(input_allocator), size_in_bytes(content.size())
+		{
+			data = static_cast<char *>(allocator != nullptr ? allocator->Alloc(size_in_bytes + 1) : std::malloc(size_in_bytes + 1));
+			if (data != nullptr) {
+				std::memcpy(data, content.data(), size_in_bytes);
+				data[size_in_bytes] = '\0';
+			}
+		}
+
+		~FakeBlob() override
+		{
+			if (allocator != nullptr) {
+				allocator->Free(data);
+			} else {
+				std::free(data);
+			}
+		}
+
+		LPVOID STDMETHODCALLTYPE GetBufferPointer() override { return data; }
+		SIZE_T STDMETHODCALLTYPE GetBufferSize() override { return size_in_bytes; }
+
+		HRESULT STDMETHODCALLTYPE GetEncoding(BOOL *is_known, UINT32 *code_page) override
+		{
+			*is_known = TRUE;
+			*code_page = DXC_CP_UTF8;
+			return S_OK;
+		}
+
+		LPCSTR STDMETHODCALLTYPE GetStringPointer() override { return data; }
+		SIZE_T STDMETHODCALLTYPE GetStringLength() override { return size_in_bytes; }
+	};
+
+	static HRESULT create_blob(IMalloc *allocator, std::string_view content, REFIID riid, void **object)
+	{
+		auto blob = Microsoft::WRL::Make<FakeBlob>(allocator, content);
+		if (blob == nullptr || blob->GetBufferPointer() == nullptr) {
+			*object = nullptr;
+			return E_OUTOFMEMORY;
+		}
+		return blob->QueryInterface(riid, object);
+	}
+
+	// Files relative to the working directory or absolute
+	struct FakeIncludeHandler final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IDxcIncludeHandler>
+	{
+		HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR filename, IDxcBlob **include_source) override
+		{
+			*include_source = nullptr;
+			std::ifstream source_file{ std::filesystem::path(filename), std::ios::binary };
+			if (!source_file) {
+				return E_FAIL;
+			}
+			const std::string source{ std::istreambuf_iterator<char>(source_file), std::istreambuf_iterator<char>() };
+			return create_blob(nullptr, source, __uuidof(IDxcBlob), reinterpret_cast<void **>(include_source));
+		}
+	};
+
+	struct FakeResult final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+		Microsoft::WRL::ChainInterfaces<IDxcResult, IDxcOperationResult>>
+	{
+	private:
+		ComPtr<IMalloc> allocator = nullptr;
+
+	public:
+		HRESULT status = S_OK;
+		std::string errors = {};
+		std::string object = {};
+		std::string reflection = {};
+		DxcShaderHash shader_hash{};
+
+		explicit FakeResult(IMalloc *input_allocator)
+		: allocator(input_allocator)
+		{
+
+		}
+
+		HRESULT STDMETHODCALLTYPE GetStatus(HRESULT *result_status) override
+		{
+			*result_status = status;
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetResult(IDxcBlob **result) override
+		{
+			return GetOutput(DXC_OUT_OBJECT, __uuidof(IDxcBlob), reinterpret_cast<void **>(result), nullptr);
+		}
+
+		HRESULT STDMETHODCALLTYPE GetErrorBuffer(IDxcBlobEncoding **error_buffer) override
+		{
+			return GetOutput(DXC_OUT_ERRORS, __uuidof(IDxcBlobEncoding), reinterpret_cast<void **>(error_buffer), nullptr);
+		}
+
+		BOOL STDMETHODCALLTYPE HasOutput(DXC_OUT_KIND output_kind) override
+		{
+			return output_kind == DXC_OUT_ERRORS || (SUCCEEDED(status) && (output_kind == DXC_OUT_OBJECT || output_kind == DXC_OUT_REFLECTION || output_kind == DXC_OUT_SHADER_HASH));
+		}
+
+		HRESULT STDMETHODCALLTYPE GetOutput(DXC_OUT_KIND output_kind, REFIID riid, void **output, IDxcBlobWide **output_name) override
+		{
+			*output = nullptr;
+			if (output_name != nullptr) {
+				*output_name = nullptr;
+			}
+			if (!HasOutput(output_kind)) {
+				return E_INVALIDARG;
+			}
+			switch (output_kind)
+			{
+				case DXC_OUT_ERRORS:
+					return create_blob(allocator.Get(), errors, riid, output);
+				case DXC_OUT_OBJECT:
+					return create_blob(allocator.Get(), object, riid, output);
+				case DXC_OUT_REFLECTION:
+					return create_blob(allocator.Get(), reflection, riid, output);
+				case DXC_OUT_SHADER_HASH:
+					return create_blob(allocator.Get(), { reinterpret_cast<const char *>(&shader_hash), sizeof(shader_hash) }, riid, output);
+				default:
+					return E_INVALIDARG;
+			}
+		}
+
+		UINT32 STDMETHODCALLTYPE GetNumOutputs() override { return SUCCEEDED(status) ? 4 : 1; }
+
+		DXC_OUT_KIND STDMETHODCALLTYPE GetOutputByIndex(UINT32 index) override
+		{
+			static constexpr std::array<DXC_OUT_KIND, 4> s_output_kinds = { DXC_OUT_ERRORS, DXC_OUT_OBJECT, DXC_OUT_REFLECTION, DXC_OUT_SHADER_HASH };
+			return index < GetNumOutputs() ? s_output_kinds[index] : DXC_OUT_NONE;
+		}
+
+		DXC_OUT_KIND STDMETHODCALLTYPE PrimaryOutput() override { return DXC_OUT_OBJECT; }
+	};
+
+	struct FakeCompiler final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IDxcCompiler3>
+	{
+	private:
+		ComPtr<IMalloc> allocator = nullptr;
+
+	public:
+		explicit FakeCompiler(IMalloc *input_allocator)
+		: allocator(input_allocator)
+		{
+
+		}
+
+		HRESULT STDMETHODCALLTYPE Compile(const DxcBuffer *source_buffer, LPCWSTR *arguments, UINT32 argument_count, IDxcIncludeHandler *include_handler,
+										  REFIID riid, LPVOID *result) override
+		{
+			*result = nullptr;
+			std::string entry_point = "main";
+			std::string target_profile = {};
+			std::vector<std::filesystem::path> include_directories{};
+			bool is_row_major = false;
+			for (UINT32 index = 0; index < argument_count; ++index)
+			{
+				const std::wstring_view argument = arguments[index];
+				if ((argument == L"-E" || argument == L"-T") && index + 1 < argument_count) {
+					const std::wstring_view value = arguments[++index];
+					(argument == L"-E" ? entry_point : target_profile) = std::string(value.begin(), value.end());
+				} else if (argument == L"-I" && index + 1 < argument_count) {
+					include_directories.emplace_back(arguments[++index]);
+				} else if (argument == DXC_ARG_PACK_MATRIX_ROW_MAJOR) {
+					is_row_major = true;
+				} else if (argument == DXC_ARG_PACK_MATRIX_COLUMN_MAJOR) {
+					is_row_major = false;
+				}
+			}
+
+			auto compile_result = Microsoft::WRL::Make<FakeResult>(allocator.Get());
+			if (compile_result == nullptr) {
+				return E_OUTOFMEMORY;
+			}
+			std::string source{ static_cast<const char *>(source_buffer->Ptr), source_buffer->Size };
+			if (!expand_includes(source, include_handler, include_directories, compile_result->errors)) {
+				compile_result->status = E_FAIL;
+				return compile_result->QueryInterface(riid, result);
+			}
+			const auto reflection = reflect_hlsl(source, entry_point, target_profile, is_row_major);
+			if (!reflection.has_entry_point || D3D12_SHVER_GET_TYPE(reflection.version) == D3D12_SHVER_RESERVED0) {
+				compile_result->errors = reflection.has_entry_point ? "error: unknown target profile '" + target_profile + "'" : "error: missing entry point definition '" + entry_point + "'";
+				compile_result->status = E_FAIL;
+				return compile_result->QueryInterface(riid, result);
+			}
+
+			compile_result->object = std::string(s_bytecode_magic) + source;
+			compile_result->reflection = make_reflection_part(source, entry_point, target_profile, is_row_major);
+			write_shader_hash(compile_result->object, compile_result->shader_hash);
+			return compile_result->QueryInterface(riid, result);
+		}
+
+		HRESULT STDMETHODCALLTYPE Disassemble(const DxcBuffer *, REFIID, LPVOID *result) override
+		{
+			*result = nullptr;
+			return E_NOTIMPL;
+		}
+
+	private:
+		// #include "file" lines are replaced by the file, scratch memory goes through the allocator like a real compile's would
+		bool expand_includes(std::string &source, IDxcIncludeHandler *include_handler, std::span<const std::filesystem::path> include_directories, std::string &errors)
+		{
+			size_t search_offset = 0;
+			for (uint32_t include_count = 0; include_count < 256; )
+			{
+				const size_t include_begin = source.find("#include", search_offset);
+				if (include_begin == std::string::npos) {
+					return true;
+				}
+				const size_t name_begin = source.find_first_of("\"<", include_begin);
+				const size_t name_end = name_begin == std::string::npos ? std::string::npos : source.find_first_of("\">", name_begin + 1);
+				const size_t line_end = source.find('\n', include_begin);
+				if (name_end == std::string::npos || (line_end != std::string::npos && name_end > line_end)) {
+					errors = "error: malformed #include";
+					return false;
+				}
+				const std::string file_name = source.substr(name_begin + 1, name_end - name_begin - 1);
+				// The working directory first, then the -I directories in order
+				ComPtr<IDxcBlob> include_source = nullptr;
+				for (size_t directory_index = 0; include_handler != nullptr && include_source == nullptr && directory_index <= include_directories.size(); ++directory_index)
+				{
+					const auto include_path = directory_index == 0 ? std::filesystem::path(file_name) : include_directories[directory_index - 1] / file_name;
+					include_handler->LoadSource(include_path.wstring().c_str(), include_source.GetAddressOf());
+				}
+				if (include_source == nullptr) {
+					errors = "error: '" + file_name + "' file not found";
+					return false;
+				}
+
+				void *scratch = allocator != nullptr ? allocator->Alloc(include_source->GetBufferSize() + 1) : nullptr;
+				source.replace(include_begin, name_end + 1 - include_begin, static_cast<const char *>(include_source->GetBufferPointer()), include_source->GetBufferSize());
+				if (allocator != nullptr) {
+					allocator->Free(scratch);
+				}
+				search_offset = include_begin;
+				++include_count;
+			}
+			errors = "error: too many #include directives";
+			return false;
+		}
+
+		static void write_shader_hash(std::string_view bytecode, DxcShaderHash &shader_hash)
+		{
+			uint64_t hash_low = 0xcbf29ce484222325ULL;
+			uint64_t hash_high = 0x84222325cbf29ce4ULL;
+			for (const char character : bytecode)
+			{
+				hash_low = (hash_low ^ static_cast<uint8_t>(character)) * 0x100000001b3ULL;
+				hash_high = (hash_high ^ static_cast<uint8_t>(character)) * 0x100000001b3ULL + 1;
+			}
+			shader_hash.Flags = 0;
+			std::memcpy(shader_hash.HashDigest, &hash_low, sizeof(hash_low));
+			std::memcpy(shader_hash.HashDigest + sizeof(hash_low), &hash_high, sizeof(hash_high));
+		}
+	};
+
+	// Accepts anything this compiler produced
+	struct FakeValidator final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IDxcValidator>
+	{
+		HRESULT STDMETHODCALLTYPE Validate(IDxcBlob *shader, UINT32, IDxcOperationResult **result) override
+		{
+			auto validation_result = Microsoft::WRL::Make<FakeResult>(nullptr);
+			const std::string_view bytecode{ static_cast<const char *>(shader->GetBufferPointer()), shader->GetBufferSize() };
+			if (!bytecode.starts_with(s_bytecode_magic)) {
+				validation_result->status = E_FAIL;
+				validation_result->errors = "error: not a dxil container";
+			}
+			return validation_result->QueryInterface(__uuidof(IDxcOperationResult), reinterpret_cast<void **>(result));
+		}
+	};
+
+	struct FakeUtils final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IDxcUtils>
+	{
+		HRESULT STDMETHODCALLTYPE CreateBlobFromBlob(IDxcBlob *, UINT32, UINT32, IDxcBlob **) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE CreateBlobFromPinned(LPCVOID, UINT32, UINT32, IDxcBlobEncoding **) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE MoveToBlob(LPCVOID, IMalloc *, UINT32, UINT32, IDxcBlobEncoding **) override { return E_NOTIMPL; }
+
+		HRESULT STDMETHODCALLTYPE CreateBlob(LPCVOID data, UINT32 size_in_bytes, UINT32, IDxcBlobEncoding **blob) override
+		{
+			return create_blob(nullptr, { static_cast<const char *>(data), size_in_bytes }, __uuidof(IDxcBlobEncoding), reinterpret_cast<void **>(blob));
+		}
+
+		HRESULT STDMETHODCALLTYPE LoadFile(LPCWSTR filename, UINT32 *, IDxcBlobEncoding **blob) override
+		{
+			std::ifstream source_file{ std::filesystem::path(filename), std::ios::binary };
+			if (!source_file) {
+				*blob = nullptr;
+				return E_FAIL;
+			}
+			const std::string source{ std::istreambuf_iterator<char>(source_file), std::istreambuf_iterator<char>() };
+			return create_blob(nullptr, source, __uuidof(IDxcBlobEncoding), reinterpret_cast<void **>(blob));
+		}
+
+		HRESULT STDMETHODCALLTYPE CreateReadOnlyStreamFromBlob(IDxcBlob *, IStream **) override { return E_NOTIMPL; }
+
+		HRESULT STDMETHODCALLTYPE CreateDefaultIncludeHandler(IDxcIncludeHandler **include_handler) override
+		{
+			*include_handler = Microsoft::WRL::Make<FakeIncludeHandler>().Detach();
+			return *include_handler != nullptr ? S_OK : E_OUTOFMEMORY;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetBlobAsUtf8(IDxcBlob *, IDxcBlobUtf8 **) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE GetBlobAsWide(IDxcBlob *, IDxcBlobWide **) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE GetDxilContainerPart(const DxcBuffer *, UINT32, void **, UINT32 *) override { return E_NOTIMPL; }
+
+		HRESULT STDMETHODCALLTYPE CreateReflection(const DxcBuffer *reflection_buffer, REFIID riid, void **reflection) override
+		{
+			return create_shader_reflection(*reflection_buffer, riid, reflection);
+		}
+
+		HRESULT STDMETHODCALLTYPE BuildArguments(LPCWSTR, LPCWSTR, LPCWSTR, LPCWSTR *, UINT32, const DxcDefine *, UINT32, IDxcCompilerArgs **) override { return E_NOTIMPL; }
+		HRESULT STDMETHODCALLTYPE GetPDBContents(IDxcBlob *, IDxcBlob **, IDxcBlob **) override { return E_NOTIMPL; }
+	};
+
+	static HRESULT create_instance(IMalloc *allocator, REFCLSID clsid, REFIID riid, void **object)
+	{
+		*object = nullptr;
+		if (clsid == CLSID_DxcCompiler) {
+			auto compiler = Microsoft::WRL::Make<FakeCompiler>(allocator);
+			return compiler != nullptr ? compiler->QueryInterface(riid, object) : E_OUTOFMEMORY;
+		}
+		if (clsid == CLSID_DxcUtils) {
+			auto utils = Microsoft::WRL::Make<FakeUtils>();
+			return utils != nullptr ? utils->QueryInterface(riid, object) : E_OUTOFMEMORY;
+		}
+		if (clsid == CLSID_DxcValidator) {
+			auto validator = Microsoft::WRL::Make<FakeValidator>();
+			return validator != nullptr ? validator->QueryInterface(riid, object) : E_OUTOFMEMORY;
+		}
+		return E_NOINTERFACE;
+	}
+}
+
+extern "C" HRESULT DxcCreateInstance(REFCLSID clsid, REFIID riid, LPVOID *object)
+{
+	return toy::create_instance(nullptr, clsid, riid, object);
+}
+
+extern "C" HRESULT DxcCreateInstance2(IMalloc *allocator, REFCLSID clsid, REFIID riid, LPVOID *object)
+{
+	return toy::create_instance(allocator, clsid, riid, object);
+}
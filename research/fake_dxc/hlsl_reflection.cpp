@@ -0,0 +1,1029 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <hlsl_reflection.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+#include <wrl/implements.h>
+
+namespace toy
+{
+	static constexpr std::string_view s_reflection_part_magic = "FRDT";
+
+	// Tokens
+	static bool is_identifier_char(char character)
+	{
+		return std::isalnum(static_cast<unsigned char>(character)) || character == '_';
+	}
+
+	// Comments and preprocessor lines removed, single token object-like macros are substituted
+	static std::vector<std::string> tokenize(std::string_view source)
+	{
+		std::vector<std::string> tokens{};
+		std::unordered_map<std::string, std::string> defines{};
+		size_t index = 0;
+		bool is_line_start = true;
+		while (index < source.size())
+		{
+			const char character = source[index];
+			if (character == '\n') {
+				is_line_start = true;
+				++index;
+				continue;
+			}
+			if (std::isspace(static_cast<unsigned char>(character))) {
+				++index;
+				continue;
+			}
+			if (source.substr(index, 2) == "//") {
+				index = source.find('\n', index);
+				index = index == std::string_view::npos ? source.size() : index;
+				continue;
+			}
+			if (source.substr(index, 2) == "/*") {
+				index = source.find("*/", index + 2);
+				index = index == std::string_view::npos ? source.size() : index + 2;
+				continue;
+			}
+			if (character == '#' && is_line_start) {
+				size_t line_end = source.find('\n', index);
+				line_end = line_end == std::string_view::npos ? source.size() : line_end;
+				const auto directive_tokens = tokenize(source.substr(index + 1, line_end - index - 1));
+				if (directive_tokens.size() == 3 && directive_tokens[0] == "define") {
+					defines[directive_tokens[1]] = directive_tokens[2];
+				}
+				index = line_end;
+				continue;
+			}
+			is_line_start = false;
+
+			if (character == '"') {
+				const size_t string_end = source.find('"', index + 1);
+				index = string_end == std::string_view::npos ? source.size() : string_end + 1;
+				continue;
+			}
+			if (is_identifier_char(character) || (character == '.' && index + 1 < source.size() && std::isdigit(static_cast<unsigned char>(source[index + 1])))) {
+				size_t token_end = index + 1;
+				while (token_end < source.size() && (is_identifier_char(source[token_end]) || source[token_end] == '.'))
+				{
+					++token_end;
+				}
+				std::string token{ source.substr(index, token_end - index) };
+				if (auto define_iter = defines.find(token); define_iter != defines.end()) {
+					token = define_iter->second;
+				}
+				tokens.emplace_back(std::move(token));
+				index = token_end;
+				continue;
+			}
+			tokens.emplace_back(1, character);
+			++index;
+		}
+		return tokens;
+	}
+
+	static uint32_t parse_uint(std::string_view token)
+	{
+		uint32_t value = 0;
+		for (const char character : token)
+		{
+			if (!std::isdigit(static_cast<unsigned char>(character))) {
+				break;
+			}
+			value = value * 10 + static_cast<uint32_t>(character - '0');
+		}
+		return value;
+	}
+
+	static uint32_t align_register(uint32_t offset)
+	{
+		return (offset + 15) & ~uint32_t{ 15 };
+	}
+
+	// Numeric types
+	struct NumericType
+	{
+		D3D_SHADER_VARIABLE_TYPE variable_type = D3D_SVT_VOID;
+		D3D_REGISTER_COMPONENT_TYPE component_type = D3D_REGISTER_COMPONENT_UNKNOWN;
+		uint32_t scalar_size = 0;
+		uint32_t rows = 1;
+		uint32_t columns = 1;
+		bool is_matrix = false;
+	};
+
+	// "float", "uint3", "float4x4", "matrix", unknown names have no variable type
+	static NumericType parse_numeric_type(std::string_view type_name)
+	{
+		static constexpr std::array<std::pair<std::string_view, NumericType>, 12> s_scalar_types{ {
+			{ "float", { D3D_SVT_FLOAT, D3D_REGISTER_COMPONENT_FLOAT32, 4 } },
+			{ "half", { D3D_SVT_FLOAT, D3D_REGISTER_COMPONENT_FLOAT32, 4 } },
+			{ "min16float", { D3D_SVT_FLOAT, D3D_REGISTER_COMPONENT_FLOAT32, 4 } },
+			{ "double", { D3D_SVT_DOUBLE, D3D_REGISTER_COMPONENT_UNKNOWN, 8 } },
+			{ "int", { D3D_SVT_INT, D3D_REGISTER_COMPONENT_SINT32, 4 } },
+			{ "min16int", { D3D_SVT_INT, D3D_REGISTER_COMPONENT_SINT32, 4 } },
+			{ "uint", { D3D_SVT_UINT, D3D_REGISTER_COMPONENT_UINT32, 4 } },
+			{ "min16uint", { D3D_SVT_UINT, D3D_REGISTER_COMPONENT_UINT32, 4 } },
+			{ "dword", { D3D_SVT_UINT, D3D_REGISTER_COMPONENT_UINT32, 4 } },
+			{ "bool", { D3D_SVT_BOOL, D3D_REGISTER_COMPONENT_UINT32, 4 } },
+			{ "matrix", { D3D_SVT_FLOAT, D3D_REGISTER_COMPONENT_FLOAT32, 4, 4, 4, true } },
+			{ "vector", { D3D_SVT_FLOAT, D3D_REGISTER_COMPONENT_FLOAT32, 4, 1, 4, false } },
+		} };
+		for (auto &&[scalar_name, scalar_type] : s_scalar_types)
+		{
+			if (!type_name.starts_with(scalar_name)) {
+				continue;
+			}
+			const auto suffix = type_name.substr(scalar_name.size());
+			auto numeric_type = scalar_type;
+			if (suffix.empty()) {
+				return numeric_type;
+			}
+			if (numeric_type.is_matrix || numeric_type.columns != 1) {
+				continue;
+			}
+			if (suffix.size() == 1 && suffix[0] >= '1' && suffix[0] <= '4') {
+				numeric_type.columns = parse_uint(suffix);
+				return numeric_type;
+			}
+			if (suffix.size() == 3 && suffix[1] == 'x' && suffix[0] >= '1' && suffix[0] <= '4' && suffix[2] >= '1' && suffix[2] <= '4') {
+				numeric_type.rows = parse_uint(suffix.substr(0, 1));
+				numeric_type.columns = parse_uint(suffix.substr(2));
+				numeric_type.is_matrix = true;
+				return numeric_type;
+			}
+		}
+		return {};
+	}
+
+	// Resource types
+	struct ResourceKind
+	{
+		std::string_view keyword = {};
+		D3D_SHADER_INPUT_TYPE input_type = D3D_SIT_TEXTURE;
+		D3D_SRV_DIMENSION dimension = D3D_SRV_DIMENSION_UNKNOWN;
+		char register_class = 't';
+	};
+
+	static constexpr std::array<ResourceKind, 25> s_resource_kinds{ {
+		{ "Texture1D", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE1D, 't' },
+		{ "Texture1DArray", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE1DARRAY, 't' },
+		{ "Texture2D", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE2D, 't' },
+		{ "Texture2DArray", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE2DARRAY, 't' },
+		{ "Texture2DMS", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE2DMS, 't' },
+		{ "Texture2DMSArray", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE2DMSARRAY, 't' },
+		{ "Texture3D", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURE3D, 't' },
+		{ "TextureCube", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURECUBE, 't' },
+		{ "TextureCubeArray", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_TEXTURECUBEARRAY, 't' },
+		{ "Buffer", D3D_SIT_TEXTURE, D3D_SRV_DIMENSION_BUFFER, 't' },
+		{ "StructuredBuffer", D3D_SIT_STRUCTURED, D3D_SRV_DIMENSION_BUFFER, 't' },
+		{ "ByteAddressBuffer", D3D_SIT_BYTEADDRESS, D3D_SRV_DIMENSION_BUFFER, 't' },
+		{ "RWTexture1D", D3D_SIT_UAV_RWTYPED, D3D_SRV_DIMENSION_TEXTURE1D, 'u' },
+		{ "RWTexture1DArray", D3D_SIT_UAV_RWTYPED, D3D_SRV_DIMENSION_TEXTURE1DARRAY, 'u' },
+		{ "RWTexture2D", D3D_SIT_UAV_RWTYPED, D3D_SRV_DIMENSION_TEXTURE2D, 'u' },
+		{ "RWTexture2DArray", D3D_SIT_UAV_RWTYPED, D3D_SRV_DIMENSION_TEXTURE2DARRAY, 'u' },
+		{ "RWTexture3D", D3D_SIT_UAV_RWTYPED, D3D_SRV_DIMENSION_TEXTURE3D, 'u' },
+		{ "RWBuffer", D3D_SIT_UAV_RWTYPED, D3D_SRV_DIMENSION_BUFFER, 'u' },
+		{ "RWStructuredBuffer", D3D_SIT_UAV_RWSTRUCTURED, D3D_SRV_DIMENSION_BUFFER, 'u' },
+		{ "RWByteAddressBuffer", D3D_SIT_UAV_RWBYTEADDRESS, D3D_SRV_DIMENSION_BUFFER, 'u' },
+		{ "AppendStructuredBuffer", D3D_SIT_UAV_APPEND_STRUCTURED, D3D_SRV_DIMENSION_BUFFER, 'u' },
+		{ "ConsumeStructuredBuffer", D3D_SIT_UAV_CONSUME_STRUCTURED, D3D_SRV_DIMENSION_BUFFER, 'u' },
+		{ "SamplerState", D3D_SIT_SAMPLER, D3D_SRV_DIMENSION_UNKNOWN, 's' },
+		{ "SamplerComparisonState", D3D_SIT_SAMPLER, D3D_SRV_DIMENSION_UNKNOWN, 's' },
+		{ "sampler", D3D_SIT_SAMPLER, D3D_SRV_DIMENSION_UNKNOWN, 's' },
+	} };
+
+	static const ResourceKind *query_resource_kind(std::string_view keyword)
+	{
+		auto iter = std::ranges::find(s_resource_kinds, keyword, &ResourceKind::keyword);
+		return iter != s_resource_kinds.end() ? &*iter : nullptr;
+	}
+
+	static D3D12_SHADER_VERSION_TYPE query_version_type(std::string_view target_profile)
+	{
+		static constexpr std::array<std::pair<std::string_view, D3D12_SHADER_VERSION_TYPE>, 6> s_profile_types{ {
+			{ "ps", D3D12_SHVER_PIXEL_SHADER }, { "vs", D3D12_SHVER_VERTEX_SHADER }, { "gs", D3D12_SHVER_GEOMETRY_SHADER },
+			{ "hs", D3D12_SHVER_HULL_SHADER }, { "ds", D3D12_SHVER_DOMAIN_SHADER }, { "cs", D3D12_SHVER_COMPUTE_SHADER },
+		} };
+		auto iter = std::ranges::find(s_profile_types, target_profile.substr(0, 2), &std::pair<std::string_view, D3D12_SHADER_VERSION_TYPE>::first);
+		return iter != s_profile_types.end() ? iter->second : D3D12_SHVER_RESERVED0;
+	}
+
+	static D3D_NAME query_system_value_type(std::string_view semantic_name)
+	{
+		static constexpr std::array<std::pair<std::string_view, D3D_NAME>, 10> s_system_values{ {
+			{ "SV_POSITION", D3D_NAME_POSITION }, { "SV_CLIPDISTANCE", D3D_NAME_CLIP_DISTANCE }, { "SV_CULLDISTANCE", D3D_NAME_CULL_DISTANCE },
+			{ "SV_RENDERTARGETARRAYINDEX", D3D_NAME_RENDER_TARGET_ARRAY_INDEX }, { "SV_VIEWPORTARRAYINDEX", D3D_NAME_VIEWPORT_ARRAY_INDEX },
+			{ "SV_VERTEXID", D3D_NAME_VERTEX_ID }, { "SV_PRIMITIVEID", D3D_NAME_PRIMITIVE_ID }, { "SV_INSTANCEID", D3D_NAME_INSTANCE_ID },
+			{ "SV_ISFRONTFACE", D3D_NAME_IS_FRONT_FACE }, { "SV_SAMPLEINDEX", D3D_NAME_SAMPLE_INDEX },
+		} };
+		std::string upper_name{ semantic_name };
+		std::ranges::transform(upper_name, upper_name.begin(), [](char character) { return static_cast<char>(std::toupper(static_cast<unsigned char>(character))); });
+		auto iter = std::ranges::find(s_system_values, std::string_view(upper_name), &std::pair<std::string_view, D3D_NAME>::first);
+		return iter != s_system_values.end() ? iter->second : D3D_NAME_UNDEFINED;
+	}
+
+	// Declarations
+	struct MemberDeclaration
+	{
+		std::vector<std::string> modifiers = {};
+		std::string type_name = {};
+		std::string name = {};
+		uint32_t elements = 0;
+		std::string semantic = {};
+		// Byte offset from packoffset, -1 when packed in order
+		int64_t pack_offset = -1;
+	};
+
+	struct StructDeclaration
+	{
+		std::vector<MemberDeclaration> members = {};
+	};
+
+	struct TypeLayout
+	{
+		uint32_t size_in_bytes = 0;
+		D3D_SHADER_VARIABLE_CLASS variable_class = D3D_SVC_SCALAR;
+		D3D_SHADER_VARIABLE_TYPE variable_type = D3D_SVT_VOID;
+		uint32_t rows = 1;
+		uint32_t columns = 1;
+		bool starts_register = false;
+	};
+
+	struct HlslScanner
+	{
+	private:
+		const std::vector<std::string> &tokens;
+		size_t cursor = 0;
+		std::unordered_map<std::string, StructDeclaration> structs = {};
+		std::array<uint32_t, 3> pending_thread_group_size = { 0, 0, 0 };
+		bool is_row_major = true;
+
+	public:
+		HlslReflection reflection = {};
+
+		HlslScanner(const std::vector<std::string> &input_tokens, bool row_major)
+		: tokens(input_tokens), is_row_major(row_major)
+		{
+
+		}
+
+		void scan(std::string_view entry_point, D3D12_SHADER_VERSION_TYPE version_type)
+		{
+			std::vector<ReflectedBinding> constant_buffer_bindings{};
+			std::vector<ReflectedBinding> resource_bindings{};
+			while (cursor < tokens.size())
+			{
+				const auto &token = tokens[cursor];
+				if (token == "[") {
+					scan_attribute();
+					continue;
+				}
+				if (token == "cbuffer") {
+					constant_buffer_bindings.emplace_back(scan_constant_buffer());
+					continue;
+				}
+				if (token == "struct" && cursor + 2 < tokens.size() && tokens[cursor + 2] == "{") {
+					scan_struct();
+					continue;
+				}
+				if (token == "static" || token == "groupshared" || token == "typedef" || token == "const" || token == ";") {
+					skip_statement();
+					continue;
+				}
+				if (auto resource_kind = query_resource_kind(token); resource_kind != nullptr) {
+					resource_bindings.emplace_back(scan_resource(*resource_kind));
+					continue;
+				}
+				scan_function_or_global(entry_point, version_type);
+			}
+
+			// cbuffers first so the index of a cbuffer binding is its cbuffer index
+			reflection.bindings = std::move(constant_buffer_bindings);
+			reflection.bindings.insert(reflection.bindings.end(), resource_bindings.begin(), resource_bindings.end());
+			assign_registers();
+		}
+
+	private:
+		[[nodiscard]] bool is_at(std::string_view token) const
+		{
+			return cursor < tokens.size() && tokens[cursor] == token;
+		}
+
+		[[nodiscard]] std::string_view take()
+		{
+			return cursor < tokens.size() ? std::string_view(tokens[cursor++]) : std::string_view{};
+		}
+
+		// Moves past the bracket that closes the one at the cursor
+		void skip_balanced()
+		{
+			int64_t depth = 0;
+			do
+			{
+				const auto &token = tokens[cursor];
+				depth += (token == "(" || token == "[" || token == "{") ? 1 : (token == ")" || token == "]" || token == "}") ? -1 : 0;
+				++cursor;
+			} while (cursor < tokens.size() && depth > 0);
+		}
+
+		void skip_statement()
+		{
+			while (cursor < tokens.size() && !is_at(";"))
+			{
+				if (is_at("(") || is_at("[") || is_at("{")) {
+					skip_balanced();
+				} else {
+					++cursor;
+				}
+			}
+			++cursor;
+		}
+
+		void scan_attribute()
+		{
+			const size_t attribute_begin = cursor;
+			skip_balanced();
+			if (cursor - attribute_begin >= 9 && tokens[attribute_begin + 1] == "numthreads") {
+				for (size_t axis = 0; axis < 3; ++axis)
+				{
+					pending_thread_group_size[axis] = parse_uint(tokens[attribute_begin + 3 + axis * 2]);
+				}
+			}
+		}
+
+		// ": register(t3)" or ": register(t3, space1)" after a declaration
+		void scan_register(ReflectedBinding &binding)
+		{
+			while (is_at(":"))
+			{
+				++cursor;
+				if (is_at("register") && cursor + 2 < tokens.size()) {
+					const auto &register_token = tokens[cursor + 2];
+					binding.register_class = static_cast<char>(std::tolower(static_cast<unsigned char>(register_token[0])));
+					binding.bind_point = parse_uint(std::string_view(register_token).substr(1));
+					binding.is_explicit = true;
+					cursor += 2;
+					while (cursor < tokens.size() && !is_at(")"))
+					{
+						++cursor;
+					}
+					++cursor;
+				} else {
+					++cursor;
+				}
+			}
+		}
+
+		ReflectedBinding scan_resource(const ResourceKind &resource_kind)
+		{
+			ReflectedBinding binding{};
+			binding.input_type = resource_kind.input_type;
+			binding.dimension = resource_kind.dimension;
+			binding.register_class = resource_kind.register_class;
+			binding.return_type = D3D_RETURN_TYPE_FLOAT;
+			if (resource_kind.input_type == D3D_SIT_SAMPLER) {
+				binding.return_type = static_cast<D3D_RESOURCE_RETURN_TYPE>(0);
+			}
+			++cursor;
+			if (is_at("<")) {
+				const auto element_type = parse_numeric_type(cursor + 1 < tokens.size() ? tokens[cursor + 1] : std::string{});
+				binding.return_type = element_type.variable_type == D3D_SVT_INT ? D3D_RETURN_TYPE_SINT :
+					element_type.variable_type == D3D_SVT_UINT || element_type.variable_type == D3D_SVT_BOOL ? D3D_RETURN_TYPE_UINT : D3D_RETURN_TYPE_FLOAT;
+				while (cursor < tokens.size() && !is_at(">"))
+				{
+					++cursor;
+				}
+				++cursor;
+			}
+			if (resource_kind.input_type == D3D_SIT_STRUCTURED || resource_kind.input_type == D3D_SIT_BYTEADDRESS || resource_kind.input_type >= D3D_SIT_UAV_RWSTRUCTURED) {
+				binding.return_type = D3D_RETURN_TYPE_MIXED;
+			}
+			binding.name = take();
+			if (is_at("[")) {
+				binding.bind_count = parse_uint(tokens[cursor + 1]);
+				skip_balanced();
+			}
+			scan_register(binding);
+			skip_statement();
+			return binding;
+		}
+
+		ReflectedBinding scan_constant_buffer()
+		{
+			++cursor;
+			ReflectedBinding binding{};
+			binding.name = take();
+			binding.input_type = D3D_SIT_CBUFFER;
+			binding.register_class = 'b';
+			binding.return_type = static_cast<D3D_RESOURCE_RETURN_TYPE>(0);
+			scan_register(binding);
+
+			ReflectedConstantBuffer constant_buffer{ binding.name };
+			const auto members = scan_members();
+			uint32_t offset = 0;
+			for (auto &&member : members)
+			{
+				const auto type_layout = query_type_layout(member);
+				ReflectedVariable variable{ member.name, 0, type_layout.size_in_bytes, type_layout.variable_class, type_layout.variable_type,
+											type_layout.rows, type_layout.columns, member.elements };
+				offset = place_member(offset, member, type_layout, variable.start_offset, variable.size_in_bytes);
+				constant_buffer.variables.emplace_back(std::move(variable));
+			}
+			constant_buffer.size_in_bytes = align_register(offset);
+			reflection.constant_buffers.emplace_back(std::move(constant_buffer));
+			if (is_at(";")) {
+				++cursor;
+			}
+			return binding;
+		}
+
+		void scan_struct()
+		{
+			++cursor;
+			const std::string struct_name{ take() };
+			structs[struct_name].members = scan_members();
+			skip_statement();
+		}
+
+		// Members between the braces at the cursor, "a, b" declarations are split
+		std::vector<MemberDeclaration> scan_members()
+		{
+			std::vector<MemberDeclaration> members{};
+			if (!is_at("{")) {
+				return members;
+			}
+			++cursor;
+			while (cursor < tokens.size() && !is_at("}"))
+			{
+				MemberDeclaration declaration{};
+				while (cursor + 1 < tokens.size() && !is_at(";") && !is_at("}") && tokens[cursor + 1] != ";" && tokens[cursor + 1] != "," &&
+					tokens[cursor + 1] != "[" && tokens[cursor + 1] != ":" && tokens[cursor + 1] != "<")
+				{
+					declaration.modifiers.emplace_back(take());
+				}
+				if (!declaration.modifiers.empty()) {
+					declaration.type_name = declaration.modifiers.back();
+					declaration.modifiers.pop_back();
+				}
+				// Statics inside a cbuffer don't belong to it
+				if (std::ranges::find(declaration.modifiers, "static") != declaration.modifiers.end()) {
+					skip_statement();
+					continue;
+				}
+				while (cursor < tokens.size() && !is_at(";") && !is_at("}"))
+				{
+					MemberDeclaration member{ declaration.modifiers, declaration.type_name };
+					member.name = take();
+					if (is_at("[")) {
+						member.elements = parse_uint(tokens[cursor + 1]);
+						skip_balanced();
+					}
+					while (is_at(":"))
+					{
+						++cursor;
+						if (is_at("packoffset") && cursor + 2 < tokens.size()) {
+							const std::string_view register_token = tokens[cursor + 2];
+							const auto component = (cursor + 4 < tokens.size() && tokens[cursor + 3] == ".") ? tokens[cursor + 4] : std::string{ "x" };
+							member.pack_offset = static_cast<int64_t>(parse_uint(register_token.substr(1))) * 16 + std::string_view("xyzw").find(component[0]) * 4;
+							while (cursor < tokens.size() && !is_at(")"))
+							{
+								++cursor;
+							}
+							++cursor;
+						} else {
+							member.semantic = take();
+						}
+					}
+					members.emplace_back(std::move(member));
+					while (cursor < tokens.size() && !is_at(",") && !is_at(";") && !is_at("}"))
+					{
+						if (is_at("(") || is_at("[") || is_at("{")) {
+							skip_balanced();
+						} else {
+							++cursor;
+						}
+					}
+					if (is_at(",")) {
+						++cursor;
+					}
+				}
+				if (is_at(";")) {
+					++cursor;
+				}
+			}
+			++cursor;
+			return members;
+		}
+
+		TypeLayout query_type_layout(const MemberDeclaration &member) const
+		{
+			TypeLayout type_layout{};
+			if (auto struct_iter = structs.find(member.type_name); struct_iter != structs.end()) {
+				uint32_t offset = 0;
+				for (auto &&struct_member : struct_iter->second.members)
+				{
+					uint32_t start_offset = 0;
+					uint32_t size_in_bytes = 0;
+					offset = place_member(offset, struct_member, query_type_layout(struct_member), start_offset, size_in_bytes);
+				}
+				type_layout.size_in_bytes = offset;
+				type_layout.variable_class = D3D_SVC_STRUCT;
+				type_layout.variable_type = D3D_SVT_VOID;
+				type_layout.starts_register = true;
+				return type_layout;
+			}
+
+			const auto numeric_type = parse_numeric_type(member.type_name);
+			type_layout.variable_type = numeric_type.variable_type;
+			type_layout.rows = numeric_type.rows;
+			type_layout.columns = numeric_type.columns;
+			if (!numeric_type.is_matrix) {
+				type_layout.variable_class = numeric_type.columns == 1 ? D3D_SVC_SCALAR : D3D_SVC_VECTOR;
+				type_layout.size_in_bytes = numeric_type.scalar_size * numeric_type.columns;
+				return type_layout;
+			}
+
+			// A matrix takes one register per row when row major, one per column otherwise
+			bool is_member_row_major = is_row_major;
+			if (std::ranges::find(member.modifiers, "row_major") != member.modifiers.end()) {
+				is_member_row_major = true;
+			} else if (std::ranges::find(member.modifiers, "column_major") != member.modifiers.end()) {
+				is_member_row_major = false;
+			}
+			const uint32_t register_count = is_member_row_major ? numeric_type.rows : numeric_type.columns;
+			const uint32_t register_width = is_member_row_major ? numeric_type.columns : numeric_type.rows;
+			type_layout.variable_class = is_member_row_major ? D3D_SVC_MATRIX_ROWS : D3D_SVC_MATRIX_COLUMNS;
+			type_layout.size_in_bytes = (register_count - 1) * 16 + register_width * numeric_type.scalar_size;
+			type_layout.starts_register = true;
+			return type_layout;
+		}
+
+		// HLSL packing, nothing straddles a 16 byte register, arrays and structs start a new register, array elements take whole registers
+		static uint32_t place_member(uint32_t offset, const MemberDeclaration &member, const TypeLayout &type_layout, uint32_t &start_offset, uint32_t &size_in_bytes)
+		{
+			size_in_bytes = type_layout.size_in_bytes;
+			if (member.elements > 0) {
+				size_in_bytes = align_register(type_layout.size_in_bytes) * (member.elements - 1) + type_layout.size_in_bytes;
+			}
+			if (member.pack_offset >= 0) {
+				start_offset = static_cast<uint32_t>(member.pack_offset);
+			} else if (type_layout.starts_register || member.elements > 0 || (offset % 16) + size_in_bytes > 16) {
+				start_offset = align_register(offset);
+			} else {
+				start_offset = offset;
+			}
+			// A struct also pushes what follows it to the next register
+			const uint32_t end_offset = (std::max)(offset, start_offset + size_in_bytes);
+			return type_layout.variable_class == D3D_SVC_STRUCT ? align_register(end_offset) : end_offset;
+		}
+
+		// Anything else at file scope, a function when a parenthesis comes before the end of the statement
+		void scan_function_or_global(std::string_view entry_point, D3D12_SHADER_VERSION_TYPE version_type)
+		{
+			const size_t statement_begin = cursor;
+			while (cursor < tokens.size() && !is_at(";") && !is_at("(") && !is_at("{") && !is_at("="))
+			{
+				++cursor;
+			}
+			if (!is_at("(") || cursor == statement_begin) {
+				if (is_at("{")) {
+					skip_balanced();
+					if (is_at(";")) {
+						++cursor;
+					}
+				} else {
+					skip_statement();
+				}
+				pending_thread_group_size = { 0, 0, 0 };
+				return;
+			}
+
+			const std::string_view function_name = tokens[cursor - 1];
+			const size_t parameter_begin = cursor + 1;
+			skip_balanced();
+			const size_t parameter_end = cursor - 1;
+			while (cursor < tokens.size() && !is_at("{") && !is_at(";"))
+			{
+				++cursor;
+			}
+			if (is_at(";")) {
+				++cursor;
+				return;
+			}
+			skip_balanced();
+
+			if (function_name == entry_point) {
+				reflection.has_entry_point = true;
+				reflection.thread_group_size = pending_thread_group_size;
+				if (version_type == D3D12_SHVER_VERTEX_SHADER) {
+					scan_input_parameters(parameter_begin, parameter_end);
+				}
+			}
+			pending_thread_group_size = { 0, 0, 0 };
+		}
+
+		void scan_input_parameters(size_t parameter_begin, size_t parameter_end)
+		{
+			size_t parameter_cursor = parameter_begin;
+			while (parameter_cursor < parameter_end)
+			{
+				std::vector<std::string_view> parameter_tokens{};
+				while (parameter_cursor < parameter_end && tokens[parameter_cursor] != ",")
+				{
+					parameter_tokens.emplace_back(tokens[parameter_cursor++]);
+				}
+				++parameter_cursor;
+
+				// [modifiers] type name [: semantic]
+				auto colon_iter = std::ranges::find(parameter_tokens, std::string_view(":"));
+				const size_t name_index = static_cast<size_t>(colon_iter - parameter_tokens.begin()) - 1;
+				if (name_index == 0 || name_index >= parameter_tokens.size()) {
+					continue;
+				}
+				const auto type_name = parameter_tokens[name_index - 1];
+				const auto modifiers_end = parameter_tokens.begin() + static_cast<ptrdiff_t>(name_index - 1);
+				if (std::find(parameter_tokens.begin(), modifiers_end, std::string_view("out")) != modifiers_end) {
+					continue;
+				}
+				if (colon_iter != parameter_tokens.end() && colon_iter + 1 != parameter_tokens.end()) {
+					add_input_parameter(type_name, *(colon_iter + 1));
+					continue;
+				}
+				if (auto struct_iter = structs.find(std::string(type_name)); struct_iter != structs.end()) {
+					for (auto &&member : struct_iter->second.members)
+					{
+						add_input_parameter(member.type_name, member.semantic);
+					}
+				}
+			}
+		}
+
+		void add_input_parameter(std::string_view type_name, std::string_view semantic)
+		{
+			if (semantic.empty()) {
+				return;
+			}
+			const auto numeric_type = parse_numeric_type(type_name);
+			size_t digit_begin = semantic.size();
+			while (digit_begin > 0 && std::isdigit(static_cast<unsigned char>(semantic[digit_begin - 1])))
+			{
+				--digit_begin;
+			}
+			ReflectedParameter parameter{};
+			parameter.semantic_name = semantic.substr(0, digit_begin);
+			parameter.semantic_index = parse_uint(semantic.substr(digit_begin));
+			parameter.register_index = static_cast<uint32_t>(reflection.input_parameters.size());
+			parameter.system_value_type = query_system_value_type(parameter.semantic_name);
+			parameter.component_type = numeric_type.component_type;
+			parameter.mask = static_cast<uint8_t>((1u << numeric_type.columns) - 1);
+			reflection.input_parameters.emplace_back(std::move(parameter));
+		}
+
+		// Bindings without a register take the lowest free ones of their class in declaration order
+		void assign_registers()
+		{
+			std::unordered_map<char, std::vector<bool>> used_registers{};
+			auto mark_registers = [&](const ReflectedBinding &binding)
+			{
+				auto &&registers = used_registers[binding.register_class];
+				registers.resize((std::max)(registers.size(), static_cast<size_t>(binding.bind_point + binding.bind_count)), false);
+				std::fill_n(registers.begin() + binding.bind_point, binding.bind_count, true);
+			};
+			for (auto &&binding : reflection.bindings)
+			{
+				if (binding.is_explicit) {
+					mark_registers(binding);
+				}
+			}
+			for (auto &&binding : reflection.bindings)
+			{
+				if (binding.is_explicit) {
+					continue;
+				}
+				auto &&registers = used_registers[binding.register_class];
+				uint32_t bind_point = 0;
+				while (bind_point < registers.size() &&
+					   std::any_of(registers.begin() + bind_point, registers.begin() + (std::min)(registers.size(), static_cast<size_t>(bind_point + binding.bind_count)), std::identity{}))
+				{
+					++bind_point;
+				}
+				binding.bind_point = bind_point;
+				mark_registers(binding);
+			}
+		}
+	};
+
+	HlslReflection reflect_hlsl(std::string_view source, std::string_view entry_point, std::string_view target_profile, bool is_row_major)
+	{
+		const auto tokens = tokenize(source);
+		const auto version_type = query_version_type(target_profile);
+		HlslScanner hlsl_scanner{ tokens, is_row_major };
+		hlsl_scanner.scan(entry_point, version_type);
+
+		// "vs_6_0"
+		auto reflection = std::move(hlsl_scanner.reflection);
+		const uint32_t major_version = target_profile.size() > 3 ? parse_uint(target_profile.substr(3, 1)) : 0;
+		const uint32_t minor_version = target_profile.size() > 5 ? parse_uint(target_profile.substr(5, 1)) : 0;
+		reflection.version = (static_cast<uint32_t>(version_type) << 16) | (major_version << 4) | minor_version;
+		return reflection;
+	}
+
+	// magic, row major flag, entry point, target profile and source, each string ends with a zero
+	std::string make_reflection_part(std::string_view source, std::string_view entry_point, std::string_view target_profile, bool is_row_major)
+	{
+		std::string reflection_part{ s_reflection_part_magic };
+		reflection_part += is_row_major ? '1' : '0';
+		reflection_part.append(entry_point).push_back('\0');
+		reflection_part.append(target_profile).push_back('\0');
+		reflection_part.append(source);
+		return reflection_part;
+	}
+
+	// Reflection objects
+	struct ReflectionType final : ID3D12ShaderReflectionType
+	{
+	private:
+		D3D12_SHADER_TYPE_DESC type_desc{};
+
+	public:
+		explicit ReflectionType(const ReflectedVariable &variable)
+		{
+			type_desc.Class = variable.variable_class;
+			type_desc.Type = variable.variable_type;
+			type_desc.Rows = variable.rows;
+			type_desc.Columns = variable.columns;
+			type_desc.Elements = variable.elements;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetDesc(D3D12_SHADER_TYPE_DESC *desc) override
+		{
+			*desc = type_desc;
+			return S_OK;
+		}
+
+		ID3D12ShaderReflectionType *STDMETHODCALLTYPE GetMemberTypeByIndex(UINT) override { return nullptr; }
+		ID3D12ShaderReflectionType *STDMETHODCALLTYPE GetMemberTypeByName(LPCSTR) override { return nullptr; }
+		LPCSTR STDMETHODCALLTYPE GetMemberTypeName(UINT) override { return nullptr; }
+		HRESULT STDMETHODCALLTYPE IsEqual(ID3D12ShaderReflectionType *other) override { return other == this ? S_OK : S_FALSE; }
+		ID3D12ShaderReflectionType *STDMETHODCALLTYPE GetSubType() override { return nullptr; }
+		ID3D12ShaderReflectionType *STDMETHODCALLTYPE GetBaseClass() override { return nullptr; }
+		UINT STDMETHODCALLTYPE GetNumInterfaces() override { return 0; }
+		ID3D12ShaderReflectionType *STDMETHODCALLTYPE GetInterfaceByIndex(UINT) override { return nullptr; }
+		HRESULT STDMETHODCALLTYPE IsOfType(ID3D12ShaderReflectionType *other) override { return other == this ? S_OK : S_FALSE; }
+		HRESULT STDMETHODCALLTYPE ImplementsInterface(ID3D12ShaderReflectionType *) override { return S_FALSE; }
+	};
+
+	struct ReflectionConstantBuffer;
+
+	struct ReflectionVariable final : ID3D12ShaderReflectionVariable
+	{
+	private:
+		const ReflectedVariable *variable = nullptr;
+		ReflectionConstantBuffer *constant_buffer = nullptr;
+		ReflectionType variable_type;
+
+	public:
+		ReflectionVariable(const ReflectedVariable &input_variable, ReflectionConstantBuffer *input_constant_buffer)
+		: variable(&input_variable), constant_buffer(input_constant_buffer), variable_type(input_variable)
+		{
+
+		}
+
+		HRESULT STDMETHODCALLTYPE GetDesc(D3D12_SHADER_VARIABLE_DESC *desc) override
+		{
+			*desc = {};
+			desc->Name = variable->name.c_str();
+			desc->StartOffset = variable->start_offset;
+			desc->Size = variable->size_in_bytes;
+			desc->StartTexture = static_cast<UINT>(-1);
+			desc->StartSampler = static_cast<UINT>(-1);
+			return S_OK;
+		}
+
+		ID3D12ShaderReflectionType *STDMETHODCALLTYPE GetType() override { return &variable_type; }
+		ID3D12ShaderReflectionConstantBuffer *STDMETHODCALLTYPE GetBuffer() override;
+		UINT STDMETHODCALLTYPE GetInterfaceSlot(UINT) override { return static_cast<UINT>(-1); }
+	};
+
+	// dxc hands out an invalid buffer rather than null for a bad index or name, its GetDesc fails
+	struct ReflectionConstantBuffer final : ID3D12ShaderReflectionConstantBuffer
+	{
+	private:
+		const ReflectedConstantBuffer *constant_buffer = nullptr;
+		std::vector<std::unique_ptr<ReflectionVariable>> variables = {};
+
+	public:
+		explicit ReflectionConstantBuffer(const ReflectedConstantBuffer *input_constant_buffer)
+		: constant_buffer(input_constant_buffer)
+		{
+			if (constant_buffer == nullptr) {
+				return;
+			}
+			for (auto &&variable : constant_buffer->variables)
+			{
+				variables.emplace_back(std::make_unique<ReflectionVariable>(variable, this));
+			}
+		}
+
+		HRESULT STDMETHODCALLTYPE GetDesc(D3D12_SHADER_BUFFER_DESC *desc) override
+		{
+			if (constant_buffer == nullptr) {
+				return E_FAIL;
+			}
+			*desc = {};
+			desc->Name = constant_buffer->name.c_str();
+			desc->Type = D3D_CT_CBUFFER;
+			desc->Variables = static_cast<UINT>(constant_buffer->variables.size());
+			desc->Size = constant_buffer->size_in_bytes;
+			return S_OK;
+		}
+
+		ID3D12ShaderReflectionVariable *STDMETHODCALLTYPE GetVariableByIndex(UINT index) override
+		{
+			return index < variables.size() ? variables[index].get() : nullptr;
+		}
+
+		ID3D12ShaderReflectionVariable *STDMETHODCALLTYPE GetVariableByName(LPCSTR name) override
+		{
+			if (constant_buffer == nullptr) {
+				return nullptr;
+			}
+			for (size_t index = 0; index < variables.size(); ++index)
+			{
+				if (constant_buffer->variables[index].name == name) {
+					return variables[index].get();
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	ID3D12ShaderReflectionConstantBuffer *ReflectionVariable::GetBuffer()
+	{
+		return constant_buffer;
+	}
+
+	struct ShaderReflection final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, ID3D12ShaderReflection>
+	{
+	private:
+		HlslReflection reflection = {};
+		std::vector<std::unique_ptr<ReflectionConstantBuffer>> constant_buffers = {};
+		ReflectionConstantBuffer invalid_constant_buffer{ nullptr };
+
+	public:
+		explicit ShaderReflection(HlslReflection input_reflection)
+		: reflection(std::move(input_reflection))
+		{
+			for (auto &&constant_buffer : reflection.constant_buffers)
+			{
+				constant_buffers.emplace_back(std::make_unique<ReflectionConstantBuffer>(&constant_buffer));
+			}
+		}
+
+		HRESULT STDMETHODCALLTYPE GetDesc(D3D12_SHADER_DESC *desc) override
+		{
+			*desc = {};
+			desc->Version = reflection.version;
+			desc->Creator = "fake dxcompiler";
+			desc->ConstantBuffers = static_cast<UINT>(reflection.constant_buffers.size());
+			desc->BoundResources = static_cast<UINT>(reflection.bindings.size());
+			desc->InputParameters = static_cast<UINT>(reflection.input_parameters.size());
+			return S_OK;
+		}
+
+		ID3D12ShaderReflectionConstantBuffer *STDMETHODCALLTYPE GetConstantBufferByIndex(UINT index) override
+		{
+			return index < constant_buffers.size() ? static_cast<ID3D12ShaderReflectionConstantBuffer *>(constant_buffers[index].get()) : &invalid_constant_buffer;
+		}
+
+		ID3D12ShaderReflectionConstantBuffer *STDMETHODCALLTYPE GetConstantBufferByName(LPCSTR name) override
+		{
+			for (size_t index = 0; index < constant_buffers.size(); ++index)
+			{
+				if (reflection.constant_buffers[index].name == name) {
+					return constant_buffers[index].get();
+				}
+			}
+			return &invalid_constant_buffer;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetResourceBindingDesc(UINT index, D3D12_SHADER_INPUT_BIND_DESC *desc) override
+		{
+			if (index >= reflection.bindings.size()) {
+				return E_INVALIDARG;
+			}
+			auto &&binding = reflection.bindings[index];
+			*desc = {};
+			desc->Name = binding.name.c_str();
+			desc->Type = binding.input_type;
+			desc->BindPoint = binding.bind_point;
+			desc->BindCount = binding.bind_count;
+			desc->ReturnType = binding.return_type;
+			desc->Dimension = binding.dimension;
+			desc->NumSamples = binding.dimension == D3D_SRV_DIMENSION_TEXTURE2DMS || binding.dimension == D3D_SRV_DIMENSION_TEXTURE2DMSARRAY ? 0 : static_cast<UINT>(-1);
+			desc->uID = index;
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetInputParameterDesc(UINT index, D3D12_SIGNATURE_PARAMETER_DESC *desc) override
+		{
+			if (index >= reflection.input_parameters.size()) {
+				return E_INVALIDARG;
+			}
+			auto &&parameter = reflection.input_parameters[index];
+			*desc = {};
+			desc->SemanticName = parameter.semantic_name.c_str();
+			desc->SemanticIndex = parameter.semantic_index;
+			desc->Register = parameter.register_index;
+			desc->SystemValueType = parameter.system_value_type;
+			desc->ComponentType = parameter.component_type;
+			desc->Mask = parameter.mask;
+			desc->ReadWriteMask = parameter.mask;
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetOutputParameterDesc(UINT, D3D12_SIGNATURE_PARAMETER_DESC *) override { return E_INVALIDARG; }
+		HRESULT STDMETHODCALLTYPE GetPatchConstantParameterDesc(UINT, D3D12_SIGNATURE_PARAMETER_DESC *) override { return E_INVALIDARG; }
+
+		ID3D12ShaderReflectionVariable *STDMETHODCALLTYPE GetVariableByName(LPCSTR name) override
+		{
+			for (auto &&constant_buffer : constant_buffers)
+			{
+				if (auto variable = constant_buffer->GetVariableByName(name); variable != nullptr) {
+					return variable;
+				}
+			}
+			return nullptr;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetResourceBindingDescByName(LPCSTR name, D3D12_SHADER_INPUT_BIND_DESC *desc) override
+		{
+			for (size_t index = 0; index < reflection.bindings.size(); ++index)
+			{
+				if (reflection.bindings[index].name == name) {
+					return GetResourceBindingDesc(static_cast<UINT>(index), desc);
+				}
+			}
+			return E_INVALIDARG;
+		}
+
+		UINT STDMETHODCALLTYPE GetMovInstructionCount() override { return 0; }
+		UINT STDMETHODCALLTYPE GetMovcInstructionCount() override { return 0; }
+		UINT STDMETHODCALLTYPE GetConversionInstructionCount() override { return 0; }
+		UINT STDMETHODCALLTYPE GetBitwiseInstructionCount() override { return 0; }
+		D3D_PRIMITIVE STDMETHODCALLTYPE GetGSInputPrimitive() override { return D3D_PRIMITIVE_UNDEFINED; }
+		BOOL STDMETHODCALLTYPE IsSampleFrequencyShader() override { return FALSE; }
+		UINT STDMETHODCALLTYPE GetNumInterfaceSlots() override { return 0; }
+
+		HRESULT STDMETHODCALLTYPE GetMinFeatureLevel(D3D_FEATURE_LEVEL *level) override
+		{
+			*level = D3D_FEATURE_LEVEL_11_0;
+			return S_OK;
+		}
+
+		UINT STDMETHODCALLTYPE GetThreadGroupSize(UINT *size_x, UINT *size_y, UINT *size_z) override
+		{
+			auto &&[group_size_x, group_size_y, group_size_z] = reflection.thread_group_size;
+			if (size_x != nullptr) {
+				*size_x = group_size_x;
+			}
+			if (size_y != nullptr) {
+				*size_y = group_size_y;
+			}
+			if (size_z != nullptr) {
+				*size_z = group_size_z;
+			}
+			return group_size_x * group_size_y * group_size_z;
+		}
+
+		UINT64 STDMETHODCALLTYPE GetRequiresFlags() override { return 0; }
+	};
+
+	HRESULT create_shader_reflection(const DxcBuffer &reflection_part, REFIID riid, void **object)
+	{
+		*object = nullptr;
+		const std::string_view part{ static_cast<const char *>(reflection_part.Ptr), reflection_part.Size };
+		if (!part.starts_with(s_reflection_part_magic) || part.size() < s_reflection_part_magic.size() + 1) {
+			return E_INVALIDARG;
+		}
+		const bool is_row_major = part[s_reflection_part_magic.size()] == '1';
+		const size_t entry_point_begin = s_reflection_part_magic.size() + 1;
+		const size_t entry_point_end = part.find('\0', entry_point_begin);
+		const size_t target_profile_end = entry_point_end == std::string_view::npos ? std::string_view::npos : part.find('\0', entry_point_end + 1);
+		if (target_profile_end == std::string_view::npos) {
+			return E_INVALIDARG;
+		}
+		const auto entry_point = part.substr(entry_point_begin, entry_point_end - entry_point_begin);
+		const auto target_profile = part.substr(entry_point_end + 1, target_profile_end - entry_point_end - 1);
+		auto shader_reflection = Microsoft::WRL::Make<ShaderReflection>(reflect_hlsl(part.substr(target_profile_end + 1), entry_point, target_profile, is_row_major));
+		if (shader_reflection == nullptr) {
+			return E_OUTOFMEMORY;
+		}
+		return shader_reflection->QueryInterface(riid, object);
+	}
+}
@@ -0,0 +1,79 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Inc/dxcapi.h>
+#include <Inc/d3d12shader.h>
+
+namespace toy
+{
+	struct ReflectedVariable
+	{
+		std::string name = {};
+		uint32_t start_offset = 0;
+		uint32_t size_in_bytes = 0;
+		D3D_SHADER_VARIABLE_CLASS variable_class = D3D_SVC_SCALAR;
+		D3D_SHADER_VARIABLE_TYPE variable_type = D3D_SVT_FLOAT;
+		uint32_t rows = 1;
+		uint32_t columns = 1;
+		uint32_t elements = 0;
+	};
+
+	struct ReflectedConstantBuffer
+	{
+		std::string name = {};
+		uint32_t size_in_bytes = 0;
+		std::vector<ReflectedVariable> variables = {};
+	};
+
+	struct ReflectedBinding
+	{
+		std::string name = {};
+		D3D_SHADER_INPUT_TYPE input_type = D3D_SIT_TEXTURE;
+		uint32_t bind_point = 0;
+		uint32_t bind_count = 1;
+		D3D_RESOURCE_RETURN_TYPE return_type = D3D_RETURN_TYPE_FLOAT;
+		D3D_SRV_DIMENSION dimension = D3D_SRV_DIMENSION_UNKNOWN;
+		// Register class, 'b' 't' 'u' or 's'
+		char register_class = 't';
+		bool is_explicit = false;
+	};
+
+	struct ReflectedParameter
+	{
+		std::string semantic_name = {};
+		uint32_t semantic_index = 0;
+		uint32_t register_index = 0;
+		D3D_NAME system_value_type = D3D_NAME_UNDEFINED;
+		D3D_REGISTER_COMPONENT_TYPE component_type = D3D_REGISTER_COMPONENT_FLOAT32;
+		uint8_t mask = 0;
+	};
+
+	// What dxc would reflect for one entry point, cbuffers come first in the bindings so a binding's index is also its cbuffer index
+	// Every declared resource is reported whether the entry point uses it or not, globals outside a cbuffer are not reported
+	struct HlslReflection
+	{
+		uint32_t version = 0;
+		std::vector<ReflectedConstantBuffer> constant_buffers = {};
+		std::vector<ReflectedBinding> bindings = {};
+		std::vector<ReflectedParameter> input_parameters = {};
+		std::array<uint32_t, 3> thread_group_size = { 0, 0, 0 };
+		bool has_entry_point = false;
+	};
+
+	// Scans preprocessed source for the declarations that make up reflection, not a compiler, bodies are skipped
+	HlslReflection reflect_hlsl(std::string_view source, std::string_view entry_point, std::string_view target_profile, bool is_row_major);
+
+	// Reflection part written to DXC_OUT_REFLECTION, the scanner runs again when it is turned into an ID3D12ShaderReflection
+	std::string make_reflection_part(std::string_view source, std::string_view entry_point, std::string_view target_profile, bool is_row_major);
+
+	HRESULT create_shader_reflection(const DxcBuffer &reflection_part, REFIID riid, void **object);
+}
@@ -0,0 +1,216 @@
+//
+// Created by ZZK on 2024/11/02.
+//
+
+#include <compile_arena.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace toy
+{
+	static size_t align_block_size(size_t size_in_bytes)
+	{
+		return (size_in_bytes + 15) & ~size_t{ 15 };
+	}
+
+	CompileArena::CompileArena(size_t chunk_size, size_t arena_limit)
+	: chunk_size_in_bytes(chunk_size), arena_limit_in_bytes(arena_limit)
+	{
+
+	}
+
+	void *CompileArena::Alloc(SIZE_T size_in_bytes)
+	{
+		static_assert(sizeof(BlockHeader) == 16);
+		const size_t block_size = align_block_size(sizeof(BlockHeader) + size_in_bytes);
+		++compile_stats.allocations;
+		compile_stats.bytes_allocated += size_in_bytes;
+
+		// A full chunk is left to its live blocks, allocation moves on to an empty one
+		if (chunk_index >= chunks.size() || chunks[chunk_index].size_in_bytes - chunks[chunk_index].used_in_bytes < block_size) {
+			const size_t empty_chunk_index = query_empty_chunk(block_size);
+			if (empty_chunk_index == chunks.size()) {
+				const size_t new_chunk_size = (std::max)(chunk_size_in_bytes, block_size);
+				if (reserved_bytes + new_chunk_size > arena_limit_in_bytes) {
+					auto block_header = static_cast<BlockHeader *>(std::malloc(sizeof(BlockHeader) + size_in_bytes));
+					if (block_header == nullptr) {
+						return nullptr;
+					}
+					*block_header = { size_in_bytes, epoch, s_heap_chunk_index };
+					compile_stats.heap_bytes += size_in_bytes;
+					++epoch_live_blocks;
+					return block_header + 1;
+				}
+				chunks.push_back({ std::make_unique_for_overwrite<uint8_t[]>(new_chunk_size), new_chunk_size, 0, 0 });
+				reserved_bytes += new_chunk_size;
+			}
+			chunk_index = empty_chunk_index;
+		}
+
+		auto &&chunk = chunks[chunk_index];
+		auto block_header = reinterpret_cast<BlockHeader *>(chunk.data.get() + chunk.used_in_bytes);
+		*block_header = { size_in_bytes, epoch, static_cast<uint32_t>(chunk_index) };
+		chunk.used_in_bytes += block_size;
+		++chunk.live_blocks;
+		used_bytes += block_size;
+		compile_stats.peak_bytes = (std::max)(compile_stats.peak_bytes, static_cast<uint64_t>(used_bytes - (std::min)(used_bytes, mark_used_bytes)));
+		++epoch_live_blocks;
+		return block_header + 1;
+	}
+
+	void *CompileArena::Realloc(void *block, SIZE_T size_in_bytes)
+	{
+		if (block == nullptr) {
+			return Alloc(size_in_bytes);
+		}
+		if (size_in_bytes == 0) {
+			Free(block);
+			return nullptr;
+		}
+
+		// The newest block grows in place
+		auto block_header = query_header(block);
+		if (is_top_block(block_header)) {
+			auto &&chunk = chunks[block_header->chunk_index];
+			const size_t old_block_size = align_block_size(sizeof(BlockHeader) + block_header->size_in_bytes);
+			const size_t new_block_size = align_block_size(sizeof(BlockHeader) + size_in_bytes);
+			if (chunk.used_in_bytes - old_block_size + new_block_size <= chunk.size_in_bytes) {
+				chunk.used_in_bytes = chunk.used_in_bytes - old_block_size + new_block_size;
+				used_bytes = used_bytes - old_block_size + new_block_size;
+				compile_stats.peak_bytes = (std::max)(compile_stats.peak_bytes, static_cast<uint64_t>(used_bytes - (std::min)(used_bytes, mark_used_bytes)));
+				if (size_in_bytes > block_header->size_in_bytes) {
+					compile_stats.bytes_allocated += size_in_bytes - block_header->size_in_bytes;
+				}
+				block_header->size_in_bytes = size_in_bytes;
+				return block;
+			}
+		}
+
+		void *new_block = Alloc(size_in_bytes);
+		if (new_block != nullptr) {
+			std::memcpy(new_block, block, (std::min)(static_cast<size_t>(block_header->size_in_bytes), static_cast<size_t>(size_in_bytes)));
+			Free(block);
+		}
+		return new_block;
+	}
+
+	void CompileArena::Free(void *block)
+	{
+		if (block == nullptr) {
+			return;
+		}
+		auto block_header = query_header(block);
+		if (block_header->epoch == epoch && epoch_live_blocks > 0) {
+			--epoch_live_blocks;
+		}
+		if (block_header->chunk_index == s_heap_chunk_index) {
+			std::free(block_header);
+			return;
+		}
+
+		// The last live block gives its whole chunk back, otherwise freeing the newest block gives its bytes back right away,
+		// dxc frees a lot in stack order
+		auto &&chunk = chunks[block_header->chunk_index];
+		--chunk.live_blocks;
+		if (chunk.live_blocks == 0) {
+			used_bytes -= chunk.used_in_bytes;
+			chunk.used_in_bytes = 0;
+		} else if (is_top_block(block_header)) {
+			const size_t block_size = align_block_size(sizeof(BlockHeader) + block_header->size_in_bytes);
+			chunk.used_in_bytes -= block_size;
+			used_bytes -= block_size;
+		}
+	}
+
+	SIZE_T CompileArena::GetSize(void *block)
+	{
+		return block == nullptr ? static_cast<SIZE_T>(-1) : static_cast<SIZE_T>(query_header(block)->size_in_bytes);
+	}
+
+	int CompileArena::DidAlloc(void *block)
+	{
+		if (block == nullptr) {
+			return -1;
+		}
+		const auto address = static_cast<const uint8_t *>(block);
+		const bool is_in_arena = std::ranges::any_of(chunks, [address](const ArenaChunk &chunk)
+		{
+			return address >= chunk.data.get() && address < chunk.data.get() + chunk.size_in_bytes;
+		});
+		// Heap blocks can't be told apart from foreign memory
+		return is_in_arena ? 1 : -1;
+	}
+
+	void CompileArena::HeapMinimize()
+	{
+		// Only the back can go, block headers refer to their chunk by index
+		while (!chunks.empty() && chunks.back().live_blocks == 0)
+		{
+			reserved_bytes -= chunks.back().size_in_bytes;
+			chunks.pop_back();
+		}
+		chunk_index = (std::min)(chunk_index, chunks.size());
+	}
+
+	void CompileArena::begin_compile()
+	{
+		++epoch;
+		epoch_live_blocks = 0;
+		mark_chunk_index = chunk_index;
+		mark_offset = chunk_index < chunks.size() ? chunks[chunk_index].used_in_bytes : 0;
+		mark_used_bytes = used_bytes;
+		compile_stats = {};
+		compile_stats.compiles = 1;
+	}
+
+	CompileArenaStats CompileArena::end_compile()
+	{
+		// Chunks only this compile used emptied as its blocks were freed, what is left is the tail of the chunk it started in
+		// A block still alive keeps that tail and its own chunk, every other chunk is free for the next compile
+		if (epoch_live_blocks == 0) {
+			if (mark_chunk_index < chunks.size() && chunks[mark_chunk_index].live_blocks > 0) {
+				auto &&mark_chunk = chunks[mark_chunk_index];
+				used_bytes -= mark_chunk.used_in_bytes - mark_offset;
+				mark_chunk.used_in_bytes = mark_offset;
+				chunk_index = mark_chunk_index;
+			}
+			compile_stats.rewinds = 1;
+		} else {
+			compile_stats.retained_compiles = 1;
+			compile_stats.retained_bytes = used_bytes - (std::min)(used_bytes, mark_used_bytes);
+		}
+		return compile_stats;
+	}
+
+	size_t CompileArena::query_reserved_bytes() const
+	{
+		return reserved_bytes;
+	}
+
+	CompileArena::BlockHeader *CompileArena::query_header(void *block)
+	{
+		return static_cast<BlockHeader *>(block) - 1;
+	}
+
+	bool CompileArena::is_top_block(const BlockHeader *block_header) const
+	{
+		if (block_header->chunk_index == s_heap_chunk_index || block_header->epoch != epoch) {
+			return false;
+		}
+		auto &&chunk = chunks[block_header->chunk_index];
+		const auto block_end = reinterpret_cast<const uint8_t *>(block_header) + align_block_size(sizeof(BlockHeader) + block_header->size_in_bytes);
+		return block_end == chunk.data.get() + chunk.used_in_bytes;
+	}
+
+	size_t CompileArena::query_empty_chunk(size_t block_size) const
+	{
+		for (size_t index = 0; index < chunks.size(); ++index)
+		{
+			if (index != chunk_index && chunks[index].live_blocks == 0 && chunks[index].size_in_bytes >= block_size) {
+				return index;
+			}
+		}
+		return chunks.size();
+	}
+}
@@ -0,0 +1,110 @@
+//
+// Created by ZZK on 2024/11/02.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <wrl/client.h>
+#include <wrl/implements.h>
+
+#include <Inc/dxcapi.h>
+
+namespace toy
+{
+	// Allocator traffic of one compile, or the sum over many when returned by DxcInStance
+	struct CompileArenaStats
+	{
+		uint64_t compiles = 0;
+		uint64_t allocations = 0;
+		uint64_t bytes_allocated = 0;
+		// Arena bytes in use at the high point of a compile, the largest one when summed
+		uint64_t peak_bytes = 0;
+		// Bytes served by the process heap once the arena reached its limit
+		uint64_t heap_bytes = 0;
+		// Compiles after which the arena was rewound
+		uint64_t rewinds = 0;
+		// Compiles that left blocks alive and so could not rewind, and the arena bytes those blocks still hold
+		uint64_t retained_compiles = 0;
+		uint64_t retained_bytes = 0;
+	};
+
+	// Bump allocator handed to DxcCreateInstance2, every pooled compiler gets its own so compiles on different threads never share one
+	// Only the thread holding the compiler allocates from it, so there is no lock
+	// end_compile rewinds to the begin_compile mark when everything allocated since has been freed,
+	// what dxc keeps across compiles (the compiler object itself included) stays below the mark
+	// Chunks count their live blocks and are reused as soon as they empty, so a block surviving one compile only pins its own chunk
+	struct CompileArena final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IMalloc>
+	{
+	private:
+		struct ArenaChunk
+		{
+			std::unique_ptr<uint8_t[]> data = nullptr;
+			size_t size_in_bytes = 0;
+			size_t used_in_bytes = 0;
+			uint64_t live_blocks = 0;
+		};
+
+		// In front of every block, keeps blocks 16 bytes aligned
+		struct BlockHeader
+		{
+			uint64_t size_in_bytes = 0;
+			uint32_t epoch = 0;
+			// s_heap_chunk_index for blocks served by the process heap
+			uint32_t chunk_index = 0;
+		};
+
+		static constexpr uint32_t s_heap_chunk_index = UINT32_MAX;
+
+		std::vector<ArenaChunk> chunks = {};
+		size_t chunk_index = 0;
+		size_t chunk_size_in_bytes = 0;
+		size_t arena_limit_in_bytes = 0;
+		size_t reserved_bytes = 0;
+		size_t used_bytes = 0;
+
+		// Rewind point set by begin_compile
+		size_t mark_chunk_index = 0;
+		size_t mark_offset = 0;
+		size_t mark_used_bytes = 0;
+		uint32_t epoch = 0;
+		uint64_t epoch_live_blocks = 0;
+
+		CompileArenaStats compile_stats{};
+
+	public:
+		explicit CompileArena(size_t chunk_size = size_t{ 4 } << 20, size_t arena_limit = size_t{ 512 } << 20);
+		~CompileArena() override = default;
+
+		void *STDMETHODCALLTYPE Alloc(SIZE_T size_in_bytes) override;
+
+		void *STDMETHODCALLTYPE Realloc(void *block, SIZE_T size_in_bytes) override;
+
+		void STDMETHODCALLTYPE Free(void *block) override;
+
+		SIZE_T STDMETHODCALLTYPE GetSize(void *block) override;
+
+		int STDMETHODCALLTYPE DidAlloc(void *block) override;
+
+		// Drops the empty chunks at the back
+		void STDMETHODCALLTYPE HeapMinimize() override;
+
+		void begin_compile();
+
+		// Rewinds when it is safe and returns what the compile allocated
+		CompileArenaStats end_compile();
+
+		[[nodiscard]] size_t query_reserved_bytes() const;
+
+	private:
+		static BlockHeader *query_header(void *block);
+
+		[[nodiscard]] bool is_top_block(const BlockHeader *block_header) const;
+
+		// An empty chunk the block fits in, chunks.size() when there is none
+		[[nodiscard]] size_t query_empty_chunk(size_t block_size) const;
+	};
+}
@@ -0,0 +1,439 @@
+//
+// Created by ZZK on 2024/11/02.
+//
+
+#include <compile_server.h>
+#include <filesystem>
+#include <thread>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace toy
+{
+	static constexpr uint32_t s_compile_request_magic = 0x51534354; // "TCSQ"
+	static constexpr uint32_t s_compile_response_magic = 0x52534354; // "TCSR"
+	static constexpr uint32_t s_compile_protocol_version = 1;
+	static constexpr uint64_t s_compile_message_max_size = 256ULL << 20;
+
+	// | header | source | arguments, each with its terminator |
+	struct CompileRequestHeader
+	{
+		uint32_t magic = s_compile_request_magic;
+		uint32_t version = s_compile_protocol_version;
+		uint32_t wchar_size = sizeof(wchar_t);
+		uint32_t encoding = 0;
+		uint64_t source_size = 0;
+		uint64_t arguments_size = 0;
+	};
+
+	// | header | serialized bytecode entry when compiled, the error log when failed |
+	struct CompileResponseHeader
+	{
+		uint32_t magic = s_compile_response_magic;
+		uint32_t version = s_compile_protocol_version;
+		uint32_t status = static_cast<uint32_t>(CompileServerStatus::Unavailable);
+		uint32_t padding = 0;
+		uint64_t payload_size = 0;
+	};
+
+	// Sockets
+#if defined(_WIN32)
+	static constexpr int s_send_flags = 0;
+	static constexpr int s_shutdown_both = SD_BOTH;
+
+	static bool initialize_sockets()
+	{
+		static const bool is_initialized = []()
+		{
+			WSADATA wsa_data{};
+			return WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0;
+		}();
+		return is_initialized;
+	}
+
+	static void close_socket(int64_t socket_handle)
+	{
+		closesocket(static_cast<SOCKET>(socket_handle));
+	}
+
+	static bool set_socket_timeout(int64_t socket_handle, uint32_t timeout_ms)
+	{
+		const DWORD timeout = timeout_ms;
+		return setsockopt(static_cast<SOCKET>(socket_handle), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout)) == 0 &&
+			   setsockopt(static_cast<SOCKET>(socket_handle), SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout)) == 0;
+	}
+#else
+	static constexpr int s_send_flags = MSG_NOSIGNAL;
+	static constexpr int s_shutdown_both = SHUT_RDWR;
+
+	static bool initialize_sockets()
+	{
+		return true;
+	}
+
+	static void close_socket(int64_t socket_handle)
+	{
+		close(static_cast<int>(socket_handle));
+	}
+
+	static bool set_socket_timeout(int64_t socket_handle, uint32_t timeout_ms)
+	{
+		const timeval timeout{ static_cast<time_t>(timeout_ms / 1000), static_cast<suseconds_t>(timeout_ms % 1000 * 1000) };
+		return setsockopt(static_cast<int>(socket_handle), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0 &&
+			   setsockopt(static_cast<int>(socket_handle), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+	}
+#endif
+
+	// Invalid sockets are -1 on every platform once widened
+	static int64_t open_socket()
+	{
+		if (!initialize_sockets()) {
+			return -1;
+		}
+		return static_cast<int64_t>(socket(AF_UNIX, SOCK_STREAM, 0));
+	}
+
+	static bool make_socket_address(std::string_view socket_path, sockaddr_un &socket_address)
+	{
+		socket_address = {};
+		socket_address.sun_family = AF_UNIX;
+		if (socket_path.empty() || socket_path.size() >= sizeof(socket_address.sun_path)) {
+			return false;
+		}
+		std::memcpy(socket_address.sun_path, socket_path.data(), socket_path.size());
+		return true;
+	}
+
+	static int64_t connect_socket(std::string_view socket_path)
+	{
+		sockaddr_un socket_address{};
+		if (!make_socket_address(socket_path, socket_address)) {
+			return -1;
+		}
+		const int64_t socket_handle = open_socket();
+		if (socket_handle == -1) {
+			return -1;
+		}
+		if (connect(socket_handle, reinterpret_cast<const sockaddr *>(&socket_address), sizeof(socket_address)) != 0) {
+			close_socket(socket_handle);
+			return -1;
+		}
+		return socket_handle;
+	}
+
+	static bool send_all(int64_t socket_handle, const void *data, uint64_t size_in_bytes)
+	{
+		auto bytes = static_cast<const char *>(data);
+		while (size_in_bytes > 0)
+		{
+			const auto chunk_size = static_cast<int>((std::min)(size_in_bytes, uint64_t{ 1 } << 30));
+			const auto sent = send(socket_handle, bytes, chunk_size, s_send_flags);
+			if (sent <= 0) {
+				return false;
+			}
+			bytes += sent;
+			size_in_bytes -= static_cast<uint64_t>(sent);
+		}
+		return true;
+	}
+
+	static bool receive_all(int64_t socket_handle, void *data, uint64_t size_in_bytes)
+	{
+		auto bytes = static_cast<char *>(data);
+		while (size_in_bytes > 0)
+		{
+			const auto chunk_size = static_cast<int>((std::min)(size_in_bytes, uint64_t{ 1 } << 30));
+			const auto received = recv(socket_handle, bytes, chunk_size, 0);
+			if (received <= 0) {
+				return false;
+			}
+			bytes += received;
+			size_in_bytes -= static_cast<uint64_t>(received);
+		}
+		return true;
+	}
+
+	// Compile server
+	CompileServer::CompileServer(const CompileServerDesc &desc)
+	: server_desc(desc), compile_slots(desc.compiler_count != 0 ? desc.compiler_count : (std::max)(std::thread::hardware_concurrency(), 1U))
+	{
+		if (server_desc.compiler_count == 0) {
+			server_desc.compiler_count = (std::max)(std::thread::hardware_concurrency(), 1U);
+		}
+	}
+
+	CompileServer::~CompileServer()
+	{
+		stop();
+		if (listen_socket != -1) {
+			close_socket(listen_socket);
+			std::error_code error_code{};
+			std::filesystem::remove(server_desc.socket_path, error_code);
+		}
+	}
+
+	bool CompileServer::start()
+	{
+		sockaddr_un socket_address{};
+		if (!make_socket_address(server_desc.socket_path, socket_address)) {
+			std::cout << std::format("Compile server socket path {} is empty or too long\n", server_desc.socket_path);
+			return false;
+		}
+		// A socket file nobody answers on is left over by a server that died, take it over
+		if (const int64_t running_server = connect_socket(server_desc.socket_path); running_server != -1) {
+			close_socket(running_server);
+			std::cout << std::format("A compile server already listens on {}\n", server_desc.socket_path);
+			return false;
+		}
+		std::error_code error_code{};
+		std::filesystem::remove(server_desc.socket_path, error_code);
+
+		listen_socket = open_socket();
+		if (listen_socket == -1 || bind(listen_socket, reinterpret_cast<const sockaddr *>(&socket_address), sizeof(socket_address)) != 0 ||
+			listen(listen_socket, SOMAXCONN) != 0) {
+			std::cout << std::format("Failed to listen on {}\n", server_desc.socket_path);
+			if (listen_socket != -1) {
+				close_socket(listen_socket);
+				listen_socket = -1;
+			}
+			return false;
+		}
+
+		ShaderBytecodeCache::get().set_directory(server_desc.cache_directory);
+		if (!server_desc.symbol_directory.empty()) {
+			DxcInStance::get().set_symbol_directory(server_desc.symbol_directory);
+		}
+		if (!DxcInStance::get().warm_up(server_desc.compiler_count)) {
+			std::cout << std::format("Compile server has no compiler to serve with\n");
+			return false;
+		}
+		is_running.store(true, std::memory_order_release);
+		return true;
+	}
+
+	void CompileServer::run()
+	{
+		while (is_running.load(std::memory_order_acquire))
+		{
+			const auto client_socket = static_cast<int64_t>(accept(listen_socket, nullptr, nullptr));
+			if (client_socket == -1) {
+				continue;
+			}
+			if (!is_running.load(std::memory_order_acquire)) {
+				close_socket(client_socket);
+				break;
+			}
+			{
+				std::lock_guard<std::mutex> lock{ server_mutex };
+				client_sockets.insert(client_socket);
+				++server_stats.connections;
+			}
+			std::thread(&CompileServer::serve_client, this, client_socket).detach();
+		}
+
+		// Wake the clients blocked in recv and wait until their threads are gone
+		std::unique_lock<std::mutex> lock{ server_mutex };
+		for (auto client_socket : client_sockets)
+		{
+			shutdown(client_socket, s_shutdown_both);
+		}
+		clients_done_condition.wait(lock, [this]() { return client_sockets.empty(); });
+	}
+
+	void CompileServer::stop()
+	{
+		// A connection of our own wakes the accept run is blocked in
+		if (is_running.exchange(false, std::memory_order_acq_rel)) {
+			if (const int64_t wake_socket = connect_socket(server_desc.socket_path); wake_socket != -1) {
+				close_socket(wake_socket);
+			}
+		}
+	}
+
+	void CompileServer::serve_client(int64_t client_socket)
+	{
+		std::vector<uint8_t> source_data{};
+		std::vector<wchar_t> arguments_data{};
+		std::vector<const wchar_t *> compilation_arguments{};
+		CompileRequestHeader request_header{};
+		while (receive_all(client_socket, &request_header, sizeof(request_header)))
+		{
+			if (request_header.magic != s_compile_request_magic || request_header.version != s_compile_protocol_version || request_header.wchar_size != sizeof(wchar_t) ||
+				request_header.source_size > s_compile_message_max_size || request_header.arguments_size > s_compile_message_max_size ||
+				request_header.arguments_size % sizeof(wchar_t) != 0) {
+				break;
+			}
+			source_data.resize(request_header.source_size);
+			arguments_data.resize(request_header.arguments_size / sizeof(wchar_t));
+			if (!receive_all(client_socket, source_data.data(), source_data.size()) || !receive_all(client_socket, arguments_data.data(), request_header.arguments_size) ||
+				(!arguments_data.empty() && arguments_data.back() != L'\0')) {
+				break;
+			}
+			compilation_arguments.clear();
+			for (size_t argument_start = 0; argument_start < arguments_data.size(); argument_start += std::char_traits<wchar_t>::length(arguments_data.data() + argument_start) + 1)
+			{
+				compilation_arguments.emplace_back(arguments_data.data() + argument_start);
+			}
+
+			const DxcBuffer source_buffer{
+				.Ptr = source_data.data(),
+				.Size = source_data.size(),
+				.Encoding = request_header.encoding,
+			};
+			const auto compile_outcome = compile(source_buffer, compilation_arguments);
+			CompileResponseHeader response_header{};
+			std::vector<uint8_t> payload{};
+			if (compile_outcome.shader_bytecode_entry != nullptr) {
+				payload = ShaderBytecodeCache::serialize_entry(compile_outcome.shader_bytecode_key, *compile_outcome.shader_bytecode_entry);
+				response_header.status = static_cast<uint32_t>(CompileServerStatus::Compiled);
+			} else {
+				payload.assign(compile_outcome.error_log.begin(), compile_outcome.error_log.end());
+				response_header.status = static_cast<uint32_t>(CompileServerStatus::Failed);
+			}
+			response_header.payload_size = payload.size();
+			if (!send_all(client_socket, &response_header, sizeof(response_header)) || !send_all(client_socket, payload.data(), payload.size())) {
+				break;
+			}
+		}
+
+		// Closed under the lock, accept may hand the same handle to a new client right after
+		std::lock_guard<std::mutex> lock{ server_mutex };
+		close_socket(client_socket);
+		client_sockets.erase(client_socket);
+		clients_done_condition.notify_all();
+	}
+
+	CompileServer::CompileOutcome CompileServer::compile(const DxcBuffer &source_buffer, std::span<const wchar_t *const> compilation_arguments)
+	{
+		auto &&shader_bytecode_cache = ShaderBytecodeCache::get();
+		const auto shader_bytecode_key = ShaderBytecodeCache::make_key({ static_cast<const uint8_t *>(source_buffer.Ptr), source_buffer.Size }, compilation_arguments);
+		{
+			std::lock_guard<std::mutex> lock{ server_mutex };
+			++server_stats.requests;
+		}
+		if (auto shader_bytecode_entry = shader_bytecode_cache.query(shader_bytecode_key); shader_bytecode_entry != nullptr) {
+			std::lock_guard<std::mutex> lock{ server_mutex };
+			++server_stats.cache_hits;
+			return { shader_bytecode_key, std::move(shader_bytecode_entry), {} };
+		}
+
+		// The first request for a key compiles, the ones arriving meanwhile wait for its outcome
+		std::promise<CompileOutcome> compile_promise{};
+		std::shared_future<CompileOutcome> compile_future{};
+		{
+			std::lock_guard<std::mutex> lock{ server_mutex };
+			auto [compile_iter, is_first_request] = in_flight_compiles.try_emplace(shader_bytecode_key);
+			if (!is_first_request) {
+				++server_stats.deduplicated;
+				compile_future = compile_iter->second;
+			} else {
+				compile_iter->second = compile_promise.get_future().share();
+			}
+		}
+		if (compile_future.valid()) {
+			return compile_future.get();
+		}
+
+		CompileOutcome compile_outcome{ shader_bytecode_key };
+		ShaderBytecodeEntry shader_bytecode_entry{};
+		compile_slots.acquire();
+		const bool is_compiled = DxcInStance::get().compile_bytecode(source_buffer, compilation_arguments, shader_bytecode_entry, compile_outcome.error_log);
+		compile_slots.release();
+		if (is_compiled) {
+			compile_outcome.shader_bytecode_entry = shader_bytecode_cache.insert(shader_bytecode_key, std::move(shader_bytecode_entry));
+		}
+		{
+			// Erased after the insert, so a request arriving now hits the cache
+			std::lock_guard<std::mutex> lock{ server_mutex };
+			in_flight_compiles.erase(shader_bytecode_key);
+			++(is_compiled ? server_stats.compiles : server_stats.failures);
+		}
+		compile_promise.set_value(compile_outcome);
+		return compile_outcome;
+	}
+
+	CompileServerStats CompileServer::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{ server_mutex };
+		return server_stats;
+	}
+
+	void CompileServer::print() const
+	{
+		std::lock_guard<std::mutex> lock{ server_mutex };
+		std::cout << std::format("Compile server: {} connections, {} requests, {} cache hits, {} deduplicated, {} compiles, {} failures\n",
+								server_stats.connections, server_stats.requests, server_stats.cache_hits, server_stats.deduplicated,
+								server_stats.compiles, server_stats.failures);
+	}
+
+	// Compile client
+	CompileServerStatus CompileClient::compile(std::string_view socket_path, uint32_t timeout_ms, const DxcBuffer &source_buffer, std::span<const wchar_t *const> compilation_arguments,
+											   ShaderBytecodeEntry &shader_bytecode_entry, std::string &error_log)
+	{
+		const int64_t server_socket = connect_socket(socket_path);
+		if (server_socket == -1) {
+			return CompileServerStatus::Unavailable;
+		}
+		// A timed out send or recv fails like a closed connection
+		if (!set_socket_timeout(server_socket, timeout_ms)) {
+			close_socket(server_socket);
+			return CompileServerStatus::Unavailable;
+		}
+
+		// The server works in its own directory, include directories are made absolute here
+		std::vector<std::wstring> absolute_paths{};
+		absolute_paths.reserve(compilation_arguments.size());
+		std::vector<const wchar_t *> sent_arguments(compilation_arguments.begin(), compilation_arguments.end());
+		for (size_t argument_index = 1; argument_index < sent_arguments.size(); ++argument_index)
+		{
+			const std::wstring_view option = sent_arguments[argument_index - 1];
+			if (option == L"-I" || option == L"/I") {
+				std::error_code error_code{};
+				auto absolute_path = std::filesystem::absolute(sent_arguments[argument_index], error_code);
+				if (!error_code) {
+					sent_arguments[argument_index] = absolute_paths.emplace_back(absolute_path.wstring()).c_str();
+				}
+			}
+		}
+		// The server keys its response by what it was sent
+		const auto shader_bytecode_key = ShaderBytecodeCache::make_key({ static_cast<const uint8_t *>(source_buffer.Ptr), source_buffer.Size }, sent_arguments);
+
+		std::vector<wchar_t> arguments_data{};
+		for (auto argument : sent_arguments)
+		{
+			arguments_data.insert(arguments_data.end(), argument, argument + std::char_traits<wchar_t>::length(argument) + 1);
+		}
+		CompileRequestHeader request_header{};
+		request_header.encoding = source_buffer.Encoding;
+		request_header.source_size = source_buffer.Size;
+		request_header.arguments_size = arguments_data.size() * sizeof(wchar_t);
+		CompileResponseHeader response_header{};
+		std::vector<uint8_t> payload{};
+		bool is_answered = send_all(server_socket, &request_header, sizeof(request_header)) && send_all(server_socket, source_buffer.Ptr, source_buffer.Size) &&
+						   send_all(server_socket, arguments_data.data(), request_header.arguments_size) &&
+						   receive_all(server_socket, &response_header, sizeof(response_header));
+		is_answered = is_answered && response_header.magic == s_compile_response_magic && response_header.version == s_compile_protocol_version &&
+					  response_header.payload_size <= s_compile_message_max_size;
+		if (is_answered) {
+			payload.resize(response_header.payload_size);
+			is_answered = receive_all(server_socket, payload.data(), payload.size());
+		}
+		close_socket(server_socket);
+		if (!is_answered) {
+			return CompileServerStatus::Unavailable;
+		}
+
+		if (response_header.status == static_cast<uint32_t>(CompileServerStatus::Compiled)) {
+			return ShaderBytecodeCache::deserialize_entry(payload, shader_bytecode_key, shader_bytecode_entry) ? CompileServerStatus::Compiled : CompileServerStatus::Unavailable;
+		}
+		error_log.assign(payload.begin(), payload.end());
+		return CompileServerStatus::Failed;
+	}
+}
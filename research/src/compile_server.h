@@ -0,0 +1,101 @@
+//
+// Created by ZZK on 2024/11/02.
+//
+
+#pragma once
+
+#include <shader_cache.h>
+#include <condition_variable>
+#include <future>
+#include <semaphore>
+#include <unordered_set>
+
+namespace toy
+{
+	enum class CompileServerStatus
+	{
+		Unavailable,
+		Compiled,
+		Failed
+	};
+
+	struct CompileServerDesc
+	{
+		std::string socket_path = {};
+		// Compiles running at once, zero picks one per hardware thread
+		uint32_t compiler_count = 0;
+		// Bytecode cache shared by every client, empty keeps it in memory
+		std::string cache_directory = {};
+		// PDBs of debug compiles, empty keeps the DxcInStance default
+		std::string symbol_directory = {};
+	};
+
+	struct CompileServerStats
+	{
+		uint64_t connections = 0;
+		uint64_t requests = 0;
+		uint64_t cache_hits = 0;
+		uint64_t deduplicated = 0;
+		uint64_t compiles = 0;
+		uint64_t failures = 0;
+	};
+
+	// Out of process compiler reached over a unix domain socket, shared by the tool, test and game processes of a machine
+	// Compilers stay warm between requests, identical requests in flight compile once and every result lands in one bytecode cache,
+	// keyed by source and arguments like the in process cache
+	struct CompileServer
+	{
+	private:
+		struct CompileOutcome
+		{
+			ShaderBytecodeKey shader_bytecode_key{};
+			std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry = nullptr;
+			std::string error_log = {};
+		};
+
+		CompileServerDesc server_desc{};
+		int64_t listen_socket = -1;
+		std::atomic<bool> is_running = false;
+		std::counting_semaphore<> compile_slots;
+		std::unordered_map<ShaderBytecodeKey, std::shared_future<CompileOutcome>, ShaderBytecodeKeyHasher> in_flight_compiles = {};
+		std::unordered_set<int64_t> client_sockets = {};
+		std::condition_variable clients_done_condition;
+		CompileServerStats server_stats{};
+		mutable std::mutex server_mutex;
+
+	public:
+		explicit CompileServer(const CompileServerDesc &desc);
+		~CompileServer();
+
+		CompileServer(const CompileServer &) = delete;
+		CompileServer &operator=(const CompileServer &) = delete;
+
+		// Bind the socket and warm the compilers, false when another server already listens on the path
+		bool start();
+
+		// Accept clients until stop is called, one thread per connection
+		void run();
+
+		// Called from another thread, run returns once the connected clients are closed
+		void stop();
+
+		[[nodiscard]] CompileServerStats get_stats() const;
+
+		void print() const;
+
+	private:
+		void serve_client(int64_t client_socket);
+
+		CompileOutcome compile(const DxcBuffer &source_buffer, std::span<const wchar_t *const> compilation_arguments);
+	};
+
+	// Client side of the protocol, one connection per request
+	struct CompileClient
+	{
+	public:
+		// Unavailable when no server answers on the path within the timeout, the caller then compiles in process
+		// Relative include directories are sent as absolute paths, the server resolves them against its own working directory
+		static CompileServerStatus compile(std::string_view socket_path, uint32_t timeout_ms, const DxcBuffer &source_buffer, std::span<const wchar_t *const> compilation_arguments,
+										   ShaderBytecodeEntry &shader_bytecode_entry, std::string &error_log);
+	};
+}
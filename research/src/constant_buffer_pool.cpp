@@ -0,0 +1,331 @@
+//
+// Created by ZZK on 2024/10/23.
+//
+
+#include <constant_buffer_pool.h>
+#include <algorithm>
+
+namespace toy
+{
+	ConstantBufferPool::ConstantBufferPool(ID3D11Device *input_device, uint32_t input_page_size)
+	: device(input_device), page_size((std::clamp)(input_page_size, min_slot_size, max_slot_size))
+	{
+		// Identifies the pool in thread local caches, addresses of destroyed pools get reused
+		static std::atomic<uint64_t> s_next_pool_id{ 1 };
+		pool_id = s_next_pool_id.fetch_add(1, std::memory_order_relaxed);
+
+		// Offset binding needs d3d11.1 runtime support, otherwise every constant buffer keeps its own buffer
+		D3D11_FEATURE_DATA_D3D11_OPTIONS feature_options{};
+		if (device != nullptr && SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &feature_options, sizeof(feature_options))))
+		{
+			offsetting_supported = feature_options.ConstantBufferOffsetting == TRUE;
+			no_overwrite_supported = feature_options.MapNoOverwriteOnDynamicConstantBuffer == TRUE;
+		}
+		if (!offsetting_supported)
+		{
+			std::cout << std::format("Constant buffer offsetting is not supported, constant buffer pool falls back to standalone buffers\n");
+		}
+	}
+
+	ConstantBufferSlot ConstantBufferPool::allocate(uint32_t size_in_bytes)
+	{
+		if (!offsetting_supported || size_in_bytes == 0 || size_in_bytes > max_slot_size)
+		{
+			return {};
+		}
+
+		std::scoped_lock pool_lock{ pool_mutex };
+
+		const uint32_t size_class = query_size_class(size_in_bytes);
+		auto &&class_pages = available_pages[size_class];
+		if (class_pages.empty())
+		{
+			const uint32_t page_index = create_page(size_class);
+			if (page_index == UINT32_MAX)
+			{
+				return {};
+			}
+			class_pages.emplace_back(page_index);
+		}
+
+		const uint32_t page_index = class_pages.back();
+		auto &&page = pages[page_index];
+		const uint32_t slot_index = page.free_slots.back();
+		page.free_slots.pop_back();
+		if (page.free_slots.empty())
+		{
+			class_pages.pop_back();
+		}
+
+		++pool_stats.slots_alive;
+		++pool_stats.slots_allocated;
+		pool_stats.bytes_requested += size_in_bytes;
+
+		ConstantBufferSlot slot{};
+		slot.buffer = page.buffer.Get();
+		slot.offset_in_bytes = slot_index * page.slot_size;
+		slot.size_in_bytes = page.slot_size;
+		slot.page_index = page_index;
+		slot.slot_index = slot_index;
+		return slot;
+	}
+
+	void ConstantBufferPool::free(ConstantBufferSlot &slot)
+	{
+		std::scoped_lock pool_lock{ pool_mutex };
+		if (!slot.is_valid() || slot.page_index >= pages.size())
+		{
+			return;
+		}
+
+		auto &&page = pages[slot.page_index];
+		if (page.free_slots.empty())
+		{
+			available_pages[page.size_class].emplace_back(slot.page_index);
+		}
+		page.free_slots.emplace_back(slot.slot_index);
+		--pool_stats.slots_alive;
+		slot = {};
+	}
+
+	void ConstantBufferPool::write(const ConstantBufferSlot &slot, const uint8_t *data, uint32_t size_in_bytes)
+	{
+		std::scoped_lock pool_lock{ pool_mutex };
+		if (!slot.is_valid() || slot.page_index >= pages.size())
+		{
+			return;
+		}
+
+		auto &&page = pages[slot.page_index];
+		std::memcpy(page.shadow_data.data() + slot.offset_in_bytes, data, (std::min)(size_in_bytes, slot.size_in_bytes));
+		page.is_dirty = true;
+	}
+
+	bool ConstantBufferPool::flush_page(ID3D11DeviceContext *device_context, const ConstantBufferSlot &slot)
+	{
+		std::scoped_lock pool_lock{ pool_mutex };
+		if (!slot.is_valid() || slot.page_index >= pages.size())
+		{
+			return true;
+		}
+
+		auto &&page = pages[slot.page_index];
+		if (!page.is_dirty)
+		{
+			return true;
+		}
+		if (device_context->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+		{
+			return false;
+		}
+		upload_page(device_context, page);
+		return true;
+	}
+
+	void ConstantBufferPool::flush(ID3D11DeviceContext *device_context)
+	{
+		std::scoped_lock pool_lock{ pool_mutex };
+		for (auto &&page : pages)
+		{
+			if (page.is_dirty)
+			{
+				upload_page(device_context, page);
+			}
+		}
+	}
+
+	ConstantBufferSlot ConstantBufferPool::write_transient(ID3D11DeviceContext *device_context, const uint8_t *data, uint32_t size_in_bytes)
+	{
+		if (!offsetting_supported || size_in_bytes == 0 || size_in_bytes > max_slot_size)
+		{
+			return {};
+		}
+		auto &&transient_ring = query_transient_ring(device_context);
+		if (transient_ring.buffer == nullptr)
+		{
+			return {};
+		}
+
+		// Without no overwrite maps on constant buffers every write discards, only the range written is bound so that stays correct
+		// Deferred contexts need a discard before the first no overwrite map of every command list, a binding reset marks the boundary
+		const uint32_t slot_size = min_slot_size << query_size_class(size_in_bytes);
+		const uint64_t binding_epoch = ResourceBindingState::query(device_context).query_reset_count();
+		D3D11_MAP map_type = D3D11_MAP_WRITE_NO_OVERWRITE;
+		if (!no_overwrite_supported || transient_ring.offset + slot_size > ring_size || transient_ring.binding_epoch != binding_epoch)
+		{
+			map_type = D3D11_MAP_WRITE_DISCARD;
+			transient_ring.offset = 0;
+			transient_ring.binding_epoch = binding_epoch;
+			++transient_ring.generation;
+			ring_discards.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mapped_data{};
+		if (FAILED(device_context->Map(transient_ring.buffer.Get(), 0, map_type, 0, &mapped_data)))
+		{
+			return {};
+		}
+		std::memcpy(static_cast<uint8_t *>(mapped_data.pData) + transient_ring.offset, data, size_in_bytes);
+		device_context->Unmap(transient_ring.buffer.Get(), 0);
+
+		ConstantBufferSlot slot{};
+		slot.buffer = transient_ring.buffer.Get();
+		slot.offset_in_bytes = transient_ring.offset;
+		slot.size_in_bytes = slot_size;
+		slot.generation = transient_ring.generation;
+		transient_ring.offset += slot_size;
+
+		transient_writes.fetch_add(1, std::memory_order_relaxed);
+		transient_bytes.fetch_add(size_in_bytes, std::memory_order_relaxed);
+		return slot;
+	}
+
+	bool ConstantBufferPool::is_transient_current(ID3D11DeviceContext *device_context, const ConstantBufferSlot &slot)
+	{
+		auto &&transient_ring = query_transient_ring(device_context);
+		return slot.buffer != nullptr && slot.buffer == transient_ring.buffer.Get() && slot.generation == transient_ring.generation &&
+			   transient_ring.binding_epoch == ResourceBindingState::query(device_context).query_reset_count();
+	}
+
+	ID3D11Device *ConstantBufferPool::get_device() const
+	{
+		return device.Get();
+	}
+
+	bool ConstantBufferPool::is_supported() const
+	{
+		return offsetting_supported;
+	}
+
+	ConstantBufferPoolStats ConstantBufferPool::get_stats() const
+	{
+		std::scoped_lock pool_lock{ pool_mutex };
+		ConstantBufferPoolStats stats = pool_stats;
+		stats.transient_writes = transient_writes.load(std::memory_order_relaxed);
+		stats.transient_bytes = transient_bytes.load(std::memory_order_relaxed);
+		stats.ring_discards = ring_discards.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void ConstantBufferPool::print() const
+	{
+		const ConstantBufferPoolStats current_stats = get_stats();
+		std::cout << std::format("Constant buffer pool: {} buffers, {} bytes, {} slots alive, {} slots allocated, {} bytes requested\n",
+								current_stats.buffer_count, current_stats.buffer_bytes, current_stats.slots_alive, current_stats.slots_allocated, current_stats.bytes_requested);
+		std::cout << std::format("Constant buffer pool: {} pages uploaded, {} bytes uploaded\n", current_stats.pages_uploaded, current_stats.bytes_uploaded);
+		std::cout << std::format("Constant buffer pool: {} transient writes, {} transient bytes, {} ring discards\n", current_stats.transient_writes, current_stats.transient_bytes,
+								current_stats.ring_discards);
+	}
+
+	uint32_t ConstantBufferPool::query_size_class(uint32_t size_in_bytes)
+	{
+		uint32_t size_class = 0;
+		uint32_t slot_size = min_slot_size;
+		while (slot_size < size_in_bytes && size_class + 1 < size_class_count)
+		{
+			slot_size <<= 1;
+			++size_class;
+		}
+		return size_class;
+	}
+
+	ID3D11DeviceContext1 *ConstantBufferPool::query_device_context1(ID3D11DeviceContext *device_context)
+	{
+		// Cache the last queried context per thread, binding happens far more often than switching contexts
+		thread_local ID3D11DeviceContext *cached_device_context = nullptr;
+		thread_local ComPtr<ID3D11DeviceContext1> cached_device_context1 = nullptr;
+		if (device_context != cached_device_context)
+		{
+			cached_device_context1.Reset();
+			device_context->QueryInterface(IID_PPV_ARGS(&cached_device_context1));
+			cached_device_context = device_context;
+		}
+		return cached_device_context1.Get();
+	}
+
+	ConstantBufferPool::TransientRing &ConstantBufferPool::query_transient_ring(ID3D11DeviceContext *device_context)
+	{
+		// Same caching as query_device_context1, a context is recorded on by one thread at a time
+		thread_local uint64_t cached_pool_id = 0;
+		thread_local ID3D11DeviceContext *cached_device_context = nullptr;
+		thread_local TransientRing *cached_transient_ring = nullptr;
+		if (cached_pool_id == pool_id && cached_device_context == device_context)
+		{
+			return *cached_transient_ring;
+		}
+
+		std::scoped_lock pool_lock{ pool_mutex };
+		auto &&transient_ring = transient_rings[device_context];
+		if (transient_ring == nullptr)
+		{
+			transient_ring = std::make_unique<TransientRing>();
+			D3D11_BUFFER_DESC ring_buffer_desc{};
+			ring_buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+			ring_buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			ring_buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			ring_buffer_desc.ByteWidth = ring_size;
+			if (FAILED(device->CreateBuffer(&ring_buffer_desc, nullptr, transient_ring->buffer.GetAddressOf())))
+			{
+				std::cout << std::format("Failed to create constant buffer pool ring of {} bytes\n", ring_size);
+			}
+			else
+			{
+				pool_stats.buffer_bytes += ring_size;
+			}
+			transient_ring->offset = ring_size;
+		}
+		cached_pool_id = pool_id;
+		cached_device_context = device_context;
+		cached_transient_ring = transient_ring.get();
+		return *cached_transient_ring;
+	}
+
+	uint32_t ConstantBufferPool::create_page(uint32_t size_class)
+	{
+		const uint32_t slot_size = min_slot_size << size_class;
+		const uint32_t buffer_size = (std::max)(page_size, slot_size);
+		const uint32_t slot_count = buffer_size / slot_size;
+
+		D3D11_BUFFER_DESC constant_buffer_desc{};
+		constant_buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+		constant_buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		constant_buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		constant_buffer_desc.ByteWidth = buffer_size;
+
+		ConstantBufferPage page{};
+		if (FAILED(device->CreateBuffer(&constant_buffer_desc, nullptr, page.buffer.GetAddressOf())))
+		{
+			std::cout << std::format("Failed to create constant buffer pool page of {} bytes\n", buffer_size);
+			return UINT32_MAX;
+		}
+		page.shadow_data.resize(buffer_size);
+		page.free_slots.reserve(slot_count);
+		for (uint32_t slot_index = slot_count; slot_index > 0; --slot_index)
+		{
+			page.free_slots.emplace_back(slot_index - 1);
+		}
+		page.size_class = size_class;
+		page.slot_size = slot_size;
+
+		++pool_stats.buffer_count;
+		pool_stats.buffer_bytes += buffer_size;
+		pages.emplace_back(std::move(page));
+		return static_cast<uint32_t>(pages.size() - 1);
+	}
+
+	void ConstantBufferPool::upload_page(ID3D11DeviceContext *device_context, ConstantBufferPage &page)
+	{
+		// Whole page discard, draws already recorded against the previous contents keep their renamed copy
+		D3D11_MAPPED_SUBRESOURCE mapped_data{};
+		if (FAILED(device_context->Map(page.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_data)))
+		{
+			return;
+		}
+		std::memcpy(mapped_data.pData, page.shadow_data.data(), page.shadow_data.size());
+		device_context->Unmap(page.buffer.Get(), 0);
+		page.is_dirty = false;
+
+		++pool_stats.pages_uploaded;
+		pool_stats.bytes_uploaded += page.shadow_data.size();
+	}
+}
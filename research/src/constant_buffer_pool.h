@@ -0,0 +1,118 @@
+//
+// Created by ZZK on 2024/10/23.
+//
+
+#pragma once
+
+#include <effect.h>
+
+namespace toy
+{
+	struct ConstantBufferPoolStats
+	{
+		uint32_t buffer_count = 0;
+		uint64_t buffer_bytes = 0;
+		uint32_t slots_alive = 0;
+		uint64_t slots_allocated = 0;
+		uint64_t bytes_requested = 0;
+		uint64_t pages_uploaded = 0;
+		uint64_t bytes_uploaded = 0;
+		uint64_t transient_writes = 0;
+		uint64_t transient_bytes = 0;
+		uint64_t ring_discards = 0;
+	};
+
+	// Constant buffers grouped by power of two size class, each class is backed by a few large dynamic buffers
+	// Slots are bound with *SetConstantBuffers1, offsets are 256 bytes aligned as d3d11.1 requires
+	// Contents changed between draws go to a transient ring with no overwrite maps instead of discarding their page
+	// Safe to use from several threads as long as each device context is only used by one of them at a time
+	struct ConstantBufferPool
+	{
+	private:
+		// One ring per device context, it is only touched by the thread recording on that context
+		struct TransientRing
+		{
+			ComPtr<ID3D11Buffer> buffer = nullptr;
+			uint32_t offset = 0;
+			uint32_t generation = 0;
+			uint64_t binding_epoch = 0;
+		};
+
+		struct ConstantBufferPage
+		{
+			ComPtr<ID3D11Buffer> buffer = nullptr;
+			std::vector<uint8_t> shadow_data = {};
+			std::vector<uint32_t> free_slots = {};
+			uint32_t size_class = 0;
+			uint32_t slot_size = 0;
+			bool is_dirty = false;
+		};
+
+		ComPtr<ID3D11Device> device = nullptr;
+		std::vector<ConstantBufferPage> pages = {};
+		std::array<std::vector<uint32_t>, 9> available_pages = {};
+		std::unordered_map<ID3D11DeviceContext *, std::unique_ptr<TransientRing>> transient_rings = {};
+		ConstantBufferPoolStats pool_stats{};
+		std::atomic<uint64_t> transient_writes{ 0 };
+		std::atomic<uint64_t> transient_bytes{ 0 };
+		std::atomic<uint64_t> ring_discards{ 0 };
+		mutable std::mutex pool_mutex;
+		uint64_t pool_id = 0;
+		uint32_t page_size = 0;
+		bool offsetting_supported = false;
+		bool no_overwrite_supported = false;
+
+	public:
+		static constexpr uint32_t min_slot_size = 256;
+		static constexpr uint32_t max_slot_size = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16;
+		static constexpr uint32_t size_class_count = 9;
+		static constexpr uint32_t ring_size = max_slot_size * 4;
+
+		explicit ConstantBufferPool(ID3D11Device *input_device, uint32_t input_page_size = 65536);
+
+		ConstantBufferPool(const ConstantBufferPool &) = delete;
+		ConstantBufferPool &operator=(const ConstantBufferPool &) = delete;
+		ConstantBufferPool(ConstantBufferPool &&) = delete;
+		ConstantBufferPool &operator=(ConstantBufferPool &&) = delete;
+
+		// Returns an invalid slot when constant buffer offsetting is unsupported or the size is too large
+		ConstantBufferSlot allocate(uint32_t size_in_bytes);
+
+		void free(ConstantBufferSlot &slot);
+
+		void write(const ConstantBufferSlot &slot, const uint8_t *data, uint32_t size_in_bytes);
+
+		// Upload the page containing the slot if it has pending writes
+		// Deferred contexts leave a dirty page alone and return false, their command lists may run before the one a flush is recorded in
+		bool flush_page(ID3D11DeviceContext *device_context, const ConstantBufferSlot &slot);
+
+		// Upload every page with pending writes, one map per page
+		void flush(ID3D11DeviceContext *device_context);
+
+		// Write the data to the next free range of the context's ring and return where it landed
+		// The ring is discarded when it wraps and after the context's bindings were reset, e.g. by FinishCommandList
+		ConstantBufferSlot write_transient(ID3D11DeviceContext *device_context, const uint8_t *data, uint32_t size_in_bytes);
+
+		// Transient slots stay valid on their own context until the ring is discarded, after that their range may hold someone else's data
+		[[nodiscard]] bool is_transient_current(ID3D11DeviceContext *device_context, const ConstantBufferSlot &slot);
+
+		[[nodiscard]] ID3D11Device *get_device() const;
+
+		[[nodiscard]] bool is_supported() const;
+
+		[[nodiscard]] ConstantBufferPoolStats get_stats() const;
+
+		void print() const;
+
+		static uint32_t query_size_class(uint32_t size_in_bytes);
+
+		static ID3D11DeviceContext1 *query_device_context1(ID3D11DeviceContext *device_context);
+
+	private:
+		TransientRing &query_transient_ring(ID3D11DeviceContext *device_context);
+
+		uint32_t create_page(uint32_t size_class);
+
+		void upload_page(ID3D11DeviceContext *device_context, ConstantBufferPage &page);
+	};
+}
@@ -0,0 +1,170 @@
+//
+// Created by ZZK on 2024/10/27.
+//
+
+#include <cpu_compute.h>
+#include <null_device.h>
+#include <algorithm>
+
+namespace toy
+{
+	// Cpu compute bindings
+	std::span<const uint8_t> CpuComputeBindings::query_constant_buffer(std::string_view constant_buffer_name) const
+	{
+		if (auto constant_buffer_iter = constant_buffers.find(string_to_id(constant_buffer_name)); constant_buffer_iter != constant_buffers.end()) {
+			return constant_buffer_iter->second;
+		}
+		return {};
+	}
+
+	CpuComputeResource CpuComputeBindings::query_shader_resource(std::string_view srv_name) const
+	{
+		if (auto shader_resource_iter = shader_resources.find(string_to_id(srv_name)); shader_resource_iter != shader_resources.end()) {
+			return shader_resource_iter->second;
+		}
+		return {};
+	}
+
+	CpuComputeResource CpuComputeBindings::query_unordered_access(std::string_view uav_name) const
+	{
+		if (auto unordered_access_iter = unordered_accesses.find(string_to_id(uav_name)); unordered_access_iter != unordered_accesses.end()) {
+			return unordered_access_iter->second;
+		}
+		return {};
+	}
+
+	// Cpu compute executor
+	CpuComputeExecutor::CpuComputeExecutor(JobSystem &input_job_system)
+	: job_system(input_job_system)
+	{
+
+	}
+
+	bool CpuComputeExecutor::register_kernel(const ComputeEffect &compute_effect, const ThreadGroupConf &thread_group_conf, CpuComputeKernel kernel)
+	{
+		auto &&reflected_conf = compute_effect.get_thread_group_conf();
+		if (reflected_conf.thread_group_size_x != thread_group_conf.thread_group_size_x ||
+			reflected_conf.thread_group_size_y != thread_group_conf.thread_group_size_y ||
+			reflected_conf.thread_group_size_z != thread_group_conf.thread_group_size_z) {
+			std::cout << std::format("Cpu kernel thread group {}x{}x{} does not match the reflected {}x{}x{}\n",
+									thread_group_conf.thread_group_size_x, thread_group_conf.thread_group_size_y, thread_group_conf.thread_group_size_z,
+									reflected_conf.thread_group_size_x, reflected_conf.thread_group_size_y, reflected_conf.thread_group_size_z);
+			return false;
+		}
+		kernels[compute_effect.get_prototype().get()] = { thread_group_conf, std::move(kernel) };
+		return true;
+	}
+
+	bool CpuComputeExecutor::has_kernel(const ComputeEffect &compute_effect) const
+	{
+		return kernels.contains(compute_effect.get_prototype().get());
+	}
+
+	void CpuComputeExecutor::bind_cpu_resource(std::string_view resource_name, const CpuComputeResource &cpu_resource)
+	{
+		cpu_resources[string_to_id(resource_name)] = cpu_resource;
+	}
+
+	void CpuComputeExecutor::unbind_cpu_resource(std::string_view resource_name)
+	{
+		cpu_resources.erase(string_to_id(resource_name));
+	}
+
+	bool CpuComputeExecutor::dispatch(ComputeEffect &compute_effect, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z)
+	{
+		auto kernel_iter = kernels.find(compute_effect.get_prototype().get());
+		if (kernel_iter == kernels.end()) {
+			++executor_stats.missing_kernels;
+			return false;
+		}
+		auto &&registered_kernel = kernel_iter->second;
+		auto &&thread_group_conf = registered_kernel.thread_group_conf;
+		const uint32_t thread_group_count_x = static_cast<uint32_t>((static_cast<uint64_t>(thread_x) + thread_group_conf.thread_group_size_x - 1) / thread_group_conf.thread_group_size_x);
+		const uint32_t thread_group_count_y = static_cast<uint32_t>((static_cast<uint64_t>(thread_y) + thread_group_conf.thread_group_size_y - 1) / thread_group_conf.thread_group_size_y);
+		const uint32_t thread_group_count_z = static_cast<uint32_t>((static_cast<uint64_t>(thread_z) + thread_group_conf.thread_group_size_z - 1) / thread_group_conf.thread_group_size_z);
+		const uint64_t thread_group_count = static_cast<uint64_t>(thread_group_count_x) * thread_group_count_y * thread_group_count_z;
+		++executor_stats.dispatches;
+		if (thread_group_count == 0) {
+			return true;
+		}
+
+		const CpuComputeBindings bindings = resolve_bindings(compute_effect);
+
+		// A few batches per thread keeps the pool busy when groups cost different amounts
+		const uint32_t batch_count = job_system.get_thread_count() * 4;
+		const uint64_t batch_size = (std::max)((thread_group_count + batch_count - 1) / batch_count, uint64_t{ 1 });
+		const auto job_count = static_cast<uint32_t>((thread_group_count + batch_size - 1) / batch_size);
+		job_system.parallel_for(job_count, 1, [&](uint32_t job_index)
+		{
+			const uint64_t group_begin = job_index * batch_size;
+			const uint64_t group_end = (std::min)(group_begin + batch_size, thread_group_count);
+			CpuComputeGroup compute_group{ bindings, thread_group_conf };
+			for (uint64_t group_index = group_begin; group_index < group_end; ++group_index)
+			{
+				compute_group.group_id = {
+					static_cast<uint32_t>(group_index % thread_group_count_x),
+					static_cast<uint32_t>(group_index / thread_group_count_x % thread_group_count_y),
+					static_cast<uint32_t>(group_index / thread_group_count_x / thread_group_count_y)
+				};
+				registered_kernel.kernel(compute_group);
+			}
+		});
+		executor_stats.thread_groups += thread_group_count;
+		return true;
+	}
+
+	const CpuComputeStats &CpuComputeExecutor::get_stats() const
+	{
+		return executor_stats;
+	}
+
+	void CpuComputeExecutor::print() const
+	{
+		std::cout << std::format("Cpu compute: {} kernels, {} dispatches, {} thread groups, {} dispatches without kernel\n",
+								kernels.size(), executor_stats.dispatches, executor_stats.thread_groups, executor_stats.missing_kernels);
+	}
+
+	CpuComputeResource CpuComputeExecutor::query_view_storage(ID3D11View *view)
+	{
+		if (view == nullptr) {
+			return {};
+		}
+		ComPtr<ID3D11Resource> resource = nullptr;
+		view->GetResource(resource.GetAddressOf());
+		auto resource_storage = query_null_resource_storage(resource.Get());
+		if (resource_storage == nullptr) {
+			return {};
+		}
+		auto null_subresource = resource_storage->query_subresource(0);
+		if (null_subresource == nullptr) {
+			return {};
+		}
+		return {
+			resource_storage->query_data(0),
+			null_subresource->size_in_bytes,
+			null_subresource->element_size,
+			null_subresource->row_pitch,
+			null_subresource->depth_pitch
+		};
+	}
+
+	CpuComputeBindings CpuComputeExecutor::resolve_bindings(const ComputeEffect &compute_effect) const
+	{
+		CpuComputeBindings bindings{};
+		for (auto &&[constant_buffer_id, constant_buffer] : compute_effect.constant_buffer_manager)
+		{
+			bindings.constant_buffers.emplace(constant_buffer_id, constant_buffer->get_upload_data());
+		}
+		for (auto &&[shader_resource_id, shader_resource] : compute_effect.shader_resource_manager)
+		{
+			auto cpu_resource_iter = cpu_resources.find(shader_resource_id);
+			bindings.shader_resources.emplace(shader_resource_id, cpu_resource_iter != cpu_resources.end() ? cpu_resource_iter->second : query_view_storage(shader_resource.srv));
+		}
+		for (auto &&[unordered_access_id, rw_resource] : compute_effect.unordered_access_manager)
+		{
+			auto cpu_resource_iter = cpu_resources.find(unordered_access_id);
+			bindings.unordered_accesses.emplace(unordered_access_id, cpu_resource_iter != cpu_resources.end() ? cpu_resource_iter->second : query_view_storage(rw_resource.uav));
+		}
+		return bindings;
+	}
+}
@@ -0,0 +1,129 @@
+//
+// Created by ZZK on 2024/10/27.
+//
+
+#pragma once
+
+#include <effect.h>
+#include <job_system.h>
+#include <functional>
+
+namespace toy
+{
+	// Cpu side bytes behind a bound view, mip 0 of the viewed resource
+	struct CpuComputeResource
+	{
+		uint8_t *data = nullptr;
+		uint32_t size_in_bytes = 0;
+		uint32_t element_size = 0;
+		uint32_t row_pitch = 0;
+		uint32_t depth_pitch = 0;
+
+		[[nodiscard]] bool is_valid() const { return data != nullptr; }
+
+		template <typename T>
+		[[nodiscard]] std::span<T> view_as() const
+		{
+			return { reinterpret_cast<T *>(data), size_in_bytes / sizeof(T) };
+		}
+	};
+
+	// Everything a kernel can read or write, resolved once per dispatch from the effect bindings
+	struct CpuComputeBindings
+	{
+	private:
+		std::unordered_map<size_t, std::span<const uint8_t>> constant_buffers = {};
+		std::unordered_map<size_t, CpuComputeResource> shader_resources = {};
+		std::unordered_map<size_t, CpuComputeResource> unordered_accesses = {};
+
+		friend struct CpuComputeExecutor;
+
+	public:
+		// Cbuffer shadow in its reflected layout, the same bytes the gpu path uploads
+		[[nodiscard]] std::span<const uint8_t> query_constant_buffer(std::string_view constant_buffer_name) const;
+
+		template <typename T>
+		[[nodiscard]] const T *query_constant_buffer_as(std::string_view constant_buffer_name) const
+		{
+			auto constant_buffer = query_constant_buffer(constant_buffer_name);
+			return constant_buffer.size() >= sizeof(T) ? reinterpret_cast<const T *>(constant_buffer.data()) : nullptr;
+		}
+
+		[[nodiscard]] CpuComputeResource query_shader_resource(std::string_view srv_name) const;
+
+		[[nodiscard]] CpuComputeResource query_unordered_access(std::string_view uav_name) const;
+	};
+
+	// One thread group of the dispatch grid, the kernel loops over its threads itself so groupshared data and
+	// barriers map to locals and loop phases
+	struct CpuComputeGroup
+	{
+		const CpuComputeBindings &bindings;
+		const ThreadGroupConf &thread_group_conf;
+		std::array<uint32_t, 3> group_id{};
+
+		[[nodiscard]] std::array<uint32_t, 3> query_dispatch_thread_id(uint32_t thread_x, uint32_t thread_y, uint32_t thread_z) const
+		{
+			return {
+				group_id[0] * thread_group_conf.thread_group_size_x + thread_x,
+				group_id[1] * thread_group_conf.thread_group_size_y + thread_y,
+				group_id[2] * thread_group_conf.thread_group_size_z + thread_z
+			};
+		}
+	};
+
+	using CpuComputeKernel = std::function<void(const CpuComputeGroup &)>;
+
+	struct CpuComputeStats
+	{
+		uint64_t dispatches = 0;
+		uint64_t thread_groups = 0;
+		uint64_t missing_kernels = 0;
+	};
+
+	// Runs compute effects on the cpu through kernels registered per prototype, for machines without a d3d11 device
+	// Resources are plain cpu memory bound by name, or views of null device resources bound through the effect
+	struct CpuComputeExecutor
+	{
+	private:
+		struct RegisteredKernel
+		{
+			ThreadGroupConf thread_group_conf{};
+			CpuComputeKernel kernel = {};
+		};
+
+		JobSystem &job_system;
+		std::unordered_map<const EffectPrototype *, RegisteredKernel> kernels = {};
+		std::unordered_map<size_t, CpuComputeResource> cpu_resources = {};
+		CpuComputeStats executor_stats{};
+
+	public:
+		explicit CpuComputeExecutor(JobSystem &input_job_system);
+
+		CpuComputeExecutor(const CpuComputeExecutor &) = delete;
+		CpuComputeExecutor &operator=(const CpuComputeExecutor &) = delete;
+
+		// The kernel is written for one thread group shape, it is rejected when the reflected shape differs
+		bool register_kernel(const ComputeEffect &compute_effect, const ThreadGroupConf &thread_group_conf, CpuComputeKernel kernel);
+
+		[[nodiscard]] bool has_kernel(const ComputeEffect &compute_effect) const;
+
+		// Srv or uav of any effect with this name reads the memory instead of the view bound through the effect
+		void bind_cpu_resource(std::string_view resource_name, const CpuComputeResource &cpu_resource);
+
+		void unbind_cpu_resource(std::string_view resource_name);
+
+		// Same grid as ComputeEffect::dispatch, thread groups are spread over the job system and waited on
+		bool dispatch(ComputeEffect &compute_effect, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z);
+
+		[[nodiscard]] const CpuComputeStats &get_stats() const;
+
+		void print() const;
+
+	private:
+		// Invalid for views of resources that no null device created
+		static CpuComputeResource query_view_storage(ID3D11View *view);
+
+		CpuComputeBindings resolve_bindings(const ComputeEffect &compute_effect) const;
+	};
+}
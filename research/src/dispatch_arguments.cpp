@@ -0,0 +1,197 @@
+//
+// Created by ZZK on 2024/10/25.
+//
+
+#include <dispatch_arguments.h>
+#include <shader_cache.h>
+#include <algorithm>
+
+namespace toy
+{
+	static constexpr uint32_t s_builder_thread_group_size = 64;
+
+	static constexpr std::string_view s_count_to_groups_source = R"(
+ByteAddressBuffer g_ItemCounts : register(t0);
+RWByteAddressBuffer g_DispatchArguments : register(u0);
+
+cbuffer CBDispatchArguments : register(b0)
+{
+	uint4 g_DispatchArgumentsConf; // dispatch count, thread group size, max thread group count
+}
+
+[numthreads(64, 1, 1)]
+void CS(uint3 dispatch_thread_id : SV_DispatchThreadID)
+{
+	const uint dispatch_index = dispatch_thread_id.x;
+	if (dispatch_index >= g_DispatchArgumentsConf.x) {
+		return;
+	}
+	const uint item_count = g_ItemCounts.Load(dispatch_index * 4);
+	const uint thread_group_count = item_count / g_DispatchArgumentsConf.y + (item_count % g_DispatchArgumentsConf.y != 0 ? 1 : 0);
+	// Groups past the limit of one dimension spill into rows of y
+	const uint row_count = min(thread_group_count / g_DispatchArgumentsConf.z + (thread_group_count % g_DispatchArgumentsConf.z != 0 ? 1 : 0), g_DispatchArgumentsConf.z);
+	g_DispatchArguments.Store3(dispatch_index * 12, row_count > 1 ? uint3(g_DispatchArgumentsConf.z, row_count, 1) : uint3(thread_group_count, 1, 1));
+}
+)";
+
+	// Dispatch arguments buffer
+	HRESULT DispatchArgumentsBuffer::create(ID3D11Device *device, uint32_t count)
+	{
+		dispatch_count = (std::max)(count, 1U);
+
+		std::vector<DispatchArguments> initial_arguments(dispatch_count);
+		D3D11_BUFFER_DESC argument_buffer_desc{};
+		argument_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+		argument_buffer_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+		argument_buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		argument_buffer_desc.ByteWidth = dispatch_count * sizeof(DispatchArguments);
+		const D3D11_SUBRESOURCE_DATA argument_data{ initial_arguments.data(), 0, 0 };
+		HRESULT hr = device->CreateBuffer(&argument_buffer_desc, &argument_data, argument_buffer.ReleaseAndGetAddressOf());
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC argument_uav_desc{};
+		argument_uav_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+		argument_uav_desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		argument_uav_desc.Buffer.NumElements = dispatch_count * 3;
+		argument_uav_desc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+		hr = device->CreateUnorderedAccessView(argument_buffer.Get(), &argument_uav_desc, argument_uav.ReleaseAndGetAddressOf());
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		std::vector<uint32_t> initial_item_counts(dispatch_count, 0);
+		D3D11_BUFFER_DESC item_count_buffer_desc{};
+		item_count_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+		item_count_buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		item_count_buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		item_count_buffer_desc.ByteWidth = dispatch_count * sizeof(uint32_t);
+		const D3D11_SUBRESOURCE_DATA item_count_data{ initial_item_counts.data(), 0, 0 };
+		hr = device->CreateBuffer(&item_count_buffer_desc, &item_count_data, item_count_buffer.ReleaseAndGetAddressOf());
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC item_count_srv_desc{};
+		item_count_srv_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+		item_count_srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+		item_count_srv_desc.BufferEx.NumElements = dispatch_count;
+		item_count_srv_desc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+		hr = device->CreateShaderResourceView(item_count_buffer.Get(), &item_count_srv_desc, item_count_srv.ReleaseAndGetAddressOf());
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC item_count_uav_desc{};
+		item_count_uav_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+		item_count_uav_desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		item_count_uav_desc.Buffer.NumElements = dispatch_count;
+		item_count_uav_desc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+		return device->CreateUnorderedAccessView(item_count_buffer.Get(), &item_count_uav_desc, item_count_uav.ReleaseAndGetAddressOf());
+	}
+
+	void DispatchArgumentsBuffer::copy_item_count(ID3D11DeviceContext *device_context, uint32_t dispatch_index, ID3D11UnorderedAccessView *counter_uav)
+	{
+		if (dispatch_index < dispatch_count) {
+			device_context->CopyStructureCount(item_count_buffer.Get(), dispatch_index * sizeof(uint32_t), counter_uav);
+		}
+	}
+
+	ID3D11Buffer *DispatchArgumentsBuffer::get_argument_buffer() const
+	{
+		return argument_buffer.Get();
+	}
+
+	ID3D11UnorderedAccessView *DispatchArgumentsBuffer::get_item_count_uav() const
+	{
+		return item_count_uav.Get();
+	}
+
+	uint32_t DispatchArgumentsBuffer::get_dispatch_count() const
+	{
+		return dispatch_count;
+	}
+
+	uint32_t DispatchArgumentsBuffer::query_argument_offset(uint32_t dispatch_index)
+	{
+		return dispatch_index * sizeof(DispatchArguments);
+	}
+
+	// Dispatch arguments builder
+	DispatchArgumentsBuilder::DispatchArgumentsBuilder(ID3D11Device *device)
+	: builder_constants("CBDispatchArguments", 0, 16), builder_constants_accessor(&builder_constants, "g_DispatchArgumentsConf", 0, 16)
+	{
+		builder_constants.set_shader_flag(ShaderType::ComputeShader);
+		if (FAILED(builder_constants.create_buffer(device))) {
+			std::cout << std::format("Failed to create dispatch arguments constant buffer\n");
+			return;
+		}
+
+		auto dxc_shader_result = DxcInStance::get().create_shader_from_source(s_count_to_groups_source, ShaderType::ComputeShader, ShaderTargetProfile::ShaderModel_5_1);
+		if (dxc_shader_result.shader_blob == nullptr) {
+			std::cout << std::format("Failed to compile dispatch arguments shader\n");
+			return;
+		}
+		ShaderObjectCache::get().create_compute_shader(device, dxc_shader_result, count_to_groups_shader.GetAddressOf());
+	}
+
+	bool DispatchArgumentsBuilder::is_valid() const
+	{
+		return count_to_groups_shader != nullptr;
+	}
+
+	void DispatchArgumentsBuilder::build(ID3D11DeviceContext *device_context, DispatchArgumentsBuffer &arguments_buffer, uint32_t thread_group_size)
+	{
+		if (!is_valid()) {
+			return;
+		}
+
+		std::array<uint32_t, 4> builder_conf{
+			arguments_buffer.dispatch_count,
+			(std::max)(thread_group_size, 1U),
+			D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION,
+			0
+		};
+		builder_constants_accessor.set_uint_vector(builder_conf);
+		builder_constants.update_buffer(device_context);
+
+		// Counts written through a uav by an earlier pass must leave it before they can be read
+		auto &&binding_state = ResourceBindingState::query(device_context);
+		const uint64_t item_count_uav_mask = binding_state.query_unordered_access_mask(ShaderType::ComputeShader, arguments_buffer.item_count_buffer.Get());
+		if (item_count_uav_mask != 0) {
+			binding_state.unbind_unordered_access_views(device_context, ShaderType::ComputeShader, item_count_uav_mask);
+		}
+
+		device_context->CSSetShader(count_to_groups_shader.Get(), nullptr, 0);
+		builder_constants.bind_cs(device_context);
+		device_context->CSSetShaderResources(0, 1, arguments_buffer.item_count_srv.GetAddressOf());
+		device_context->CSSetUnorderedAccessViews(0, 1, arguments_buffer.argument_uav.GetAddressOf(), nullptr);
+		device_context->Dispatch((arguments_buffer.dispatch_count + s_builder_thread_group_size - 1) / s_builder_thread_group_size, 1, 1);
+
+		// The argument buffer cannot be bound for writing while DispatchIndirect reads it
+		ID3D11ShaderResourceView *null_srv = nullptr;
+		ID3D11UnorderedAccessView *null_uav = nullptr;
+		device_context->CSSetShaderResources(0, 1, &null_srv);
+		device_context->CSSetUnorderedAccessViews(0, 1, &null_uav, nullptr);
+		binding_state.track_shader_resource(ShaderType::ComputeShader, 0, nullptr);
+		binding_state.track_unordered_access(ShaderType::ComputeShader, 0, nullptr);
+	}
+
+	DispatchArguments DispatchArgumentsBuilder::compute_dispatch_arguments(uint32_t item_count, uint32_t thread_group_size)
+	{
+		constexpr uint32_t max_thread_group_count = D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+		thread_group_size = (std::max)(thread_group_size, 1U);
+		const uint32_t thread_group_count = static_cast<uint32_t>((static_cast<uint64_t>(item_count) + thread_group_size - 1) / thread_group_size);
+		const uint32_t row_count = (std::min)((thread_group_count + max_thread_group_count - 1) / max_thread_group_count, max_thread_group_count);
+		if (row_count > 1) {
+			return { max_thread_group_count, row_count, 1 };
+		}
+		return { thread_group_count, 1, 1 };
+	}
+
+	uint32_t DispatchArgumentsBuilder::query_linear_group_index(const std::array<uint32_t, 3> &group_id)
+	{
+		return group_id[0] + group_id[1] * D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+	}
+}
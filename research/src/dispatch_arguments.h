@@ -0,0 +1,77 @@
+//
+// Created by ZZK on 2024/10/25.
+//
+
+#pragma once
+
+#include <effect.h>
+
+namespace toy
+{
+	// Layout D3D11 reads for DispatchIndirect
+	struct DispatchArguments
+	{
+		uint32_t thread_group_count_x = 0;
+		uint32_t thread_group_count_y = 1;
+		uint32_t thread_group_count_z = 1;
+	};
+
+	// Gpu side dispatch arguments plus the item counts they are built from, one entry per dispatch
+	struct DispatchArgumentsBuffer
+	{
+	private:
+		ComPtr<ID3D11Buffer> argument_buffer = nullptr;
+		ComPtr<ID3D11UnorderedAccessView> argument_uav = nullptr;
+		ComPtr<ID3D11Buffer> item_count_buffer = nullptr;
+		ComPtr<ID3D11ShaderResourceView> item_count_srv = nullptr;
+		ComPtr<ID3D11UnorderedAccessView> item_count_uav = nullptr;
+		uint32_t dispatch_count = 0;
+
+		friend struct DispatchArgumentsBuilder;
+
+	public:
+		DispatchArgumentsBuffer() = default;
+
+		// Arguments start as one empty dispatch each, so an indirect dispatch before the first build does nothing
+		HRESULT create(ID3D11Device *device, uint32_t count);
+
+		// Copy the hidden counter of an append or counter uav into the item count of one dispatch
+		void copy_item_count(ID3D11DeviceContext *device_context, uint32_t dispatch_index, ID3D11UnorderedAccessView *counter_uav);
+
+		[[nodiscard]] ID3D11Buffer *get_argument_buffer() const;
+
+		// Raw uav over the item counts, for passes that count with InterlockedAdd instead of a hidden counter
+		[[nodiscard]] ID3D11UnorderedAccessView *get_item_count_uav() const;
+
+		[[nodiscard]] uint32_t get_dispatch_count() const;
+
+		static uint32_t query_argument_offset(uint32_t dispatch_index);
+	};
+
+	// Helper compute stage turning item counts into thread group counts on the gpu, no readback involved
+	struct DispatchArgumentsBuilder
+	{
+	private:
+		ComPtr<ID3D11ComputeShader> count_to_groups_shader = nullptr;
+		ConstantBuffer builder_constants;
+		ConstantBufferAccessor builder_constants_accessor;
+
+	public:
+		explicit DispatchArgumentsBuilder(ID3D11Device *device);
+
+		DispatchArgumentsBuilder(const DispatchArgumentsBuilder &) = delete;
+		DispatchArgumentsBuilder &operator=(const DispatchArgumentsBuilder &) = delete;
+
+		[[nodiscard]] bool is_valid() const;
+
+		// Group counts past the d3d11 limit of one dimension spill into y, see query_linear_group_index
+		void build(ID3D11DeviceContext *device_context, DispatchArgumentsBuffer &arguments_buffer, uint32_t thread_group_size);
+
+		// Cpu reference of the helper stage
+		static DispatchArguments compute_dispatch_arguments(uint32_t item_count, uint32_t thread_group_size);
+
+		// Consumers flatten SV_GroupID + g_DispatchGroupOffset to x + y * 65535 and skip groups past their item count,
+		// the same index also covers a 1d dispatch that ComputeEffect::dispatch split along x
+		static uint32_t query_linear_group_index(const std::array<uint32_t, 3> &group_id);
+	};
+}
@@ -0,0 +1,179 @@
+//
+// Created by ZZK on 2024/10/26.
+//
+
+#include <dispatch_batch.h>
+#include <algorithm>
+#include <bit>
+
+namespace toy
+{
+	constexpr std::string_view s_dispatch_batch_items_name = "g_DispatchBatchItems";
+	constexpr std::string_view s_dispatch_batch_groups_name = "g_DispatchBatchGroups";
+
+	ComputeDispatchBatch::ComputeDispatchBatch(ComputeEffect &effect, ID3D11Device *input_device, std::string_view item_constant_buffer_name)
+	: compute_effect(&effect), item_constant_buffer(effect.query_constant_buffer(item_constant_buffer_name)), device(input_device)
+	{
+		if (item_constant_buffer == nullptr) {
+			std::cout << std::format("Dispatch batch found no cbuffer {}, dispatches are not batched\n", item_constant_buffer_name);
+			return;
+		}
+		item_stride = static_cast<uint32_t>(item_constant_buffer->get_upload_data().size());
+
+		// Without both buffers a single dispatch would run every item with the last cbuffer values
+		for (auto &&srv_name : { s_dispatch_batch_items_name, s_dispatch_batch_groups_name })
+		{
+			auto shader_resource = effect.query_shader_resource(srv_name);
+			if (shader_resource == nullptr || (shader_resource->srv_dimension != D3D11_SRV_DIMENSION_BUFFER && shader_resource->srv_dimension != D3D11_SRV_DIMENSION_BUFFEREX)) {
+				std::cout << std::format("Dispatch batch found no buffer {} in the shader, dispatches are not batched\n", srv_name);
+				item_constant_buffer = nullptr;
+				return;
+			}
+		}
+	}
+
+	bool ComputeDispatchBatch::is_valid() const
+	{
+		return item_constant_buffer != nullptr;
+	}
+
+	void ComputeDispatchBatch::add(ID3D11DeviceContext *device_context, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z)
+	{
+		++batch_stats.dispatches_added;
+
+		auto &&thread_group_conf = compute_effect->get_thread_group_conf();
+		const uint64_t thread_group_count_x = (static_cast<uint64_t>(thread_x) + thread_group_conf.thread_group_size_x - 1) / thread_group_conf.thread_group_size_x;
+		const uint64_t thread_group_count_y = (static_cast<uint64_t>(thread_y) + thread_group_conf.thread_group_size_y - 1) / thread_group_conf.thread_group_size_y;
+		const uint64_t thread_group_count_z = (static_cast<uint64_t>(thread_z) + thread_group_conf.thread_group_size_z - 1) / thread_group_conf.thread_group_size_z;
+		const uint64_t thread_group_count = thread_group_count_x * thread_group_count_y * thread_group_count_z;
+		if (thread_group_count == 0) {
+			return;
+		}
+
+		if (!is_valid()) {
+			compute_effect->emit_compute_pipeline(device_context);
+			compute_effect->dispatch(device_context, thread_x, thread_y, thread_z);
+			++batch_stats.dispatches_issued;
+			return;
+		}
+
+		constexpr uint32_t max_thread_group_count = D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+		if (group_table.size() + thread_group_count > max_thread_group_count) {
+			flush(device_context);
+		}
+
+		// A batch aware shader reads its parameters from the batch buffers only, so an oversized dispatch still goes
+		// through the batch, its item repeated in every flush its groups span
+		if (thread_group_count > max_thread_group_count) {
+			++batch_stats.oversized_dispatches;
+		}
+		uint32_t item_index = append_item();
+		for (uint32_t group_z = 0; group_z < thread_group_count_z; ++group_z)
+		{
+			for (uint32_t group_y = 0; group_y < thread_group_count_y; ++group_y)
+			{
+				for (uint32_t group_x = 0; group_x < thread_group_count_x; ++group_x)
+				{
+					if (group_table.size() == max_thread_group_count) {
+						flush(device_context);
+						item_index = append_item();
+					}
+					group_table.push_back({ item_index, group_x, group_y, group_z });
+				}
+			}
+		}
+	}
+
+	void ComputeDispatchBatch::flush(ID3D11DeviceContext *device_context)
+	{
+		if (group_table.empty()) {
+			return;
+		}
+
+		const auto item_bytes = static_cast<uint32_t>(item_data.size());
+		const auto group_bytes = static_cast<uint32_t>(group_table.size() * sizeof(group_table[0]));
+		if (FAILED(upload(device_context, item_buffer, item_data.data(), item_bytes, 0)) ||
+			FAILED(upload(device_context, group_buffer, group_table.data(), group_bytes, sizeof(group_table[0])))) {
+			std::cout << std::format("Failed to upload dispatch batch\n");
+		} else {
+			compute_effect->bind_shader_resource_view(s_dispatch_batch_items_name, item_buffer.srv.Get());
+			compute_effect->bind_shader_resource_view(s_dispatch_batch_groups_name, group_buffer.srv.Get());
+			compute_effect->emit_compute_pipeline(device_context);
+			device_context->Dispatch(static_cast<uint32_t>(group_table.size()), 1, 1);
+			++batch_stats.dispatches_issued;
+			++batch_stats.flushes;
+			batch_stats.item_bytes_uploaded += item_bytes;
+		}
+
+		item_data.clear();
+		group_table.clear();
+	}
+
+	uint32_t ComputeDispatchBatch::get_pending_count() const
+	{
+		return item_stride > 0 ? static_cast<uint32_t>(item_data.size() / item_stride) : 0;
+	}
+
+	const DispatchBatchStats &ComputeDispatchBatch::get_stats() const
+	{
+		return batch_stats;
+	}
+
+	void ComputeDispatchBatch::print() const
+	{
+		std::cout << std::format("Dispatch batch: {} dispatches added, {} issued in {} flushes, {} oversized, {} item bytes uploaded\n",
+								batch_stats.dispatches_added, batch_stats.dispatches_issued, batch_stats.flushes, batch_stats.oversized_dispatches, batch_stats.item_bytes_uploaded);
+	}
+
+	uint32_t ComputeDispatchBatch::append_item()
+	{
+		const auto item_index = static_cast<uint32_t>(item_data.size() / item_stride);
+		auto &&item_upload_data = item_constant_buffer->get_upload_data();
+		item_data.insert(item_data.end(), item_upload_data.begin(), item_upload_data.end());
+		return item_index;
+	}
+
+	HRESULT ComputeDispatchBatch::upload(ID3D11DeviceContext *device_context, BatchBuffer &batch_buffer, const void *data, uint32_t size_in_bytes, uint32_t structure_byte_stride)
+	{
+		// Grow to the next power of two so a steady batch size stops recreating buffers
+		if (size_in_bytes > batch_buffer.capacity_in_bytes) {
+			const uint32_t capacity_in_bytes = std::bit_ceil((std::max)(size_in_bytes, 256U));
+			D3D11_BUFFER_DESC buffer_desc{};
+			buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+			buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			buffer_desc.ByteWidth = capacity_in_bytes;
+			buffer_desc.MiscFlags = structure_byte_stride > 0 ? D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+			buffer_desc.StructureByteStride = structure_byte_stride;
+			HRESULT hr = device->CreateBuffer(&buffer_desc, nullptr, batch_buffer.buffer.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				return hr;
+			}
+
+			D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc{};
+			srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+			if (structure_byte_stride > 0) {
+				srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+				srv_desc.BufferEx.NumElements = capacity_in_bytes / structure_byte_stride;
+			} else {
+				srv_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+				srv_desc.BufferEx.NumElements = capacity_in_bytes / 4;
+				srv_desc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+			}
+			hr = device->CreateShaderResourceView(batch_buffer.buffer.Get(), &srv_desc, batch_buffer.srv.ReleaseAndGetAddressOf());
+			if (FAILED(hr)) {
+				return hr;
+			}
+			batch_buffer.capacity_in_bytes = capacity_in_bytes;
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mapped_data{};
+		const HRESULT hr = device_context->Map(batch_buffer.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_data);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		std::memcpy(mapped_data.pData, data, size_in_bytes);
+		device_context->Unmap(batch_buffer.buffer.Get(), 0);
+		return S_OK;
+	}
+}
@@ -0,0 +1,73 @@
+//
+// Created by ZZK on 2024/10/26.
+//
+
+#pragma once
+
+#include <effect.h>
+
+namespace toy
+{
+	struct DispatchBatchStats
+	{
+		uint64_t dispatches_added = 0;
+		uint64_t dispatches_issued = 0;
+		uint64_t flushes = 0;
+		uint64_t oversized_dispatches = 0;
+		uint64_t item_bytes_uploaded = 0;
+	};
+
+	// Gathers many small dispatches of one compute effect into a single dispatch
+	// Per dispatch values of one cbuffer are snapshotted in its reflected layout into g_DispatchBatchItems, a ByteAddressBuffer
+	// with a stride of the cbuffer size. g_DispatchBatchGroups is a StructuredBuffer<uint4> indexed by SV_GroupID.x holding
+	// the item index in x and the group id inside that item's own dispatch in yzw
+	// The indirection is not generated from the cbuffer layout, batch aware shaders read both buffers themselves. Shaders
+	// that don't declare them are dispatched one by one through the effect
+	struct ComputeDispatchBatch
+	{
+	private:
+		struct BatchBuffer
+		{
+			ComPtr<ID3D11Buffer> buffer = nullptr;
+			ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+			uint32_t capacity_in_bytes = 0;
+		};
+
+		ComputeEffect *compute_effect = nullptr;
+		ConstantBuffer *item_constant_buffer = nullptr;
+		ComPtr<ID3D11Device> device = nullptr;
+		uint32_t item_stride = 0;
+		std::vector<uint8_t> item_data = {};
+		std::vector<std::array<uint32_t, 4>> group_table = {};
+		BatchBuffer item_buffer{};
+		BatchBuffer group_buffer{};
+		DispatchBatchStats batch_stats{};
+
+	public:
+		ComputeDispatchBatch(ComputeEffect &effect, ID3D11Device *input_device, std::string_view item_constant_buffer_name);
+
+		ComputeDispatchBatch(const ComputeDispatchBatch &) = delete;
+		ComputeDispatchBatch &operator=(const ComputeDispatchBatch &) = delete;
+
+		// False when the effect has no such cbuffer or its shader lacks either batch buffer, dispatches then go straight to the effect
+		[[nodiscard]] bool is_valid() const;
+
+		// Snapshot the item cbuffer as it is now and queue the dispatch, a full batch is flushed first
+		// Meant for micro dispatches, one larger than a whole batch of 65535 groups is issued alone over several flushes
+		void add(ID3D11DeviceContext *device_context, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z);
+
+		// Upload the queued items, emit the pipeline once and issue one dispatch for all of them
+		void flush(ID3D11DeviceContext *device_context);
+
+		[[nodiscard]] uint32_t get_pending_count() const;
+
+		[[nodiscard]] const DispatchBatchStats &get_stats() const;
+
+		void print() const;
+
+	private:
+		uint32_t append_item();
+
+		HRESULT upload(ID3D11DeviceContext *device_context, BatchBuffer &batch_buffer, const void *data, uint32_t size_in_bytes, uint32_t structure_byte_stride);
+	};
+}
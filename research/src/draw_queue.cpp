@@ -0,0 +1,208 @@
+//
+// Created by ZZK on 2024/10/22.
+//
+
+#include <draw_queue.h>
+#include <algorithm>
+
+namespace toy
+{
+	uint32_t DrawSortKey::quantize_depth(float normalized_depth, bool reverse)
+	{
+		const float clamped_depth = (std::clamp)(normalized_depth, 0.0f, 1.0f);
+		const auto quantized_depth = static_cast<uint32_t>(clamped_depth * static_cast<float>(depth_mask));
+		return reverse ? static_cast<uint32_t>(depth_mask) - quantized_depth : quantized_depth;
+	}
+
+	// Draw queue
+	uint32_t DrawQueue::register_effect(Effect *effect)
+	{
+		if (effects.size() >= invalid_effect) {
+			std::cout << std::format("Too many effects registered to draw queue\n");
+			return invalid_effect;
+		}
+		effects.emplace_back(effect);
+		return static_cast<uint32_t>(effects.size() - 1);
+	}
+
+	uint32_t DrawQueue::register_resource_set(std::vector<DrawResourceBinding> resource_bindings)
+	{
+		if (resource_sets.size() >= null_resource_set) {
+			std::cout << std::format("Too many resource sets registered to draw queue\n");
+			return null_resource_set;
+		}
+		for (auto &&resource_binding : resource_bindings)
+		{
+			if (std::find(resource_set_srv_names.begin(), resource_set_srv_names.end(), resource_binding.srv_name) == resource_set_srv_names.end()) {
+				resource_set_srv_names.emplace_back(resource_binding.srv_name);
+			}
+		}
+		resource_sets.emplace_back(std::move(resource_bindings));
+		return static_cast<uint32_t>(resource_sets.size() - 1);
+	}
+
+	uint32_t DrawQueue::register_geometry(DrawGeometry geometry)
+	{
+		geometries.emplace_back(std::move(geometry));
+		return static_cast<uint32_t>(geometries.size() - 1);
+	}
+
+	void DrawQueue::reserve(size_t draw_count)
+	{
+		draw_items.reserve(draw_count);
+		sort_entries.reserve(draw_count);
+		sort_scratch.reserve(draw_count);
+	}
+
+	void DrawQueue::push(uint64_t sort_key, uint32_t geometry_id, const DrawArguments &draw_arguments)
+	{
+		sort_entries.emplace_back(sort_key, static_cast<uint32_t>(draw_items.size()));
+		draw_items.emplace_back(sort_key, geometry_id, draw_arguments);
+	}
+
+	void DrawQueue::push(uint32_t effect_id, uint32_t resource_set_id, float normalized_depth, uint32_t geometry_id, const DrawArguments &draw_arguments)
+	{
+		push(DrawSortKey::make(effect_id, resource_set_id, DrawSortKey::quantize_depth(normalized_depth)), geometry_id, draw_arguments);
+	}
+
+	void DrawQueue::sort()
+	{
+		// LSD radix sort on 8 bit digits, all histograms are built in one pass and digits shared by every key are skipped
+		const size_t entry_count = sort_entries.size();
+		if (entry_count < 2) {
+			return;
+		}
+
+		std::array<std::array<uint32_t, 256>, sizeof(uint64_t)> histograms{};
+		for (auto &&sort_entry : sort_entries)
+		{
+			for (uint32_t digit = 0; digit < sizeof(uint64_t); ++digit)
+			{
+				++histograms[digit][(sort_entry.sort_key >> (digit * 8)) & 0xff];
+			}
+		}
+
+		sort_scratch.resize(entry_count);
+		for (uint32_t digit = 0; digit < sizeof(uint64_t); ++digit)
+		{
+			auto &&histogram = histograms[digit];
+			const uint32_t first_bucket = (sort_entries.front().sort_key >> (digit * 8)) & 0xff;
+			if (histogram[first_bucket] == entry_count) {
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (auto &&bucket : histogram)
+			{
+				const uint32_t count = bucket;
+				bucket = offset;
+				offset += count;
+			}
+			for (auto &&sort_entry : sort_entries)
+			{
+				sort_scratch[histogram[(sort_entry.sort_key >> (digit * 8)) & 0xff]++] = sort_entry;
+			}
+			sort_entries.swap(sort_scratch);
+		}
+	}
+
+	DrawQueueStats DrawQueue::submit(ID3D11DeviceContext *device_context)
+	{
+		sort();
+
+		DrawQueueStats draw_queue_stats{};
+		uint32_t current_effect_id = UINT32_MAX;
+		uint32_t current_resource_set_id = UINT32_MAX;
+		uint32_t current_geometry_id = UINT32_MAX;
+		Effect *current_effect = nullptr;
+		const DrawGeometry *current_geometry = nullptr;
+		for (auto &&sort_entry : sort_entries)
+		{
+			auto &&draw_item = draw_items[sort_entry.item_index];
+			const uint32_t effect_id = DrawSortKey::query_effect_id(sort_entry.sort_key);
+			const uint32_t resource_set_id = DrawSortKey::query_resource_set_id(sort_entry.sort_key);
+			if (effect_id >= effects.size() || draw_item.geometry_id >= geometries.size()) {
+				continue;
+			}
+
+			// The whole pipeline is emitted only when the effect bits change, resource set changes only rebind shader resources
+			if (effect_id != current_effect_id) {
+				current_effect_id = effect_id;
+				current_resource_set_id = resource_set_id;
+				current_effect = effects[effect_id];
+				bind_resource_set(current_effect, resource_set_id);
+				current_effect->emit_graphics_pipeline(device_context);
+				++draw_queue_stats.effect_switches;
+			} else if (resource_set_id != current_resource_set_id) {
+				current_resource_set_id = resource_set_id;
+				bind_resource_set(current_effect, resource_set_id);
+				current_effect->emit_shader_resources(device_context);
+				++draw_queue_stats.resource_set_switches;
+			}
+
+			if (draw_item.geometry_id != current_geometry_id) {
+				current_geometry_id = draw_item.geometry_id;
+				current_geometry = &geometries[current_geometry_id];
+				bind_geometry(device_context, *current_geometry);
+				++draw_queue_stats.geometry_switches;
+			}
+
+			auto &&draw_arguments = draw_item.draw_arguments;
+			if (current_geometry->index_buffer != nullptr) {
+				if (draw_arguments.instance_count > 1 || draw_arguments.start_instance != 0) {
+					device_context->DrawIndexedInstanced(draw_arguments.element_count, draw_arguments.instance_count, draw_arguments.start_element,
+														draw_arguments.base_vertex, draw_arguments.start_instance);
+				} else {
+					device_context->DrawIndexed(draw_arguments.element_count, draw_arguments.start_element, draw_arguments.base_vertex);
+				}
+			} else {
+				if (draw_arguments.instance_count > 1 || draw_arguments.start_instance != 0) {
+					device_context->DrawInstanced(draw_arguments.element_count, draw_arguments.instance_count, draw_arguments.start_element, draw_arguments.start_instance);
+				} else {
+					device_context->Draw(draw_arguments.element_count, draw_arguments.start_element);
+				}
+			}
+			++draw_queue_stats.draw_count;
+		}
+
+		clear();
+		return draw_queue_stats;
+	}
+
+	void DrawQueue::clear()
+	{
+		draw_items.clear();
+		sort_entries.clear();
+	}
+
+	size_t DrawQueue::size() const
+	{
+		return draw_items.size();
+	}
+
+	void DrawQueue::bind_resource_set(Effect *effect, uint32_t resource_set_id)
+	{
+		// Null set, nothing from an earlier set may stay bound
+		if (resource_set_id >= resource_sets.size()) {
+			for (auto &&srv_name : resource_set_srv_names)
+			{
+				effect->bind_shader_resource_view(srv_name, nullptr);
+			}
+			return;
+		}
+		for (auto &&resource_binding : resource_sets[resource_set_id])
+		{
+			effect->bind_shader_resource_view(resource_binding.srv_name, resource_binding.srv);
+		}
+	}
+
+	void DrawQueue::bind_geometry(ID3D11DeviceContext *device_context, const DrawGeometry &geometry)
+	{
+		if (!geometry.vertex_buffers.empty()) {
+			device_context->IASetVertexBuffers(0, static_cast<uint32_t>(geometry.vertex_buffers.size()), geometry.vertex_buffers.data(),
+												geometry.vertex_strides.data(), geometry.vertex_offsets.data());
+		}
+		device_context->IASetIndexBuffer(geometry.index_buffer, geometry.index_format, geometry.index_offset);
+		device_context->IASetPrimitiveTopology(geometry.primitive_topology);
+	}
+}
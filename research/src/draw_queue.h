@@ -0,0 +1,139 @@
+//
+// Created by ZZK on 2024/10/22.
+//
+
+#pragma once
+
+#include <effect.h>
+
+namespace toy
+{
+	// 64 bit draw sort key, effect bits are the most significant so draws sharing an effect end up adjacent
+	// | effect 16 bits | resource set 24 bits | depth 24 bits |
+	struct DrawSortKey
+	{
+		static constexpr uint32_t effect_bits = 16;
+		static constexpr uint32_t resource_set_bits = 24;
+		static constexpr uint32_t depth_bits = 24;
+		static constexpr uint32_t effect_shift = resource_set_bits + depth_bits;
+		static constexpr uint32_t resource_set_shift = depth_bits;
+		static constexpr uint64_t effect_mask = (1ULL << effect_bits) - 1;
+		static constexpr uint64_t resource_set_mask = (1ULL << resource_set_bits) - 1;
+		static constexpr uint64_t depth_mask = (1ULL << depth_bits) - 1;
+
+		static constexpr uint64_t make(uint32_t effect_id, uint32_t resource_set_id, uint32_t depth)
+		{
+			return ((effect_id & effect_mask) << effect_shift) | ((resource_set_id & resource_set_mask) << resource_set_shift) | (depth & depth_mask);
+		}
+
+		static constexpr uint32_t query_effect_id(uint64_t sort_key)
+		{
+			return static_cast<uint32_t>((sort_key >> effect_shift) & effect_mask);
+		}
+
+		static constexpr uint32_t query_resource_set_id(uint64_t sort_key)
+		{
+			return static_cast<uint32_t>((sort_key >> resource_set_shift) & resource_set_mask);
+		}
+
+		// Quantize depth in [0, 1] to 24 bits, front to back order unless reversed
+		static uint32_t quantize_depth(float normalized_depth, bool reverse = false);
+	};
+
+	// Shader resource bound by name when a resource set becomes active
+	struct DrawResourceBinding
+	{
+		std::string srv_name = {};
+		ID3D11ShaderResourceView *srv = nullptr;
+	};
+
+	// Vertex and index buffers shared by many draws, one vertex buffer per input slot
+	struct DrawGeometry
+	{
+		std::vector<ID3D11Buffer *> vertex_buffers = {};
+		std::vector<uint32_t> vertex_strides = {};
+		std::vector<uint32_t> vertex_offsets = {};
+		ID3D11Buffer *index_buffer = nullptr;
+		DXGI_FORMAT index_format = DXGI_FORMAT_R32_UINT;
+		uint32_t index_offset = 0;
+		D3D11_PRIMITIVE_TOPOLOGY primitive_topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	};
+
+	// Draw arguments, element count is the index count for indexed geometry and the vertex count otherwise
+	struct DrawArguments
+	{
+		uint32_t element_count = 0;
+		uint32_t start_element = 0;
+		int32_t base_vertex = 0;
+		uint32_t instance_count = 1;
+		uint32_t start_instance = 0;
+	};
+
+	struct DrawItem
+	{
+		uint64_t sort_key = 0;
+		uint32_t geometry_id = 0;
+		DrawArguments draw_arguments{};
+	};
+
+	struct DrawQueueStats
+	{
+		uint32_t draw_count = 0;
+		uint32_t effect_switches = 0;
+		uint32_t resource_set_switches = 0;
+		uint32_t geometry_switches = 0;
+	};
+
+	// Submission layer above graphics effects, draws are radix sorted by key before emission
+	struct DrawQueue
+	{
+	private:
+		struct SortEntry
+		{
+			uint64_t sort_key = 0;
+			uint32_t item_index = 0;
+		};
+
+		std::vector<Effect *> effects = {};
+		std::vector<std::vector<DrawResourceBinding>> resource_sets = {};
+		std::vector<std::string> resource_set_srv_names = {};
+		std::vector<DrawGeometry> geometries = {};
+		std::vector<DrawItem> draw_items = {};
+		std::vector<SortEntry> sort_entries = {};
+		std::vector<SortEntry> sort_scratch = {};
+
+	public:
+		// Draws with the null resource set unbind every srv name the registered resource sets bind
+		static constexpr uint32_t null_resource_set = static_cast<uint32_t>(DrawSortKey::resource_set_mask);
+		static constexpr uint32_t invalid_effect = static_cast<uint32_t>(DrawSortKey::effect_mask);
+
+		DrawQueue() = default;
+
+		// Returns invalid_effect when every effect id is taken, draws with it are skipped
+		uint32_t register_effect(Effect *effect);
+
+		uint32_t register_resource_set(std::vector<DrawResourceBinding> resource_bindings);
+
+		uint32_t register_geometry(DrawGeometry geometry);
+
+		void reserve(size_t draw_count);
+
+		void push(uint64_t sort_key, uint32_t geometry_id, const DrawArguments &draw_arguments);
+
+		void push(uint32_t effect_id, uint32_t resource_set_id, float normalized_depth, uint32_t geometry_id, const DrawArguments &draw_arguments);
+
+		void sort();
+
+		// Sort, emit and clear the queued draws
+		DrawQueueStats submit(ID3D11DeviceContext *device_context);
+
+		void clear();
+
+		[[nodiscard]] size_t size() const;
+
+	private:
+		void bind_resource_set(Effect *effect, uint32_t resource_set_id);
+
+		void bind_geometry(ID3D11DeviceContext *device_context, const DrawGeometry &geometry);
+	};
+}
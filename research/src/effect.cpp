@@ -3,7 +3,19 @@
 //
 
 #include <effect.h>
+#include <constant_buffer_pool.h>
+#include <shader_cache.h>
+#include <compile_server.h>
 #include <cassert>
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <wrl/implements.h>
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#endif
 
 namespace toy
 {
@@ -39,6 +51,59 @@ namespace toy
 		return hash(str_view);
 	}
 
+	// Size of one texel or element of a dxgi format
+	uint32_t query_format_size_in_bytes(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+			case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+			case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			case DXGI_FORMAT_R32G32B32A32_UINT:
+			case DXGI_FORMAT_R32G32B32A32_SINT:
+				return 16;
+			case DXGI_FORMAT_R32G32B32_TYPELESS:
+			case DXGI_FORMAT_R32G32B32_FLOAT:
+			case DXGI_FORMAT_R32G32B32_UINT:
+			case DXGI_FORMAT_R32G32B32_SINT:
+				return 12;
+			case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+			case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			case DXGI_FORMAT_R16G16B16A16_UNORM:
+			case DXGI_FORMAT_R16G16B16A16_UINT:
+			case DXGI_FORMAT_R16G16B16A16_SNORM:
+			case DXGI_FORMAT_R16G16B16A16_SINT:
+			case DXGI_FORMAT_R32G32_TYPELESS:
+			case DXGI_FORMAT_R32G32_FLOAT:
+			case DXGI_FORMAT_R32G32_UINT:
+			case DXGI_FORMAT_R32G32_SINT:
+			case DXGI_FORMAT_R32G8X24_TYPELESS:
+			case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+				return 8;
+			case DXGI_FORMAT_R8G8_TYPELESS:
+			case DXGI_FORMAT_R8G8_UNORM:
+			case DXGI_FORMAT_R8G8_UINT:
+			case DXGI_FORMAT_R8G8_SNORM:
+			case DXGI_FORMAT_R8G8_SINT:
+			case DXGI_FORMAT_R16_TYPELESS:
+			case DXGI_FORMAT_R16_FLOAT:
+			case DXGI_FORMAT_D16_UNORM:
+			case DXGI_FORMAT_R16_UNORM:
+			case DXGI_FORMAT_R16_UINT:
+			case DXGI_FORMAT_R16_SNORM:
+			case DXGI_FORMAT_R16_SINT:
+				return 2;
+			case DXGI_FORMAT_R8_TYPELESS:
+			case DXGI_FORMAT_R8_UNORM:
+			case DXGI_FORMAT_R8_UINT:
+			case DXGI_FORMAT_R8_SNORM:
+			case DXGI_FORMAT_R8_SINT:
+				return 1;
+			// 32 bit formats, block compressed formats are approximated with 4 bytes per texel as well
+			default:
+				return 4;
+		}
+	}
+
 	// Convert dxc shader type to user defined shader type
 	static ShaderType convert_to_internal_shader_type(D3D12_SHADER_VERSION_TYPE shader_version_type)
 	{
@@ -50,7 +115,7 @@ namespace toy
 			case D3D12_SHVER_GEOMETRY_SHADER : return ShaderType::GeometryShader;
 			case D3D12_SHVER_PIXEL_SHADER    : return ShaderType::PixelShader;
 			case D3D12_SHVER_COMPUTE_SHADER  : return ShaderType::ComputeShader;
-			default : assert(false && "Unsupported shader");
+			default : assert(false && "Unsupported shader"); return ShaderType::VertexShader;
 		}
 	}
 
@@ -65,7 +130,7 @@ namespace toy
 			case ShaderType::GeometryShader: return L"GS";
 			case ShaderType::PixelShader   : return L"PS";
 			case ShaderType::ComputeShader : return L"CS";
-			default: assert(false && "Unsupported shader type");
+			default: assert(false && "Unsupported shader type"); return {};
 		}
 	}
 
@@ -78,7 +143,7 @@ namespace toy
 			case D3D_REGISTER_COMPONENT_UINT32  : return ShaderInputParaType::UInt32;
 			case D3D_REGISTER_COMPONENT_SINT32  : return ShaderInputParaType::SInt32;
 			case D3D_REGISTER_COMPONENT_FLOAT32 : return ShaderInputParaType::Float32;
-			default: assert(false && "Unsupported shader component type");
+			default: assert(false && "Unsupported shader component type"); return ShaderInputParaType::Unknown;
 		}
 	}
 
@@ -128,6 +193,111 @@ namespace toy
 		return s_shader_input_para_mapping[input_para_key];
 	}
 
+	// Compressed format of a float attribute, unknown when the encoding can't hold that many components
+	static DXGIFormatDesc query_compressed_format_desc(VertexAttributeEncoding encoding, uint32_t component_count)
+	{
+		switch (encoding)
+		{
+			case VertexAttributeEncoding::Float16:
+				return component_count <= 2 ? DXGIFormatDesc{ DXGI_FORMAT_R16G16_FLOAT, 4 } : DXGIFormatDesc{ DXGI_FORMAT_R16G16B16A16_FLOAT, 8 };
+			case VertexAttributeEncoding::BiasedUnorm10:
+				return DXGIFormatDesc{ DXGI_FORMAT_R10G10B10A2_UNORM, 4 };
+			case VertexAttributeEncoding::Snorm8:
+				return DXGIFormatDesc{ DXGI_FORMAT_R8G8B8A8_SNORM, 4 };
+			case VertexAttributeEncoding::Octahedral16:
+				return component_count == 3 ? DXGIFormatDesc{ DXGI_FORMAT_R16G16_SNORM, 4 } : DXGIFormatDesc{};
+			default:
+				return DXGIFormatDesc{};
+		}
+	}
+
+	// Assign every VS input attribute a stream and an offset inside it according to the layout policy
+	static VertexFormat build_vertex_format(ID3D12ShaderReflection *shader_reflection, const D3D12_SHADER_DESC &shader_desc, const VertexLayoutDesc &vertex_layout)
+	{
+		VertexFormat vertex_format{};
+		for (uint32_t index = 0; index < shader_desc.InputParameters; ++index)
+		{
+			D3D12_SIGNATURE_PARAMETER_DESC signature_parameter_desc{};
+			shader_reflection->GetInputParameterDesc(index, &signature_parameter_desc);
+			// System values such as SV_VertexID are generated by the input assembler, not fetched
+			if (signature_parameter_desc.SystemValueType != D3D_NAME_UNDEFINED) {
+				continue;
+			}
+			auto shader_input_para_type = convert_to_internal_component_type(signature_parameter_desc.ComponentType);
+			auto shader_input_para_mask = static_cast<ShaderInputParaMask>(signature_parameter_desc.Mask);
+			auto dxgi_format_desc = query_dxgi_format_desc(shader_input_para_mask, shader_input_para_type);
+			const uint32_t component_count = static_cast<uint32_t>(std::popcount(signature_parameter_desc.Mask));
+
+			auto encoding = VertexAttributeEncoding::Float32;
+			auto compression_iter = std::ranges::find_if(vertex_layout.compressions, [&](const VertexAttributeCompression &compression)
+			{
+				return compression.semantic_name == signature_parameter_desc.SemanticName;
+			});
+			if (compression_iter != vertex_layout.compressions.end() && compression_iter->encoding != VertexAttributeEncoding::Float32) {
+				auto compressed_format_desc = query_compressed_format_desc(compression_iter->encoding, component_count);
+				if (shader_input_para_type != ShaderInputParaType::Float32 || compressed_format_desc.dxgi_format == DXGI_FORMAT_UNKNOWN) {
+					std::cout << std::format("Compression hint of {}{} doesn't fit a {} component {} input, keeping the 32-bit format\n",
+											 signature_parameter_desc.SemanticName, signature_parameter_desc.SemanticIndex, component_count,
+											 shader_input_para_type == ShaderInputParaType::Float32 ? "float" : "integer");
+				} else {
+					dxgi_format_desc = compressed_format_desc;
+					encoding = compression_iter->encoding;
+				}
+			}
+
+			// Instance attributes keep their step rate as the stream id until the streams are compacted
+			auto instance_classification = std::ranges::find_if(vertex_layout.instance_classifications, [&](const VertexInstanceClassification &classification)
+			{
+				return classification.semantic_name == signature_parameter_desc.SemanticName;
+			});
+			if (instance_classification != vertex_layout.instance_classifications.end()) {
+				vertex_format.attributes.push_back({ signature_parameter_desc.SemanticName, signature_parameter_desc.SemanticIndex, dxgi_format_desc.dxgi_format,
+													 instance_classification->instance_step_rate, 0, dxgi_format_desc.size_in_bytes, component_count, encoding,
+													 D3D11_INPUT_PER_INSTANCE_DATA, instance_classification->instance_step_rate });
+				continue;
+			}
+
+			uint32_t stream_id = 0;
+			switch (vertex_layout.layout_policy)
+			{
+				case VertexLayoutPolicy::SeparateStreams:
+					stream_id = static_cast<uint32_t>(vertex_format.attributes.size());
+					break;
+				case VertexLayoutPolicy::Interleaved:
+					stream_id = 0;
+					break;
+				case VertexLayoutPolicy::HotCold:
+					stream_id = std::ranges::find(vertex_layout.hot_semantics, signature_parameter_desc.SemanticName) != vertex_layout.hot_semantics.end() ? 0 : 1;
+					break;
+			}
+			vertex_format.attributes.push_back({ signature_parameter_desc.SemanticName, signature_parameter_desc.SemanticIndex, dxgi_format_desc.dxgi_format,
+												 stream_id, 0, dxgi_format_desc.size_in_bytes, component_count, encoding });
+		}
+
+		// Compact the streams actually used into consecutive slots, vertex streams first, then pack attributes in signature order
+		auto compact_streams = [&vertex_format](D3D11_INPUT_CLASSIFICATION input_slot_class)
+		{
+			std::unordered_map<uint32_t, uint32_t> stream_slots{};
+			for (auto &&vertex_attribute : vertex_format.attributes)
+			{
+				if (vertex_attribute.input_slot_class != input_slot_class) {
+					continue;
+				}
+				auto [stream_slot, is_new_stream] = stream_slots.try_emplace(vertex_attribute.input_slot, vertex_format.get_stream_count());
+				if (is_new_stream) {
+					vertex_format.stream_strides.emplace_back(0);
+					vertex_format.stream_classes.emplace_back(input_slot_class);
+				}
+				vertex_attribute.input_slot = stream_slot->second;
+				vertex_attribute.aligned_byte_offset = vertex_format.stream_strides[vertex_attribute.input_slot];
+				vertex_format.stream_strides[vertex_attribute.input_slot] += vertex_attribute.size_in_bytes;
+			}
+		};
+		compact_streams(D3D11_INPUT_PER_VERTEX_DATA);
+		compact_streams(D3D11_INPUT_PER_INSTANCE_DATA);
+		return vertex_format;
+	}
+
 	static std::wstring_view query_shader_target_profile(ShaderType shader_type, ShaderTargetProfile shader_target_profile)
 	{
 		const auto profile_key = shader_type | shader_target_profile;
@@ -135,268 +305,831 @@ namespace toy
 	}
 
 	// Dxc instance
+#if defined(_WIN32)
 	constexpr std::string_view s_compiler_path = "D:/Dev/CMakeCook/DXC_Research/dxc/bin/x64/dxcompiler.dll";
+#else
+	constexpr std::string_view s_compiler_path = "libdxcompiler.so";
+#endif
 	constexpr std::wstring_view s_search_path = L"D:/Dev/CMakeCook/DXC_Research/shaders";
-	DxcInStance::DxcInStance()
-	{
-		compiler_hmodule = LoadLibraryA(s_compiler_path.data());
-		dxc_create_instance_pfn = reinterpret_cast<DxcCreateInstanceFn>(GetProcAddress(compiler_hmodule, "DxcCreateInstance"));
-		dxc_create_instance_pfn(CLSID_DxcUtils, IID_PPV_ARGS(&utils));
-		dxc_create_instance_pfn(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
-		dxc_create_instance_pfn(CLSID_DxcValidator, IID_PPV_ARGS(validator.GetAddressOf()));
-		utils->CreateDefaultIncludeHandler(include_handler.GetAddressOf());
-	}
+	constexpr std::string_view s_symbol_directory = "shader_symbols";
 
-	DxcInStance::~DxcInStance()
+	static void *load_compiler_module(const std::string &path)
 	{
-		if (compiler_hmodule)
-		{
-			FreeLibrary(compiler_hmodule);
-			dxc_create_instance_pfn = nullptr;
-		}
+#if defined(_WIN32)
+		return LoadLibraryA(path.c_str());
+#else
+		return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
 	}
 
-	DxcInStance &DxcInStance::get()
+	static void *query_compiler_symbol(void *module, const char *symbol_name)
 	{
-		static DxcInStance dxc_instance{};
-		return dxc_instance;
+#if defined(_WIN32)
+		return reinterpret_cast<void *>(GetProcAddress(static_cast<HMODULE>(module), symbol_name));
+#else
+		return dlsym(module, symbol_name);
+#endif
 	}
 
-	DxcShaderResult DxcInStance::create_shader_from_file(std::wstring_view shader_filepath, ShaderType shader_type, ShaderTargetProfile shader_target_profile)
+	static void free_compiler_module(void *module)
 	{
-		DxcShaderResult shader_result{};
-		auto entry_point = query_shader_entry_point(shader_type);
-		auto target_profile = query_shader_target_profile(shader_type, shader_target_profile);
-		std::vector<const wchar_t *> compilation_arguments{
-			L"-E", entry_point.data(),
-			L"-T", target_profile.data(),
-			L"-I", s_search_path.data(),
-			DXC_ARG_PACK_MATRIX_ROW_MAJOR,
-			DXC_ARG_WARNINGS_ARE_ERRORS,
-			DXC_ARG_ALL_RESOURCES_BOUND,
-		};
-#if defined(_DEBUG)
-		compilation_arguments.push_back(DXC_ARG_DEBUG);
+#if defined(_WIN32)
+		FreeLibrary(static_cast<HMODULE>(module));
 #else
-		compilation_arguments.push_back(DXC_ARG_OPTIMIZATION_LEVEL1);
+		dlclose(module);
 #endif
+	}
 
-		// Load the shader source file to a blob.
-		ComPtr<IDxcBlobEncoding> source_blob = nullptr;
-		utils->LoadFile(shader_filepath.data(), nullptr, source_blob.GetAddressOf());
-		const DxcBuffer source_buffer{
-			.Ptr = source_blob->GetBufferPointer(),
-			.Size = source_blob->GetBufferSize(),
-			.Encoding = 0U,
-		};
+	// Default include handler that records the files it opens, the dependencies of a cached compile
+	struct DependencyIncludeHandler final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IDxcIncludeHandler>
+	{
+	private:
+		ComPtr<IDxcIncludeHandler> include_handler = nullptr;
 
-		// Compile shader
-		ComPtr<IDxcResult> compiled_shader_buffer = nullptr;
-		const HRESULT hr = compiler->Compile(&source_buffer,
-								compilation_arguments.data(),
-								static_cast<uint32_t>(compilation_arguments.size()),
-								include_handler.Get(),
-								IID_PPV_ARGS(compiled_shader_buffer.GetAddressOf()));
-		if (FAILED(hr))
+	public:
+		std::vector<ShaderDependency> dependencies = {};
+
+		explicit DependencyIncludeHandler(IDxcIncludeHandler *input_include_handler)
+		: include_handler(input_include_handler)
+		{
+
+		}
+
+		HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR filename, IDxcBlob **include_source) override
+		{
+			const HRESULT hr = include_handler->LoadSource(filename, include_source);
+			ShaderDependency shader_dependency{ filename, 0 };
+			if (SUCCEEDED(hr) && ShaderBytecodeCache::hash_file(shader_dependency.file_path, shader_dependency.content_hash))
+			{
+				dependencies.emplace_back(std::move(shader_dependency));
+			}
+			return hr;
+		}
+	};
+
+	// One file per shader hash, an existing file already holds the same PDB
+	static void write_shader_symbols(std::string_view symbol_directory, IDxcBlob *pdb_blob, IDxcBlobWide *pdb_name, const ShaderBytecodeEntry &shader_bytecode_entry)
+	{
+		std::filesystem::path pdb_file_name{};
+		if (pdb_name != nullptr && pdb_name->GetStringLength() > 0)
+		{
+			pdb_file_name = std::wstring(pdb_name->GetStringPointer(), pdb_name->GetStringLength());
+		}
+		else if (shader_bytecode_entry.has_shader_hash)
+		{
+			std::string hash_name{};
+			for (const uint8_t digest_byte : shader_bytecode_entry.shader_hash.HashDigest)
+			{
+				hash_name += std::format("{:02x}", digest_byte);
+			}
+			pdb_file_name = hash_name + ".pdb";
+		}
+		else
+		{
+			return;
+		}
+
+		std::error_code error_code{};
+		const auto pdb_file_path = std::filesystem::path(symbol_directory) / pdb_file_name.filename();
+		if (std::filesystem::exists(pdb_file_path, error_code))
+		{
+			return;
+		}
+		std::filesystem::create_directories(symbol_directory, error_code);
+
+		// Written aside and renamed so a debugger never loads a partial file
+		auto temporary_path = pdb_file_path;
+		temporary_path += std::format(".{:x}.tmp", reinterpret_cast<uintptr_t>(&shader_bytecode_entry));
+		{
+			std::ofstream pdb_file{ temporary_path, std::ios::binary | std::ios::trunc };
+			pdb_file.write(static_cast<const char *>(pdb_blob->GetBufferPointer()), static_cast<std::streamsize>(pdb_blob->GetBufferSize()));
+			if (!pdb_file)
+			{
+				std::cout << std::format("Failed to write shader symbols {}\n", pdb_file_path.string());
+				pdb_file.close();
+				std::filesystem::remove(temporary_path, error_code);
+				return;
+			}
+		}
+		std::filesystem::rename(temporary_path, pdb_file_path, error_code);
+		if (error_code)
 		{
-			std::cout << std::format("Failed to compile shader with path\n");
+			std::filesystem::remove(temporary_path, error_code);
 		}
+	}
 
+	// Outputs of a finished compile copied into the entry, nothing of the result is referenced afterwards
+	static bool read_compile_result(IDxcResult *compiled_shader_buffer, std::string_view symbol_directory, ShaderBytecodeEntry &shader_bytecode_entry,
+									std::string &error_log)
+	{
 		// Get compilation errors (if any).
 		ComPtr<IDxcBlobUtf8> errors = nullptr;
 		compiled_shader_buffer->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(errors.GetAddressOf()), nullptr);
 		if (errors != nullptr && errors->GetStringLength() > 0LLU)
 		{
-			const char *errorMessage = errors->GetStringPointer();
-			std::cout << std::format("{}\n", errorMessage);
+			error_log.assign(errors->GetStringPointer(), errors->GetStringLength());
 		}
 
 		// Get shader blob
-		compiled_shader_buffer->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(shader_result.shader_blob.GetAddressOf()), nullptr);
-		if (shader_result.shader_blob == nullptr)
+		ComPtr<IDxcBlob> shader_blob = nullptr;
+		compiled_shader_buffer->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(shader_blob.GetAddressOf()), nullptr);
+		if (shader_blob == nullptr || shader_blob->GetBufferSize() == 0)
+		{
+			error_log = error_log.empty() ? std::format("Failed to get shader blob") : error_log;
+			return false;
+		}
+
+		// Get shader hash, identical bytecode has identical hash
+		ComPtr<IDxcBlob> shader_hash_blob = nullptr;
+		compiled_shader_buffer->GetOutput(DXC_OUT_SHADER_HASH, IID_PPV_ARGS(shader_hash_blob.GetAddressOf()), nullptr);
+		if (shader_hash_blob != nullptr && shader_hash_blob->GetBufferSize() == sizeof(DxcShaderHash))
 		{
-			std::cout << std::format("Failed to get shader blob\n");
+			std::memcpy(&shader_bytecode_entry.shader_hash, shader_hash_blob->GetBufferPointer(), sizeof(DxcShaderHash));
+			shader_bytecode_entry.has_shader_hash = true;
 		}
 
 		// Get shader reflection data.
 		ComPtr<IDxcBlob> reflection_blob = nullptr;
 		compiled_shader_buffer->GetOutput(DXC_OUT_REFLECTION, IID_PPV_ARGS(reflection_blob.GetAddressOf()), nullptr);
-		const DxcBuffer reflection_buffer{
-			.Ptr = reflection_blob->GetBufferPointer(),
-			.Size = reflection_blob->GetBufferSize(),
-			.Encoding = 0U,
-		};
-		utils->CreateReflection(&reflection_buffer, IID_PPV_ARGS(shader_result.shader_reflection.GetAddressOf()));
-		if (shader_result.shader_reflection == nullptr)
+		if (reflection_blob == nullptr)
 		{
-			std::cout << std::format("Failed to get shader reflection");
+			error_log = error_log.empty() ? std::format("Failed to get shader reflection") : error_log;
+			return false;
 		}
 
-		return shader_result;
-	}
-
-	// Constant buffer
-	ConstantBuffer::ConstantBuffer(const std::string &cb_name, uint32_t slot, uint32_t size_in_bytes, uint8_t *initial_data)
-	: constant_buffer(nullptr), upload_data(size_in_bytes), constant_buffer_name(cb_name), binding_slot(slot), is_dirty(false)
-	{
-		if (initial_data != nullptr)
+		// Debug info was stripped from the container, the PDB goes to the symbol store under the name the container refers to
+		ComPtr<IDxcBlob> pdb_blob = nullptr;
+		ComPtr<IDxcBlobWide> pdb_name = nullptr;
+		compiled_shader_buffer->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(pdb_blob.GetAddressOf()), pdb_name.GetAddressOf());
+		if (pdb_blob != nullptr && !symbol_directory.empty())
 		{
-			std::memcpy(upload_data.data(), initial_data, size_in_bytes);
+			write_shader_symbols(symbol_directory, pdb_blob.Get(), pdb_name.Get(), shader_bytecode_entry);
 		}
-	}
 
-	HRESULT ConstantBuffer::create_buffer(ID3D11Device *device)
-	{
-		if (device != nullptr)
-		{
-			D3D11_BUFFER_DESC constant_buffer_desc{};
-			constant_buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
-			constant_buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-			constant_buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-			constant_buffer_desc.ByteWidth = static_cast<uint32_t>(upload_data.size());
-			return device->CreateBuffer(&constant_buffer_desc, nullptr, constant_buffer.GetAddressOf());
-		}
-		return S_FALSE;
+		auto bytecode = static_cast<const uint8_t *>(shader_blob->GetBufferPointer());
+		auto reflection = static_cast<const uint8_t *>(reflection_blob->GetBufferPointer());
+		shader_bytecode_entry.bytecode.assign(bytecode, bytecode + shader_blob->GetBufferSize());
+		shader_bytecode_entry.reflection.assign(reflection, reflection + reflection_blob->GetBufferSize());
+		return true;
 	}
 
-	void ConstantBuffer::transmit_upload_data(ConstantBuffer &other) const
+	DxcInStance::DxcInStance()
+	: compiler_path(s_compiler_path), symbol_directory(s_symbol_directory)
 	{
-		const size_t min_size = (std::min)(upload_data.size(), other.upload_data.size());
-		std::memcpy(other.upload_data.data(), upload_data.data(), min_size);
+
 	}
 
-	void ConstantBuffer::update_buffer(ID3D11DeviceContext *device_context)
+	DxcInStance::~DxcInStance()
 	{
-		if (is_dirty)
+		// Release every dxc object before the code behind it is unloaded
+		idle_compilers.clear();
+		validator = nullptr;
+		utils = nullptr;
+		if (compiler_module)
 		{
-			is_dirty = false;
-			D3D11_MAPPED_SUBRESOURCE mapped_data{};
-			device_context->Map(constant_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_data);
-			std::memcpy(mapped_data.pData, upload_data.data(), upload_data.size());
-			device_context->Unmap(constant_buffer.Get(), 0);
+			free_compiler_module(compiler_module);
+			dxc_create_instance_pfn = nullptr;
+			dxc_create_instance2_pfn = nullptr;
 		}
 	}
 
-	void ConstantBuffer::set_shader_flag(ShaderType shader_type)
-	{
-		shader_flag = (shader_flag | shader_type);
-	}
-
-	void ConstantBuffer::emit_constant_buffer(ID3D11DeviceContext *device_context)
+	DxcInStance &DxcInStance::get()
 	{
-		if (shader_flag & ShaderType::VertexShader) {
-			bind_vs(device_context);
-		}
-		if (shader_flag & ShaderType::HullShader) {
-			bind_hs(device_context);
-		}
-		if (shader_flag & ShaderType::DomainShader) {
-			bind_ds(device_context);
-		}
-		if (shader_flag & ShaderType::GeometryShader) {
-			bind_gs(device_context);
-		}
-		if (shader_flag & ShaderType::PixelShader) {
-			bind_ps(device_context);
-		}
-		if (shader_flag & ShaderType::ComputeShader) {
-			bind_cs(device_context);
-		}
+		static DxcInStance dxc_instance{};
+		return dxc_instance;
 	}
 
-	void ConstantBuffer::bind_vs(ID3D11DeviceContext *device_context)
+	void DxcInStance::set_compiler_path(std::string_view path)
 	{
-		device_context->VSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+		compiler_path = path;
 	}
 
-	void ConstantBuffer::bind_hs(ID3D11DeviceContext *device_context)
+	void DxcInStance::set_compile_server(std::string_view socket_path, uint32_t timeout_ms)
 	{
-		device_context->HSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+		compile_server_path = socket_path;
+		compile_server_timeout_ms = timeout_ms;
 	}
 
-	void ConstantBuffer::bind_ds(ID3D11DeviceContext *device_context)
+	void DxcInStance::set_symbol_directory(std::string_view directory)
 	{
-		device_context->DSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+		symbol_directory = directory;
 	}
 
-	void ConstantBuffer::bind_gs(ID3D11DeviceContext *device_context)
+	bool DxcInStance::is_compiler_loaded() const
 	{
-		device_context->GSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+		return is_compiler_created.load(std::memory_order_acquire);
 	}
 
-	void ConstantBuffer::bind_ps(ID3D11DeviceContext *device_context)
+	bool DxcInStance::load_library()
 	{
-		device_context->PSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+		std::call_once(library_once_flag, [this]()
+		{
+			compiler_module = load_compiler_module(compiler_path);
+			if (compiler_module == nullptr)
+			{
+				std::cout << std::format("Failed to load dxc compiler {}\n", compiler_path);
+				return;
+			}
+			dxc_create_instance_pfn = reinterpret_cast<DxcCreateInstanceFn>(query_compiler_symbol(compiler_module, "DxcCreateInstance"));
+			if (dxc_create_instance_pfn == nullptr)
+			{
+				std::cout << std::format("Dxc compiler {} exports no DxcCreateInstance\n", compiler_path);
+				return;
+			}
+			dxc_create_instance2_pfn = reinterpret_cast<DxcCreateInstance2Proc>(query_compiler_symbol(compiler_module, "DxcCreateInstance2"));
+			dxc_create_instance_pfn(CLSID_DxcUtils, IID_PPV_ARGS(&utils));
+		});
+		return utils != nullptr;
 	}
 
-	void ConstantBuffer::bind_cs(ID3D11DeviceContext *device_context)
+	bool DxcInStance::load_compiler()
 	{
-		device_context->GSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+		if (!load_library())
+		{
+			return false;
+		}
+		std::call_once(compiler_once_flag, [this]()
+		{
+			dxc_create_instance_pfn(CLSID_DxcValidator, IID_PPV_ARGS(validator.GetAddressOf()));
+		});
+		return true;
 	}
 
-	// Constant buffer accessor
-	ConstantBufferAccessor::ConstantBufferAccessor(ConstantBuffer *input_constant_buffer, const std::string &in_component_name, uint32_t in_offset, uint32_t in_size)
-	: constant_buffer_ref(input_constant_buffer), component_name(in_component_name), component_offset(in_offset), component_size(in_size)
+	DxcInStance::PooledCompiler DxcInStance::acquire_compiler()
 	{
+		{
+			std::lock_guard<std::mutex> lock{ compiler_pool_mutex };
+			if (!idle_compilers.empty())
+			{
+				auto pooled_compiler = std::move(idle_compilers.back());
+				idle_compilers.pop_back();
+				return pooled_compiler;
+			}
+		}
 
+		// Each compiler allocates from its own arena, dxc without DxcCreateInstance2 uses the process heap
+		PooledCompiler pooled_compiler{};
+		if (dxc_create_instance2_pfn != nullptr)
+		{
+			pooled_compiler.compile_arena = Microsoft::WRL::Make<CompileArena>();
+			dxc_create_instance2_pfn(pooled_compiler.compile_arena.Get(), CLSID_DxcCompiler, IID_PPV_ARGS(pooled_compiler.compiler.GetAddressOf()));
+		}
+		else
+		{
+			dxc_create_instance_pfn(CLSID_DxcCompiler, IID_PPV_ARGS(pooled_compiler.compiler.GetAddressOf()));
+		}
+		if (pooled_compiler.compiler != nullptr)
+		{
+			std::lock_guard<std::mutex> lock{ compiler_pool_mutex };
+			++compilers_created;
+			is_compiler_created.store(true, std::memory_order_release);
+		}
+		return pooled_compiler;
 	}
 
-	void ConstantBufferAccessor::set_raw(const uint8_t *data, uint32_t offset_in_bytes, uint32_t size_in_bytes)
+	void DxcInStance::release_compiler(PooledCompiler pooled_compiler)
 	{
-		if (data == nullptr || offset_in_bytes > component_size) {
-			return;
-		}
-
-		if ((offset_in_bytes + size_in_bytes) > component_size) {
-			size_in_bytes = component_size - offset_in_bytes;
+		if (pooled_compiler.compiler != nullptr)
+		{
+			std::lock_guard<std::mutex> lock{ compiler_pool_mutex };
+			idle_compilers.emplace_back(std::move(pooled_compiler));
 		}
-
-		std::memcpy(constant_buffer_ref->upload_data.data() + component_offset + offset_in_bytes, data, size_in_bytes);
-		constant_buffer_ref->is_dirty = true;
 	}
 
-	void ConstantBufferAccessor::set_matrix_in_bytes(const uint8_t *no_padding_data, uint32_t rows, uint32_t cols)
+	bool DxcInStance::warm_up(uint32_t compiler_count)
 	{
-		if (rows == 0 || rows > 4 || cols == 0 || cols > 4) {
-			return;
+		if (!load_compiler())
+		{
+			return false;
 		}
-
-		uint32_t remain_bytes = component_size < 64 ? component_size : 64;
-		uint8_t *dst_data = constant_buffer_ref->upload_data.data() + component_offset;
-		while (remain_bytes > 0) {
-			constexpr uint32_t stride = 16;
-			uint32_t row_pitch = sizeof(uint32_t) * cols < remain_bytes ? sizeof(uint32_t) * cols : remain_bytes;
-			std::memcpy(dst_data, no_padding_data, row_pitch);
-			dst_data += stride;
-			no_padding_data += sizeof(uint32_t) * cols;
-			remain_bytes = remain_bytes < stride ? 0 : (remain_bytes - stride);
+		std::vector<PooledCompiler> pooled_compilers(compiler_count);
+		for (auto &&pooled_compiler : pooled_compilers)
+		{
+			pooled_compiler = acquire_compiler();
 		}
-		constant_buffer_ref->is_dirty = true;
+		const bool is_warm = std::ranges::all_of(pooled_compilers, [](const PooledCompiler &pooled_compiler) { return pooled_compiler.compiler != nullptr; });
+		for (auto &&pooled_compiler : pooled_compilers)
+		{
+			release_compiler(std::move(pooled_compiler));
+		}
+		return is_warm;
 	}
 
-	void ConstantBufferAccessor::set_sint_matrix(const int32_t *no_padding_data, uint32_t rows, uint32_t cols)
+	CompileArenaStats DxcInStance::get_compile_arena_stats() const
 	{
-		set_matrix_in_bytes(reinterpret_cast<const uint8_t *>(no_padding_data), rows, cols);
+		std::lock_guard<std::mutex> lock{ compiler_pool_mutex };
+		return total_arena_stats;
 	}
 
-	void ConstantBufferAccessor::set_uint_matrix(const uint32_t *no_padding_data, uint32_t rows, uint32_t cols)
+	void DxcInStance::print_compile_arena_stats() const
 	{
-		set_matrix_in_bytes(reinterpret_cast<const uint8_t *>(no_padding_data), rows, cols);
+		std::lock_guard<std::mutex> lock{ compiler_pool_mutex };
+		const uint64_t compiles = (std::max)(total_arena_stats.compiles, uint64_t{ 1 });
+		std::cout << std::format("Dxc compile arenas: {} compiles, {} rewound, {} bytes and {} allocations per compile, {} bytes peak, {} bytes from the heap\n",
+								total_arena_stats.compiles, total_arena_stats.rewinds, total_arena_stats.bytes_allocated / compiles,
+								total_arena_stats.allocations / compiles, total_arena_stats.peak_bytes, total_arena_stats.heap_bytes);
+		std::cout << std::format("Dxc compile arenas: {} compiles left blocks alive, {} bytes retained\n", total_arena_stats.retained_compiles, total_arena_stats.retained_bytes);
 	}
 
-	void ConstantBufferAccessor::set_float_matrix(const float *no_padding_data, uint32_t rows, uint32_t cols)
+	void DxcInStance::set_deferred_validation(bool is_deferred)
 	{
-		set_matrix_in_bytes(reinterpret_cast<const uint8_t *>(no_padding_data), rows, cols);
+		is_validation_deferred.store(is_deferred, std::memory_order_release);
 	}
 
-	void ConstantBufferAccessor::set_sint_vector(std::span<int32_t> data)
+	HRESULT DxcInStance::validate_bytecode(IDxcBlob *bytecode_blob, std::string &error_log)
 	{
-		auto components = (std::min)(static_cast<uint32_t>(data.size()), 4U);
-		auto size_in_bytes = (std::min)(static_cast<uint32_t>(components * sizeof(uint32_t)), component_size);
-		set_raw(reinterpret_cast<const uint8_t *>(data.data()), 0, size_in_bytes);
-	}
-
-	void ConstantBufferAccessor::set_uint_vector(std::span<uint32_t> data)
+		if (!load_compiler() || validator == nullptr)
+		{
+			return E_NOINTERFACE;
+		}
+		ComPtr<IDxcOperationResult> validation_result = nullptr;
+		{
+			std::lock_guard<std::mutex> lock{ validator_mutex };
+			validator->Validate(bytecode_blob, DxcValidatorFlags_InPlaceEdit, validation_result.GetAddressOf());
+		}
+		HRESULT status = E_FAIL;
+		if (validation_result != nullptr)
+		{
+			validation_result->GetStatus(&status);
+		}
+		if (FAILED(status))
+		{
+			ComPtr<IDxcBlobEncoding> errors = nullptr;
+			if (validation_result != nullptr)
+			{
+				validation_result->GetErrorBuffer(errors.GetAddressOf());
+			}
+			if (errors != nullptr && errors->GetBufferSize() > 0)
+			{
+				error_log.assign(static_cast<const char *>(errors->GetBufferPointer()), errors->GetBufferSize());
+			}
+			return status == E_NOINTERFACE ? E_FAIL : status;
+		}
+		return S_OK;
+	}
+
+	DxcShaderResult DxcInStance::create_shader_from_file(std::wstring_view shader_filepath, ShaderType shader_type, ShaderTargetProfile shader_target_profile)
+	{
+		// Read the source directly, the compiler isn't needed when the bytecode is cached
+		std::ifstream source_file{ std::filesystem::path(shader_filepath), std::ios::binary };
+		if (!source_file)
+		{
+			std::cout << std::format("Failed to load shader source file\n");
+			return {};
+		}
+		const std::vector<char> source_data{ std::istreambuf_iterator<char>(source_file), std::istreambuf_iterator<char>() };
+		const DxcBuffer source_buffer{
+			.Ptr = source_data.data(),
+			.Size = source_data.size(),
+			.Encoding = 0U,
+		};
+		return compile_shader(source_buffer, shader_type, shader_target_profile);
+	}
+
+	DxcShaderResult DxcInStance::create_shader_from_source(std::string_view shader_source, ShaderType shader_type, ShaderTargetProfile shader_target_profile)
+	{
+		const DxcBuffer source_buffer{
+			.Ptr = shader_source.data(),
+			.Size = shader_source.size(),
+			.Encoding = DXC_CP_UTF8,
+		};
+		return compile_shader(source_buffer, shader_type, shader_target_profile);
+	}
+
+	DxcShaderResult DxcInStance::compile_shader(const DxcBuffer &source_buffer, ShaderType shader_type, ShaderTargetProfile shader_target_profile)
+	{
+		auto entry_point = query_shader_entry_point(shader_type);
+		auto target_profile = query_shader_target_profile(shader_type, shader_target_profile);
+		std::vector<const wchar_t *> compilation_arguments{
+			L"-E", entry_point.data(),
+			L"-T", target_profile.data(),
+			L"-I", s_search_path.data(),
+			DXC_ARG_PACK_MATRIX_ROW_MAJOR,
+			DXC_ARG_WARNINGS_ARE_ERRORS,
+			DXC_ARG_ALL_RESOURCES_BOUND,
+			L"-Qstrip_debug",
+			L"-Qstrip_reflect",
+		};
+#if defined(_DEBUG)
+		compilation_arguments.push_back(DXC_ARG_DEBUG);
+#else
+		compilation_arguments.push_back(DXC_ARG_OPTIMIZATION_LEVEL1);
+#endif
+		if (is_validation_deferred.load(std::memory_order_acquire))
+		{
+			compilation_arguments.push_back(DXC_ARG_SKIP_VALIDATION);
+		}
+
+		// Bytecode cache first, then the compile server, the compiler is only created when both miss
+		auto &&shader_bytecode_cache = ShaderBytecodeCache::get();
+		const auto shader_bytecode_key = ShaderBytecodeCache::make_key({ static_cast<const uint8_t *>(source_buffer.Ptr), source_buffer.Size }, compilation_arguments);
+		if (auto shader_bytecode_entry = shader_bytecode_cache.query(shader_bytecode_key); shader_bytecode_entry != nullptr)
+		{
+			if (!shader_bytecode_entry->is_validated)
+			{
+				ShaderValidationQueue::get().enqueue(shader_bytecode_key, shader_bytecode_entry);
+			}
+			return create_shader_result(std::move(shader_bytecode_entry));
+		}
+
+		ShaderBytecodeEntry shader_bytecode_entry{};
+		std::string error_log{};
+		auto compile_status = CompileServerStatus::Unavailable;
+		if (!compile_server_path.empty())
+		{
+			compile_status = CompileClient::compile(compile_server_path, compile_server_timeout_ms, source_buffer, compilation_arguments, shader_bytecode_entry, error_log);
+		}
+		if (compile_status == CompileServerStatus::Unavailable)
+		{
+			const bool is_compiled = compile_bytecode(source_buffer, compilation_arguments, shader_bytecode_entry, error_log);
+			compile_status = is_compiled ? CompileServerStatus::Compiled : CompileServerStatus::Failed;
+		}
+		if (!error_log.empty())
+		{
+			std::cout << std::format("{}\n", error_log);
+		}
+		if (compile_status != CompileServerStatus::Compiled)
+		{
+			return {};
+		}
+		auto cached_entry = shader_bytecode_cache.insert(shader_bytecode_key, std::move(shader_bytecode_entry));
+		if (!cached_entry->is_validated)
+		{
+			ShaderValidationQueue::get().enqueue(shader_bytecode_key, cached_entry);
+		}
+		return create_shader_result(std::move(cached_entry));
+	}
+
+	DxcShaderResult DxcInStance::create_shader_result(std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry)
+	{
+		DxcShaderResult shader_result{};
+		if (shader_bytecode_entry == nullptr || !load_library())
+		{
+			return shader_result;
+		}
+		const DxcBuffer reflection_buffer{
+			.Ptr = shader_bytecode_entry->reflection.data(),
+			.Size = shader_bytecode_entry->reflection.size(),
+			.Encoding = 0U,
+		};
+		utils->CreateReflection(&reflection_buffer, IID_PPV_ARGS(shader_result.shader_reflection.GetAddressOf()));
+		if (shader_result.shader_reflection == nullptr)
+		{
+			std::cout << std::format("Failed to get shader reflection");
+		}
+		shader_result.shader_hash = shader_bytecode_entry->shader_hash;
+		shader_result.has_shader_hash = shader_bytecode_entry->has_shader_hash;
+		shader_result.shader_blob = ShaderBytecodeCache::create_bytecode_blob(std::move(shader_bytecode_entry));
+		return shader_result;
+	}
+
+	bool DxcInStance::compile_bytecode(const DxcBuffer &source_buffer, std::span<const wchar_t *const> compilation_arguments, ShaderBytecodeEntry &shader_bytecode_entry,
+									   std::string &error_log, CompileArenaStats *compile_arena_stats)
+	{
+		if (!load_compiler())
+		{
+			error_log = std::format("Dxc compiler {} is unavailable", compiler_path);
+			return false;
+		}
+		auto pooled_compiler = acquire_compiler();
+		ComPtr<IDxcIncludeHandler> include_handler = nullptr;
+		utils->CreateDefaultIncludeHandler(include_handler.GetAddressOf());
+		if (pooled_compiler.compiler == nullptr || include_handler == nullptr)
+		{
+			error_log = std::format("Failed to create dxc compiler");
+			release_compiler(std::move(pooled_compiler));
+			return false;
+		}
+
+		// Compile shader, every output is copied out and released before the arena is rewound
+		if (pooled_compiler.compile_arena != nullptr)
+		{
+			pooled_compiler.compile_arena->begin_compile();
+		}
+		auto dependency_include_handler = Microsoft::WRL::Make<DependencyIncludeHandler>(include_handler.Get());
+		ComPtr<IDxcResult> compiled_shader_buffer = nullptr;
+		const HRESULT hr = pooled_compiler.compiler->Compile(&source_buffer,
+								const_cast<LPCWSTR *>(compilation_arguments.data()),
+								static_cast<uint32_t>(compilation_arguments.size()),
+								dependency_include_handler.Get(),
+								IID_PPV_ARGS(compiled_shader_buffer.GetAddressOf()));
+		bool is_compiled = SUCCEEDED(hr) && compiled_shader_buffer != nullptr;
+		if (!is_compiled)
+		{
+			error_log = std::format("Failed to compile shader");
+		}
+		else
+		{
+			is_compiled = read_compile_result(compiled_shader_buffer.Get(), symbol_directory, shader_bytecode_entry, error_log);
+		}
+		compiled_shader_buffer = nullptr;
+		if (pooled_compiler.compile_arena != nullptr)
+		{
+			const auto arena_stats = pooled_compiler.compile_arena->end_compile();
+			if (compile_arena_stats != nullptr)
+			{
+				*compile_arena_stats = arena_stats;
+			}
+			std::lock_guard<std::mutex> lock{ compiler_pool_mutex };
+			total_arena_stats.compiles += arena_stats.compiles;
+			total_arena_stats.allocations += arena_stats.allocations;
+			total_arena_stats.bytes_allocated += arena_stats.bytes_allocated;
+			total_arena_stats.peak_bytes = (std::max)(total_arena_stats.peak_bytes, arena_stats.peak_bytes);
+			total_arena_stats.heap_bytes += arena_stats.heap_bytes;
+			total_arena_stats.rewinds += arena_stats.rewinds;
+			total_arena_stats.retained_compiles += arena_stats.retained_compiles;
+			total_arena_stats.retained_bytes += arena_stats.retained_bytes;
+		}
+		release_compiler(std::move(pooled_compiler));
+		if (!is_compiled)
+		{
+			return false;
+		}
+
+		shader_bytecode_entry.dependencies = std::move(dependency_include_handler->dependencies);
+		shader_bytecode_entry.is_validated = std::ranges::none_of(compilation_arguments, [](const wchar_t *argument)
+		{
+			return std::wstring_view(argument) == DXC_ARG_SKIP_VALIDATION;
+		});
+		return true;
+	}
+
+	// Constant buffer
+	ConstantBuffer::ConstantBuffer(const std::string &cb_name, uint32_t slot, uint32_t size_in_bytes, uint8_t *initial_data)
+	: constant_buffer(nullptr), upload_data(size_in_bytes), constant_buffer_name(cb_name), binding_slot(slot), is_dirty(false)
+	{
+		if (initial_data != nullptr)
+		{
+			std::memcpy(upload_data.data(), initial_data, size_in_bytes);
+		}
+	}
+
+	ConstantBuffer::~ConstantBuffer()
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			constant_buffer_pool->free(pool_slot);
+		}
+	}
+
+	HRESULT ConstantBuffer::create_buffer(ID3D11Device *device)
+	{
+		if (device != nullptr)
+		{
+			D3D11_BUFFER_DESC constant_buffer_desc{};
+			constant_buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+			constant_buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			constant_buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			constant_buffer_desc.ByteWidth = static_cast<uint32_t>(upload_data.size());
+			return device->CreateBuffer(&constant_buffer_desc, nullptr, constant_buffer.GetAddressOf());
+		}
+		return S_FALSE;
+	}
+
+	HRESULT ConstantBuffer::create_buffer(ConstantBufferPool &pool)
+	{
+		pool_slot = pool.allocate(static_cast<uint32_t>(upload_data.size()));
+		if (!pool_slot.is_valid())
+		{
+			return create_buffer(pool.get_device());
+		}
+		constant_buffer_pool = &pool;
+		constant_buffer_pool->write(pool_slot, upload_data.data(), static_cast<uint32_t>(upload_data.size()));
+		return S_OK;
+	}
+
+	void ConstantBuffer::stage_buffer()
+	{
+		if (is_dirty && constant_buffer_pool != nullptr)
+		{
+			is_dirty = false;
+			transient_slot = {};
+			constant_buffer_pool->write(pool_slot, upload_data.data(), static_cast<uint32_t>(upload_data.size()));
+		}
+	}
+
+	void ConstantBuffer::transmit_upload_data(ConstantBuffer &other) const
+	{
+		const size_t min_size = (std::min)(upload_data.size(), other.upload_data.size());
+		std::memcpy(other.upload_data.data(), upload_data.data(), min_size);
+	}
+
+	std::span<const uint8_t> ConstantBuffer::get_upload_data() const
+	{
+		return upload_data;
+	}
+
+	void ConstantBuffer::update_buffer(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			// Staged contents go up with their page, anything else is written to the ring so a draw doesn't discard a whole page
+			if (is_dirty || (transient_slot.is_valid() && !constant_buffer_pool->is_transient_current(device_context, transient_slot)))
+			{
+				transient_slot = constant_buffer_pool->write_transient(device_context, upload_data.data(), static_cast<uint32_t>(upload_data.size()));
+				is_dirty = !transient_slot.is_valid();
+			}
+			stage_buffer();
+			// A deferred context can't flush the page, the contents go to its own ring instead
+			if (!transient_slot.is_valid() && !constant_buffer_pool->flush_page(device_context, pool_slot))
+			{
+				transient_slot = constant_buffer_pool->write_transient(device_context, upload_data.data(), static_cast<uint32_t>(upload_data.size()));
+			}
+			return;
+		}
+		if (is_dirty)
+		{
+			is_dirty = false;
+			D3D11_MAPPED_SUBRESOURCE mapped_data{};
+			device_context->Map(constant_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_data);
+			std::memcpy(mapped_data.pData, upload_data.data(), upload_data.size());
+			device_context->Unmap(constant_buffer.Get(), 0);
+		}
+	}
+
+	void ConstantBuffer::set_shader_flag(ShaderType shader_type)
+	{
+		shader_flag = (shader_flag | shader_type);
+	}
+
+	void ConstantBuffer::set_shader_flag(uint32_t shader_flags)
+	{
+		shader_flag = shader_flag | shader_flags;
+	}
+
+	void ConstantBuffer::emit_constant_buffer(ID3D11DeviceContext *device_context)
+	{
+		if (shader_flag & ShaderType::VertexShader) {
+			bind_vs(device_context);
+		}
+		if (shader_flag & ShaderType::HullShader) {
+			bind_hs(device_context);
+		}
+		if (shader_flag & ShaderType::DomainShader) {
+			bind_ds(device_context);
+		}
+		if (shader_flag & ShaderType::GeometryShader) {
+			bind_gs(device_context);
+		}
+		if (shader_flag & ShaderType::PixelShader) {
+			bind_ps(device_context);
+		}
+		if (shader_flag & ShaderType::ComputeShader) {
+			bind_cs(device_context);
+		}
+	}
+
+	void ConstantBuffer::bind_vs(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			auto &&bound_slot = query_bound_slot();
+			const uint32_t first_constant = bound_slot.query_first_constant();
+			const uint32_t num_constants = bound_slot.query_num_constants();
+			ConstantBufferPool::query_device_context1(device_context)->VSSetConstantBuffers1(binding_slot, 1, &bound_slot.buffer, &first_constant, &num_constants);
+			return;
+		}
+		device_context->VSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+	}
+
+	void ConstantBuffer::bind_hs(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			auto &&bound_slot = query_bound_slot();
+			const uint32_t first_constant = bound_slot.query_first_constant();
+			const uint32_t num_constants = bound_slot.query_num_constants();
+			ConstantBufferPool::query_device_context1(device_context)->HSSetConstantBuffers1(binding_slot, 1, &bound_slot.buffer, &first_constant, &num_constants);
+			return;
+		}
+		device_context->HSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+	}
+
+	void ConstantBuffer::bind_ds(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			auto &&bound_slot = query_bound_slot();
+			const uint32_t first_constant = bound_slot.query_first_constant();
+			const uint32_t num_constants = bound_slot.query_num_constants();
+			ConstantBufferPool::query_device_context1(device_context)->DSSetConstantBuffers1(binding_slot, 1, &bound_slot.buffer, &first_constant, &num_constants);
+			return;
+		}
+		device_context->DSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+	}
+
+	void ConstantBuffer::bind_gs(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			auto &&bound_slot = query_bound_slot();
+			const uint32_t first_constant = bound_slot.query_first_constant();
+			const uint32_t num_constants = bound_slot.query_num_constants();
+			ConstantBufferPool::query_device_context1(device_context)->GSSetConstantBuffers1(binding_slot, 1, &bound_slot.buffer, &first_constant, &num_constants);
+			return;
+		}
+		device_context->GSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+	}
+
+	void ConstantBuffer::bind_ps(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			auto &&bound_slot = query_bound_slot();
+			const uint32_t first_constant = bound_slot.query_first_constant();
+			const uint32_t num_constants = bound_slot.query_num_constants();
+			ConstantBufferPool::query_device_context1(device_context)->PSSetConstantBuffers1(binding_slot, 1, &bound_slot.buffer, &first_constant, &num_constants);
+			return;
+		}
+		device_context->PSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+	}
+
+	void ConstantBuffer::bind_cs(ID3D11DeviceContext *device_context)
+	{
+		if (constant_buffer_pool != nullptr)
+		{
+			auto &&bound_slot = query_bound_slot();
+			const uint32_t first_constant = bound_slot.query_first_constant();
+			const uint32_t num_constants = bound_slot.query_num_constants();
+			ConstantBufferPool::query_device_context1(device_context)->CSSetConstantBuffers1(binding_slot, 1, &bound_slot.buffer, &first_constant, &num_constants);
+			return;
+		}
+		device_context->CSSetConstantBuffers(binding_slot, 1, constant_buffer.GetAddressOf());
+	}
+
+	const ConstantBufferSlot &ConstantBuffer::query_bound_slot() const
+	{
+		return transient_slot.is_valid() ? transient_slot : pool_slot;
+	}
+
+	// Constant buffer accessor
+	ConstantBufferAccessor::ConstantBufferAccessor(ConstantBuffer *input_constant_buffer, const std::string &in_component_name, uint32_t in_offset, uint32_t in_size)
+	: constant_buffer_ref(input_constant_buffer), component_name(in_component_name), component_offset(in_offset), component_size(in_size)
+	{
+
+	}
+
+	ConstantBuffer *ConstantBufferAccessor::get_constant_buffer() const
+	{
+		return constant_buffer_ref;
+	}
+
+	void ConstantBufferAccessor::set_raw(const uint8_t *data, uint32_t offset_in_bytes, uint32_t size_in_bytes)
+	{
+		if (data == nullptr || offset_in_bytes > component_size) {
+			return;
+		}
+
+		if ((offset_in_bytes + size_in_bytes) > component_size) {
+			size_in_bytes = component_size - offset_in_bytes;
+		}
+
+		std::memcpy(constant_buffer_ref->upload_data.data() + component_offset + offset_in_bytes, data, size_in_bytes);
+		constant_buffer_ref->is_dirty = true;
+	}
+
+	void ConstantBufferAccessor::set_matrix_in_bytes(const uint8_t *no_padding_data, uint32_t rows, uint32_t cols)
+	{
+		if (rows == 0 || rows > 4 || cols == 0 || cols > 4) {
+			return;
+		}
+
+		uint32_t remain_bytes = component_size < 64 ? component_size : 64;
+		uint8_t *dst_data = constant_buffer_ref->upload_data.data() + component_offset;
+		while (remain_bytes > 0) {
+			constexpr uint32_t stride = 16;
+			uint32_t row_pitch = sizeof(uint32_t) * cols < remain_bytes ? sizeof(uint32_t) * cols : remain_bytes;
+			std::memcpy(dst_data, no_padding_data, row_pitch);
+			dst_data += stride;
+			no_padding_data += sizeof(uint32_t) * cols;
+			remain_bytes = remain_bytes < stride ? 0 : (remain_bytes - stride);
+		}
+		constant_buffer_ref->is_dirty = true;
+	}
+
+	void ConstantBufferAccessor::set_sint_matrix(const int32_t *no_padding_data, uint32_t rows, uint32_t cols)
+	{
+		set_matrix_in_bytes(reinterpret_cast<const uint8_t *>(no_padding_data), rows, cols);
+	}
+
+	void ConstantBufferAccessor::set_uint_matrix(const uint32_t *no_padding_data, uint32_t rows, uint32_t cols)
+	{
+		set_matrix_in_bytes(reinterpret_cast<const uint8_t *>(no_padding_data), rows, cols);
+	}
+
+	void ConstantBufferAccessor::set_float_matrix(const float *no_padding_data, uint32_t rows, uint32_t cols)
+	{
+		set_matrix_in_bytes(reinterpret_cast<const uint8_t *>(no_padding_data), rows, cols);
+	}
+
+	void ConstantBufferAccessor::set_sint_vector(std::span<int32_t> data)
+	{
+		auto components = (std::min)(static_cast<uint32_t>(data.size()), 4U);
+		auto size_in_bytes = (std::min)(static_cast<uint32_t>(components * sizeof(uint32_t)), component_size);
+		set_raw(reinterpret_cast<const uint8_t *>(data.data()), 0, size_in_bytes);
+	}
+
+	void ConstantBufferAccessor::set_uint_vector(std::span<uint32_t> data)
 	{
 		auto components = (std::min)(static_cast<uint32_t>(data.size()), 4U);
 		auto size_in_bytes = (std::min)(static_cast<uint32_t>(components * sizeof(uint32_t)), component_size);
@@ -420,100 +1153,503 @@ namespace toy
 		set_raw(reinterpret_cast<const uint8_t *>(&data), 0, sizeof(uint32_t));
 	}
 
-	void ConstantBufferAccessor::set_float(float data)
+	void ConstantBufferAccessor::set_float(float data)
+	{
+		set_raw(reinterpret_cast<const uint8_t *>(&data), 0, sizeof(float));
+	}
+
+	// EmitShader
+	void EmitShader::operator()(const VertexShaderInfo &vertex_shader) const
+	{
+		device_context->VSSetShader(vertex_shader.vs.Get(), nullptr, 0);
+	}
+
+	void EmitShader::operator()(const HullShaderInfo &hull_shader) const
+	{
+		device_context->HSSetShader(hull_shader.hs.Get(), nullptr, 0);
+	}
+
+	void EmitShader::operator()(const DomainShaderInfo &domain_shader) const
+	{
+		device_context->DSSetShader(domain_shader.ds.Get(), nullptr, 0);
+	}
+
+	void EmitShader::operator()(const GeometryShaderInfo &geometry_shader) const
+	{
+		device_context->GSSetShader(geometry_shader.gs.Get(), nullptr, 0);
+	}
+
+	void EmitShader::operator()(const PixelShaderInfo &pixel_shader) const
+	{
+		device_context->PSSetShader(pixel_shader.ps.Get(), nullptr, 0);
+	}
+
+	void EmitShader::operator()(const ComputeShaderInfo &compute_shader) const
+	{
+		device_context->CSSetShader(compute_shader.cs.Get(), nullptr, 0);
+	}
+
+	// Emit shader resource view
+	static void emit_shader_resource_view(const ShaderResource &shader_resource, ID3D11DeviceContext *device_context)
+	{
+		if (shader_resource.shader_flag == ShaderType::VertexShader) {
+			device_context->VSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		} else if (shader_resource.shader_flag == ShaderType::HullShader) {
+			device_context->HSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		} else if (shader_resource.shader_flag == ShaderType::DomainShader) {
+			device_context->DSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		} else if (shader_resource.shader_flag == ShaderType::GeometryShader) {
+			device_context->GSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		} else if (shader_resource.shader_flag == ShaderType::PixelShader) {
+			device_context->PSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		} else {
+			device_context->CSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		}
+	}
+
+	// Emit sampler
+	static void emit_sampler_state(const SamplerState &sampler_state, ID3D11DeviceContext *device_context)
+	{
+		if (sampler_state.shader_flag == ShaderType::VertexShader) {
+			device_context->VSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		} else if (sampler_state.shader_flag == ShaderType::HullShader) {
+			device_context->HSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		} else if (sampler_state.shader_flag == ShaderType::DomainShader) {
+			device_context->DSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		} else if (sampler_state.shader_flag == ShaderType::GeometryShader) {
+			device_context->GSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		} else if (sampler_state.shader_flag == ShaderType::PixelShader) {
+			device_context->PSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		} else {
+			device_context->CSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		}
+	}
+
+	// Emit unordered access view
+	static void emit_unordered_access_view(RWResource &rw_resource, ID3D11DeviceContext *device_context)
+	{
+		if (rw_resource.shader_flag == ShaderType::PixelShader) {
+			const bool need_init = rw_resource.first_init;
+			rw_resource.first_init = false;
+			device_context->OMSetRenderTargetsAndUnorderedAccessViews(D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL, nullptr, nullptr,
+																	rw_resource.bind_slot, 1, &rw_resource.uav, (need_init ? &rw_resource.initial_count : nullptr));
+		} else if (rw_resource.shader_flag == ShaderType::ComputeShader) {
+			const bool need_init = rw_resource.enable_counter && rw_resource.first_init;
+			rw_resource.first_init = false;
+			device_context->CSSetUnorderedAccessViews(rw_resource.bind_slot, 1, &rw_resource.uav,
+														(need_init ? &rw_resource.initial_count : nullptr));
+		}
+	}
+
+	// Resource binding state
+	static uint32_t query_shader_stage_index(ShaderType shader_type)
+	{
+		switch (shader_type)
+		{
+			case ShaderType::VertexShader: return 0;
+			case ShaderType::HullShader: return 1;
+			case ShaderType::DomainShader: return 2;
+			case ShaderType::GeometryShader: return 3;
+			case ShaderType::PixelShader: return 4;
+			default: return 5;
+		}
+	}
+
+	template <typename View>
+	static ID3D11Resource *query_view_resource(View *view)
+	{
+		// Views keep their resource alive, so the raw pointer stays valid as long as the view is bound
+		if (view == nullptr) {
+			return nullptr;
+		}
+		ComPtr<ID3D11Resource> resource = nullptr;
+		view->GetResource(resource.GetAddressOf());
+		return resource.Get();
+	}
+
+	ResourceBindingState &ResourceBindingState::query(ID3D11DeviceContext *device_context)
+	{
+		thread_local std::unordered_map<ID3D11DeviceContext *, std::unique_ptr<ResourceBindingState>> binding_states{};
+		thread_local ID3D11DeviceContext *cached_device_context = nullptr;
+		thread_local ResourceBindingState *cached_binding_state = nullptr;
+		if (device_context != cached_device_context) {
+			auto &&binding_state = binding_states[device_context];
+			if (binding_state == nullptr) {
+				binding_state = std::make_unique<ResourceBindingState>();
+			}
+			cached_device_context = device_context;
+			cached_binding_state = binding_state.get();
+		}
+		return *cached_binding_state;
+	}
+
+	void ResourceBindingState::reset(ID3D11DeviceContext *device_context)
+	{
+		auto &&binding_state = query(device_context);
+		for (auto &&stage_resources : binding_state.srv_resources)
+		{
+			stage_resources.fill(nullptr);
+		}
+		binding_state.srv_slot_ends.fill(0);
+		binding_state.cs_uav_resources.fill(nullptr);
+		binding_state.ps_uav_resources.fill(nullptr);
+		binding_state.input_layout = nullptr;
+		binding_state.is_input_layout_known = true;
+		++binding_state.reset_count;
+	}
+
+	uint64_t ResourceBindingState::query_reset_count() const
+	{
+		return reset_count;
+	}
+
+	void ResourceBindingState::track_shader_resource(ShaderType shader_type, uint32_t slot, ID3D11Resource *resource)
+	{
+		if (slot >= srv_slot_count) {
+			return;
+		}
+		const uint32_t stage_index = query_shader_stage_index(shader_type);
+		srv_resources[stage_index][slot] = resource;
+		if (resource != nullptr) {
+			srv_slot_ends[stage_index] = (std::max)(srv_slot_ends[stage_index], slot + 1);
+		}
+	}
+
+	void ResourceBindingState::track_unordered_access(ShaderType shader_type, uint32_t slot, ID3D11Resource *resource)
+	{
+		if (slot >= uav_slot_count) {
+			return;
+		}
+		if (shader_type == ShaderType::ComputeShader) {
+			cs_uav_resources[slot] = resource;
+		} else if (shader_type == ShaderType::PixelShader) {
+			ps_uav_resources[slot] = resource;
+		}
+	}
+
+	void ResourceBindingState::unbind_shader_resources(ID3D11DeviceContext *device_context, uint32_t stage_index, const SrvSlotMask &slot_mask)
+	{
+		static ID3D11ShaderResourceView *const null_srvs[srv_slot_count] = {};
+		auto &&stage_resources = srv_resources[stage_index];
+		uint32_t slot = 0;
+		while (slot < srv_slot_count)
+		{
+			if ((slot_mask[slot / 64] & (1ULL << (slot % 64))) == 0) {
+				++slot;
+				continue;
+			}
+			uint32_t slot_end = slot;
+			while (slot_end < srv_slot_count && (slot_mask[slot_end / 64] & (1ULL << (slot_end % 64))) != 0)
+			{
+				stage_resources[slot_end] = nullptr;
+				++slot_end;
+			}
+
+			const uint32_t slot_count = slot_end - slot;
+			switch (stage_index)
+			{
+				case 0: device_context->VSSetShaderResources(slot, slot_count, null_srvs); break;
+				case 1: device_context->HSSetShaderResources(slot, slot_count, null_srvs); break;
+				case 2: device_context->DSSetShaderResources(slot, slot_count, null_srvs); break;
+				case 3: device_context->GSSetShaderResources(slot, slot_count, null_srvs); break;
+				case 4: device_context->PSSetShaderResources(slot, slot_count, null_srvs); break;
+				default: device_context->CSSetShaderResources(slot, slot_count, null_srvs); break;
+			}
+			hazards_resolved += slot_count;
+			++unbind_calls;
+			slot = slot_end;
+		}
+	}
+
+	void ResourceBindingState::unbind_unordered_access_views(ID3D11DeviceContext *device_context, ShaderType shader_type, uint64_t slot_mask)
+	{
+		static ID3D11UnorderedAccessView *const null_uavs[uav_slot_count] = {};
+		auto &&uav_resources = shader_type == ShaderType::ComputeShader ? cs_uav_resources : ps_uav_resources;
+		uint32_t slot = 0;
+		while (slot < uav_slot_count)
+		{
+			if ((slot_mask & (1ULL << slot)) == 0) {
+				++slot;
+				continue;
+			}
+			uint32_t slot_end = slot;
+			while (slot_end < uav_slot_count && (slot_mask & (1ULL << slot_end)) != 0)
+			{
+				uav_resources[slot_end] = nullptr;
+				++slot_end;
+			}
+
+			const uint32_t slot_count = slot_end - slot;
+			if (shader_type == ShaderType::ComputeShader) {
+				device_context->CSSetUnorderedAccessViews(slot, slot_count, null_uavs, nullptr);
+			} else {
+				device_context->OMSetRenderTargetsAndUnorderedAccessViews(D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL, nullptr, nullptr, slot, slot_count, null_uavs, nullptr);
+			}
+			hazards_resolved += slot_count;
+			++unbind_calls;
+			slot = slot_end;
+		}
+	}
+
+	uint64_t ResourceBindingState::query_unordered_access_mask(ShaderType shader_type, ID3D11Resource *resource) const
+	{
+		uint64_t slot_mask = 0;
+		if (resource == nullptr) {
+			return slot_mask;
+		}
+		auto &&uav_resources = shader_type == ShaderType::ComputeShader ? cs_uav_resources : ps_uav_resources;
+		for (uint32_t slot = 0; slot < uav_slot_count; ++slot)
+		{
+			if (uav_resources[slot] == resource) {
+				slot_mask |= 1ULL << slot;
+			}
+		}
+		return slot_mask;
+	}
+
+	void ResourceBindingState::emit_input_layout(ID3D11DeviceContext *device_context, ID3D11InputLayout *vertex_input_layout)
+	{
+		if (is_input_layout_known && input_layout == vertex_input_layout) {
+			++redundant_states_skipped;
+			return;
+		}
+		device_context->IASetInputLayout(vertex_input_layout);
+		input_layout = vertex_input_layout;
+		is_input_layout_known = true;
+	}
+
+	uint64_t ResourceBindingState::query_hazards_resolved() const
 	{
-		set_raw(reinterpret_cast<const uint8_t *>(&data), 0, sizeof(float));
+		return hazards_resolved;
 	}
 
-	// EmitShader
-	void EmitShader::operator()(const VertexShaderInfo &vertex_shader) const
+	uint64_t ResourceBindingState::query_unbind_calls() const
 	{
-		device_context->VSSetShader(vertex_shader.vs.Get(), nullptr, 0);
+		return unbind_calls;
 	}
 
-	void EmitShader::operator()(const HullShaderInfo &hull_shader) const
+	uint64_t ResourceBindingState::query_redundant_states_skipped() const
 	{
-		device_context->HSSetShader(hull_shader.hs.Get(), nullptr, 0);
+		return redundant_states_skipped;
 	}
 
-	void EmitShader::operator()(const DomainShaderInfo &domain_shader) const
+	// Effect prototype
+	EffectPrototype::EffectPrototype(const PipelineStateObject &pipeline_state_object, ID3D11Device *device)
 	{
-		device_context->DSSetShader(domain_shader.ds.Get(), nullptr, 0);
+		if (std::holds_alternative<GraphicsPipelineStateObject>(pipeline_state_object)) {
+			create_graphics_pipeline(std::get<GraphicsPipelineStateObject>(pipeline_state_object), device);
+		} else {
+			create_compute_pipeline(std::get<ComputePipelineStateObject>(pipeline_state_object), device);
+		}
 	}
 
-	void EmitShader::operator()(const GeometryShaderInfo &geometry_shader) const
+	std::shared_ptr<const EffectPrototype> EffectPrototype::create(const PipelineStateObject &pipeline_state_object, ID3D11Device *device)
 	{
-		device_context->GSSetShader(geometry_shader.gs.Get(), nullptr, 0);
+		auto effect_prototype = std::make_shared<const EffectPrototype>(pipeline_state_object, device);
+		return effect_prototype->is_valid() ? effect_prototype : nullptr;
 	}
 
-	void EmitShader::operator()(const PixelShaderInfo &pixel_shader) const
+	bool EffectPrototype::is_valid() const
 	{
-		device_context->PSSetShader(pixel_shader.ps.Get(), nullptr, 0);
+		return is_pipeline_valid;
 	}
 
-	void EmitShader::operator()(const ComputeShaderInfo &compute_shader) const
+	bool EffectPrototype::accept_shader_result(std::wstring_view shader_path, const DxcShaderResult &shader_result)
 	{
-		device_context->CSSetShader(compute_shader.cs.Get(), nullptr, 0);
+		D3D12_SHADER_DESC shader_desc{};
+		if (shader_result.shader_blob == nullptr || shader_result.shader_blob->GetBufferSize() == 0 || shader_result.shader_reflection == nullptr ||
+			FAILED(shader_result.shader_reflection->GetDesc(&shader_desc))) {
+			std::cout << std::format("Failed to create shader {}\n", std::filesystem::path(shader_path).string());
+			is_pipeline_valid = false;
+			return false;
+		}
+		return true;
 	}
 
-	// Emit shader resource view
-	static void emit_shader_resource_view(const ShaderResource &shader_resource, ID3D11DeviceContext *device_context)
+	void EffectPrototype::create_graphics_pipeline(const GraphicsPipelineStateObject &graphics_pipeline_state_object, ID3D11Device *device)
 	{
-		if (shader_resource.shader_flag == ShaderType::VertexShader) {
-			device_context->VSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
-		} else if (shader_resource.shader_flag == ShaderType::HullShader) {
-			device_context->HSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
-		} else if (shader_resource.shader_flag == ShaderType::DomainShader) {
-			device_context->DSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
-		} else if (shader_resource.shader_flag == ShaderType::GeometryShader) {
-			device_context->GSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
-		} else if (shader_resource.shader_flag == ShaderType::PixelShader) {
-			device_context->PSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+		auto &&dxc_instance = DxcInStance::get();
+		auto &&shader_object_cache = ShaderObjectCache::get();
+		rasterizer_state = graphics_pipeline_state_object.rasterizer_state;
+		depth_stencil_state = graphics_pipeline_state_object.depth_stencil_state;
+		blend_state = graphics_pipeline_state_object.blend_state;
+		auto shader_target_profile = graphics_pipeline_state_object.shader_target_profile;
+
+		// VS
+		if (!graphics_pipeline_state_object.vs_path.empty()) {
+			auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.vs_path, ShaderType::VertexShader, shader_target_profile);
+			if (!accept_shader_result(graphics_pipeline_state_object.vs_path, dxc_shader_result)) {
+				return;
+			}
+			update_shader_reflection(graphics_pipeline_state_object.vs_path, dxc_shader_result.shader_reflection.Get());
+			update_bytecode_digest(dxc_shader_result, ShaderType::VertexShader);
+
+			VertexShaderInfo vs_info{};
+			auto &&shader_blob = dxc_shader_result.shader_blob;
+			shader_object_cache.create_vertex_shader(device, dxc_shader_result, vs_info.vs.GetAddressOf());
+			pipeline_shaders.emplace_back(std::move(vs_info));
+
+			// Create vertex input layout if possible
+			auto &&shader_reflection = dxc_shader_result.shader_reflection;
+			D3D12_SHADER_DESC shader_desc{};
+			if (FAILED(shader_reflection->GetDesc(&shader_desc))) {
+				std::cout << std::format("Failed to get shader reflection desc\n");
+				return;
+			}
+			vertex_format = build_vertex_format(shader_reflection.Get(), shader_desc, graphics_pipeline_state_object.vertex_layout);
+			std::vector<D3D11_INPUT_ELEMENT_DESC> input_elements{};
+			input_elements.reserve(vertex_format.attributes.size());
+			for (auto &&vertex_attribute : vertex_format.attributes)
+			{
+				D3D11_INPUT_ELEMENT_DESC input_element_desc{ vertex_attribute.semantic_name.c_str(), vertex_attribute.semantic_index, vertex_attribute.format, vertex_attribute.input_slot,
+													vertex_attribute.aligned_byte_offset, vertex_attribute.input_slot_class, vertex_attribute.instance_step_rate };
+				input_elements.emplace_back(input_element_desc);
+			}
+			if (!input_elements.empty())
+			{
+				InputLayoutCache::get().create_input_layout(device, input_elements, shader_blob->GetBufferPointer(), shader_blob->GetBufferSize(),
+															vertex_input_layout.GetAddressOf());
+			}
 		} else {
-			device_context->CSSetShaderResources(shader_resource.bind_slot, 1, &shader_resource.srv);
+			pipeline_shaders.emplace_back(VertexShaderInfo{});
+		}
+
+		// HS
+		if (!graphics_pipeline_state_object.hs_path.empty()) {
+			auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.hs_path, ShaderType::HullShader, shader_target_profile);
+			if (!accept_shader_result(graphics_pipeline_state_object.hs_path, dxc_shader_result)) {
+				return;
+			}
+			update_shader_reflection(graphics_pipeline_state_object.hs_path, dxc_shader_result.shader_reflection.Get());
+			update_bytecode_digest(dxc_shader_result, ShaderType::HullShader);
+			HullShaderInfo hs_info{};
+			shader_object_cache.create_hull_shader(device, dxc_shader_result, hs_info.hs.GetAddressOf());
+			pipeline_shaders.emplace_back(std::move(hs_info));
+		} else {
+			pipeline_shaders.emplace_back(HullShaderInfo{});
+		}
+
+		// DS
+		if (!graphics_pipeline_state_object.ds_path.empty()) {
+			auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.ds_path, ShaderType::DomainShader, shader_target_profile);
+			if (!accept_shader_result(graphics_pipeline_state_object.ds_path, dxc_shader_result)) {
+				return;
+			}
+			update_shader_reflection(graphics_pipeline_state_object.ds_path, dxc_shader_result.shader_reflection.Get());
+			update_bytecode_digest(dxc_shader_result, ShaderType::DomainShader);
+			DomainShaderInfo ds_info{};
+			shader_object_cache.create_domain_shader(device, dxc_shader_result, ds_info.ds.GetAddressOf());
+			pipeline_shaders.emplace_back(std::move(ds_info));
+		} else {
+			pipeline_shaders.emplace_back(DomainShaderInfo{});
+		}
+
+		// GS
+		if (!graphics_pipeline_state_object.gs_path.empty()) {
+			auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.gs_path, ShaderType::GeometryShader, shader_target_profile);
+			if (!accept_shader_result(graphics_pipeline_state_object.gs_path, dxc_shader_result)) {
+				return;
+			}
+			update_shader_reflection(graphics_pipeline_state_object.gs_path, dxc_shader_result.shader_reflection.Get());
+			update_bytecode_digest(dxc_shader_result, ShaderType::GeometryShader);
+			GeometryShaderInfo gs_info{};
+			shader_object_cache.create_geometry_shader(device, dxc_shader_result, gs_info.gs.GetAddressOf());
+			pipeline_shaders.emplace_back(std::move(gs_info));
+		} else {
+			pipeline_shaders.emplace_back(GeometryShaderInfo{});
+		}
+
+		// PS
+		if (!graphics_pipeline_state_object.ps_path.empty()) {
+			auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.ps_path, ShaderType::PixelShader, shader_target_profile);
+			if (!accept_shader_result(graphics_pipeline_state_object.ps_path, dxc_shader_result)) {
+				return;
+			}
+			update_shader_reflection(graphics_pipeline_state_object.ps_path, dxc_shader_result.shader_reflection.Get());
+			update_bytecode_digest(dxc_shader_result, ShaderType::PixelShader);
+			PixelShaderInfo ps_info{};
+			shader_object_cache.create_pixel_shader(device, dxc_shader_result, ps_info.ps.GetAddressOf());
+			pipeline_shaders.emplace_back(std::move(ps_info));
+		} else {
+			pipeline_shaders.emplace_back(PixelShaderInfo{});
 		}
 	}
 
-	// Emit sampler
-	static void emit_sampler_state(const SamplerState &sampler_state, ID3D11DeviceContext *device_context)
+	void EffectPrototype::create_compute_pipeline(const ComputePipelineStateObject &compute_pipeline_state_object, ID3D11Device *device)
 	{
-		if (sampler_state.shader_flag == ShaderType::VertexShader) {
-			device_context->VSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
-		} else if (sampler_state.shader_flag == ShaderType::HullShader) {
-			device_context->HSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
-		} else if (sampler_state.shader_flag == ShaderType::DomainShader) {
-			device_context->DSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
-		} else if (sampler_state.shader_flag == ShaderType::GeometryShader) {
-			device_context->GSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
-		} else if (sampler_state.shader_flag == ShaderType::PixelShader) {
-			device_context->PSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+		auto &&dxc_instance = DxcInStance::get();
+		auto &&shader_object_cache = ShaderObjectCache::get();
+		auto shader_target_profile = compute_pipeline_state_object.shader_target_profile;
+
+		// CS
+		if (!compute_pipeline_state_object.cs_path.empty()) {
+			auto dxc_shader_result = dxc_instance.create_shader_from_file(compute_pipeline_state_object.cs_path, ShaderType::ComputeShader, shader_target_profile);
+			if (!accept_shader_result(compute_pipeline_state_object.cs_path, dxc_shader_result)) {
+				return;
+			}
+			update_shader_reflection(compute_pipeline_state_object.cs_path, dxc_shader_result.shader_reflection.Get());
+			update_bytecode_digest(dxc_shader_result, ShaderType::ComputeShader);
+			ComputeShaderInfo cs_info{};
+			dxc_shader_result.shader_reflection->GetThreadGroupSize(&cs_info.thread_group_conf.thread_group_size_x, &cs_info.thread_group_conf.thread_group_size_y, &cs_info.thread_group_conf.thread_group_size_z);
+			thread_group_conf = cs_info.thread_group_conf;
+			shader_object_cache.create_compute_shader(device, dxc_shader_result, cs_info.cs.GetAddressOf());
+			pipeline_shaders.emplace_back(std::move(cs_info));
 		} else {
-			device_context->CSSetSamplers(sampler_state.bind_slot, 1, &sampler_state.sampler);
+			pipeline_shaders.emplace_back(ComputeShaderInfo{});
 		}
 	}
 
-	// Emit unordered access view
-	static void emit_unordered_access_view(RWResource &rw_resource, ID3D11DeviceContext *device_context)
+	void EffectPrototype::update_bytecode_digest(const DxcShaderResult &shader_result, ShaderType shader_type)
 	{
-		if (rw_resource.shader_flag == ShaderType::PixelShader) {
-			const bool need_init = rw_resource.first_init;
-			rw_resource.first_init = false;
-			device_context->OMSetRenderTargetsAndUnorderedAccessViews(D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL, nullptr, nullptr,
-																	rw_resource.bind_slot, 1, &rw_resource.uav, (need_init ? &rw_resource.initial_count : nullptr));
-		} else if (rw_resource.shader_flag == ShaderType::ComputeShader) {
-			const bool need_init = rw_resource.enable_counter && rw_resource.first_init;
-			rw_resource.first_init = false;
-			device_context->CSSetUnorderedAccessViews(rw_resource.bind_slot, 1, &rw_resource.uav,
-														(need_init ? &rw_resource.initial_count : nullptr));
+		if (shader_result.shader_blob == nullptr) {
+			return;
+		}
+		// Fold every stage in pipeline order, so the digest changes when any stage's bytecode does
+		const auto shader_object_key = ShaderObjectCache::make_key(nullptr, shader_result, shader_type);
+		for (size_t byte_index = 0; byte_index < bytecode_digest.size(); ++byte_index)
+		{
+			bytecode_digest[byte_index] = static_cast<uint8_t>(bytecode_digest[byte_index] * 31 + shader_object_key.digest[byte_index] + static_cast<uint8_t>(shader_type));
 		}
 	}
 
-	// Effect
-	Effect::Effect() = default;
+	const std::array<uint8_t, 16> &EffectPrototype::get_bytecode_digest() const
+	{
+		return bytecode_digest;
+	}
 
-	Effect::~Effect() = default;
+	const VertexAttribute *VertexFormat::query_attribute(std::string_view semantic_name, uint32_t semantic_index) const
+	{
+		auto iter = std::ranges::find_if(attributes, [&](const VertexAttribute &vertex_attribute)
+		{
+			return vertex_attribute.semantic_name == semantic_name && vertex_attribute.semantic_index == semantic_index;
+		});
+		return iter != attributes.end() ? &*iter : nullptr;
+	}
+
+	uint32_t VertexFormat::query_vertex_size_in_bytes() const
+	{
+		uint32_t vertex_size = 0;
+		for (uint32_t stream_index = 0; stream_index < get_stream_count(); ++stream_index)
+		{
+			if (stream_classes[stream_index] == D3D11_INPUT_PER_VERTEX_DATA) {
+				vertex_size += stream_strides[stream_index];
+			}
+		}
+		return vertex_size;
+	}
+
+	uint32_t VertexFormat::query_instance_stream() const
+	{
+		auto instance_stream = std::ranges::find(stream_classes, D3D11_INPUT_PER_INSTANCE_DATA);
+		return static_cast<uint32_t>(instance_stream - stream_classes.begin());
+	}
 
-	void Effect::update_shader_reflection(std::wstring_view shader_name, ID3D11Device *device, ID3D12ShaderReflection *shader_reflection)
+	const VertexFormat &EffectPrototype::get_vertex_format() const
+	{
+		return vertex_format;
+	}
+
+	void EffectPrototype::update_shader_reflection([[maybe_unused]] std::wstring_view shader_name, ID3D12ShaderReflection *shader_reflection)
 	{
 		D3D12_SHADER_DESC shader_desc{};
 		if (FAILED(shader_reflection->GetDesc(&shader_desc))) {
@@ -536,16 +1672,13 @@ namespace toy
 				shader_reflection_constant_buffer->GetDesc(&shader_buffer_desc);
 
 				auto constant_buffer_id = string_to_id(shader_input_bind_desc.Name);
-				ConstantBuffer *constant_buffer_ref = nullptr;
-				if (constant_buffer_manager.contains(constant_buffer_id)) {
-					constant_buffer_ref = constant_buffer_manager[constant_buffer_id].get();
-					constant_buffer_ref->set_shader_flag(inner_shader_type);
-				} else {
-					constant_buffer_manager[constant_buffer_id] = std::make_unique<ConstantBuffer>(shader_input_bind_desc.Name, shader_input_bind_desc.BindPoint, shader_buffer_desc.Size);
-					constant_buffer_ref = constant_buffer_manager[constant_buffer_id].get();
-					constant_buffer_ref->create_buffer(device);
-					constant_buffer_ref->set_shader_flag(inner_shader_type);
+				auto &&constant_buffer_layout = constant_buffer_layouts[constant_buffer_id];
+				if (constant_buffer_layout.constant_buffer_name.empty()) {
+					constant_buffer_layout.constant_buffer_name = shader_input_bind_desc.Name;
+					constant_buffer_layout.binding_slot = shader_input_bind_desc.BindPoint;
+					constant_buffer_layout.size_in_bytes = shader_buffer_desc.Size;
 				}
+				constant_buffer_layout.shader_flag = (constant_buffer_layout.shader_flag | inner_shader_type);
 
 				for (uint32_t j = 0; j < shader_buffer_desc.Variables; ++j)
 				{
@@ -554,9 +1687,9 @@ namespace toy
 					shader_reflection_variable->GetDesc(&shader_variable_desc);
 
 					auto constant_buffer_var_id = string_to_id(shader_variable_desc.Name);
-					if (!constant_buffer_accessor_manager.contains(constant_buffer_var_id)) {
-						constant_buffer_accessor_manager[constant_buffer_var_id] = std::make_unique<ConstantBufferAccessor>(constant_buffer_ref, shader_variable_desc.Name,
-																					shader_variable_desc.StartOffset, shader_variable_desc.Size);
+					if (!constant_buffer_variable_layouts.contains(constant_buffer_var_id)) {
+						constant_buffer_variable_layouts.try_emplace(constant_buffer_var_id, shader_variable_desc.Name, constant_buffer_id,
+																	shader_variable_desc.StartOffset, shader_variable_desc.Size);
 					}
 				}
 				continue;
@@ -565,8 +1698,8 @@ namespace toy
 			if (bind_type == D3D_SIT_TEXTURE || bind_type == D3D_SIT_TBUFFER || bind_type == D3D_SIT_STRUCTURED || bind_type == D3D_SIT_BYTEADDRESS)
 			{
 				auto srv_id = string_to_id(shader_input_bind_desc.Name);
-				if (!shader_resource_manager.contains(srv_id)) {
-					shader_resource_manager.try_emplace(srv_id, nullptr,  shader_input_bind_desc.Dimension, shader_input_bind_desc.BindPoint, inner_shader_type);
+				if (!shader_resource_layouts.contains(srv_id)) {
+					shader_resource_layouts.try_emplace(srv_id, nullptr,  shader_input_bind_desc.Dimension, shader_input_bind_desc.BindPoint, inner_shader_type);
 				}
 				continue;
 			}
@@ -574,8 +1707,8 @@ namespace toy
 			if (bind_type == D3D_SIT_UAV_RWTYPED || bind_type == D3D_SIT_UAV_RWSTRUCTURED || bind_type == D3D_SIT_UAV_RWBYTEADDRESS || bind_type == D3D_SIT_UAV_FEEDBACKTEXTURE ||
 				bind_type == D3D_SIT_UAV_APPEND_STRUCTURED || bind_type == D3D_SIT_UAV_CONSUME_STRUCTURED || bind_type == D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER) {
 				auto uav_id = string_to_id(shader_input_bind_desc.Name);
-				if (!unordered_access_manager.contains(uav_id)) {
-					unordered_access_manager.try_emplace(uav_id, nullptr, static_cast<D3D11_UAV_DIMENSION>(shader_input_bind_desc.Dimension), 0, shader_input_bind_desc.BindPoint,
+				if (!unordered_access_layouts.contains(uav_id)) {
+					unordered_access_layouts.try_emplace(uav_id, nullptr, static_cast<D3D11_UAV_DIMENSION>(shader_input_bind_desc.Dimension), 0, shader_input_bind_desc.BindPoint,
 											inner_shader_type, bind_type == D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER, false);
 				}
 				continue;
@@ -584,19 +1717,69 @@ namespace toy
 			if (bind_type == D3D_SIT_SAMPLER)
 			{
 				auto sampler_id = string_to_id(shader_input_bind_desc.Name);
-				if (!sampler_manager.contains(sampler_id)) {
-					sampler_manager.try_emplace(sampler_id, nullptr, shader_input_bind_desc.BindPoint, inner_shader_type);
+				if (!sampler_layouts.contains(sampler_id)) {
+					sampler_layouts.try_emplace(sampler_id, nullptr, shader_input_bind_desc.BindPoint, inner_shader_type);
 				}
 			}
 		}
 	}
 
+	// Effect, instance creation only copies binding tables and creates constant buffers
+	Effect::Effect(std::shared_ptr<const EffectPrototype> prototype, ID3D11Device *device, ConstantBufferPool *constant_buffer_pool)
+	: effect_prototype(std::move(prototype)),
+	shader_resource_manager(effect_prototype->shader_resource_layouts),
+	unordered_access_manager(effect_prototype->unordered_access_layouts),
+	sampler_manager(effect_prototype->sampler_layouts)
+	{
+		constant_buffer_manager.reserve(effect_prototype->constant_buffer_layouts.size());
+		for (auto &&[constant_buffer_id, constant_buffer_layout] : effect_prototype->constant_buffer_layouts)
+		{
+			auto constant_buffer = std::make_unique<ConstantBuffer>(constant_buffer_layout.constant_buffer_name, constant_buffer_layout.binding_slot, constant_buffer_layout.size_in_bytes);
+			if (constant_buffer_pool != nullptr) {
+				constant_buffer->create_buffer(*constant_buffer_pool);
+			} else {
+				constant_buffer->create_buffer(device);
+			}
+			constant_buffer->set_shader_flag(constant_buffer_layout.shader_flag);
+			constant_buffer_manager.emplace(constant_buffer_id, std::move(constant_buffer));
+		}
+	}
+
+	Effect::~Effect() = default;
+
+	const std::shared_ptr<const EffectPrototype> &Effect::get_prototype() const
+	{
+		return effect_prototype;
+	}
+
 	ConstantBufferAccessor *Effect::query_constant_buffer_accessor(std::string_view variable_name)
 	{
-		if (const auto constant_buffer_var_id = string_to_id(variable_name); constant_buffer_accessor_manager.contains(constant_buffer_var_id))
+		const auto constant_buffer_var_id = string_to_id(variable_name);
+		if (constant_buffer_accessor_manager.contains(constant_buffer_var_id))
 		{
 			return constant_buffer_accessor_manager[constant_buffer_var_id].get();
 		}
+
+		// Accessors are created on first query from the prototype layout
+		auto &&variable_layouts = effect_prototype->constant_buffer_variable_layouts;
+		if (auto variable_layout_iter = variable_layouts.find(constant_buffer_var_id); variable_layout_iter != variable_layouts.end())
+		{
+			auto &&variable_layout = variable_layout_iter->second;
+			auto constant_buffer_ref = constant_buffer_manager[variable_layout.constant_buffer_id].get();
+			auto &&constant_buffer_accessor = constant_buffer_accessor_manager[constant_buffer_var_id];
+			constant_buffer_accessor = std::make_unique<ConstantBufferAccessor>(constant_buffer_ref, variable_layout.variable_name, variable_layout.offset, variable_layout.size);
+			return constant_buffer_accessor.get();
+		}
+		return nullptr;
+	}
+
+	ConstantBuffer *Effect::query_constant_buffer(std::string_view constant_buffer_name)
+	{
+		const auto constant_buffer_id = string_to_id(constant_buffer_name);
+		if (auto constant_buffer_iter = constant_buffer_manager.find(constant_buffer_id); constant_buffer_iter != constant_buffer_manager.end())
+		{
+			return constant_buffer_iter->second.get();
+		}
 		return nullptr;
 	}
 
@@ -612,10 +1795,18 @@ namespace toy
 	{
 		auto shader_resource_id = string_to_id(srv_name);
 		if (shader_resource_manager.contains(shader_resource_id)) {
-			shader_resource_manager[shader_resource_id].srv = srv;
+			auto &&shader_resource = shader_resource_manager[shader_resource_id];
+			shader_resource.srv = srv;
+			shader_resource.resource = query_view_resource(srv);
 		}
 	}
 
+	const ShaderResource *Effect::query_shader_resource(std::string_view srv_name) const
+	{
+		auto shader_resource_iterator = shader_resource_manager.find(string_to_id(srv_name));
+		return shader_resource_iterator != shader_resource_manager.end() ? &shader_resource_iterator->second : nullptr;
+	}
+
 	void Effect::bind_sampler(std::string_view sampler_name, ID3D11SamplerState *sampler)
 	{
 		auto sampler_id = string_to_id(sampler_name);
@@ -628,13 +1819,18 @@ namespace toy
 	{
 		auto uav_id = string_to_id(uav_name);
 		if (unordered_access_manager.contains(uav_id)) {
-			unordered_access_manager[uav_id].uav = uav;
+			auto &&rw_resource = unordered_access_manager[uav_id];
+			rw_resource.uav = uav;
+			rw_resource.resource = query_view_resource(uav);
 		}
 	}
 
 	void Effect::emit_pipeline(ID3D11DeviceContext *device_context)
 	{
-		for (auto &&shader_info : pipeline_shader_manager)
+		auto &&binding_state = ResourceBindingState::query(device_context);
+		resolve_resource_hazards(device_context, binding_state);
+
+		for (auto &&shader_info : effect_prototype->pipeline_shaders)
 		{
 			std::visit(EmitShader{ device_context }, shader_info);
 		}
@@ -647,7 +1843,9 @@ namespace toy
 
 		for (auto &&shader_resource_info : shader_resource_manager)
 		{
-			emit_shader_resource_view(shader_resource_info.second, device_context);
+			auto &&shader_resource = shader_resource_info.second;
+			emit_shader_resource_view(shader_resource, device_context);
+			binding_state.track_shader_resource(shader_resource.shader_flag, shader_resource.bind_slot, shader_resource.resource);
 		}
 
 		for (auto &&sampler_state_info : sampler_manager)
@@ -657,107 +1855,118 @@ namespace toy
 
 		for (auto &&rw_resource_info : unordered_access_manager)
 		{
-			emit_unordered_access_view(rw_resource_info.second, device_context);
+			auto &&rw_resource = rw_resource_info.second;
+			emit_unordered_access_view(rw_resource, device_context);
+			binding_state.track_unordered_access(rw_resource.shader_flag, rw_resource.bind_slot, rw_resource.resource);
 		}
 	}
 
-	// Graphics effect
-	GraphicsEffect::GraphicsEffect(const PipelineStateObject &pipeline_state_object, ID3D11Device *device)
+	void Effect::emit_shader_resources(ID3D11DeviceContext *device_context)
 	{
-		auto &&dxc_instance = DxcInStance::get();
-		if (std::holds_alternative<GraphicsPipelineStateObject>(pipeline_state_object))
-		{
-			auto &&graphics_pipeline_state_object = std::get<GraphicsPipelineStateObject>(pipeline_state_object);
-			rasterizer_state = graphics_pipeline_state_object.rasterizer_state;
-			depth_stencil_state = graphics_pipeline_state_object.depth_stencil_state;
-			blend_state = graphics_pipeline_state_object.blend_state;
-			auto shader_target_profile = graphics_pipeline_state_object.shader_target_profile;
-
-			// VS
-			if (!graphics_pipeline_state_object.vs_path.empty()) {
-				auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.vs_path, ShaderType::VertexShader, shader_target_profile);
-				update_shader_reflection(graphics_pipeline_state_object.vs_path, device, dxc_shader_result.shader_reflection.Get());
-
-				VertexShaderInfo vs_info{};
-				auto &&shader_blob = dxc_shader_result.shader_blob;
-				device->CreateVertexShader(shader_blob->GetBufferPointer(), shader_blob->GetBufferSize(), nullptr, vs_info.vs.GetAddressOf());
-				pipeline_shader_manager.emplace_back(std::move(vs_info));
-
-				// Create vertex input layout if possible
-				auto &&shader_reflection = dxc_shader_result.shader_reflection;
-				D3D12_SHADER_DESC shader_desc{};
-				if (FAILED(shader_reflection->GetDesc(&shader_desc))) {
-					std::cout << std::format("Failed to get shader reflection desc\n");
-					return;
-				}
-				std::vector<D3D11_INPUT_ELEMENT_DESC> input_elements{};
-				input_elements.reserve(shader_desc.InputParameters);
-				uint32_t input_slot = 0;
-				for (uint32_t index = 0; index < shader_desc.InputParameters; ++index)
-				{
-					D3D12_SIGNATURE_PARAMETER_DESC signature_parameter_desc{};
-					shader_reflection->GetInputParameterDesc(index, &signature_parameter_desc);
-					auto shader_input_para_type = convert_to_internal_component_type(signature_parameter_desc.ComponentType);
-					auto shader_input_para_mask = static_cast<ShaderInputParaMask>(signature_parameter_desc.Mask);
-					auto dxgi_format_desc = query_dxgi_format_desc(shader_input_para_mask, shader_input_para_type);
-					D3D11_INPUT_ELEMENT_DESC input_element_desc{ signature_parameter_desc.SemanticName, signature_parameter_desc.SemanticIndex, dxgi_format_desc.dxgi_format, input_slot,
-														0, D3D11_INPUT_PER_VERTEX_DATA, 0 };
-					input_elements.emplace_back(input_element_desc);
-					++input_slot;
-				}
-				if (shader_desc.InputParameters > 0)
+		auto &&binding_state = ResourceBindingState::query(device_context);
+		resolve_resource_hazards(device_context, binding_state);
+
+		for (auto &&shader_resource_info : shader_resource_manager)
+		{
+			auto &&shader_resource = shader_resource_info.second;
+			emit_shader_resource_view(shader_resource, device_context);
+			binding_state.track_shader_resource(shader_resource.shader_flag, shader_resource.bind_slot, shader_resource.resource);
+		}
+	}
+
+	void Effect::stage_constant_buffers()
+	{
+		for (auto &&constant_buffer_info : constant_buffer_manager)
+		{
+			constant_buffer_info.second->stage_buffer();
+		}
+	}
+
+	void Effect::resolve_resource_hazards(ID3D11DeviceContext *device_context, ResourceBindingState &binding_state)
+	{
+		std::array<ResourceBindingState::SrvSlotMask, ResourceBindingState::shader_stage_count> srv_unbind_masks{};
+		uint64_t cs_uav_unbind_mask = 0;
+		uint64_t ps_uav_unbind_mask = 0;
+
+		// Resources written by this effect must leave every srv slot
+		for (auto &&rw_resource_info : unordered_access_manager)
+		{
+			auto written_resource = rw_resource_info.second.resource;
+			if (written_resource == nullptr) {
+				continue;
+			}
+			for (uint32_t stage_index = 0; stage_index < ResourceBindingState::shader_stage_count; ++stage_index)
+			{
+				auto &&stage_resources = binding_state.srv_resources[stage_index];
+				for (uint32_t slot = 0; slot < binding_state.srv_slot_ends[stage_index]; ++slot)
 				{
-					device->CreateInputLayout(input_elements.data(), static_cast<uint32_t>(input_elements.size()), shader_blob->GetBufferPointer(), shader_blob->GetBufferSize(),
-											vertex_input_layout.GetAddressOf());
+					if (stage_resources[slot] == written_resource) {
+						srv_unbind_masks[stage_index][slot / 64] |= 1ULL << (slot % 64);
+					}
 				}
-			} else {
-				pipeline_shader_manager.emplace_back(VertexShaderInfo{});
 			}
+		}
 
-			// HS
-			if (!graphics_pipeline_state_object.hs_path.empty()) {
-				auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.hs_path, ShaderType::HullShader, shader_target_profile);
-				update_shader_reflection(graphics_pipeline_state_object.hs_path, device, dxc_shader_result.shader_reflection.Get());
-				HullShaderInfo hs_info{};
-				device->CreateHullShader(dxc_shader_result.shader_blob->GetBufferPointer(), dxc_shader_result.shader_blob->GetBufferSize(), nullptr, hs_info.hs.GetAddressOf());
-				pipeline_shader_manager.emplace_back(std::move(hs_info));
-			} else {
-				pipeline_shader_manager.emplace_back(HullShaderInfo{});
-			}
+		// Srv slots this effect binds are overwritten anyway
+		for (auto &&shader_resource_info : shader_resource_manager)
+		{
+			auto &&shader_resource = shader_resource_info.second;
+			const uint32_t stage_index = query_shader_stage_index(shader_resource.shader_flag);
+			srv_unbind_masks[stage_index][shader_resource.bind_slot / 64] &= ~(1ULL << (shader_resource.bind_slot % 64));
+		}
 
-			// DS
-			if (!graphics_pipeline_state_object.ds_path.empty()) {
-				auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.ds_path, ShaderType::DomainShader, shader_target_profile);
-				update_shader_reflection(graphics_pipeline_state_object.ds_path, device, dxc_shader_result.shader_reflection.Get());
-				DomainShaderInfo ds_info{};
-				device->CreateDomainShader(dxc_shader_result.shader_blob->GetBufferPointer(), dxc_shader_result.shader_blob->GetBufferSize(), nullptr, ds_info.ds.GetAddressOf());
-				pipeline_shader_manager.emplace_back(std::move(ds_info));
-			} else {
-				pipeline_shader_manager.emplace_back(DomainShaderInfo{});
+		// Resources read by this effect must leave every uav slot first, srvs are emitted before uavs
+		for (auto &&shader_resource_info : shader_resource_manager)
+		{
+			auto read_resource = shader_resource_info.second.resource;
+			if (read_resource == nullptr) {
+				continue;
 			}
-
-			// GS
-			if (!graphics_pipeline_state_object.gs_path.empty()) {
-				auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.gs_path, ShaderType::GeometryShader, shader_target_profile);
-				update_shader_reflection(graphics_pipeline_state_object.gs_path, device, dxc_shader_result.shader_reflection.Get());
-				GeometryShaderInfo gs_info{};
-				device->CreateGeometryShader(dxc_shader_result.shader_blob->GetBufferPointer(), dxc_shader_result.shader_blob->GetBufferSize(), nullptr, gs_info.gs.GetAddressOf());
-				pipeline_shader_manager.emplace_back(std::move(gs_info));
-			} else {
-				pipeline_shader_manager.emplace_back(GeometryShaderInfo{});
+			for (uint32_t slot = 0; slot < ResourceBindingState::uav_slot_count; ++slot)
+			{
+				if (binding_state.cs_uav_resources[slot] == read_resource) {
+					cs_uav_unbind_mask |= 1ULL << slot;
+				}
+				if (binding_state.ps_uav_resources[slot] == read_resource) {
+					ps_uav_unbind_mask |= 1ULL << slot;
+				}
 			}
+		}
 
-			// PS
-			if (!graphics_pipeline_state_object.ps_path.empty()) {
-				auto dxc_shader_result = dxc_instance.create_shader_from_file(graphics_pipeline_state_object.ps_path, ShaderType::PixelShader, shader_target_profile);
-				update_shader_reflection(graphics_pipeline_state_object.ps_path, device, dxc_shader_result.shader_reflection.Get());
-				PixelShaderInfo ps_info{};
-				device->CreatePixelShader(dxc_shader_result.shader_blob->GetBufferPointer(), dxc_shader_result.shader_blob->GetBufferSize(), nullptr, ps_info.ps.GetAddressOf());
-				pipeline_shader_manager.emplace_back(std::move(ps_info));
-			} else {
-				pipeline_shader_manager.emplace_back(PixelShaderInfo{});
+		for (uint32_t stage_index = 0; stage_index < ResourceBindingState::shader_stage_count; ++stage_index)
+		{
+			auto &&srv_unbind_mask = srv_unbind_masks[stage_index];
+			if (std::any_of(srv_unbind_mask.begin(), srv_unbind_mask.end(), [](uint64_t mask) { return mask != 0; })) {
+				binding_state.unbind_shader_resources(device_context, stage_index, srv_unbind_mask);
 			}
 		}
+		if (cs_uav_unbind_mask != 0) {
+			binding_state.unbind_unordered_access_views(device_context, ShaderType::ComputeShader, cs_uav_unbind_mask);
+		}
+		if (ps_uav_unbind_mask != 0) {
+			binding_state.unbind_unordered_access_views(device_context, ShaderType::PixelShader, ps_uav_unbind_mask);
+		}
+	}
+
+	// Compute effect helpers
+	constexpr std::string_view s_dispatch_group_offset_name = "g_DispatchGroupOffset";
+
+	static uint32_t query_thread_group_count(uint32_t thread_count, uint32_t thread_group_size)
+	{
+		return static_cast<uint32_t>((static_cast<uint64_t>(thread_count) + thread_group_size - 1) / thread_group_size);
+	}
+
+	// Graphics effect
+	GraphicsEffect::GraphicsEffect(const PipelineStateObject &pipeline_state_object, ID3D11Device *device)
+	: GraphicsEffect(std::make_shared<const EffectPrototype>(pipeline_state_object, device), device)
+	{
+
+	}
+
+	GraphicsEffect::GraphicsEffect(std::shared_ptr<const EffectPrototype> prototype, ID3D11Device *device, ConstantBufferPool *constant_buffer_pool)
+	: Effect(std::move(prototype), device, constant_buffer_pool)
+	{
+
 	}
 
 	void GraphicsEffect::set_stencil_ref(uint32_t stencil_value)
@@ -774,34 +1983,64 @@ namespace toy
 	void GraphicsEffect::emit_graphics_pipeline(ID3D11DeviceContext *device_context)
 	{
 		Effect::emit_pipeline(device_context);
-		device_context->IASetInputLayout(vertex_input_layout.Get());
-		device_context->RSSetState(rasterizer_state.Get());
-		device_context->OMSetDepthStencilState(depth_stencil_state.Get(), stencil_ref);
-		device_context->OMSetBlendState(blend_state.Get(), blend_factor.data(), sample_mask);
+		ResourceBindingState::query(device_context).emit_input_layout(device_context, effect_prototype->vertex_input_layout.Get());
+		device_context->RSSetState(effect_prototype->rasterizer_state.Get());
+		device_context->OMSetDepthStencilState(effect_prototype->depth_stencil_state.Get(), stencil_ref);
+		device_context->OMSetBlendState(effect_prototype->blend_state.Get(), blend_factor.data(), sample_mask);
+	}
+
+	void GraphicsEffect::emit_vertex_buffers(ID3D11DeviceContext *device_context, std::span<ID3D11Buffer *const> vertex_buffers, std::span<const uint32_t> offsets)
+	{
+		static constexpr uint32_t zero_offsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT] = {};
+		auto &&stream_strides = effect_prototype->vertex_format.stream_strides;
+		const uint32_t stream_count = (std::min)(static_cast<uint32_t>(vertex_buffers.size()), static_cast<uint32_t>(stream_strides.size()));
+		if (stream_count == 0) {
+			return;
+		}
+		device_context->IASetVertexBuffers(0, stream_count, vertex_buffers.data(), stream_strides.data(), offsets.size() >= stream_count ? offsets.data() : zero_offsets);
+	}
+
+	void GraphicsEffect::emit_compute_pipeline(ID3D11DeviceContext *)
+	{
+
+	}
+
+	void GraphicsEffect::dispatch(ID3D11DeviceContext *, uint32_t, uint32_t, uint32_t)
+	{
+
+	}
+
+	void GraphicsEffect::dispatch_indirect(ID3D11DeviceContext *, ID3D11Buffer *, uint32_t)
+	{
+
 	}
 
 	// Compute pipeline
 	ComputeEffect::ComputeEffect(const PipelineStateObject &pipeline_state_object, ID3D11Device *device)
+	: ComputeEffect(std::make_shared<const EffectPrototype>(pipeline_state_object, device), device)
 	{
-		auto &&dxc_instance = DxcInStance::get();
-		if (std::holds_alternative<ComputePipelineStateObject>(pipeline_state_object))
-		{
-			auto &&compute_pipeline_state_object = std::get<ComputePipelineStateObject>(pipeline_state_object);
-			auto shader_target_profile = compute_pipeline_state_object.shader_target_profile;
-
-			// CS
-			if (!compute_pipeline_state_object.cs_path.empty()) {
-				auto dxc_shader_result = dxc_instance.create_shader_from_file(compute_pipeline_state_object.cs_path, ShaderType::ComputeShader, shader_target_profile);
-				update_shader_reflection(compute_pipeline_state_object.cs_path, device, dxc_shader_result.shader_reflection.Get());
-				ComputeShaderInfo cs_info{};
-				dxc_shader_result.shader_reflection->GetThreadGroupSize(&cs_info.thread_group_conf.thread_group_size_x, &cs_info.thread_group_conf.thread_group_size_y, &cs_info.thread_group_conf.thread_group_size_z);
-				thread_group_conf = cs_info.thread_group_conf;
-				device->CreateComputeShader(dxc_shader_result.shader_blob->GetBufferPointer(), dxc_shader_result.shader_blob->GetBufferSize(), nullptr, cs_info.cs.GetAddressOf());
-				pipeline_shader_manager.emplace_back(std::move(cs_info));
-			} else {
-				pipeline_shader_manager.emplace_back(ComputeShaderInfo{});
-			}
-		}
+
+	}
+
+	ComputeEffect::ComputeEffect(std::shared_ptr<const EffectPrototype> prototype, ID3D11Device *device, ConstantBufferPool *constant_buffer_pool)
+	: Effect(std::move(prototype), device, constant_buffer_pool)
+	{
+		group_offset_accessor = query_constant_buffer_accessor(s_dispatch_group_offset_name);
+	}
+
+	void ComputeEffect::set_stencil_ref(uint32_t)
+	{
+
+	}
+
+	void ComputeEffect::set_blend_factor(std::span<float>)
+	{
+
+	}
+
+	void ComputeEffect::emit_graphics_pipeline(ID3D11DeviceContext *)
+	{
+
 	}
 
 	void ComputeEffect::emit_compute_pipeline(ID3D11DeviceContext *device_context)
@@ -811,10 +2050,80 @@ namespace toy
 
 	void ComputeEffect::dispatch(ID3D11DeviceContext *device_context, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z)
 	{
-		uint32_t thread_group_count_x = (thread_x + thread_group_conf.thread_group_size_x - 1) / thread_group_conf.thread_group_size_x;
-		uint32_t thread_group_count_y = (thread_y + thread_group_conf.thread_group_size_y - 1) / thread_group_conf.thread_group_size_y;
-		uint32_t thread_group_count_z = (thread_z + thread_group_conf.thread_group_size_z - 1) / thread_group_conf.thread_group_size_z;
-		device_context->Dispatch(thread_group_count_x, thread_group_count_y, thread_group_count_z);
+		auto &&thread_group_conf = effect_prototype->thread_group_conf;
+		const std::array<uint32_t, 3> thread_group_counts{
+			query_thread_group_count(thread_x, thread_group_conf.thread_group_size_x),
+			query_thread_group_count(thread_y, thread_group_conf.thread_group_size_y),
+			query_thread_group_count(thread_z, thread_group_conf.thread_group_size_z)
+		};
+
+		// Chunks per axis, the fewest that keep every axis under the limit
+		constexpr uint32_t max_thread_group_count = D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+		std::array<uint32_t, 3> chunk_counts{};
+		std::array<uint32_t, 3> chunk_sizes{};
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			chunk_counts[axis] = (std::max)((thread_group_counts[axis] + max_thread_group_count - 1) / max_thread_group_count, 1U);
+			chunk_sizes[axis] = (thread_group_counts[axis] + chunk_counts[axis] - 1) / chunk_counts[axis];
+		}
+
+		if (chunk_counts[0] == 1 && chunk_counts[1] == 1 && chunk_counts[2] == 1) {
+			set_group_offset(device_context, { 0, 0, 0 });
+			device_context->Dispatch(thread_group_counts[0], thread_group_counts[1], thread_group_counts[2]);
+			return;
+		}
+
+		if (group_offset_accessor == nullptr) {
+			std::cout << std::format("Dispatch of {}x{}x{} thread groups exceeds the limit and the shader declares no {}, clamping\n",
+									thread_group_counts[0], thread_group_counts[1], thread_group_counts[2], s_dispatch_group_offset_name);
+			device_context->Dispatch((std::min)(thread_group_counts[0], max_thread_group_count), (std::min)(thread_group_counts[1], max_thread_group_count),
+									(std::min)(thread_group_counts[2], max_thread_group_count));
+			return;
+		}
+
+		// Even chunk sizes so the last chunk is not a tiny tail
+		for (uint32_t chunk_z = 0; chunk_z < chunk_counts[2]; ++chunk_z)
+		{
+			for (uint32_t chunk_y = 0; chunk_y < chunk_counts[1]; ++chunk_y)
+			{
+				for (uint32_t chunk_x = 0; chunk_x < chunk_counts[0]; ++chunk_x)
+				{
+					const std::array<uint32_t, 3> chunk_offset{ chunk_x * chunk_sizes[0], chunk_y * chunk_sizes[1], chunk_z * chunk_sizes[2] };
+					if (chunk_offset[0] >= thread_group_counts[0] || chunk_offset[1] >= thread_group_counts[1] || chunk_offset[2] >= thread_group_counts[2]) {
+						continue;
+					}
+					set_group_offset(device_context, chunk_offset);
+					device_context->Dispatch((std::min)(chunk_sizes[0], thread_group_counts[0] - chunk_offset[0]),
+											(std::min)(chunk_sizes[1], thread_group_counts[1] - chunk_offset[1]),
+											(std::min)(chunk_sizes[2], thread_group_counts[2] - chunk_offset[2]));
+				}
+			}
+		}
+	}
+
+	void ComputeEffect::set_group_offset(ID3D11DeviceContext *device_context, const std::array<uint32_t, 3> &offset)
+	{
+		if (group_offset_accessor == nullptr || group_offset == offset) {
+			return;
+		}
+		group_offset = offset;
+		group_offset_accessor->set_uint_vector(group_offset);
+		// A pooled cbuffer lands in a new ring slot on every update, the shader only sees it once that slot is bound
+		auto constant_buffer = group_offset_accessor->get_constant_buffer();
+		constant_buffer->update_buffer(device_context);
+		constant_buffer->bind_cs(device_context);
+	}
+
+	void ComputeEffect::dispatch_indirect(ID3D11DeviceContext *device_context, ID3D11Buffer *argument_buffer, uint32_t aligned_byte_offset)
+	{
+		// Arguments are never split on the cpu, drop whatever offset the last split dispatch left behind
+		set_group_offset(device_context, { 0, 0, 0 });
+		device_context->DispatchIndirect(argument_buffer, aligned_byte_offset);
+	}
+
+	const ThreadGroupConf &ComputeEffect::get_thread_group_conf() const
+	{
+		return effect_prototype->thread_group_conf;
 	}
 
 }
@@ -13,14 +13,21 @@
 #include <unordered_map>
 #include <variant>
 #include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
 
 #include <wrl/client.h>
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <dxgi.h>
 #include <Inc/dxcapi.h>
 #include <Inc/d3d12shader.h>
 
+#include <compile_arena.h>
+
 template <typename T>
 using ComPtr = Microsoft::WRL::ComPtr<T>;
 
@@ -81,6 +88,8 @@ namespace toy
 	{
 		ComPtr<IDxcBlob> shader_blob = nullptr;
 		ComPtr<ID3D12ShaderReflection> shader_reflection = nullptr;
+		DxcShaderHash shader_hash{};
+		bool has_shader_hash = false;
 	};
 
 	// Helper function
@@ -90,18 +99,45 @@ namespace toy
 
 	size_t string_to_id(std::string_view str_view);
 
+	uint32_t query_format_size_in_bytes(DXGI_FORMAT format);
+
+	struct ShaderBytecodeEntry;
+
 	// DXC instance
+	// dxcompiler is loaded when first needed, a compile that hits the bytecode cache or the compile server doesn't create a compiler,
+	// and the library itself is only loaded to create the reflection of a shader compiled elsewhere
+	// Runtime bytecode is stripped of debug info and reflection, the reflection is kept beside it and the PDB goes to the symbol directory
 	struct DxcInStance
 	{
 	private:
 		using DxcCreateInstanceFn = decltype(&::DxcCreateInstance);
 
 		ComPtr<IDxcUtils> utils = nullptr;
-		ComPtr<IDxcCompiler3> compiler = nullptr;
 		ComPtr<IDxcValidator> validator = nullptr;
-		ComPtr<IDxcIncludeHandler> include_handler = nullptr;
-		HMODULE compiler_hmodule = nullptr;
+		void *compiler_module = nullptr;
 		DxcCreateInstanceFn dxc_create_instance_pfn = nullptr;
+		DxcCreateInstance2Proc dxc_create_instance2_pfn = nullptr;
+		std::string compiler_path = {};
+		std::string compile_server_path = {};
+		uint32_t compile_server_timeout_ms = 0;
+		std::string symbol_directory = {};
+		std::once_flag library_once_flag;
+		std::once_flag compiler_once_flag;
+		std::atomic<bool> is_compiler_created = false;
+		std::atomic<bool> is_validation_deferred = false;
+		std::mutex validator_mutex;
+
+		// Compilers aren't safe to share between threads, each compile takes one from the pool along with its arena
+		struct PooledCompiler
+		{
+			ComPtr<CompileArena> compile_arena = nullptr;
+			ComPtr<IDxcCompiler3> compiler = nullptr;
+		};
+
+		std::vector<PooledCompiler> idle_compilers = {};
+		uint32_t compilers_created = 0;
+		CompileArenaStats total_arena_stats{};
+		mutable std::mutex compiler_pool_mutex;
 
 	private:
 		DxcInStance();
@@ -116,9 +152,81 @@ namespace toy
 
 		static DxcInStance &get();
 
+		// dxcompiler.dll on windows, libdxcompiler.so elsewhere, only used if set before the library is loaded
+		void set_compiler_path(std::string_view path);
+
+		// Socket of a CompileServer tried before compiling in process, empty compiles in process only
+		// The default timeout is long enough for a cold compile of a large shader, a server silent for longer is taken as wedged
+		void set_compile_server(std::string_view socket_path, uint32_t timeout_ms = 30'000);
+
+		// Debug compiles write their PDB here, named the way the stripped container refers to it, empty drops the PDB
+		void set_symbol_directory(std::string_view directory);
+
+		// False as long as every shader came from the bytecode cache or the compile server
+		[[nodiscard]] bool is_compiler_loaded() const;
+
+		// Create compiler_count compilers up front so the first compiles don't pay for it
+		bool warm_up(uint32_t compiler_count);
+
+		// Allocations of every compile that ran on an arena, summed
+		[[nodiscard]] CompileArenaStats get_compile_arena_stats() const;
+
+		void print_compile_arena_stats() const;
+
+		// Compile with -Vd and leave validation to the ShaderValidationQueue thread, off by default
+		void set_deferred_validation(bool is_deferred);
+
+		// Validate and sign the container in place, errors go to error_log, E_NOINTERFACE when there is no validator to ask
+		HRESULT validate_bytecode(IDxcBlob *bytecode_blob, std::string &error_log);
+
 		DxcShaderResult create_shader_from_file(std::wstring_view shader_filepath, ShaderType shader_type, ShaderTargetProfile shader_target_profile);
+
+		// Compile hlsl held in memory, used by internal helper stages that ship without a shader file
+		DxcShaderResult create_shader_from_source(std::string_view shader_source, ShaderType shader_type, ShaderTargetProfile shader_target_profile);
+
+		// Compile in process without the cache, errors go to error_log, false when the compile failed
+		// compile_arena_stats receives what this compile allocated, left untouched when the compiler has no arena
+		bool compile_bytecode(const DxcBuffer &source_buffer, std::span<const wchar_t *const> compilation_arguments, ShaderBytecodeEntry &shader_bytecode_entry,
+							  std::string &error_log, CompileArenaStats *compile_arena_stats = nullptr);
+
+	private:
+		DxcShaderResult compile_shader(const DxcBuffer &source_buffer, ShaderType shader_type, ShaderTargetProfile shader_target_profile);
+
+		// Blob over the cached bytecode plus its reflection
+		DxcShaderResult create_shader_result(std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry);
+
+		// Library and utils, false when the library can't be loaded
+		bool load_library();
+
+		// Validator on top of the library
+		bool load_compiler();
+
+		PooledCompiler acquire_compiler();
+
+		void release_compiler(PooledCompiler pooled_compiler);
+	};
+
+	// Constant buffer slot, a 256 bytes aligned range of a buffer owned by a constant buffer pool
+	struct ConstantBufferSlot
+	{
+		ID3D11Buffer *buffer = nullptr;
+		uint32_t offset_in_bytes = 0;
+		uint32_t size_in_bytes = 0;
+		uint32_t page_index = UINT32_MAX;
+		uint32_t slot_index = 0;
+		// Transient slots only, the ring generation they were written in
+		uint32_t generation = 0;
+
+		[[nodiscard]] bool is_valid() const { return buffer != nullptr; }
+
+		// Offset and size in shader constants of 16 bytes
+		[[nodiscard]] uint32_t query_first_constant() const { return offset_in_bytes / 16; }
+
+		[[nodiscard]] uint32_t query_num_constants() const { return size_in_bytes / 16; }
 	};
 
+	struct ConstantBufferPool;
+
 	// Constant buffer and its accessor
 	struct ConstantBufferAccessor;
 
@@ -131,21 +239,40 @@ namespace toy
 		uint32_t binding_slot = 0;
 		uint32_t shader_flag = 0;
 		bool is_dirty = false;
+		ConstantBufferPool *constant_buffer_pool = nullptr;
+		ConstantBufferSlot pool_slot{};
+		ConstantBufferSlot transient_slot{};
 
 		friend struct ConstantBufferAccessor;
 
 	public:
 		ConstantBuffer() = default;
 		ConstantBuffer(const std::string &cb_name, uint32_t slot, uint32_t size_in_bytes, uint8_t *initial_data = nullptr);
+		~ConstantBuffer();
+
+		ConstantBuffer(const ConstantBuffer &) = delete;
+		ConstantBuffer &operator=(const ConstantBuffer &) = delete;
 
 		HRESULT create_buffer(ID3D11Device *device);
 
+		// Take a slot from the pool, falls back to a standalone buffer when the pool cannot serve it
+		HRESULT create_buffer(ConstantBufferPool &pool);
+
+		// Copy pending writes into the pool page without uploading, the pool flush uploads each page once
+		void stage_buffer();
+
+		// Pooled buffers upload unstaged writes to the pool's transient ring, only this buffer's slot is written
 		void update_buffer(ID3D11DeviceContext *device_context);
 
 		void transmit_upload_data(ConstantBuffer &other) const;
 
+		// Cpu side contents in the reflected cbuffer layout, including writes not uploaded yet
+		[[nodiscard]] std::span<const uint8_t> get_upload_data() const;
+
 		void set_shader_flag(ShaderType shader_type);
 
+		void set_shader_flag(uint32_t shader_flags);
+
 		void emit_constant_buffer(ID3D11DeviceContext *device_context);
 
 		void bind_vs(ID3D11DeviceContext *device_context);
@@ -159,6 +286,10 @@ namespace toy
 		void bind_ps(ID3D11DeviceContext *device_context);
 
 		void bind_cs(ID3D11DeviceContext *device_context);
+
+	private:
+		// The transient slot while it holds the latest contents, the pool slot otherwise
+		[[nodiscard]] const ConstantBufferSlot &query_bound_slot() const;
 	};
 
 	struct ConstantBufferAccessor
@@ -172,6 +303,8 @@ namespace toy
 	public:
 		explicit ConstantBufferAccessor(ConstantBuffer *input_constant_buffer, const std::string &in_component_name, uint32_t in_offset, uint32_t in_size);
 
+		[[nodiscard]] ConstantBuffer *get_constant_buffer() const;
+
 		void set_raw(const uint8_t *data, uint32_t offset_in_bytes, uint32_t size_in_bytes);
 
 		void set_matrix_in_bytes(const uint8_t *no_padding_data, uint32_t rows, uint32_t cols);
@@ -241,6 +374,7 @@ namespace toy
 		D3D11_SRV_DIMENSION srv_dimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 		uint32_t bind_slot = 0;
 		ShaderType shader_flag = ShaderType::VertexShader;
+		ID3D11Resource *resource = nullptr;
 	};
 
 	// Unordered access view info
@@ -253,6 +387,7 @@ namespace toy
 		ShaderType shader_flag = ShaderType::VertexShader;
 		bool enable_counter = false;
 		bool first_init = false;
+		ID3D11Resource *resource = nullptr;
 	};
 
 	// Sampler state
@@ -284,6 +419,83 @@ namespace toy
 	};
 
 	// Pipeline state object
+	// How VS input attributes are spread over vertex buffers
+	enum class VertexLayoutPolicy
+	{
+		SeparateStreams = 0,
+		Interleaved,
+		HotCold
+	};
+
+	// Storage of a float VS input in the vertex buffer, the input assembler expands it back to float
+	enum class VertexAttributeEncoding
+	{
+		Float32 = 0,
+		Float16,         // R16G16_FLOAT or R16G16B16A16_FLOAT
+		BiasedUnorm10,   // R10G10B10A2_UNORM of v * 0.5 + 0.5, the shader maps it back with v * 2 - 1
+		Snorm8,          // R8G8B8A8_SNORM
+		Octahedral16     // R16G16_SNORM octahedral unit vector, float3 only, the shader decodes it
+	};
+
+	struct VertexAttributeCompression
+	{
+		std::string semantic_name = {};
+		VertexAttributeEncoding encoding = VertexAttributeEncoding::Float32;
+	};
+
+	// Semantic fetched once per instance_step_rate instances instead of once per vertex, e.g. the world matrix or the entity id
+	struct VertexInstanceClassification
+	{
+		std::string semantic_name = {};
+		uint32_t instance_step_rate = 1;
+	};
+
+	struct VertexLayoutDesc
+	{
+		VertexLayoutPolicy layout_policy = VertexLayoutPolicy::SeparateStreams;
+
+		// HotCold only, attributes with these semantics go to stream 0 and the rest to stream 1, e.g. position for depth passes
+		std::vector<std::string> hot_semantics = { "POSITION" };
+
+		// Per semantic compression hints, attributes without a hint keep their 32-bit format
+		std::vector<VertexAttributeCompression> compressions = {};
+
+		// Per instance attributes get one interleaved stream per step rate, placed after the vertex streams
+		std::vector<VertexInstanceClassification> instance_classifications = {};
+	};
+
+	struct VertexAttribute
+	{
+		std::string semantic_name = {};
+		uint32_t semantic_index = 0;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		uint32_t input_slot = 0;
+		uint32_t aligned_byte_offset = 0;
+		uint32_t size_in_bytes = 0;
+		uint32_t component_count = 0;
+		VertexAttributeEncoding encoding = VertexAttributeEncoding::Float32;
+		D3D11_INPUT_CLASSIFICATION input_slot_class = D3D11_INPUT_PER_VERTEX_DATA;
+		uint32_t instance_step_rate = 0;
+	};
+
+	// Vertex buffer layout the input layout was created for, mesh data is laid out to match it
+	struct VertexFormat
+	{
+		std::vector<VertexAttribute> attributes = {};
+		std::vector<uint32_t> stream_strides = {};
+		std::vector<D3D11_INPUT_CLASSIFICATION> stream_classes = {};
+
+		[[nodiscard]] const VertexAttribute *query_attribute(std::string_view semantic_name, uint32_t semantic_index = 0) const;
+
+		[[nodiscard]] uint32_t get_stream_count() const { return static_cast<uint32_t>(stream_strides.size()); }
+
+		// Bytes fetched per vertex over the per vertex streams
+		[[nodiscard]] uint32_t query_vertex_size_in_bytes() const;
+
+		// First per instance stream, the stream count when every attribute is per vertex
+		[[nodiscard]] uint32_t query_instance_stream() const;
+	};
+
 	struct GraphicsPipelineStateObject
 	{
 		ComPtr<ID3D11RasterizerState> rasterizer_state = nullptr;
@@ -295,6 +507,7 @@ namespace toy
 		std::wstring_view gs_path{};
 		std::wstring_view ps_path{};
 		ShaderTargetProfile shader_target_profile = ShaderTargetProfile::ShaderModel_5_1;
+		VertexLayoutDesc vertex_layout{};
 	};
 
 	struct ComputePipelineStateObject
@@ -305,33 +518,173 @@ namespace toy
 
 	using PipelineStateObject = std::variant<GraphicsPipelineStateObject, ComputePipelineStateObject>;
 
-	// Effect
+	// Constant buffer layout
+	struct ConstantBufferLayout
+	{
+		std::string constant_buffer_name = {};
+		uint32_t binding_slot = 0;
+		uint32_t size_in_bytes = 0;
+		uint32_t shader_flag = 0;
+	};
+
+	struct ConstantBufferVariableLayout
+	{
+		std::string variable_name = {};
+		size_t constant_buffer_id = 0;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	// Effect prototype, the immutable part of an effect shared by all of its instances
+	struct EffectPrototype
+	{
+	private:
+		std::unordered_map<size_t, ConstantBufferLayout> constant_buffer_layouts;
+		std::unordered_map<size_t, ConstantBufferVariableLayout> constant_buffer_variable_layouts;
+		std::unordered_map<size_t, ShaderResource> shader_resource_layouts;
+		std::unordered_map<size_t, RWResource> unordered_access_layouts;
+		std::unordered_map<size_t, SamplerState> sampler_layouts;
+		std::vector<ShaderInfo> pipeline_shaders;
+		ComPtr<ID3D11RasterizerState> rasterizer_state = nullptr;
+		ComPtr<ID3D11DepthStencilState> depth_stencil_state = nullptr;
+		ComPtr<ID3D11BlendState> blend_state = nullptr;
+		ComPtr<ID3D11InputLayout> vertex_input_layout = nullptr;
+		ThreadGroupConf thread_group_conf{};
+		std::array<uint8_t, 16> bytecode_digest{};
+		VertexFormat vertex_format{};
+		bool is_pipeline_valid = true;
+
+		friend struct Effect;
+		friend struct GraphicsEffect;
+		friend struct ComputeEffect;
+
+	public:
+		explicit EffectPrototype(const PipelineStateObject &pipeline_state_object, ID3D11Device *device);
+
+		EffectPrototype(const EffectPrototype &) = delete;
+		EffectPrototype &operator=(const EffectPrototype &) = delete;
+		EffectPrototype(EffectPrototype &&) = delete;
+		EffectPrototype &operator=(EffectPrototype &&) = delete;
+
+		// nullptr when a stage fails to compile or reflect
+		static std::shared_ptr<const EffectPrototype> create(const PipelineStateObject &pipeline_state_object, ID3D11Device *device);
+
+		// False when a stage failed, the stages after it are left out
+		[[nodiscard]] bool is_valid() const;
+
+		// Digest over the bytecode of every stage, for caches of anything the shaders produce
+		[[nodiscard]] const std::array<uint8_t, 16> &get_bytecode_digest() const;
+
+		[[nodiscard]] const VertexFormat &get_vertex_format() const;
+
+	private:
+		void create_graphics_pipeline(const GraphicsPipelineStateObject &graphics_pipeline_state_object, ID3D11Device *device);
+
+		void create_compute_pipeline(const ComputePipelineStateObject &compute_pipeline_state_object, ID3D11Device *device);
+
+		// Blob and reflection of a stage are usable, logs and marks the prototype invalid otherwise
+		bool accept_shader_result(std::wstring_view shader_path, const DxcShaderResult &shader_result);
+
+		void update_shader_reflection(std::wstring_view shader_name, ID3D12ShaderReflection *shader_reflection);
+
+		void update_bytecode_digest(const DxcShaderResult &shader_result, ShaderType shader_type);
+	};
+
+	// Resources bound through effects on one device context, used to unbind read/write conflicts before they reach d3d
+	struct ResourceBindingState
+	{
+	private:
+		static constexpr uint32_t shader_stage_count = 6;
+		static constexpr uint32_t srv_slot_count = D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT;
+		static constexpr uint32_t uav_slot_count = D3D11_1_UAV_SLOT_COUNT;
+
+		std::array<std::array<ID3D11Resource *, srv_slot_count>, shader_stage_count> srv_resources{};
+		std::array<uint32_t, shader_stage_count> srv_slot_ends{};
+		std::array<ID3D11Resource *, uav_slot_count> cs_uav_resources{};
+		std::array<ID3D11Resource *, uav_slot_count> ps_uav_resources{};
+		ID3D11InputLayout *input_layout = nullptr;
+		bool is_input_layout_known = false;
+		uint64_t hazards_resolved = 0;
+		uint64_t unbind_calls = 0;
+		uint64_t redundant_states_skipped = 0;
+		uint64_t reset_count = 0;
+
+		friend struct Effect;
+
+	public:
+		using SrvSlotMask = std::array<uint64_t, srv_slot_count / 64>;
+
+		// Binding state of a context as seen by the calling thread
+		static ResourceBindingState &query(ID3D11DeviceContext *device_context);
+
+		// Forget every tracked binding, e.g. after ClearState, FinishCommandList or ExecuteCommandList
+		static void reset(ID3D11DeviceContext *device_context);
+
+		// Number of resets so far, mapped ranges recorded before the last one belong to an earlier command list
+		[[nodiscard]] uint64_t query_reset_count() const;
+
+		void track_shader_resource(ShaderType shader_type, uint32_t slot, ID3D11Resource *resource);
+
+		void track_unordered_access(ShaderType shader_type, uint32_t slot, ID3D11Resource *resource);
+
+		// Null every slot set in the masks with one ranged call per run of contiguous slots
+		void unbind_shader_resources(ID3D11DeviceContext *device_context, uint32_t stage_index, const SrvSlotMask &slot_mask);
+
+		void unbind_unordered_access_views(ID3D11DeviceContext *device_context, ShaderType shader_type, uint64_t slot_mask);
+
+		// Input layouts come from InputLayoutCache, so effects with the same layout pass the same pointer and the call is skipped
+		void emit_input_layout(ID3D11DeviceContext *device_context, ID3D11InputLayout *vertex_input_layout);
+
+		// Uav slots of a stage currently holding the resource
+		[[nodiscard]] uint64_t query_unordered_access_mask(ShaderType shader_type, ID3D11Resource *resource) const;
+
+		[[nodiscard]] uint64_t query_hazards_resolved() const;
+
+		[[nodiscard]] uint64_t query_unbind_calls() const;
+
+		[[nodiscard]] uint64_t query_redundant_states_skipped() const;
+	};
+
+	// Effect instance, owns its constant buffer shadows and resource bindings only
 	struct Effect
 	{
 	protected:
+		std::shared_ptr<const EffectPrototype> effect_prototype;
 		std::unordered_map<size_t, std::unique_ptr<ConstantBuffer>> constant_buffer_manager;
 		std::unordered_map<size_t, std::unique_ptr<ConstantBufferAccessor>> constant_buffer_accessor_manager;
 		std::unordered_map<size_t, ShaderResource> shader_resource_manager;
 		std::unordered_map<size_t, RWResource> unordered_access_manager;
 		std::unordered_map<size_t, SamplerState> sampler_manager;
-		std::vector<ShaderInfo> pipeline_shader_manager;
+
+		friend struct CpuComputeExecutor;
 
 	public:
-		Effect();
+		explicit Effect(std::shared_ptr<const EffectPrototype> prototype, ID3D11Device *device, ConstantBufferPool *constant_buffer_pool = nullptr);
 		virtual ~Effect();
 
+		[[nodiscard]] const std::shared_ptr<const EffectPrototype> &get_prototype() const;
+
 		ConstantBufferAccessor *query_constant_buffer_accessor(std::string_view variable_name);
 
+		ConstantBuffer *query_constant_buffer(std::string_view constant_buffer_name);
+
 		void transmit_constant_buffer(Effect &other, std::string_view constant_buffer_name);
 
 		void bind_shader_resource_view(std::string_view srv_name, ID3D11ShaderResourceView *srv);
 
+		// Reflected srv of any stage, nullptr when no shader declares it
+		[[nodiscard]] const ShaderResource *query_shader_resource(std::string_view srv_name) const;
+
 		void bind_sampler(std::string_view sampler_name, ID3D11SamplerState *sampler);
 
 		void bind_unordered_access_view(std::string_view uav_name, ID3D11UnorderedAccessView *uav);
 
 		void emit_pipeline(ID3D11DeviceContext *device_context);
 
+		void emit_shader_resources(ID3D11DeviceContext *device_context);
+
+		void stage_constant_buffers();
+
 		virtual void set_stencil_ref(uint32_t stencil_value) = 0;
 
 		virtual void set_blend_factor(std::span<float> blend_value) = 0;
@@ -342,17 +695,17 @@ namespace toy
 
 		virtual void dispatch(ID3D11DeviceContext *device_context, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z) = 0;
 
+		// Thread group counts are read on the gpu from three uints at the offset, e.g. written by an earlier compute pass
+		virtual void dispatch_indirect(ID3D11DeviceContext *device_context, ID3D11Buffer *argument_buffer, uint32_t aligned_byte_offset) = 0;
+
 	protected:
-		void update_shader_reflection(std::wstring_view shader_name, ID3D11Device *device, ID3D12ShaderReflection *shader_reflection);
+		// Unbind slots that hold a resource this effect writes, and writable slots that hold a resource it reads
+		void resolve_resource_hazards(ID3D11DeviceContext *device_context, ResourceBindingState &binding_state);
 	};
 
 	struct GraphicsEffect final : Effect
 	{
 	private:
-		ComPtr<ID3D11RasterizerState> rasterizer_state = nullptr;
-		ComPtr<ID3D11DepthStencilState> depth_stencil_state = nullptr;
-		ComPtr<ID3D11BlendState> blend_state = nullptr;
-		ComPtr<ID3D11InputLayout> vertex_input_layout = nullptr;
 		std::array<float, 4> blend_factor{ 0.0f, 0.0f, 0.0f, 0.0f };
 		uint32_t sample_mask = 0xffffffff;
 		uint32_t stencil_ref = 0;
@@ -360,6 +713,8 @@ namespace toy
 	public:
 		explicit GraphicsEffect(const PipelineStateObject &pipeline_state_object, ID3D11Device *device);
 
+		explicit GraphicsEffect(std::shared_ptr<const EffectPrototype> prototype, ID3D11Device *device, ConstantBufferPool *constant_buffer_pool = nullptr);
+
 		~GraphicsEffect() override = default;
 		GraphicsEffect(const GraphicsEffect &) = delete;
 		GraphicsEffect &operator=(const GraphicsEffect &) = delete;
@@ -371,25 +726,53 @@ namespace toy
 		void set_blend_factor(std::span<float> blend_value) override;
 
 		void emit_graphics_pipeline(ID3D11DeviceContext *device_context) override;
+
+		// One buffer per stream of the vertex format, bound with a single call using the format's strides
+		void emit_vertex_buffers(ID3D11DeviceContext *device_context, std::span<ID3D11Buffer *const> vertex_buffers, std::span<const uint32_t> offsets = {});
+
+		void emit_compute_pipeline(ID3D11DeviceContext *device_context) override;
+
+		void dispatch(ID3D11DeviceContext *device_context, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z) override;
+
+		void dispatch_indirect(ID3D11DeviceContext *device_context, ID3D11Buffer *argument_buffer, uint32_t aligned_byte_offset) override;
 	};
 
+	// Large dispatches are split into chunks of at most D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION groups per axis
+	// Shaders that may be split declare uint3 g_DispatchGroupOffset in any cbuffer and add it to SV_GroupID
 	struct ComputeEffect final : Effect
 	{
 	private:
-		ThreadGroupConf thread_group_conf{};
+		ConstantBufferAccessor *group_offset_accessor = nullptr;
+		std::array<uint32_t, 3> group_offset{ 0, 0, 0 };
 
 	public:
 		explicit ComputeEffect(const PipelineStateObject &pipeline_state_object, ID3D11Device *device);
 
+		explicit ComputeEffect(std::shared_ptr<const EffectPrototype> prototype, ID3D11Device *device, ConstantBufferPool *constant_buffer_pool = nullptr);
+
 		~ComputeEffect() override = default;
 		ComputeEffect(const ComputeEffect &) = delete;
 		ComputeEffect &operator=(const ComputeEffect &) = delete;
 		ComputeEffect(ComputeEffect &&) = delete;
 		ComputeEffect &operator=(ComputeEffect &&) = delete;
 
+		void set_stencil_ref(uint32_t stencil_value) override;
+
+		void set_blend_factor(std::span<float> blend_value) override;
+
+		void emit_graphics_pipeline(ID3D11DeviceContext *device_context) override;
+
 		void emit_compute_pipeline(ID3D11DeviceContext *device_context) override;
 
 		void dispatch(ID3D11DeviceContext *device_context, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z) override;
+
+		void dispatch_indirect(ID3D11DeviceContext *device_context, ID3D11Buffer *argument_buffer, uint32_t aligned_byte_offset) override;
+
+		[[nodiscard]] const ThreadGroupConf &get_thread_group_conf() const;
+
+	private:
+		// Upload only when the offset changes, the constant buffer stays bound
+		void set_group_offset(ID3D11DeviceContext *device_context, const std::array<uint32_t, 3> &offset);
 	};
 }
 
@@ -0,0 +1,146 @@
+//
+// Created by ZZK on 2024/10/31.
+//
+
+#include <instance_stream.h>
+#include <algorithm>
+#include <bit>
+
+namespace toy
+{
+	static uint32_t query_instance_stride(const VertexFormat &vertex_format)
+	{
+		const uint32_t instance_stream = vertex_format.query_instance_stream();
+		if (instance_stream >= vertex_format.get_stream_count()) {
+			std::cout << std::format("Vertex format has no per instance stream\n");
+			return 0;
+		}
+		return vertex_format.stream_strides[instance_stream];
+	}
+
+	InstanceStream::InstanceStream(ID3D11Device *input_device, uint32_t input_stride_in_bytes, uint32_t initial_capacity)
+	: device(input_device), stride_in_bytes(input_stride_in_bytes)
+	{
+		if (stride_in_bytes > 0) {
+			create_buffer((std::max)(initial_capacity, 1U));
+		}
+	}
+
+	InstanceStream::InstanceStream(ID3D11Device *input_device, const VertexFormat &vertex_format, uint32_t initial_capacity)
+	: InstanceStream(input_device, query_instance_stride(vertex_format), initial_capacity)
+	{
+
+	}
+
+	void *InstanceStream::begin_write(ID3D11DeviceContext *device_context, uint32_t instance_count, uint32_t &start_instance)
+	{
+		start_instance = UINT32_MAX;
+		if (is_mapped || instance_count == 0 || stride_in_bytes == 0) {
+			return nullptr;
+		}
+
+		// Appends never overwrite instances the gpu may still read, a full buffer is discarded and writing restarts at zero
+		D3D11_MAP map_type = D3D11_MAP_WRITE_NO_OVERWRITE;
+		if (instance_count > capacity) {
+			if (FAILED(create_buffer(std::bit_ceil(instance_count)))) {
+				return nullptr;
+			}
+			write_cursor = 0;
+			map_type = D3D11_MAP_WRITE_DISCARD;
+		} else if (write_cursor + instance_count > capacity || write_cursor == 0) {
+			write_cursor = 0;
+			map_type = D3D11_MAP_WRITE_DISCARD;
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mapped_data{};
+		if (FAILED(device_context->Map(instance_buffer.Get(), 0, map_type, 0, &mapped_data))) {
+			std::cout << std::format("Failed to map instance buffer\n");
+			return nullptr;
+		}
+		if (map_type == D3D11_MAP_WRITE_DISCARD) {
+			++stream_stats.discards;
+		}
+		is_mapped = true;
+		pending_count = instance_count;
+		start_instance = write_cursor;
+		return static_cast<uint8_t *>(mapped_data.pData) + static_cast<size_t>(write_cursor) * stride_in_bytes;
+	}
+
+	void InstanceStream::end_write(ID3D11DeviceContext *device_context)
+	{
+		if (!is_mapped) {
+			return;
+		}
+		device_context->Unmap(instance_buffer.Get(), 0);
+		write_cursor += pending_count;
+		stream_stats.instances_written += pending_count;
+		stream_stats.bytes_written += static_cast<uint64_t>(pending_count) * stride_in_bytes;
+		pending_count = 0;
+		is_mapped = false;
+	}
+
+	uint32_t InstanceStream::write(ID3D11DeviceContext *device_context, const void *instance_data, uint32_t instance_count)
+	{
+		uint32_t start_instance = UINT32_MAX;
+		auto mapped_instances = begin_write(device_context, instance_count, start_instance);
+		if (mapped_instances == nullptr) {
+			return UINT32_MAX;
+		}
+		std::memcpy(mapped_instances, instance_data, static_cast<size_t>(instance_count) * stride_in_bytes);
+		end_write(device_context);
+		return start_instance;
+	}
+
+	void InstanceStream::emit(ID3D11DeviceContext *device_context, uint32_t input_slot) const
+	{
+		const uint32_t offset = 0;
+		ID3D11Buffer *const vertex_buffer = instance_buffer.Get();
+		device_context->IASetVertexBuffers(input_slot, 1, &vertex_buffer, &stride_in_bytes, &offset);
+	}
+
+	ID3D11Buffer *InstanceStream::get_buffer() const
+	{
+		return instance_buffer.Get();
+	}
+
+	uint32_t InstanceStream::get_stride_in_bytes() const
+	{
+		return stride_in_bytes;
+	}
+
+	uint32_t InstanceStream::get_capacity() const
+	{
+		return capacity;
+	}
+
+	const InstanceStreamStats &InstanceStream::get_stats() const
+	{
+		return stream_stats;
+	}
+
+	void InstanceStream::print() const
+	{
+		std::cout << std::format("Instance stream: {} instances ({} bytes) written, {} discards, {} buffer creations, capacity {} instances of {} bytes\n",
+								stream_stats.instances_written, stream_stats.bytes_written, stream_stats.discards, stream_stats.buffer_creations,
+								capacity, stride_in_bytes);
+	}
+
+	HRESULT InstanceStream::create_buffer(uint32_t instance_capacity)
+	{
+		D3D11_BUFFER_DESC buffer_desc{};
+		buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		buffer_desc.ByteWidth = instance_capacity * stride_in_bytes;
+		const HRESULT hr = device->CreateBuffer(&buffer_desc, nullptr, instance_buffer.ReleaseAndGetAddressOf());
+		if (FAILED(hr)) {
+			std::cout << std::format("Failed to create instance buffer of {} instances\n", instance_capacity);
+			capacity = 0;
+			return hr;
+		}
+		capacity = instance_capacity;
+		write_cursor = 0;
+		++stream_stats.buffer_creations;
+		return hr;
+	}
+}
@@ -0,0 +1,67 @@
+//
+// Created by ZZK on 2024/10/31.
+//
+
+#pragma once
+
+#include <effect.h>
+
+namespace toy
+{
+	struct InstanceStreamStats
+	{
+		uint64_t instances_written = 0;
+		uint64_t bytes_written = 0;
+		uint64_t discards = 0;
+		uint32_t buffer_creations = 0;
+	};
+
+	// Dynamic vertex buffer for a per instance stream of a VertexFormat, written by no-overwrite appends
+	// Each write returns its first instance, passed as the start instance of DrawIndexedInstanced so one draw covers all objects sharing a mesh
+	// The buffer is discarded when an append doesn't fit, and recreated larger when a single write exceeds it, so bind it after writing
+	// and record the draw of a write before the next one, a discard drops the instances written before it
+	struct InstanceStream
+	{
+	private:
+		ComPtr<ID3D11Device> device = nullptr;
+		ComPtr<ID3D11Buffer> instance_buffer = nullptr;
+		uint32_t stride_in_bytes = 0;
+		uint32_t capacity = 0;
+		uint32_t write_cursor = 0;
+		uint32_t pending_count = 0;
+		bool is_mapped = false;
+		InstanceStreamStats stream_stats{};
+
+	public:
+		InstanceStream(ID3D11Device *input_device, uint32_t input_stride_in_bytes, uint32_t initial_capacity = 4096);
+
+		// Stream stride taken from the format, the format must have a per instance stream
+		InstanceStream(ID3D11Device *input_device, const VertexFormat &vertex_format, uint32_t initial_capacity = 4096);
+
+		InstanceStream(const InstanceStream &) = delete;
+		InstanceStream &operator=(const InstanceStream &) = delete;
+
+		// Map room for instance_count contiguous instances, the caller fills them until end_write, nullptr on failure
+		void *begin_write(ID3D11DeviceContext *device_context, uint32_t instance_count, uint32_t &start_instance);
+
+		void end_write(ID3D11DeviceContext *device_context);
+
+		// Copy instances in, returns their start instance or UINT32_MAX on failure
+		uint32_t write(ID3D11DeviceContext *device_context, const void *instance_data, uint32_t instance_count);
+
+		void emit(ID3D11DeviceContext *device_context, uint32_t input_slot) const;
+
+		[[nodiscard]] ID3D11Buffer *get_buffer() const;
+
+		[[nodiscard]] uint32_t get_stride_in_bytes() const;
+
+		[[nodiscard]] uint32_t get_capacity() const;
+
+		[[nodiscard]] const InstanceStreamStats &get_stats() const;
+
+		void print() const;
+
+	private:
+		HRESULT create_buffer(uint32_t instance_capacity);
+	};
+}
@@ -0,0 +1,187 @@
+//
+// Created by ZZK on 2024/10/24.
+//
+
+#include <job_system.h>
+#include <algorithm>
+
+namespace toy
+{
+	// Worker identity of the current thread, set once when a worker starts
+	static thread_local const JobSystem *s_owner_job_system = nullptr;
+	static thread_local uint32_t s_worker_index = 0;
+
+	// Work stealing queue
+	void WorkStealingQueue::push(Job job, JobCounter *job_counter)
+	{
+		std::lock_guard<std::mutex> lock{ queue_mutex };
+		queued_jobs.emplace_back(std::move(job), job_counter);
+	}
+
+	bool WorkStealingQueue::pop(Job &job, JobCounter *&job_counter)
+	{
+		std::lock_guard<std::mutex> lock{ queue_mutex };
+		if (queued_jobs.empty()) {
+			return false;
+		}
+		job = std::move(queued_jobs.back().job);
+		job_counter = queued_jobs.back().job_counter;
+		queued_jobs.pop_back();
+		return true;
+	}
+
+	bool WorkStealingQueue::steal(Job &job, JobCounter *&job_counter)
+	{
+		std::lock_guard<std::mutex> lock{ queue_mutex };
+		if (queued_jobs.empty()) {
+			return false;
+		}
+		job = std::move(queued_jobs.front().job);
+		job_counter = queued_jobs.front().job_counter;
+		queued_jobs.pop_front();
+		return true;
+	}
+
+	// Job system
+	JobSystem::JobSystem(uint32_t worker_count)
+	{
+		if (worker_count == 0) {
+			const uint32_t hardware_thread_count = std::thread::hardware_concurrency();
+			worker_count = hardware_thread_count > 1 ? hardware_thread_count - 1 : 1;
+		}
+
+		job_queues.reserve(worker_count + 1);
+		for (uint32_t queue_index = 0; queue_index <= worker_count; ++queue_index)
+		{
+			job_queues.emplace_back(std::make_unique<WorkStealingQueue>());
+		}
+		workers.reserve(worker_count);
+		for (uint32_t worker_index = 0; worker_index < worker_count; ++worker_index)
+		{
+			workers.emplace_back(&JobSystem::worker_loop, this, worker_index);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ wake_mutex };
+			is_running.store(false);
+		}
+		wake_condition.notify_all();
+		for (auto &&worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void JobSystem::submit(Job job, JobCounter *job_counter)
+	{
+		if (job_counter != nullptr) {
+			job_counter->pending_jobs.fetch_add(1, std::memory_order_relaxed);
+		}
+		queued_job_count.fetch_add(1, std::memory_order_release);
+		job_queues[query_thread_index()]->push(std::move(job), job_counter);
+		{
+			// Taking the lock orders the count increment against a worker checking it before sleeping
+			std::lock_guard<std::mutex> lock{ wake_mutex };
+		}
+		wake_condition.notify_one();
+	}
+
+	void JobSystem::wait(JobCounter &job_counter)
+	{
+		const uint32_t thread_index = query_thread_index();
+		while (!job_counter.is_done())
+		{
+			if (!try_execute(thread_index)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::parallel_for(uint32_t count, uint32_t batch_size, const std::function<void(uint32_t)> &function)
+	{
+		batch_size = batch_size > 0 ? batch_size : 1;
+		JobCounter job_counter{};
+		for (uint32_t batch_begin = 0; batch_begin < count; batch_begin += batch_size)
+		{
+			const uint32_t batch_end = (std::min)(batch_begin + batch_size, count);
+			submit([&function, batch_begin, batch_end]()
+			{
+				for (uint32_t index = batch_begin; index < batch_end; ++index)
+				{
+					function(index);
+				}
+			}, &job_counter);
+		}
+		wait(job_counter);
+	}
+
+	uint32_t JobSystem::get_worker_count() const
+	{
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	uint32_t JobSystem::get_thread_count() const
+	{
+		return static_cast<uint32_t>(workers.size()) + 1;
+	}
+
+	uint32_t JobSystem::query_thread_index() const
+	{
+		return s_owner_job_system == this ? s_worker_index : static_cast<uint32_t>(workers.size());
+	}
+
+	JobSystemStats JobSystem::get_stats() const
+	{
+		return { jobs_executed.load(std::memory_order_relaxed), jobs_stolen.load(std::memory_order_relaxed) };
+	}
+
+	void JobSystem::worker_loop(uint32_t worker_index)
+	{
+		s_owner_job_system = this;
+		s_worker_index = worker_index;
+		while (true)
+		{
+			if (try_execute(worker_index)) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ wake_mutex };
+			wake_condition.wait(lock, [this]() { return queued_job_count.load(std::memory_order_acquire) > 0 || !is_running.load(); });
+			if (!is_running.load() && queued_job_count.load(std::memory_order_acquire) == 0) {
+				return;
+			}
+		}
+	}
+
+	bool JobSystem::try_execute(uint32_t thread_index)
+	{
+		Job job{};
+		JobCounter *job_counter = nullptr;
+		bool has_job = job_queues[thread_index]->pop(job, job_counter);
+		if (!has_job) {
+			// Steal from the other queues, starting after our own so thieves spread over victims
+			const uint32_t queue_count = static_cast<uint32_t>(job_queues.size());
+			for (uint32_t offset = 1; offset < queue_count && !has_job; ++offset)
+			{
+				has_job = job_queues[(thread_index + offset) % queue_count]->steal(job, job_counter);
+			}
+			if (has_job) {
+				jobs_stolen.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		if (!has_job) {
+			return false;
+		}
+
+		queued_job_count.fetch_sub(1, std::memory_order_acq_rel);
+		job();
+		jobs_executed.fetch_add(1, std::memory_order_relaxed);
+		if (job_counter != nullptr) {
+			job_counter->pending_jobs.fetch_sub(1, std::memory_order_acq_rel);
+		}
+		return true;
+	}
+}
@@ -0,0 +1,107 @@
+//
+// Created by ZZK on 2024/10/24.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace toy
+{
+	using Job = std::function<void()>;
+
+	// Number of submitted jobs not finished yet, waited on by JobSystem::wait
+	struct JobCounter
+	{
+		std::atomic<uint32_t> pending_jobs{ 0 };
+
+		[[nodiscard]] bool is_done() const
+		{
+			return pending_jobs.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	struct JobSystemStats
+	{
+		uint64_t jobs_executed = 0;
+		uint64_t jobs_stolen = 0;
+	};
+
+	// Per thread job deque, the owner pushes and pops at the back, thieves steal from the front
+	struct WorkStealingQueue
+	{
+	private:
+		struct QueuedJob
+		{
+			Job job = {};
+			JobCounter *job_counter = nullptr;
+		};
+
+		std::deque<QueuedJob> queued_jobs = {};
+		std::mutex queue_mutex;
+
+		friend struct JobSystem;
+
+	public:
+		void push(Job job, JobCounter *job_counter);
+
+		bool pop(Job &job, JobCounter *&job_counter);
+
+		bool steal(Job &job, JobCounter *&job_counter);
+	};
+
+	// Work stealing job system, one queue per worker plus one shared by threads outside the system
+	struct JobSystem
+	{
+	private:
+		std::vector<std::thread> workers = {};
+		std::vector<std::unique_ptr<WorkStealingQueue>> job_queues = {};
+		std::atomic<uint32_t> queued_job_count{ 0 };
+		std::atomic<uint64_t> jobs_executed{ 0 };
+		std::atomic<uint64_t> jobs_stolen{ 0 };
+		std::atomic<bool> is_running{ true };
+		std::mutex wake_mutex;
+		std::condition_variable wake_condition;
+
+	public:
+		// Zero worker count picks one worker per hardware thread minus the calling thread
+		explicit JobSystem(uint32_t worker_count = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem &) = delete;
+		JobSystem &operator=(const JobSystem &) = delete;
+		JobSystem(JobSystem &&) = delete;
+		JobSystem &operator=(JobSystem &&) = delete;
+
+		void submit(Job job, JobCounter *job_counter = nullptr);
+
+		// Run queued jobs on the calling thread until the counter drops to zero
+		void wait(JobCounter &job_counter);
+
+		// Split [0, count) into batches and wait for all of them
+		void parallel_for(uint32_t count, uint32_t batch_size, const std::function<void(uint32_t)> &function);
+
+		[[nodiscard]] uint32_t get_worker_count() const;
+
+		// Workers plus the thread that waits on jobs
+		[[nodiscard]] uint32_t get_thread_count() const;
+
+		// Index of the calling thread in [0, worker count), threads outside the system get the worker count
+		[[nodiscard]] uint32_t query_thread_index() const;
+
+		[[nodiscard]] JobSystemStats get_stats() const;
+
+	private:
+		void worker_loop(uint32_t worker_index);
+
+		bool try_execute(uint32_t thread_index);
+	};
+}
@@ -0,0 +1,262 @@
+//
+// Created by ZZK on 2024/10/29.
+//
+
+#include <lut_cache.h>
+#include <filesystem>
+#include <fstream>
+
+namespace toy
+{
+	static constexpr uint32_t s_lut_cache_magic = 0x4354554c; // "LUTC"
+	static constexpr uint32_t s_lut_cache_version = 1;
+
+	struct LutCacheFileHeader
+	{
+		uint32_t magic = s_lut_cache_magic;
+		uint32_t version = s_lut_cache_version;
+		LutCacheKey lut_cache_key{};
+	};
+
+	static uint64_t hash_bytes(const uint8_t *data, size_t size_in_bytes, uint64_t hash = 0xcbf29ce484222325ULL)
+	{
+		for (size_t index = 0; index < size_in_bytes; ++index)
+		{
+			hash = (hash ^ data[index]) * 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	size_t LutCacheKeyHasher::operator()(const LutCacheKey &lut_cache_key) const
+	{
+		uint64_t hash = hash_bytes(lut_cache_key.bytecode_digest.data(), lut_cache_key.bytecode_digest.size(), lut_cache_key.params_hash);
+		hash = hash_bytes(reinterpret_cast<const uint8_t *>(&lut_cache_key.width), sizeof(lut_cache_key.width), hash);
+		hash = hash_bytes(reinterpret_cast<const uint8_t *>(&lut_cache_key.height), sizeof(lut_cache_key.height), hash);
+		return static_cast<size_t>(hash_bytes(reinterpret_cast<const uint8_t *>(&lut_cache_key.format), sizeof(lut_cache_key.format), hash));
+	}
+
+	LutCache::LutCache(ID3D11Device *input_device, std::string_view directory, uint32_t max_resident_luts)
+	: device(input_device), disk_directory(directory), capacity((std::max)(max_resident_luts, 1U))
+	{
+		if (!disk_directory.empty()) {
+			std::error_code error_code{};
+			std::filesystem::create_directories(disk_directory, error_code);
+		}
+	}
+
+	LutCacheKey LutCache::make_key(std::span<const uint8_t> params_data, const EffectPrototype &effect_prototype, uint32_t width, uint32_t height, DXGI_FORMAT format)
+	{
+		return { hash_bytes(params_data.data(), params_data.size()), effect_prototype.get_bytecode_digest(), width, height, format };
+	}
+
+	ComPtr<ID3D11ShaderResourceView> LutCache::query(const LutCacheKey &lut_cache_key)
+	{
+		++cache_stats.lookups;
+		if (auto lut_iter = lut_index.find(lut_cache_key); lut_iter != lut_index.end()) {
+			lru_luts.splice(lru_luts.begin(), lru_luts, lut_iter->second);
+			++cache_stats.memory_hits;
+			return lut_iter->second->srv;
+		}
+
+		std::vector<uint8_t> texel_data{};
+		if (read_from_disk(lut_cache_key, texel_data)) {
+			ComPtr<ID3D11Texture2D> texture = nullptr;
+			ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+			if (SUCCEEDED(create_texture(lut_cache_key, texel_data, texture.GetAddressOf(), srv.GetAddressOf()))) {
+				++cache_stats.disk_hits;
+				return insert_resident(lut_cache_key, std::move(texture), std::move(srv));
+			}
+		}
+
+		++cache_stats.misses;
+		return nullptr;
+	}
+
+	ComPtr<ID3D11ShaderResourceView> LutCache::insert(ID3D11DeviceContext *device_context, const LutCacheKey &lut_cache_key, ID3D11Texture2D *texture, ID3D11ShaderResourceView *srv)
+	{
+		if (!disk_directory.empty()) {
+			// One stalling readback per miss, every later run loads the file instead of recomputing
+			D3D11_TEXTURE2D_DESC staging_desc{};
+			texture->GetDesc(&staging_desc);
+			staging_desc.MipLevels = 1;
+			staging_desc.Usage = D3D11_USAGE_STAGING;
+			staging_desc.BindFlags = 0;
+			staging_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			staging_desc.MiscFlags = 0;
+			ComPtr<ID3D11Texture2D> staging_texture = nullptr;
+			D3D11_MAPPED_SUBRESOURCE mapped_data{};
+			if (SUCCEEDED(device->CreateTexture2D(&staging_desc, nullptr, staging_texture.GetAddressOf()))) {
+				device_context->CopySubresourceRegion(staging_texture.Get(), 0, 0, 0, 0, texture, 0, nullptr);
+				if (SUCCEEDED(device_context->Map(staging_texture.Get(), 0, D3D11_MAP_READ, 0, &mapped_data))) {
+					const size_t size_in_bytes = static_cast<size_t>(mapped_data.RowPitch) * lut_cache_key.height;
+					write_to_disk(lut_cache_key, { static_cast<const uint8_t *>(mapped_data.pData), size_in_bytes }, mapped_data.RowPitch);
+					device_context->Unmap(staging_texture.Get(), 0);
+				}
+			}
+		}
+		return insert_resident(lut_cache_key, texture, srv);
+	}
+
+	ComPtr<ID3D11ShaderResourceView> LutCache::insert(const LutCacheKey &lut_cache_key, std::span<const uint8_t> texel_data)
+	{
+		ComPtr<ID3D11Texture2D> texture = nullptr;
+		ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+		if (FAILED(create_texture(lut_cache_key, texel_data, texture.GetAddressOf(), srv.GetAddressOf()))) {
+			std::cout << std::format("Failed to create lut texture\n");
+			return nullptr;
+		}
+		if (!disk_directory.empty()) {
+			write_to_disk(lut_cache_key, texel_data, lut_cache_key.width * query_format_size_in_bytes(lut_cache_key.format));
+		}
+		return insert_resident(lut_cache_key, std::move(texture), std::move(srv));
+	}
+
+	ComPtr<ID3D11ShaderResourceView> LutCache::query_or_compute(ID3D11DeviceContext *device_context, ComputeEffect &compute_effect, std::string_view params_constant_buffer_name,
+																std::string_view output_uav_name, uint32_t width, uint32_t height, DXGI_FORMAT format)
+	{
+		auto params_constant_buffer = compute_effect.query_constant_buffer(params_constant_buffer_name);
+		if (params_constant_buffer == nullptr) {
+			std::cout << std::format("Lut effect has no cbuffer {}\n", params_constant_buffer_name);
+			return nullptr;
+		}
+		const auto lut_cache_key = make_key(params_constant_buffer->get_upload_data(), *compute_effect.get_prototype(), width, height, format);
+		if (auto srv = query(lut_cache_key); srv != nullptr) {
+			return srv;
+		}
+
+		D3D11_TEXTURE2D_DESC texture_desc{};
+		texture_desc.Width = width;
+		texture_desc.Height = height;
+		texture_desc.MipLevels = 1;
+		texture_desc.ArraySize = 1;
+		texture_desc.Format = format;
+		texture_desc.SampleDesc.Count = 1;
+		texture_desc.Usage = D3D11_USAGE_DEFAULT;
+		texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		ComPtr<ID3D11Texture2D> texture = nullptr;
+		ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+		ComPtr<ID3D11UnorderedAccessView> uav = nullptr;
+		if (FAILED(device->CreateTexture2D(&texture_desc, nullptr, texture.GetAddressOf())) ||
+			FAILED(device->CreateShaderResourceView(texture.Get(), nullptr, srv.GetAddressOf())) ||
+			FAILED(device->CreateUnorderedAccessView(texture.Get(), nullptr, uav.GetAddressOf()))) {
+			std::cout << std::format("Failed to create lut texture\n");
+			return nullptr;
+		}
+
+		compute_effect.bind_unordered_access_view(output_uav_name, uav.Get());
+		compute_effect.emit_compute_pipeline(device_context);
+		compute_effect.dispatch(device_context, width, height, 1);
+
+		// Unbind so the lut can be sampled right away
+		compute_effect.bind_unordered_access_view(output_uav_name, nullptr);
+		auto &&binding_state = ResourceBindingState::query(device_context);
+		binding_state.unbind_unordered_access_views(device_context, ShaderType::ComputeShader, binding_state.query_unordered_access_mask(ShaderType::ComputeShader, texture.Get()));
+		return insert(device_context, lut_cache_key, texture.Get(), srv.Get());
+	}
+
+	void LutCache::clear()
+	{
+		lru_luts.clear();
+		lut_index.clear();
+		cache_stats.resident_bytes = 0;
+	}
+
+	const LutCacheStats &LutCache::get_stats() const
+	{
+		return cache_stats;
+	}
+
+	void LutCache::print() const
+	{
+		std::cout << std::format("Lut cache: {} lookups, {} memory hits, {} disk hits, {} misses, {} evictions, {} luts resident in {} bytes\n",
+								cache_stats.lookups, cache_stats.memory_hits, cache_stats.disk_hits, cache_stats.misses, cache_stats.evictions,
+								lru_luts.size(), cache_stats.resident_bytes);
+	}
+
+	ComPtr<ID3D11ShaderResourceView> LutCache::insert_resident(const LutCacheKey &lut_cache_key, ComPtr<ID3D11Texture2D> texture, ComPtr<ID3D11ShaderResourceView> srv)
+	{
+		if (auto lut_iter = lut_index.find(lut_cache_key); lut_iter != lut_index.end()) {
+			cache_stats.resident_bytes -= lut_iter->second->size_in_bytes;
+			lru_luts.erase(lut_iter->second);
+			lut_index.erase(lut_iter);
+		}
+		while (lru_luts.size() >= capacity)
+		{
+			cache_stats.resident_bytes -= lru_luts.back().size_in_bytes;
+			lut_index.erase(lru_luts.back().lut_cache_key);
+			lru_luts.pop_back();
+			++cache_stats.evictions;
+		}
+
+		const uint64_t size_in_bytes = static_cast<uint64_t>(lut_cache_key.width) * lut_cache_key.height * query_format_size_in_bytes(lut_cache_key.format);
+		lru_luts.push_front({ lut_cache_key, std::move(texture), std::move(srv), size_in_bytes });
+		lut_index[lut_cache_key] = lru_luts.begin();
+		cache_stats.resident_bytes += size_in_bytes;
+		return lru_luts.front().srv;
+	}
+
+	std::string LutCache::query_file_path(const LutCacheKey &lut_cache_key) const
+	{
+		return std::format("{}/{:016x}.lut", disk_directory, static_cast<uint64_t>(LutCacheKeyHasher{}(lut_cache_key)));
+	}
+
+	bool LutCache::write_to_disk(const LutCacheKey &lut_cache_key, std::span<const uint8_t> texel_data, uint32_t row_pitch) const
+	{
+		std::ofstream lut_file{ query_file_path(lut_cache_key), std::ios::binary | std::ios::trunc };
+		if (!lut_file) {
+			std::cout << std::format("Failed to write lut {}\n", query_file_path(lut_cache_key));
+			return false;
+		}
+		const LutCacheFileHeader header{ s_lut_cache_magic, s_lut_cache_version, lut_cache_key };
+		lut_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		const uint32_t row_size = lut_cache_key.width * query_format_size_in_bytes(lut_cache_key.format);
+		for (uint32_t row = 0; row < lut_cache_key.height; ++row)
+		{
+			lut_file.write(reinterpret_cast<const char *>(texel_data.data() + static_cast<size_t>(row) * row_pitch), row_size);
+		}
+		return static_cast<bool>(lut_file);
+	}
+
+	bool LutCache::read_from_disk(const LutCacheKey &lut_cache_key, std::vector<uint8_t> &texel_data) const
+	{
+		if (disk_directory.empty()) {
+			return false;
+		}
+		std::ifstream lut_file{ query_file_path(lut_cache_key), std::ios::binary };
+		if (!lut_file) {
+			return false;
+		}
+		// The file name is only a hash, the header holds the full key
+		LutCacheFileHeader header{};
+		lut_file.read(reinterpret_cast<char *>(&header), sizeof(header));
+		if (!lut_file || header.magic != s_lut_cache_magic || header.version != s_lut_cache_version || !(header.lut_cache_key == lut_cache_key)) {
+			return false;
+		}
+		texel_data.resize(static_cast<size_t>(lut_cache_key.width) * lut_cache_key.height * query_format_size_in_bytes(lut_cache_key.format));
+		lut_file.read(reinterpret_cast<char *>(texel_data.data()), static_cast<std::streamsize>(texel_data.size()));
+		return static_cast<bool>(lut_file);
+	}
+
+	HRESULT LutCache::create_texture(const LutCacheKey &lut_cache_key, std::span<const uint8_t> texel_data, ID3D11Texture2D **texture, ID3D11ShaderResourceView **srv) const
+	{
+		const uint32_t row_pitch = lut_cache_key.width * query_format_size_in_bytes(lut_cache_key.format);
+		if (row_pitch == 0 || texel_data.size() < static_cast<size_t>(row_pitch) * lut_cache_key.height) {
+			return E_INVALIDARG;
+		}
+		D3D11_TEXTURE2D_DESC texture_desc{};
+		texture_desc.Width = lut_cache_key.width;
+		texture_desc.Height = lut_cache_key.height;
+		texture_desc.MipLevels = 1;
+		texture_desc.ArraySize = 1;
+		texture_desc.Format = lut_cache_key.format;
+		texture_desc.SampleDesc.Count = 1;
+		texture_desc.Usage = D3D11_USAGE_IMMUTABLE;
+		texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		const D3D11_SUBRESOURCE_DATA texture_data{ texel_data.data(), row_pitch, 0 };
+		const HRESULT hr = device->CreateTexture2D(&texture_desc, &texture_data, texture);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		return device->CreateShaderResourceView(*texture, nullptr, srv);
+	}
+}
@@ -0,0 +1,98 @@
+//
+// Created by ZZK on 2024/10/29.
+//
+
+#pragma once
+
+#include <effect.h>
+#include <list>
+
+namespace toy
+{
+	// A lut is fully determined by the cbuffer bytes it was computed from, its size and format, and the shader bytecode
+	struct LutCacheKey
+	{
+		uint64_t params_hash = 0;
+		std::array<uint8_t, 16> bytecode_digest{};
+		uint32_t width = 0;
+		uint32_t height = 0;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+
+		bool operator==(const LutCacheKey &other) const = default;
+	};
+
+	struct LutCacheKeyHasher
+	{
+		size_t operator()(const LutCacheKey &lut_cache_key) const;
+	};
+
+	struct LutCacheStats
+	{
+		uint64_t lookups = 0;
+		uint64_t memory_hits = 0;
+		uint64_t disk_hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t resident_bytes = 0;
+	};
+
+	// In memory lru of lut textures backed by an on-disk store, a hit in either skips the pass that computes the lut
+	struct LutCache
+	{
+	private:
+		struct CachedLut
+		{
+			LutCacheKey lut_cache_key{};
+			ComPtr<ID3D11Texture2D> texture = nullptr;
+			ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+			uint64_t size_in_bytes = 0;
+		};
+
+		ComPtr<ID3D11Device> device = nullptr;
+		std::string disk_directory = {};
+		uint32_t capacity = 0;
+		std::list<CachedLut> lru_luts = {};
+		std::unordered_map<LutCacheKey, std::list<CachedLut>::iterator, LutCacheKeyHasher> lut_index = {};
+		LutCacheStats cache_stats{};
+
+	public:
+		// An empty directory keeps the cache in memory only
+		LutCache(ID3D11Device *input_device, std::string_view directory, uint32_t max_resident_luts = 8);
+
+		LutCache(const LutCache &) = delete;
+		LutCache &operator=(const LutCache &) = delete;
+
+		static LutCacheKey make_key(std::span<const uint8_t> params_data, const EffectPrototype &effect_prototype, uint32_t width, uint32_t height, DXGI_FORMAT format);
+
+		// Memory first, then disk, nullptr on a miss
+		// Returned views hold a reference, a lut stays alive while bound even after the lru evicts it
+		ComPtr<ID3D11ShaderResourceView> query(const LutCacheKey &lut_cache_key);
+
+		// Keep a lut computed on the gpu, it is read back once to be written to disk
+		ComPtr<ID3D11ShaderResourceView> insert(ID3D11DeviceContext *device_context, const LutCacheKey &lut_cache_key, ID3D11Texture2D *texture, ID3D11ShaderResourceView *srv);
+
+		// Keep a lut computed on the cpu, rows are tightly packed
+		ComPtr<ID3D11ShaderResourceView> insert(const LutCacheKey &lut_cache_key, std::span<const uint8_t> texel_data);
+
+		// Dispatch the effect over width x height into a new texture only when no cached lut matches the params cbuffer
+		ComPtr<ID3D11ShaderResourceView> query_or_compute(ID3D11DeviceContext *device_context, ComputeEffect &compute_effect, std::string_view params_constant_buffer_name,
+														   std::string_view output_uav_name, uint32_t width, uint32_t height, DXGI_FORMAT format);
+
+		void clear();
+
+		[[nodiscard]] const LutCacheStats &get_stats() const;
+
+		void print() const;
+
+	private:
+		ComPtr<ID3D11ShaderResourceView> insert_resident(const LutCacheKey &lut_cache_key, ComPtr<ID3D11Texture2D> texture, ComPtr<ID3D11ShaderResourceView> srv);
+
+		[[nodiscard]] std::string query_file_path(const LutCacheKey &lut_cache_key) const;
+
+		bool write_to_disk(const LutCacheKey &lut_cache_key, std::span<const uint8_t> texel_data, uint32_t row_pitch) const;
+
+		bool read_from_disk(const LutCacheKey &lut_cache_key, std::vector<uint8_t> &texel_data) const;
+
+		HRESULT create_texture(const LutCacheKey &lut_cache_key, std::span<const uint8_t> texel_data, ID3D11Texture2D **texture, ID3D11ShaderResourceView **srv) const;
+	};
+}
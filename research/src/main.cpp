@@ -3,14 +3,83 @@
 //
 
 #include <effect.h>
+#include <compile_server.h>
+#include <mesh_baker.h>
+#include <null_device.h>
+#include <filesystem>
 
 constexpr std::string_view s_compiler_path = "D:/Dev/CMakeCook/DXC_Research/dxc/bin/x64/dxcompiler.dll";
 // constexpr std::wstring_view s_shader_path = L"D:/Dev/CMakeCook/DXC_Research/shaders/transmittance.hlsl";
 constexpr std::wstring_view s_shader_path = L"D:/Dev/CMakeCook/DXC_Research/shaders/geometry_vs.hlsl";
 constexpr std::wstring_view s_search_path = L"D:/Dev/CMakeCook/DXC_Research/shaders";
 
-int main()
+// Bakes an obj mesh into the vertex format the vertex shader reflects to, arguments after the output file are SEMANTIC=encoding hints
+static int bake_mesh(int argc, char **argv)
 {
+	static constexpr std::pair<std::string_view, toy::VertexAttributeEncoding> s_encoding_names[] = {
+		{ "float32", toy::VertexAttributeEncoding::Float32 },
+		{ "float16", toy::VertexAttributeEncoding::Float16 },
+		{ "unorm10", toy::VertexAttributeEncoding::BiasedUnorm10 },
+		{ "snorm8", toy::VertexAttributeEncoding::Snorm8 },
+		{ "octahedral16", toy::VertexAttributeEncoding::Octahedral16 }
+	};
+
+	toy::GraphicsPipelineStateObject pipeline_state_object{};
+	for (int arg_index = 5; arg_index < argc; ++arg_index)
+	{
+		const std::string_view hint = argv[arg_index];
+		const size_t separator = hint.find('=');
+		auto encoding_iter = std::ranges::find_if(s_encoding_names, [&](auto &&encoding_name)
+		{
+			return separator != std::string_view::npos && encoding_name.first == hint.substr(separator + 1);
+		});
+		if (encoding_iter == std::end(s_encoding_names)) {
+			std::cout << std::format("Unknown compression hint {}, expected SEMANTIC=float32|float16|unorm10|snorm8|octahedral16\n", hint);
+			return 1;
+		}
+		pipeline_state_object.vertex_layout.compressions.push_back({ std::string(hint.substr(0, separator)), encoding_iter->second });
+	}
+
+	toy::ObjMesh obj_mesh{};
+	if (!toy::ObjMesh::load(argv[2], obj_mesh)) {
+		return 1;
+	}
+	// The vertex format only needs reflection, so a null device stands in for the gpu
+	auto null_device = toy::NullDevice::create();
+	const auto vs_path = std::filesystem::path(argv[3]).wstring();
+	pipeline_state_object.vs_path = vs_path;
+	auto prototype = toy::EffectPrototype::create(pipeline_state_object, null_device.Get());
+	if (prototype == nullptr) {
+		return 1;
+	}
+
+	toy::MeshBakeStats bake_stats{};
+	const auto file_data = toy::MeshBaker::bake(obj_mesh.get_raw_mesh(), prototype->get_vertex_format(), &bake_stats);
+	if (file_data.empty() || !toy::MeshBaker::save(file_data, argv[4])) {
+		return 1;
+	}
+	toy::MeshBaker::print(bake_stats);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	// DXCResearch --compile-server <socket path> [cache directory] [symbol directory]
+	if (argc > 2 && std::string_view(argv[1]) == "--compile-server") {
+		toy::CompileServer compile_server{ { argv[2], 0, argc > 3 ? argv[3] : "", argc > 4 ? argv[4] : "" } };
+		if (!compile_server.start()) {
+			return 1;
+		}
+		compile_server.run();
+		return 0;
+	}
+
+	// DXCResearch --bake-mesh <obj file> <vertex shader> <output file> [SEMANTIC=encoding ...]
+	if (argc > 4 && std::string_view(argv[1]) == "--bake-mesh") {
+		return bake_mesh(argc, argv);
+	}
+
+#if defined(_WIN32)
 	using DxcCreateInstanceFn = decltype(&::DxcCreateInstance);
 	const HMODULE compiler_hmodule = LoadLibraryA(s_compiler_path.data());
 	auto dxc_create_instance_pfn = reinterpret_cast<DxcCreateInstanceFn>(GetProcAddress(compiler_hmodule, "DxcCreateInstance"));
@@ -122,4 +191,10 @@ int main()
 
 
 	std::cout << std::format("Finished.\n");
+#else
+	// The reflection demo loads dxcompiler.dll from the paths above, elsewhere only the compile server and the mesh baker run
+	std::cout << std::format("Usage: {} --compile-server <socket path> [cache directory] [symbol directory]\n", argv[0]);
+	std::cout << std::format("       {} --bake-mesh <obj file> <vertex shader> <output file> [SEMANTIC=encoding ...]\n", argv[0]);
+	return 1;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,417 @@
+//
+// Created by ZZK on 2024/11/01.
+//
+
+#include <mesh_baker.h>
+#include <algorithm>
+#include <cfloat>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace toy
+{
+	static constexpr uint32_t s_mesh_file_magic = 0x48534d54; // "TMSH"
+	static constexpr uint32_t s_mesh_file_version = 1;
+	static constexpr uint64_t s_mesh_file_alignment = 16;
+
+	static uint64_t align_mesh_offset(uint64_t offset)
+	{
+		return (offset + s_mesh_file_alignment - 1) / s_mesh_file_alignment * s_mesh_file_alignment;
+	}
+
+	// Obj mesh
+	static bool resolve_obj_index(int64_t obj_index, size_t element_count, uint32_t &index)
+	{
+		// One based, negative indices count back from the last element read so far
+		const int64_t resolved = obj_index > 0 ? obj_index - 1 : static_cast<int64_t>(element_count) + obj_index;
+		if (obj_index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(element_count)) {
+			return false;
+		}
+		index = static_cast<uint32_t>(resolved);
+		return true;
+	}
+
+	bool ObjMesh::parse(std::string_view obj_source, ObjMesh &obj_mesh)
+	{
+		static constexpr uint32_t s_missing = UINT32_MAX;
+		std::vector<float> source_positions{};
+		std::vector<float> source_texcoords{};
+		std::vector<float> source_normals{};
+		// Position, texcoord and normal of a corner, corners used by several faces share their vertex
+		std::vector<std::array<uint32_t, 3>> corners{};
+		std::map<std::array<uint32_t, 3>, uint32_t> corner_vertices{};
+		std::vector<uint32_t> face_vertices{};
+
+		obj_mesh = {};
+		std::istringstream source_stream{ std::string(obj_source) };
+		std::string line{};
+		uint32_t line_number = 0;
+		while (std::getline(source_stream, line))
+		{
+			++line_number;
+			std::istringstream line_stream{ line };
+			std::string keyword{};
+			line_stream >> keyword;
+			if (keyword == "v" || keyword == "vn") {
+				float value[3]{};
+				line_stream >> value[0] >> value[1] >> value[2];
+				auto &&elements = keyword == "v" ? source_positions : source_normals;
+				elements.insert(elements.end(), value, value + 3);
+			} else if (keyword == "vt") {
+				float value[2]{};
+				line_stream >> value[0] >> value[1];
+				source_texcoords.insert(source_texcoords.end(), value, value + 2);
+			} else if (keyword == "f") {
+				face_vertices.clear();
+				std::string corner_token{};
+				while (line_stream >> corner_token)
+				{
+					// v, v/vt, v//vn or v/vt/vn
+					std::array<uint32_t, 3> corner = { s_missing, s_missing, s_missing };
+					const std::array<size_t, 3> element_counts = { source_positions.size() / 3, source_texcoords.size() / 2, source_normals.size() / 3 };
+					size_t token_begin = 0;
+					for (uint32_t element = 0; element < 3 && token_begin <= corner_token.size(); ++element)
+					{
+						const size_t token_end = (std::min)(corner_token.find('/', token_begin), corner_token.size());
+						if (token_end > token_begin) {
+							int64_t obj_index = 0;
+							std::from_chars(corner_token.data() + token_begin, corner_token.data() + token_end, obj_index);
+							if (!resolve_obj_index(obj_index, element_counts[element], corner[element])) {
+								std::cout << std::format("Obj face on line {} references a missing element {}\n", line_number, corner_token);
+								return false;
+							}
+						}
+						token_begin = token_end + 1;
+					}
+					if (corner[0] == s_missing) {
+						std::cout << std::format("Obj face on line {} has a corner without position\n", line_number);
+						return false;
+					}
+					auto [corner_iter, is_inserted] = corner_vertices.try_emplace(corner, static_cast<uint32_t>(corners.size()));
+					if (is_inserted) {
+						corners.emplace_back(corner);
+					}
+					face_vertices.emplace_back(corner_iter->second);
+				}
+				for (size_t corner_index = 2; corner_index < face_vertices.size(); ++corner_index)
+				{
+					obj_mesh.indices.insert(obj_mesh.indices.end(), { face_vertices[0], face_vertices[corner_index - 1], face_vertices[corner_index] });
+				}
+			}
+		}
+
+		// Texcoords and normals are kept when the source has any, corners without them read zero
+		obj_mesh.vertex_count = static_cast<uint32_t>(corners.size());
+		obj_mesh.positions.resize(corners.size() * 3);
+		obj_mesh.texcoords.resize(source_texcoords.empty() ? 0 : corners.size() * 2);
+		obj_mesh.normals.resize(source_normals.empty() ? 0 : corners.size() * 3);
+		for (size_t vertex = 0; vertex < corners.size(); ++vertex)
+		{
+			auto &&corner = corners[vertex];
+			std::memcpy(obj_mesh.positions.data() + vertex * 3, source_positions.data() + static_cast<size_t>(corner[0]) * 3, 3 * sizeof(float));
+			if (!obj_mesh.texcoords.empty() && corner[1] != s_missing) {
+				std::memcpy(obj_mesh.texcoords.data() + vertex * 2, source_texcoords.data() + static_cast<size_t>(corner[1]) * 2, 2 * sizeof(float));
+			}
+			if (!obj_mesh.normals.empty() && corner[2] != s_missing) {
+				std::memcpy(obj_mesh.normals.data() + vertex * 3, source_normals.data() + static_cast<size_t>(corner[2]) * 3, 3 * sizeof(float));
+			}
+		}
+		return true;
+	}
+
+	bool ObjMesh::load(std::string_view file_path, ObjMesh &obj_mesh)
+	{
+		std::ifstream obj_file{ std::string(file_path) };
+		if (!obj_file) {
+			std::cout << std::format("Failed to open obj mesh {}\n", file_path);
+			return false;
+		}
+		std::ostringstream obj_source{};
+		obj_source << obj_file.rdbuf();
+		return parse(obj_source.str(), obj_mesh);
+	}
+
+	RawMesh ObjMesh::get_raw_mesh() const
+	{
+		RawMesh raw_mesh{};
+		raw_mesh.attributes.push_back({ "POSITION", 0, positions.data(), 3, 0 });
+		if (!texcoords.empty()) {
+			raw_mesh.attributes.push_back({ "TEXCOORD", 0, texcoords.data(), 2, 0 });
+		}
+		if (!normals.empty()) {
+			raw_mesh.attributes.push_back({ "NORMAL", 0, normals.data(), 3, 0 });
+		}
+		raw_mesh.indices = indices;
+		raw_mesh.vertex_count = vertex_count;
+		return raw_mesh;
+	}
+
+	// Mesh file view
+	bool MeshFileView::parse(std::span<const uint8_t> file_data, MeshFileView &mesh_file_view)
+	{
+		if (file_data.size() < sizeof(MeshFileHeader)) {
+			return false;
+		}
+		auto header = reinterpret_cast<const MeshFileHeader *>(file_data.data());
+		if (header->magic != s_mesh_file_magic || header->version != s_mesh_file_version || header->stream_count > s_mesh_file_max_streams) {
+			return false;
+		}
+		auto is_in_file = [&file_data](uint64_t offset, uint64_t size_in_bytes)
+		{
+			return offset <= file_data.size() && size_in_bytes <= file_data.size() - offset;
+		};
+		const uint64_t attribute_table_size = static_cast<uint64_t>(header->attribute_count) * sizeof(MeshFileAttribute);
+		if (!is_in_file(header->attribute_offset, attribute_table_size) || !is_in_file(header->index_offset, header->index_size_in_bytes)) {
+			return false;
+		}
+
+		mesh_file_view = {};
+		mesh_file_view.header = header;
+		mesh_file_view.attributes = { reinterpret_cast<const MeshFileAttribute *>(file_data.data() + header->attribute_offset), header->attribute_count };
+		mesh_file_view.index_data = file_data.subspan(header->index_offset, header->index_size_in_bytes);
+		for (uint32_t stream_index = 0; stream_index < header->stream_count; ++stream_index)
+		{
+			auto &&stream = header->streams[stream_index];
+			if (!is_in_file(stream.offset, stream.size_in_bytes)) {
+				return false;
+			}
+			mesh_file_view.stream_data[stream_index] = file_data.subspan(stream.offset, stream.size_in_bytes);
+		}
+		return true;
+	}
+
+	bool MeshFileView::is_compatible(const VertexFormat &vertex_format) const
+	{
+		if (header == nullptr || attributes.size() != vertex_format.attributes.size() || header->stream_count != vertex_format.get_stream_count()) {
+			return false;
+		}
+		for (uint32_t stream_index = 0; stream_index < header->stream_count; ++stream_index)
+		{
+			if (header->streams[stream_index].stride_in_bytes != vertex_format.stream_strides[stream_index]) {
+				return false;
+			}
+		}
+		for (auto &&file_attribute : attributes)
+		{
+			auto vertex_attribute = vertex_format.query_attribute(file_attribute.semantic_name, file_attribute.semantic_index);
+			if (vertex_attribute == nullptr || vertex_attribute->format != static_cast<DXGI_FORMAT>(file_attribute.format) ||
+				vertex_attribute->input_slot != file_attribute.input_slot || vertex_attribute->aligned_byte_offset != file_attribute.aligned_byte_offset) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	HRESULT MeshFileView::create_buffers(ID3D11Device *device, std::vector<ComPtr<ID3D11Buffer>> &vertex_buffers, ComPtr<ID3D11Buffer> &index_buffer) const
+	{
+		if (header == nullptr) {
+			return E_INVALIDARG;
+		}
+		auto create_immutable_buffer = [device](std::span<const uint8_t> data, uint32_t bind_flags, ID3D11Buffer **buffer)
+		{
+			D3D11_BUFFER_DESC buffer_desc{};
+			buffer_desc.Usage = D3D11_USAGE_IMMUTABLE;
+			buffer_desc.BindFlags = bind_flags;
+			buffer_desc.ByteWidth = static_cast<uint32_t>(data.size());
+			const D3D11_SUBRESOURCE_DATA initial_data{ data.data(), 0, 0 };
+			return device->CreateBuffer(&buffer_desc, &initial_data, buffer);
+		};
+
+		vertex_buffers.clear();
+		for (uint32_t stream_index = 0; stream_index < header->stream_count; ++stream_index)
+		{
+			if (header->streams[stream_index].input_slot_class != D3D11_INPUT_PER_VERTEX_DATA) {
+				break;
+			}
+			ComPtr<ID3D11Buffer> vertex_buffer = nullptr;
+			const HRESULT hr = create_immutable_buffer(stream_data[stream_index], D3D11_BIND_VERTEX_BUFFER, vertex_buffer.GetAddressOf());
+			if (FAILED(hr)) {
+				std::cout << std::format("Failed to create vertex buffer of stream {}\n", stream_index);
+				return hr;
+			}
+			vertex_buffers.emplace_back(std::move(vertex_buffer));
+		}
+		const HRESULT hr = create_immutable_buffer(index_data, D3D11_BIND_INDEX_BUFFER, index_buffer.ReleaseAndGetAddressOf());
+		if (FAILED(hr)) {
+			std::cout << std::format("Failed to create index buffer\n");
+		}
+		return hr;
+	}
+
+	// Mesh baker
+	std::vector<uint8_t> MeshBaker::bake(const RawMesh &raw_mesh, const VertexFormat &vertex_format, MeshBakeStats *bake_stats, float overdraw_threshold)
+	{
+		if (vertex_format.get_stream_count() > s_mesh_file_max_streams) {
+			std::cout << std::format("Vertex format has {} streams, mesh files hold at most {}\n", vertex_format.get_stream_count(), s_mesh_file_max_streams);
+			return {};
+		}
+		for (auto index : raw_mesh.indices)
+		{
+			if (index >= raw_mesh.vertex_count) {
+				std::cout << std::format("Index {} is out of range of {} vertices\n", index, raw_mesh.vertex_count);
+				return {};
+			}
+		}
+		auto position_attribute = std::ranges::find_if(raw_mesh.attributes, [&raw_mesh](const VertexSourceAttribute &source_attribute)
+		{
+			return source_attribute.semantic_name == raw_mesh.position_semantic && source_attribute.semantic_index == 0;
+		});
+		if (position_attribute == raw_mesh.attributes.end() || position_attribute->component_count < 3) {
+			std::cout << std::format("Mesh has no float3 {} attribute\n", raw_mesh.position_semantic);
+			return {};
+		}
+		const uint32_t position_stride = position_attribute->stride_in_bytes != 0 ? position_attribute->stride_in_bytes : position_attribute->component_count * 4;
+
+		// Triangle order first, vertex order last since it renumbers by the final triangle order
+		std::vector<uint32_t> indices(raw_mesh.indices.begin(), raw_mesh.indices.begin() + raw_mesh.indices.size() / 3 * 3);
+		MeshBakeStats stats{};
+		stats.before = MeshOptimizer::analyze_vertex_cache(indices, raw_mesh.vertex_count);
+		MeshOptimizer::optimize_vertex_cache(indices, raw_mesh.vertex_count);
+		MeshOptimizer::optimize_overdraw(indices, static_cast<const float *>(position_attribute->data), position_stride, raw_mesh.vertex_count, overdraw_threshold);
+		std::vector<uint32_t> remap{};
+		const uint32_t vertex_count = MeshOptimizer::optimize_vertex_fetch(indices, raw_mesh.vertex_count, remap);
+		stats.after = MeshOptimizer::analyze_vertex_cache(indices, vertex_count);
+		stats.vertices_dropped = raw_mesh.vertex_count - vertex_count;
+
+		// Gather every source attribute in the new vertex order, then pack them into the format's streams
+		std::vector<std::vector<uint8_t>> remapped_data(raw_mesh.attributes.size());
+		std::vector<VertexSourceAttribute> remapped_attributes(raw_mesh.attributes.begin(), raw_mesh.attributes.end());
+		float bounds_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float bounds_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t attribute_index = 0; attribute_index < raw_mesh.attributes.size(); ++attribute_index)
+		{
+			auto &&source_attribute = raw_mesh.attributes[attribute_index];
+			if (source_attribute.data == nullptr) {
+				continue;
+			}
+			const uint32_t element_size = source_attribute.component_count * 4;
+			const uint32_t source_stride = source_attribute.stride_in_bytes != 0 ? source_attribute.stride_in_bytes : element_size;
+			auto &&attribute_data = remapped_data[attribute_index];
+			attribute_data.resize(static_cast<size_t>(element_size) * vertex_count);
+			for (uint32_t vertex = 0; vertex < raw_mesh.vertex_count; ++vertex)
+			{
+				if (remap[vertex] != UINT32_MAX) {
+					std::memcpy(attribute_data.data() + static_cast<size_t>(remap[vertex]) * element_size,
+								static_cast<const uint8_t *>(source_attribute.data) + static_cast<size_t>(vertex) * source_stride, element_size);
+				}
+			}
+			remapped_attributes[attribute_index].data = attribute_data.data();
+			remapped_attributes[attribute_index].stride_in_bytes = element_size;
+		}
+		auto remapped_positions = static_cast<const float *>(remapped_attributes[position_attribute - raw_mesh.attributes.begin()].data);
+		for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				bounds_min[axis] = (std::min)(bounds_min[axis], remapped_positions[vertex * position_attribute->component_count + axis]);
+				bounds_max[axis] = (std::max)(bounds_max[axis], remapped_positions[vertex * position_attribute->component_count + axis]);
+			}
+		}
+		std::vector<std::vector<uint8_t>> streams{};
+		if (!VertexPacker::pack(vertex_format, remapped_attributes, vertex_count, streams)) {
+			return {};
+		}
+
+		// Header, attribute table, indices, streams
+		MeshFileHeader header{};
+		header.magic = s_mesh_file_magic;
+		header.version = s_mesh_file_version;
+		header.vertex_count = vertex_count;
+		header.index_count = static_cast<uint32_t>(indices.size());
+		header.index_format = vertex_count <= 65536 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		header.stream_count = vertex_format.get_stream_count();
+		header.attribute_count = static_cast<uint32_t>(vertex_format.attributes.size());
+		header.attribute_offset = align_mesh_offset(sizeof(MeshFileHeader));
+		header.index_offset = align_mesh_offset(header.attribute_offset + header.attribute_count * sizeof(MeshFileAttribute));
+		header.index_size_in_bytes = static_cast<uint64_t>(indices.size()) * (header.index_format == DXGI_FORMAT_R16_UINT ? 2 : 4);
+		std::memcpy(header.bounds_min, bounds_min, sizeof(bounds_min));
+		std::memcpy(header.bounds_max, bounds_max, sizeof(bounds_max));
+		uint64_t file_size = align_mesh_offset(header.index_offset + header.index_size_in_bytes);
+		for (uint32_t stream_index = 0; stream_index < header.stream_count; ++stream_index)
+		{
+			auto &&stream = header.streams[stream_index];
+			stream.offset = file_size;
+			stream.size_in_bytes = streams[stream_index].size();
+			stream.stride_in_bytes = vertex_format.stream_strides[stream_index];
+			stream.input_slot_class = vertex_format.stream_classes[stream_index];
+			file_size = align_mesh_offset(stream.offset + stream.size_in_bytes);
+		}
+
+		std::vector<uint8_t> file_data(file_size, 0);
+		std::memcpy(file_data.data(), &header, sizeof(header));
+		auto file_attributes = reinterpret_cast<MeshFileAttribute *>(file_data.data() + header.attribute_offset);
+		for (uint32_t attribute_index = 0; attribute_index < header.attribute_count; ++attribute_index)
+		{
+			auto &&vertex_attribute = vertex_format.attributes[attribute_index];
+			MeshFileAttribute file_attribute{};
+			std::memcpy(file_attribute.semantic_name, vertex_attribute.semantic_name.data(), (std::min)(vertex_attribute.semantic_name.size(), sizeof(file_attribute.semantic_name) - 1));
+			file_attribute.semantic_index = vertex_attribute.semantic_index;
+			file_attribute.format = vertex_attribute.format;
+			file_attribute.input_slot = vertex_attribute.input_slot;
+			file_attribute.aligned_byte_offset = vertex_attribute.aligned_byte_offset;
+			file_attribute.encoding = static_cast<uint32_t>(vertex_attribute.encoding);
+			file_attribute.input_slot_class = vertex_attribute.input_slot_class;
+			file_attribute.instance_step_rate = vertex_attribute.instance_step_rate;
+			std::memcpy(file_attributes + attribute_index, &file_attribute, sizeof(file_attribute));
+		}
+		auto index_destination = file_data.data() + header.index_offset;
+		if (header.index_format == DXGI_FORMAT_R16_UINT) {
+			for (size_t index = 0; index < indices.size(); ++index)
+			{
+				const auto short_index = static_cast<uint16_t>(indices[index]);
+				std::memcpy(index_destination + index * 2, &short_index, 2);
+			}
+		} else {
+			std::memcpy(index_destination, indices.data(), header.index_size_in_bytes);
+		}
+		for (uint32_t stream_index = 0; stream_index < header.stream_count; ++stream_index)
+		{
+			if (!streams[stream_index].empty()) {
+				std::memcpy(file_data.data() + header.streams[stream_index].offset, streams[stream_index].data(), streams[stream_index].size());
+			}
+		}
+
+		for (uint32_t stream_index = 0; stream_index < header.stream_count; ++stream_index)
+		{
+			stats.vertex_bytes += header.streams[stream_index].size_in_bytes;
+		}
+		stats.index_bytes = header.index_size_in_bytes;
+		if (bake_stats != nullptr) {
+			*bake_stats = stats;
+		}
+		return file_data;
+	}
+
+	bool MeshBaker::save(std::span<const uint8_t> file_data, std::string_view file_path)
+	{
+		std::ofstream mesh_file{ std::string(file_path), std::ios::binary | std::ios::trunc };
+		if (!mesh_file) {
+			std::cout << std::format("Failed to open mesh {} for writing\n", file_path);
+			return false;
+		}
+		mesh_file.write(reinterpret_cast<const char *>(file_data.data()), static_cast<std::streamsize>(file_data.size()));
+		return static_cast<bool>(mesh_file);
+	}
+
+	std::vector<uint8_t> MeshBaker::load(std::string_view file_path)
+	{
+		std::ifstream mesh_file{ std::string(file_path), std::ios::binary | std::ios::ate };
+		if (!mesh_file) {
+			return {};
+		}
+		std::vector<uint8_t> file_data(static_cast<size_t>(mesh_file.tellg()));
+		mesh_file.seekg(0);
+		mesh_file.read(reinterpret_cast<char *>(file_data.data()), static_cast<std::streamsize>(file_data.size()));
+		return mesh_file ? file_data : std::vector<uint8_t>{};
+	}
+
+	void MeshBaker::print(const MeshBakeStats &bake_stats)
+	{
+		std::cout << std::format("Mesh bake: {} triangles, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} unused vertices dropped, {} vertex bytes, {} index bytes\n",
+								bake_stats.after.triangle_count, bake_stats.before.acmr, bake_stats.after.acmr, bake_stats.before.atvr, bake_stats.after.atvr,
+								bake_stats.vertices_dropped, bake_stats.vertex_bytes, bake_stats.index_bytes);
+	}
+}
@@ -0,0 +1,125 @@
+//
+// Created by ZZK on 2024/11/01.
+//
+
+#pragma once
+
+#include <mesh_optimizer.h>
+#include <vertex_packer.h>
+
+namespace toy
+{
+	// Source mesh, attributes reference caller owned arrays, indices form a triangle list
+	struct RawMesh
+	{
+		std::vector<VertexSourceAttribute> attributes = {};
+		std::span<const uint32_t> indices = {};
+		uint32_t vertex_count = 0;
+		std::string_view position_semantic = "POSITION";
+	};
+
+	// Wavefront obj source, one vertex per distinct position/texcoord/normal corner, polygons are fanned into triangles
+	struct ObjMesh
+	{
+		std::vector<float> positions = {};
+		std::vector<float> texcoords = {};
+		std::vector<float> normals = {};
+		std::vector<uint32_t> indices = {};
+		uint32_t vertex_count = 0;
+
+		// False when a face references an element the source doesn't have
+		static bool parse(std::string_view obj_source, ObjMesh &obj_mesh);
+
+		static bool load(std::string_view file_path, ObjMesh &obj_mesh);
+
+		// POSITION, plus TEXCOORD and NORMAL when the source has them, referencing this mesh
+		[[nodiscard]] RawMesh get_raw_mesh() const;
+	};
+
+	struct MeshBakeStats
+	{
+		VertexCacheStats before{};
+		VertexCacheStats after{};
+		uint32_t vertices_dropped = 0;
+		uint64_t vertex_bytes = 0;
+		uint64_t index_bytes = 0;
+	};
+
+	static constexpr uint32_t s_mesh_file_max_streams = 8;
+
+	// File layout, every block starts on a 16 byte boundary so a mapped file is used in place
+	// | header | attribute table | indices | stream 0 | stream 1 | ...
+	struct MeshFileStream
+	{
+		uint64_t offset = 0;
+		uint64_t size_in_bytes = 0;
+		uint32_t stride_in_bytes = 0;
+		uint32_t input_slot_class = D3D11_INPUT_PER_VERTEX_DATA;
+	};
+
+	struct MeshFileHeader
+	{
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		uint32_t index_format = DXGI_FORMAT_R32_UINT;
+		uint32_t stream_count = 0;
+		uint32_t attribute_count = 0;
+		uint32_t padding = 0;
+		uint64_t attribute_offset = 0;
+		uint64_t index_offset = 0;
+		uint64_t index_size_in_bytes = 0;
+		float bounds_min[3] = { 0.0f, 0.0f, 0.0f };
+		float bounds_max[3] = { 0.0f, 0.0f, 0.0f };
+		MeshFileStream streams[s_mesh_file_max_streams]{};
+	};
+
+	struct MeshFileAttribute
+	{
+		char semantic_name[32]{};
+		uint32_t semantic_index = 0;
+		uint32_t format = DXGI_FORMAT_UNKNOWN;
+		uint32_t input_slot = 0;
+		uint32_t aligned_byte_offset = 0;
+		uint32_t encoding = 0;
+		uint32_t input_slot_class = D3D11_INPUT_PER_VERTEX_DATA;
+		uint32_t instance_step_rate = 0;
+		uint32_t padding = 0;
+	};
+
+	// Parsed mesh file, spans point into the file bytes, nothing is copied
+	struct MeshFileView
+	{
+		const MeshFileHeader *header = nullptr;
+		std::span<const MeshFileAttribute> attributes = {};
+		std::span<const uint8_t> index_data = {};
+		std::array<std::span<const uint8_t>, s_mesh_file_max_streams> stream_data = {};
+
+		// False when the bytes aren't a complete mesh file of this version
+		static bool parse(std::span<const uint8_t> file_data, MeshFileView &mesh_file_view);
+
+		// Same attributes at the same slots, offsets and formats as the format the effect reflected
+		[[nodiscard]] bool is_compatible(const VertexFormat &vertex_format) const;
+
+		// Immutable buffers initialized straight from the file bytes, one vertex buffer per per vertex stream
+		HRESULT create_buffers(ID3D11Device *device, std::vector<ComPtr<ID3D11Buffer>> &vertex_buffers, ComPtr<ID3D11Buffer> &index_buffer) const;
+	};
+
+	// Offline mesh processing into the exact vertex layout of a reflected VertexFormat
+	// Triangles are ordered for the post-transform cache, then clusters for overdraw, then vertices for fetch locality,
+	// and the vertices are packed with the format's encodings. Indices are 16 bit whenever the vertex count allows it
+	struct MeshBaker
+	{
+	public:
+		// Returns the file bytes, empty on failure
+		static std::vector<uint8_t> bake(const RawMesh &raw_mesh, const VertexFormat &vertex_format, MeshBakeStats *bake_stats = nullptr,
+										 float overdraw_threshold = 1.05f);
+
+		static bool save(std::span<const uint8_t> file_data, std::string_view file_path);
+
+		static std::vector<uint8_t> load(std::string_view file_path);
+
+		static void print(const MeshBakeStats &bake_stats);
+	};
+}
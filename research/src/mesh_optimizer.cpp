@@ -0,0 +1,371 @@
+//
+// Created by ZZK on 2024/11/01.
+//
+
+#include <mesh_optimizer.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace toy
+{
+	// Forsyth scoring, see "Linear-Speed Vertex Cache Optimisation"
+	static constexpr float s_cache_decay_power = 1.5f;
+	static constexpr float s_last_triangle_score = 0.75f;
+	static constexpr float s_valence_boost_scale = 2.0f;
+	static constexpr float s_valence_boost_power = 0.5f;
+	static constexpr uint32_t s_valence_table_size = 32;
+
+	struct ForsythScoreTable
+	{
+		std::array<float, MeshOptimizer::ordering_cache_size> cache_scores{};
+		std::array<float, s_valence_table_size> valence_scores{};
+
+		ForsythScoreTable()
+		{
+			for (uint32_t cache_position = 0; cache_position < MeshOptimizer::ordering_cache_size; ++cache_position)
+			{
+				if (cache_position < 3) {
+					// The last triangle's vertices get a fixed score so the next one can't simply reuse the same edge
+					cache_scores[cache_position] = s_last_triangle_score;
+				} else {
+					const float scaler = 1.0f / static_cast<float>(MeshOptimizer::ordering_cache_size - 3);
+					cache_scores[cache_position] = std::pow(1.0f - static_cast<float>(cache_position - 3) * scaler, s_cache_decay_power);
+				}
+			}
+			for (uint32_t valence = 1; valence < s_valence_table_size; ++valence)
+			{
+				valence_scores[valence] = s_valence_boost_scale * std::pow(static_cast<float>(valence), -s_valence_boost_power);
+			}
+		}
+
+		[[nodiscard]] float query_vertex_score(int32_t cache_position, uint32_t remaining_triangles) const
+		{
+			if (remaining_triangles == 0) {
+				return -1.0f;
+			}
+			float score = cache_position >= 0 && cache_position < static_cast<int32_t>(MeshOptimizer::ordering_cache_size) ? cache_scores[cache_position] : 0.0f;
+			score += remaining_triangles < s_valence_table_size ? valence_scores[remaining_triangles]
+															   : s_valence_boost_scale * std::pow(static_cast<float>(remaining_triangles), -s_valence_boost_power);
+			return score;
+		}
+	};
+
+	// Triangles of every vertex in one array, offsets[v] .. offsets[v] + counts[v]
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> offsets = {};
+		std::vector<uint32_t> counts = {};
+		std::vector<uint32_t> triangles = {};
+
+		TriangleAdjacency(std::span<const uint32_t> indices, uint32_t vertex_count)
+		{
+			offsets.assign(vertex_count + 1, 0);
+			counts.assign(vertex_count, 0);
+			for (auto index : indices)
+			{
+				++counts[index];
+			}
+			for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+			{
+				offsets[vertex + 1] = offsets[vertex] + counts[vertex];
+			}
+			triangles.resize(indices.size());
+			std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+			for (uint32_t index = 0; index < indices.size(); ++index)
+			{
+				triangles[cursors[indices[index]]++] = index / 3;
+			}
+		}
+
+		void remove(uint32_t vertex, uint32_t triangle)
+		{
+			auto begin = triangles.begin() + offsets[vertex];
+			auto end = begin + counts[vertex];
+			auto iter = std::find(begin, end, triangle);
+			if (iter != end) {
+				*iter = *(end - 1);
+				--counts[vertex];
+			}
+		}
+	};
+
+	void MeshOptimizer::optimize_vertex_cache(std::span<uint32_t> indices, uint32_t vertex_count)
+	{
+		const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+		if (triangle_count == 0) {
+			return;
+		}
+		static const ForsythScoreTable score_table{};
+		const std::vector<uint32_t> source_indices(indices.begin(), indices.begin() + triangle_count * 3);
+		TriangleAdjacency adjacency{ source_indices, vertex_count };
+
+		std::vector<float> vertex_scores(vertex_count, 0.0f);
+		for (uint32_t vertex = 0; vertex < vertex_count; ++vertex)
+		{
+			vertex_scores[vertex] = score_table.query_vertex_score(-1, adjacency.counts[vertex]);
+		}
+		std::vector<float> triangle_scores(triangle_count, 0.0f);
+		std::vector<uint8_t> is_emitted(triangle_count, 0);
+		for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+		{
+			triangle_scores[triangle] = vertex_scores[source_indices[triangle * 3]] + vertex_scores[source_indices[triangle * 3 + 1]] +
+										vertex_scores[source_indices[triangle * 3 + 2]];
+		}
+
+		// The cache holds three extra entries for the vertices pushed out by the newest triangle
+		std::vector<uint32_t> cache{};
+		std::vector<uint32_t> next_cache{};
+		cache.reserve(ordering_cache_size + 3);
+		next_cache.reserve(ordering_cache_size + 3);
+		uint32_t best_triangle = static_cast<uint32_t>(std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin());
+		uint32_t input_cursor = 0;
+		for (uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+		{
+			if (best_triangle == UINT32_MAX) {
+				// Nothing in the cache has triangles left, continue with the next triangle in input order
+				while (is_emitted[input_cursor] != 0)
+				{
+					++input_cursor;
+				}
+				best_triangle = input_cursor;
+			}
+
+			const uint32_t *triangle_vertices = &source_indices[best_triangle * 3];
+			std::memcpy(&indices[emitted_count * 3], triangle_vertices, 3 * sizeof(uint32_t));
+			is_emitted[best_triangle] = 1;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				adjacency.remove(triangle_vertices[corner], best_triangle);
+			}
+
+			next_cache.assign(triangle_vertices, triangle_vertices + 3);
+			for (auto vertex : cache)
+			{
+				if (vertex != triangle_vertices[0] && vertex != triangle_vertices[1] && vertex != triangle_vertices[2]) {
+					next_cache.emplace_back(vertex);
+				}
+			}
+			std::swap(cache, next_cache);
+
+			// Refresh the scores of every vertex whose cache position changed and of their remaining triangles
+			for (uint32_t cache_position = 0; cache_position < cache.size(); ++cache_position)
+			{
+				const uint32_t vertex = cache[cache_position];
+				const int32_t new_position = cache_position < ordering_cache_size ? static_cast<int32_t>(cache_position) : -1;
+				const float score = score_table.query_vertex_score(new_position, adjacency.counts[vertex]);
+				const float score_delta = score - vertex_scores[vertex];
+				vertex_scores[vertex] = score;
+				const uint32_t *vertex_triangles = &adjacency.triangles[adjacency.offsets[vertex]];
+				for (uint32_t triangle_index = 0; triangle_index < adjacency.counts[vertex]; ++triangle_index)
+				{
+					triangle_scores[vertex_triangles[triangle_index]] += score_delta;
+				}
+			}
+			if (cache.size() > ordering_cache_size) {
+				cache.resize(ordering_cache_size);
+			}
+
+			// The next triangle is the best one touching the cache, only these scores can have changed
+			best_triangle = UINT32_MAX;
+			float best_score = -1.0f;
+			for (auto vertex : cache)
+			{
+				const uint32_t *vertex_triangles = &adjacency.triangles[adjacency.offsets[vertex]];
+				for (uint32_t triangle_index = 0; triangle_index < adjacency.counts[vertex]; ++triangle_index)
+				{
+					const uint32_t triangle = vertex_triangles[triangle_index];
+					if (triangle_scores[triangle] > best_score) {
+						best_score = triangle_scores[triangle];
+						best_triangle = triangle;
+					}
+				}
+			}
+		}
+	}
+
+	void MeshOptimizer::optimize_overdraw(std::span<uint32_t> indices, const float *positions, uint32_t position_stride_in_bytes, uint32_t vertex_count,
+										  float threshold)
+	{
+		const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+		if (triangle_count == 0 || positions == nullptr) {
+			return;
+		}
+		auto query_position = [positions, position_stride_in_bytes](uint32_t vertex)
+		{
+			return reinterpret_cast<const float *>(reinterpret_cast<const uint8_t *>(positions) + static_cast<size_t>(vertex) * position_stride_in_bytes);
+		};
+
+		// FIFO cache simulation shared by both boundary passes, a zero timestamp marks a reset cache
+		std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+		uint32_t timestamp = analysis_cache_size + 1;
+		auto count_misses = [&](uint32_t triangle)
+		{
+			uint32_t misses = 0;
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				if (timestamp - cache_timestamps[vertex] > analysis_cache_size) {
+					cache_timestamps[vertex] = timestamp++;
+					++misses;
+				}
+			}
+			return misses;
+		};
+		auto reset_cache = [&]()
+		{
+			timestamp += analysis_cache_size + 1;
+		};
+
+		// Hard boundaries, triangles missing on all three vertices start over from a cold cache anyway
+		std::vector<uint32_t> hard_clusters{};
+		for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+		{
+			if (count_misses(triangle) == 3) {
+				hard_clusters.emplace_back(triangle);
+			}
+		}
+		if (hard_clusters.empty() || hard_clusters.front() != 0) {
+			hard_clusters.insert(hard_clusters.begin(), 0);
+		}
+
+		// Soft boundaries, a cluster closes once its ACMR is within threshold of the hard cluster it belongs to
+		std::vector<uint32_t> clusters{};
+		for (uint32_t hard_cluster = 0; hard_cluster < hard_clusters.size(); ++hard_cluster)
+		{
+			const uint32_t begin = hard_clusters[hard_cluster];
+			const uint32_t end = hard_cluster + 1 < hard_clusters.size() ? hard_clusters[hard_cluster + 1] : triangle_count;
+			reset_cache();
+			uint32_t hard_misses = 0;
+			for (uint32_t triangle = begin; triangle < end; ++triangle)
+			{
+				hard_misses += count_misses(triangle);
+			}
+			const float cluster_threshold = threshold * static_cast<float>(hard_misses) / static_cast<float>(end - begin);
+
+			reset_cache();
+			clusters.emplace_back(begin);
+			uint32_t cluster_begin = begin;
+			uint32_t cluster_misses = 0;
+			for (uint32_t triangle = begin; triangle < end; ++triangle)
+			{
+				cluster_misses += count_misses(triangle);
+				if (triangle + 1 < end && static_cast<float>(cluster_misses) <= cluster_threshold * static_cast<float>(triangle + 1 - cluster_begin)) {
+					clusters.emplace_back(triangle + 1);
+					cluster_begin = triangle + 1;
+					cluster_misses = 0;
+					reset_cache();
+				}
+			}
+		}
+
+		// Area weighted centroid and normal of the mesh and every cluster
+		std::array<double, 3> mesh_centroid{};
+		double mesh_area = 0.0;
+		const uint32_t cluster_count = static_cast<uint32_t>(clusters.size());
+		std::vector<std::array<float, 3>> cluster_centroids(cluster_count);
+		std::vector<std::array<float, 3>> cluster_normals(cluster_count);
+		for (uint32_t cluster = 0; cluster < cluster_count; ++cluster)
+		{
+			const uint32_t begin = clusters[cluster];
+			const uint32_t end = cluster + 1 < cluster_count ? clusters[cluster + 1] : triangle_count;
+			std::array<double, 3> centroid{};
+			std::array<double, 3> normal{};
+			double cluster_area = 0.0;
+			for (uint32_t triangle = begin; triangle < end; ++triangle)
+			{
+				auto p0 = query_position(indices[triangle * 3]);
+				auto p1 = query_position(indices[triangle * 3 + 1]);
+				auto p2 = query_position(indices[triangle * 3 + 2]);
+				const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				const double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					centroid[axis] += (p0[axis] + p1[axis] + p2[axis]) * (area / 3.0);
+					normal[axis] += n[axis];
+				}
+				cluster_area += area;
+			}
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				mesh_centroid[axis] += centroid[axis];
+				cluster_centroids[cluster][axis] = static_cast<float>(cluster_area > 0.0 ? centroid[axis] / cluster_area : 0.0);
+			}
+			mesh_area += cluster_area;
+			const double normal_length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				cluster_normals[cluster][axis] = static_cast<float>(normal_length > 0.0 ? normal[axis] / normal_length : 0.0);
+			}
+		}
+		for (auto &&axis_sum : mesh_centroid)
+		{
+			axis_sum = mesh_area > 0.0 ? axis_sum / mesh_area : 0.0;
+		}
+
+		// Clusters facing away from the center are likely in front, drawing them first lets early z reject the rest
+		std::vector<float> sort_keys(cluster_count);
+		std::vector<uint32_t> cluster_order(cluster_count);
+		for (uint32_t cluster = 0; cluster < cluster_count; ++cluster)
+		{
+			float sort_key = 0.0f;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				sort_key += (cluster_centroids[cluster][axis] - static_cast<float>(mesh_centroid[axis])) * cluster_normals[cluster][axis];
+			}
+			sort_keys[cluster] = sort_key;
+			cluster_order[cluster] = cluster;
+		}
+		std::stable_sort(cluster_order.begin(), cluster_order.end(), [&sort_keys](uint32_t lhs, uint32_t rhs) { return sort_keys[lhs] > sort_keys[rhs]; });
+
+		const std::vector<uint32_t> source_indices(indices.begin(), indices.begin() + triangle_count * 3);
+		uint32_t write_offset = 0;
+		for (auto cluster : cluster_order)
+		{
+			const uint32_t begin = clusters[cluster];
+			const uint32_t end = cluster + 1 < cluster_count ? clusters[cluster + 1] : triangle_count;
+			std::memcpy(&indices[write_offset], &source_indices[begin * 3], static_cast<size_t>(end - begin) * 3 * sizeof(uint32_t));
+			write_offset += (end - begin) * 3;
+		}
+	}
+
+	uint32_t MeshOptimizer::optimize_vertex_fetch(std::span<uint32_t> indices, uint32_t vertex_count, std::vector<uint32_t> &remap)
+	{
+		remap.assign(vertex_count, UINT32_MAX);
+		uint32_t next_vertex = 0;
+		for (auto &&index : indices)
+		{
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = next_vertex++;
+			}
+			index = remap[index];
+		}
+		return next_vertex;
+	}
+
+	VertexCacheStats MeshOptimizer::analyze_vertex_cache(std::span<const uint32_t> indices, uint32_t vertex_count, uint32_t cache_size)
+	{
+		VertexCacheStats cache_stats{};
+		cache_stats.triangle_count = static_cast<uint32_t>(indices.size() / 3);
+		std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+		std::vector<uint8_t> is_referenced(vertex_count, 0);
+		uint32_t timestamp = cache_size + 1;
+		for (auto index : indices)
+		{
+			if (timestamp - cache_timestamps[index] > cache_size) {
+				cache_timestamps[index] = timestamp++;
+				++cache_stats.cache_misses;
+			}
+			if (is_referenced[index] == 0) {
+				is_referenced[index] = 1;
+				++cache_stats.vertex_count;
+			}
+		}
+		cache_stats.acmr = cache_stats.triangle_count > 0 ? static_cast<float>(cache_stats.cache_misses) / static_cast<float>(cache_stats.triangle_count) : 0.0f;
+		cache_stats.atvr = cache_stats.vertex_count > 0 ? static_cast<float>(cache_stats.cache_misses) / static_cast<float>(cache_stats.vertex_count) : 0.0f;
+		return cache_stats;
+	}
+}
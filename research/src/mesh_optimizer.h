@@ -0,0 +1,49 @@
+//
+// Created by ZZK on 2024/11/01.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace toy
+{
+	// Post-transform cache behaviour of an index buffer under a FIFO cache
+	// ACMR is misses per triangle, ATVR misses per referenced vertex, 1.0 being the best possible
+	struct VertexCacheStats
+	{
+		uint32_t triangle_count = 0;
+		uint32_t vertex_count = 0;
+		uint32_t cache_misses = 0;
+		float acmr = 0.0f;
+		float atvr = 0.0f;
+	};
+
+	// Index and vertex order optimizations for triangle lists, plain cpu code without any d3d dependency
+	struct MeshOptimizer
+	{
+	public:
+		// Cache the statistics are measured with, close to the post-transform cache of current hardware
+		static constexpr uint32_t analysis_cache_size = 16;
+
+		// Cache modelled by the triangle ordering
+		static constexpr uint32_t ordering_cache_size = 32;
+
+		// Reorder triangles for the post-transform cache with Forsyth's linear speed algorithm
+		static void optimize_vertex_cache(std::span<uint32_t> indices, uint32_t vertex_count);
+
+		// Reorder clusters of an already cache optimized index buffer so triangles facing outwards are drawn first
+		// Clusters split where the cache restarts or where the local ACMR stays within threshold times the cluster ACMR,
+		// so the cache efficiency lost is bounded by the threshold
+		static void optimize_overdraw(std::span<uint32_t> indices, const float *positions, uint32_t position_stride_in_bytes, uint32_t vertex_count,
+									  float threshold = 1.05f);
+
+		// Renumber vertices in first use order so fetches walk the vertex buffer linearly, unused vertices are dropped
+		// remap[old vertex] is the new vertex or UINT32_MAX when unused, returns the number of vertices kept
+		static uint32_t optimize_vertex_fetch(std::span<uint32_t> indices, uint32_t vertex_count, std::vector<uint32_t> &remap);
+
+		static VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, uint32_t vertex_count, uint32_t cache_size = analysis_cache_size);
+	};
+}
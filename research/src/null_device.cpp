@@ -0,0 +1,1531 @@
+//
+// Created by ZZK on 2024/10/21.
+//
+
+#include <null_device.h>
+#include <algorithm>
+
+namespace toy
+{
+	static constexpr std::array<std::string_view, static_cast<size_t>(NullDeviceCall::Count)> s_null_device_call_names = {
+		"CreateBuffer", "CreateTexture", "CreateView", "CreateShader", "CreateInputLayout", "CreateState",
+		"Map", "Unmap", "UpdateSubresource", "CopyResource",
+		"SetShader", "SetConstantBuffers", "SetShaderResources", "SetSamplers", "SetUnorderedAccessViews",
+		"SetInputLayout", "SetVertexBuffers", "SetIndexBuffer", "SetPrimitiveTopology", "SetRenderTargets",
+		"SetRasterizerState", "SetDepthStencilState", "SetBlendState", "SetViewports",
+		"Draw", "Dispatch", "Clear", "ExecuteCommandList", "Other"
+	};
+
+	static constexpr std::array<std::string_view, static_cast<size_t>(NullObjectType::Count)> s_null_object_type_names = {
+		"Buffer", "Texture", "ShaderResourceView", "UnorderedAccessView", "RenderTargetView", "DepthStencilView",
+		"Shader", "InputLayout", "PipelineState", "SamplerState", "CommandList", "DeferredContext"
+	};
+
+	static void update_peak(std::atomic<int64_t> &peak, int64_t value)
+	{
+		int64_t current_peak = peak.load(std::memory_order_relaxed);
+		while (value > current_peak && !peak.compare_exchange_weak(current_peak, value, std::memory_order_relaxed))
+		{
+
+		}
+	}
+
+	void NullDeviceStats::record_call(NullDeviceCall call, uint64_t count)
+	{
+		call_counts[static_cast<size_t>(call)].fetch_add(count, std::memory_order_relaxed);
+	}
+
+	void NullDeviceStats::record_object_created(NullObjectType object_type)
+	{
+		objects_created[static_cast<size_t>(object_type)].fetch_add(1, std::memory_order_relaxed);
+		objects_alive[static_cast<size_t>(object_type)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void NullDeviceStats::record_object_destroyed(NullObjectType object_type)
+	{
+		objects_alive[static_cast<size_t>(object_type)].fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void NullDeviceStats::record_buffer_memory(int64_t size_in_bytes)
+	{
+		const int64_t alive = buffer_bytes_alive.fetch_add(size_in_bytes, std::memory_order_relaxed) + size_in_bytes;
+		update_peak(buffer_bytes_peak, alive);
+	}
+
+	void NullDeviceStats::record_texture_memory(int64_t size_in_bytes)
+	{
+		const int64_t alive = texture_bytes_alive.fetch_add(size_in_bytes, std::memory_order_relaxed) + size_in_bytes;
+		update_peak(texture_bytes_peak, alive);
+	}
+
+	uint64_t NullDeviceStats::query_call_count(NullDeviceCall call) const
+	{
+		return call_counts[static_cast<size_t>(call)].load(std::memory_order_relaxed);
+	}
+
+	uint64_t NullDeviceStats::query_objects_created(NullObjectType object_type) const
+	{
+		return objects_created[static_cast<size_t>(object_type)].load(std::memory_order_relaxed);
+	}
+
+	int64_t NullDeviceStats::query_objects_alive(NullObjectType object_type) const
+	{
+		return objects_alive[static_cast<size_t>(object_type)].load(std::memory_order_relaxed);
+	}
+
+	void NullDeviceStats::reset()
+	{
+		for (auto &&call_count : call_counts)
+		{
+			call_count.store(0, std::memory_order_relaxed);
+		}
+		for (auto &&object_count : objects_created)
+		{
+			object_count.store(0, std::memory_order_relaxed);
+		}
+		slots_bound.store(0, std::memory_order_relaxed);
+		bytes_mapped.store(0, std::memory_order_relaxed);
+		bytes_updated.store(0, std::memory_order_relaxed);
+		bytecode_bytes.store(0, std::memory_order_relaxed);
+		thread_groups_dispatched.store(0, std::memory_order_relaxed);
+		buffer_bytes_peak.store(buffer_bytes_alive.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		texture_bytes_peak.store(texture_bytes_alive.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	void NullDeviceStats::print() const
+	{
+		uint64_t total_calls = 0;
+		std::cout << std::format("Null device calls\n");
+		for (size_t index = 0; index < call_counts.size(); ++index)
+		{
+			const uint64_t call_count = call_counts[index].load(std::memory_order_relaxed);
+			total_calls += call_count;
+			if (call_count != 0) {
+				std::cout << std::format("    {:<26}{}\n", s_null_device_call_names[index], call_count);
+			}
+		}
+		std::cout << std::format("    {:<26}{}\n", "Total", total_calls);
+		std::cout << std::format("    {:<26}{}\n", "Slots bound", slots_bound.load(std::memory_order_relaxed));
+		std::cout << std::format("    {:<26}{}\n", "Thread groups dispatched", thread_groups_dispatched.load(std::memory_order_relaxed));
+
+		std::cout << std::format("Null device objects (created / alive)\n");
+		for (size_t index = 0; index < objects_created.size(); ++index)
+		{
+			const uint64_t created = objects_created[index].load(std::memory_order_relaxed);
+			const int64_t alive = objects_alive[index].load(std::memory_order_relaxed);
+			if (created != 0 || alive != 0) {
+				std::cout << std::format("    {:<26}{} / {}\n", s_null_object_type_names[index], created, alive);
+			}
+		}
+
+		std::cout << std::format("Null device bytes\n");
+		std::cout << std::format("    {:<26}{}\n", "Mapped", bytes_mapped.load(std::memory_order_relaxed));
+		std::cout << std::format("    {:<26}{}\n", "Updated", bytes_updated.load(std::memory_order_relaxed));
+		std::cout << std::format("    {:<26}{}\n", "Bytecode", bytecode_bytes.load(std::memory_order_relaxed));
+		std::cout << std::format("    {:<26}{} (peak {})\n", "Buffer memory", buffer_bytes_alive.load(std::memory_order_relaxed), buffer_bytes_peak.load(std::memory_order_relaxed));
+		std::cout << std::format("    {:<26}{} (peak {})\n", "Texture memory", texture_bytes_alive.load(std::memory_order_relaxed), texture_bytes_peak.load(std::memory_order_relaxed));
+	}
+
+	const NullSubresource *NullResourceStorage::query_subresource(uint32_t subresource) const
+	{
+		if (subresource >= subresources.size()) {
+			return nullptr;
+		}
+		return &subresources[subresource];
+	}
+
+	uint8_t *NullResourceStorage::query_data(uint32_t subresource)
+	{
+		if (subresource >= subresources.size()) {
+			return nullptr;
+		}
+		return storage.data() + subresources[subresource].offset;
+	}
+
+	size_t build_null_texture_layout(uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, DXGI_FORMAT format,
+									std::vector<NullSubresource> &subresources)
+	{
+		if (mip_levels == 0) {
+			uint32_t max_dimension = (std::max)({ width, height, depth });
+			while (max_dimension > 0)
+			{
+				++mip_levels;
+				max_dimension >>= 1;
+			}
+		}
+
+		const uint32_t element_size = query_format_size_in_bytes(format);
+		size_t offset = 0;
+		subresources.clear();
+		subresources.reserve(mip_levels * array_size);
+		// Subresource index follows D3D11CalcSubresource, mip slice + array slice * mip levels
+		for (uint32_t array_slice = 0; array_slice < array_size; ++array_slice)
+		{
+			for (uint32_t mip_slice = 0; mip_slice < mip_levels; ++mip_slice)
+			{
+				NullSubresource subresource = {};
+				subresource.offset = static_cast<uint32_t>(offset);
+				subresource.element_size = element_size;
+				subresource.row_pitch = (std::max)(width >> mip_slice, 1u) * element_size;
+				subresource.rows = (std::max)(height >> mip_slice, 1u);
+				subresource.slices = (std::max)(depth >> mip_slice, 1u);
+				subresource.depth_pitch = subresource.row_pitch * subresource.rows;
+				subresource.size_in_bytes = subresource.depth_pitch * subresource.slices;
+				offset += subresource.size_in_bytes;
+				subresources.emplace_back(subresource);
+			}
+		}
+		return offset;
+	}
+
+	NullResourceStorage *query_null_resource_storage(ID3D11Resource *resource)
+	{
+		if (resource == nullptr) {
+			return nullptr;
+		}
+
+		// The dimension alone says nothing about who created the resource, only null resources answer this guid
+		NullResourceStorage *resource_storage = nullptr;
+		UINT data_size = sizeof(resource_storage);
+		if (FAILED(resource->GetPrivateData(null_resource_storage_guid, &data_size, &resource_storage)) || data_size != sizeof(resource_storage)) {
+			return nullptr;
+		}
+		return resource_storage;
+	}
+
+	// Null resources
+	NullBuffer::NullBuffer(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_BUFFER_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data)
+	: NullResource(device, device_stats, desc)
+	{
+		NullSubresource subresource = {};
+		subresource.element_size = 1;
+		subresource.row_pitch = desc.ByteWidth;
+		subresource.depth_pitch = desc.ByteWidth;
+		subresource.rows = 1;
+		subresource.slices = 1;
+		subresource.size_in_bytes = desc.ByteWidth;
+		subresources.emplace_back(subresource);
+		allocate_storage(desc.ByteWidth, initial_data);
+	}
+
+	NullTexture1D::NullTexture1D(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_TEXTURE1D_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data)
+	: NullResource(device, device_stats, desc)
+	{
+		const size_t size_in_bytes = build_null_texture_layout(desc.Width, 1, 1, desc.MipLevels, desc.ArraySize, desc.Format, subresources);
+		resource_desc.MipLevels = static_cast<uint32_t>(subresources.size()) / desc.ArraySize;
+		allocate_storage(size_in_bytes, initial_data);
+	}
+
+	NullTexture2D::NullTexture2D(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_TEXTURE2D_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data)
+	: NullResource(device, device_stats, desc)
+	{
+		const size_t size_in_bytes = build_null_texture_layout(desc.Width, desc.Height, 1, desc.MipLevels, desc.ArraySize, desc.Format, subresources);
+		resource_desc.MipLevels = static_cast<uint32_t>(subresources.size()) / desc.ArraySize;
+		allocate_storage(size_in_bytes, initial_data);
+	}
+
+	NullTexture3D::NullTexture3D(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_TEXTURE3D_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data)
+	: NullResource(device, device_stats, desc)
+	{
+		const size_t size_in_bytes = build_null_texture_layout(desc.Width, desc.Height, desc.Depth, desc.MipLevels, 1, desc.Format, subresources);
+		resource_desc.MipLevels = static_cast<uint32_t>(subresources.size());
+		allocate_storage(size_in_bytes, initial_data);
+	}
+
+	// Null input layout
+	NullInputLayout::NullInputLayout(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_INPUT_ELEMENT_DESC *input_element_descs, uint32_t num_elements)
+	: NullDeviceChild(device, device_stats)
+	{
+		input_elements.assign(input_element_descs, input_element_descs + num_elements);
+		semantic_names.reserve(num_elements);
+		for (auto &&input_element : input_elements)
+		{
+			semantic_names.emplace_back(input_element.SemanticName);
+		}
+		for (uint32_t index = 0; index < num_elements; ++index)
+		{
+			input_elements[index].SemanticName = semantic_names[index].c_str();
+		}
+	}
+
+	std::span<const D3D11_INPUT_ELEMENT_DESC> NullInputLayout::query_input_elements() const
+	{
+		return input_elements;
+	}
+
+	// Null command list
+	NullCommandList::NullCommandList(ID3D11Device *device, NullDeviceStats *device_stats, uint64_t call_count)
+	: NullDeviceChild(device, device_stats), recorded_calls(call_count)
+	{
+
+	}
+
+	UINT NullCommandList::GetContextFlags()
+	{
+		return 0;
+	}
+
+	uint64_t NullCommandList::query_recorded_calls() const
+	{
+		return recorded_calls;
+	}
+
+	// Null device context
+	NullDeviceContext::NullDeviceContext(ID3D11Device *device, NullDeviceStats *device_stats, D3D11_DEVICE_CONTEXT_TYPE type, const NullComputeKernel *device_compute_kernel)
+	: parent_device(device), stats(device_stats), context_type(type), compute_kernel(device_compute_kernel)
+	{
+		if (context_type == D3D11_DEVICE_CONTEXT_DEFERRED) {
+			parent_device_ref = device;
+			stats->record_object_created(NullObjectType::DeferredContext);
+		}
+	}
+
+	NullDeviceContext::~NullDeviceContext()
+	{
+		if (context_type == D3D11_DEVICE_CONTEXT_DEFERRED) {
+			stats->record_object_destroyed(NullObjectType::DeferredContext);
+		}
+	}
+
+	void NullDeviceContext::record(NullDeviceCall call, uint32_t slot_count)
+	{
+		stats->record_call(call);
+		if (slot_count != 0) {
+			stats->slots_bound.fetch_add(slot_count, std::memory_order_relaxed);
+		}
+		++recorded_calls;
+	}
+
+	void NullDeviceContext::run_compute_kernel(uint32_t thread_group_count_x, uint32_t thread_group_count_y, uint32_t thread_group_count_z)
+	{
+		if (compute_kernel == nullptr || !*compute_kernel) {
+			return;
+		}
+		compute_bindings.device_context = this;
+		compute_bindings.thread_group_counts = { thread_group_count_x, thread_group_count_y, thread_group_count_z };
+		(*compute_kernel)(compute_bindings);
+	}
+
+	void NullDeviceContext::GetDevice(ID3D11Device **device)
+	{
+		*device = parent_device;
+		parent_device->AddRef();
+	}
+
+	HRESULT NullDeviceContext::GetPrivateData(REFGUID, UINT *, void *)
+	{
+		return DXGI_ERROR_NOT_FOUND;
+	}
+
+	HRESULT NullDeviceContext::SetPrivateData(REFGUID, UINT, const void *)
+	{
+		return S_OK;
+	}
+
+	HRESULT NullDeviceContext::SetPrivateDataInterface(REFGUID, const IUnknown *)
+	{
+		return S_OK;
+	}
+
+	// Shader stages
+	void NullDeviceContext::VSSetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer *const *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::PSSetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView *const *)
+	{
+		record(NullDeviceCall::SetShaderResources, num_views);
+	}
+
+	void NullDeviceContext::PSSetShader(ID3D11PixelShader *, ID3D11ClassInstance *const *, UINT)
+	{
+		record(NullDeviceCall::SetShader);
+	}
+
+	void NullDeviceContext::PSSetSamplers(UINT, UINT num_samplers, ID3D11SamplerState *const *)
+	{
+		record(NullDeviceCall::SetSamplers, num_samplers);
+	}
+
+	void NullDeviceContext::VSSetShader(ID3D11VertexShader *, ID3D11ClassInstance *const *, UINT)
+	{
+		record(NullDeviceCall::SetShader);
+	}
+
+	void NullDeviceContext::PSSetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer *const *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::GSSetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer *const *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::GSSetShader(ID3D11GeometryShader *, ID3D11ClassInstance *const *, UINT)
+	{
+		record(NullDeviceCall::SetShader);
+	}
+
+	void NullDeviceContext::VSSetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView *const *)
+	{
+		record(NullDeviceCall::SetShaderResources, num_views);
+	}
+
+	void NullDeviceContext::VSSetSamplers(UINT, UINT num_samplers, ID3D11SamplerState *const *)
+	{
+		record(NullDeviceCall::SetSamplers, num_samplers);
+	}
+
+	void NullDeviceContext::GSSetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView *const *)
+	{
+		record(NullDeviceCall::SetShaderResources, num_views);
+	}
+
+	void NullDeviceContext::GSSetSamplers(UINT, UINT num_samplers, ID3D11SamplerState *const *)
+	{
+		record(NullDeviceCall::SetSamplers, num_samplers);
+	}
+
+	void NullDeviceContext::HSSetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView *const *)
+	{
+		record(NullDeviceCall::SetShaderResources, num_views);
+	}
+
+	void NullDeviceContext::HSSetShader(ID3D11HullShader *, ID3D11ClassInstance *const *, UINT)
+	{
+		record(NullDeviceCall::SetShader);
+	}
+
+	void NullDeviceContext::HSSetSamplers(UINT, UINT num_samplers, ID3D11SamplerState *const *)
+	{
+		record(NullDeviceCall::SetSamplers, num_samplers);
+	}
+
+	void NullDeviceContext::HSSetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer *const *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::DSSetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView *const *)
+	{
+		record(NullDeviceCall::SetShaderResources, num_views);
+	}
+
+	void NullDeviceContext::DSSetShader(ID3D11DomainShader *, ID3D11ClassInstance *const *, UINT)
+	{
+		record(NullDeviceCall::SetShader);
+	}
+
+	void NullDeviceContext::DSSetSamplers(UINT, UINT num_samplers, ID3D11SamplerState *const *)
+	{
+		record(NullDeviceCall::SetSamplers, num_samplers);
+	}
+
+	void NullDeviceContext::DSSetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer *const *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::CSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views)
+	{
+		record(NullDeviceCall::SetShaderResources, num_views);
+		for (UINT view_index = 0; view_index < num_views && start_slot + view_index < compute_bindings.shader_resource_views.size(); ++view_index)
+		{
+			compute_bindings.shader_resource_views[start_slot + view_index] = shader_resource_views != nullptr ? shader_resource_views[view_index] : nullptr;
+		}
+	}
+
+	void NullDeviceContext::CSSetUnorderedAccessViews(UINT start_slot, UINT num_uavs, ID3D11UnorderedAccessView *const *unordered_access_views, const UINT *)
+	{
+		record(NullDeviceCall::SetUnorderedAccessViews, num_uavs);
+		for (UINT uav_index = 0; uav_index < num_uavs && start_slot + uav_index < compute_bindings.unordered_access_views.size(); ++uav_index)
+		{
+			compute_bindings.unordered_access_views[start_slot + uav_index] = unordered_access_views != nullptr ? unordered_access_views[uav_index] : nullptr;
+		}
+	}
+
+	void NullDeviceContext::CSSetShader(ID3D11ComputeShader *compute_shader, ID3D11ClassInstance *const *, UINT)
+	{
+		record(NullDeviceCall::SetShader);
+		compute_bindings.compute_shader = compute_shader;
+	}
+
+	void NullDeviceContext::CSSetSamplers(UINT, UINT num_samplers, ID3D11SamplerState *const *)
+	{
+		record(NullDeviceCall::SetSamplers, num_samplers);
+	}
+
+	void NullDeviceContext::CSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers)
+	{
+		CSSetConstantBuffers1(start_slot, num_buffers, constant_buffers, nullptr, nullptr);
+	}
+
+	// Draw and dispatch
+	void NullDeviceContext::DrawIndexed(UINT, UINT, INT)
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::Draw(UINT, UINT)
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT)
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::DrawInstanced(UINT, UINT, UINT, UINT)
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::DrawAuto()
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::DrawIndexedInstancedIndirect(ID3D11Buffer *, UINT)
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::DrawInstancedIndirect(ID3D11Buffer *, UINT)
+	{
+		record(NullDeviceCall::Draw);
+	}
+
+	void NullDeviceContext::Dispatch(UINT thread_group_count_x, UINT thread_group_count_y, UINT thread_group_count_z)
+	{
+		record(NullDeviceCall::Dispatch);
+		stats->thread_groups_dispatched.fetch_add(static_cast<uint64_t>(thread_group_count_x) * thread_group_count_y * thread_group_count_z, std::memory_order_relaxed);
+		run_compute_kernel(thread_group_count_x, thread_group_count_y, thread_group_count_z);
+	}
+
+	void NullDeviceContext::DispatchIndirect(ID3D11Buffer *buffer_for_args, UINT aligned_byte_offset_for_args)
+	{
+		record(NullDeviceCall::Dispatch);
+
+		// Arguments are read back from the buffer storage, so whatever the cpu wrote into it is what gets dispatched
+		auto resource_storage = query_null_resource_storage(buffer_for_args);
+		if (resource_storage == nullptr || aligned_byte_offset_for_args % 4 != 0 ||
+			aligned_byte_offset_for_args + 3 * sizeof(uint32_t) > resource_storage->storage.size()) {
+			return;
+		}
+		uint32_t thread_group_counts[3]{};
+		std::memcpy(thread_group_counts, resource_storage->storage.data() + aligned_byte_offset_for_args, sizeof(thread_group_counts));
+		stats->thread_groups_dispatched.fetch_add(static_cast<uint64_t>(thread_group_counts[0]) * thread_group_counts[1] * thread_group_counts[2], std::memory_order_relaxed);
+		run_compute_kernel(thread_group_counts[0], thread_group_counts[1], thread_group_counts[2]);
+	}
+
+	// Resource access
+	HRESULT NullDeviceContext::Map(ID3D11Resource *resource, UINT subresource, D3D11_MAP map_type, UINT, D3D11_MAPPED_SUBRESOURCE *mapped_resource)
+	{
+		record(NullDeviceCall::Map);
+		auto resource_storage = query_null_resource_storage(resource);
+		if (resource_storage == nullptr || mapped_resource == nullptr) {
+			return E_INVALIDARG;
+		}
+		auto null_subresource = resource_storage->query_subresource(subresource);
+		if (null_subresource == nullptr) {
+			return E_INVALIDARG;
+		}
+
+		mapped_resource->pData = resource_storage->query_data(subresource);
+		mapped_resource->RowPitch = null_subresource->row_pitch;
+		mapped_resource->DepthPitch = null_subresource->depth_pitch;
+		// No overwrite maps append to memory the gpu may still read, nothing is renamed
+		if (map_type != D3D11_MAP_WRITE_NO_OVERWRITE) {
+			stats->bytes_mapped.fetch_add(null_subresource->size_in_bytes, std::memory_order_relaxed);
+		}
+		return S_OK;
+	}
+
+	void NullDeviceContext::Unmap(ID3D11Resource *, UINT)
+	{
+		record(NullDeviceCall::Unmap);
+	}
+
+	void NullDeviceContext::CopySubresourceRegion(ID3D11Resource *dst_resource, UINT dst_subresource, UINT dst_x, UINT dst_y, UINT dst_z,
+												ID3D11Resource *src_resource, UINT src_subresource, const D3D11_BOX *src_box)
+	{
+		record(NullDeviceCall::CopyResource);
+		auto dst_storage = query_null_resource_storage(dst_resource);
+		auto src_storage = query_null_resource_storage(src_resource);
+		if (dst_storage == nullptr || src_storage == nullptr) {
+			return;
+		}
+		auto dst_null_subresource = dst_storage->query_subresource(dst_subresource);
+		auto src_null_subresource = src_storage->query_subresource(src_subresource);
+		if (dst_null_subresource == nullptr || src_null_subresource == nullptr) {
+			return;
+		}
+
+		// Copy in whole rows, the box only selects texels inside each row
+		const uint32_t element_size = src_null_subresource->element_size;
+		const uint32_t left = src_box ? src_box->left : 0;
+		const uint32_t top = src_box ? src_box->top : 0;
+		const uint32_t front = src_box ? src_box->front : 0;
+		const uint32_t row_size = src_box ? (src_box->right - src_box->left) * element_size : src_null_subresource->row_pitch;
+		const uint32_t rows = src_box ? src_box->bottom - src_box->top : src_null_subresource->rows;
+		const uint32_t slices = src_box ? src_box->back - src_box->front : src_null_subresource->slices;
+		auto dst_data = dst_storage->query_data(dst_subresource);
+		auto src_data = src_storage->query_data(src_subresource);
+		for (uint32_t slice = 0; slice < slices; ++slice)
+		{
+			for (uint32_t row = 0; row < rows; ++row)
+			{
+				const size_t dst_offset = (dst_z + slice) * dst_null_subresource->depth_pitch + (dst_y + row) * dst_null_subresource->row_pitch + dst_x * element_size;
+				const size_t src_offset = (front + slice) * src_null_subresource->depth_pitch + (top + row) * src_null_subresource->row_pitch + left * element_size;
+				if (dst_offset + row_size > dst_null_subresource->size_in_bytes || src_offset + row_size > src_null_subresource->size_in_bytes) {
+					return;
+				}
+				std::memcpy(dst_data + dst_offset, src_data + src_offset, row_size);
+			}
+		}
+	}
+
+	void NullDeviceContext::CopyResource(ID3D11Resource *dst_resource, ID3D11Resource *src_resource)
+	{
+		record(NullDeviceCall::CopyResource);
+		auto dst_storage = query_null_resource_storage(dst_resource);
+		auto src_storage = query_null_resource_storage(src_resource);
+		if (dst_storage == nullptr || src_storage == nullptr || dst_storage->storage.size() != src_storage->storage.size()) {
+			return;
+		}
+		std::memcpy(dst_storage->storage.data(), src_storage->storage.data(), src_storage->storage.size());
+	}
+
+	void NullDeviceContext::UpdateSubresource(ID3D11Resource *dst_resource, UINT dst_subresource, const D3D11_BOX *dst_box, const void *src_data, UINT src_row_pitch, UINT src_depth_pitch)
+	{
+		record(NullDeviceCall::UpdateSubresource);
+		auto dst_storage = query_null_resource_storage(dst_resource);
+		if (dst_storage == nullptr || src_data == nullptr) {
+			return;
+		}
+		auto dst_null_subresource = dst_storage->query_subresource(dst_subresource);
+		if (dst_null_subresource == nullptr) {
+			return;
+		}
+
+		const uint32_t element_size = dst_null_subresource->element_size;
+		const uint32_t left = dst_box ? dst_box->left : 0;
+		const uint32_t top = dst_box ? dst_box->top : 0;
+		const uint32_t front = dst_box ? dst_box->front : 0;
+		const uint32_t row_size = dst_box ? (dst_box->right - dst_box->left) * element_size : dst_null_subresource->row_pitch;
+		const uint32_t rows = dst_box ? dst_box->bottom - dst_box->top : dst_null_subresource->rows;
+		const uint32_t slices = dst_box ? dst_box->back - dst_box->front : dst_null_subresource->slices;
+		// Buffers ignore the pitches
+		if (src_row_pitch == 0 || rows == 1) {
+			src_row_pitch = row_size;
+		}
+		if (src_depth_pitch == 0 || slices == 1) {
+			src_depth_pitch = src_row_pitch * rows;
+		}
+
+		auto dst_data = dst_storage->query_data(dst_subresource);
+		auto src_bytes = static_cast<const uint8_t *>(src_data);
+		for (uint32_t slice = 0; slice < slices; ++slice)
+		{
+			for (uint32_t row = 0; row < rows; ++row)
+			{
+				const size_t dst_offset = (front + slice) * dst_null_subresource->depth_pitch + (top + row) * dst_null_subresource->row_pitch + left * element_size;
+				if (dst_offset + row_size > dst_null_subresource->size_in_bytes) {
+					return;
+				}
+				std::memcpy(dst_data + dst_offset, src_bytes + slice * src_depth_pitch + row * src_row_pitch, row_size);
+			}
+		}
+		stats->bytes_updated.fetch_add(static_cast<uint64_t>(row_size) * rows * slices, std::memory_order_relaxed);
+	}
+
+	void NullDeviceContext::CopyStructureCount(ID3D11Buffer *, UINT, ID3D11UnorderedAccessView *)
+	{
+		record(NullDeviceCall::CopyResource);
+	}
+
+	void NullDeviceContext::ClearRenderTargetView(ID3D11RenderTargetView *, const FLOAT[4])
+	{
+		record(NullDeviceCall::Clear);
+	}
+
+	void NullDeviceContext::ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView *, const UINT[4])
+	{
+		record(NullDeviceCall::Clear);
+	}
+
+	void NullDeviceContext::ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView *, const FLOAT[4])
+	{
+		record(NullDeviceCall::Clear);
+	}
+
+	void NullDeviceContext::ClearDepthStencilView(ID3D11DepthStencilView *, UINT, FLOAT, UINT8)
+	{
+		record(NullDeviceCall::Clear);
+	}
+
+	void NullDeviceContext::GenerateMips(ID3D11ShaderResourceView *)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	void NullDeviceContext::SetResourceMinLOD(ID3D11Resource *, FLOAT)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	FLOAT NullDeviceContext::GetResourceMinLOD(ID3D11Resource *)
+	{
+		return 0.0f;
+	}
+
+	void NullDeviceContext::ResolveSubresource(ID3D11Resource *, UINT, ID3D11Resource *, UINT, DXGI_FORMAT)
+	{
+		record(NullDeviceCall::CopyResource);
+	}
+
+	// Input assembler, rasterizer and output merger
+	void NullDeviceContext::IASetInputLayout(ID3D11InputLayout *)
+	{
+		record(NullDeviceCall::SetInputLayout);
+	}
+
+	void NullDeviceContext::IASetVertexBuffers(UINT, UINT num_buffers, ID3D11Buffer *const *, const UINT *, const UINT *)
+	{
+		record(NullDeviceCall::SetVertexBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::IASetIndexBuffer(ID3D11Buffer *, DXGI_FORMAT, UINT)
+	{
+		record(NullDeviceCall::SetIndexBuffer);
+	}
+
+	void NullDeviceContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY)
+	{
+		record(NullDeviceCall::SetPrimitiveTopology);
+	}
+
+	void NullDeviceContext::OMSetRenderTargets(UINT num_views, ID3D11RenderTargetView *const *, ID3D11DepthStencilView *)
+	{
+		record(NullDeviceCall::SetRenderTargets, num_views);
+	}
+
+	void NullDeviceContext::OMSetRenderTargetsAndUnorderedAccessViews(UINT num_rtvs, ID3D11RenderTargetView *const *, ID3D11DepthStencilView *,
+																	UINT, UINT num_uavs, ID3D11UnorderedAccessView *const *, const UINT *)
+	{
+		const uint32_t rtv_count = num_rtvs == D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL ? 0 : num_rtvs;
+		const uint32_t uav_count = num_uavs == D3D11_KEEP_UNORDERED_ACCESS_VIEWS ? 0 : num_uavs;
+		record(NullDeviceCall::SetRenderTargets, rtv_count + uav_count);
+	}
+
+	void NullDeviceContext::OMSetBlendState(ID3D11BlendState *, const FLOAT[4], UINT)
+	{
+		record(NullDeviceCall::SetBlendState);
+	}
+
+	void NullDeviceContext::OMSetDepthStencilState(ID3D11DepthStencilState *, UINT)
+	{
+		record(NullDeviceCall::SetDepthStencilState);
+	}
+
+	void NullDeviceContext::SOSetTargets(UINT num_buffers, ID3D11Buffer *const *, const UINT *)
+	{
+		record(NullDeviceCall::Other, num_buffers);
+	}
+
+	void NullDeviceContext::RSSetState(ID3D11RasterizerState *)
+	{
+		record(NullDeviceCall::SetRasterizerState);
+	}
+
+	void NullDeviceContext::RSSetViewports(UINT, const D3D11_VIEWPORT *)
+	{
+		record(NullDeviceCall::SetViewports);
+	}
+
+	void NullDeviceContext::RSSetScissorRects(UINT, const D3D11_RECT *)
+	{
+		record(NullDeviceCall::SetViewports);
+	}
+
+	// Queries and predication
+	void NullDeviceContext::Begin(ID3D11Asynchronous *)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	void NullDeviceContext::End(ID3D11Asynchronous *)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	HRESULT NullDeviceContext::GetData(ID3D11Asynchronous *, void *, UINT, UINT)
+	{
+		return E_NOTIMPL;
+	}
+
+	void NullDeviceContext::SetPredication(ID3D11Predicate *, BOOL)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	void NullDeviceContext::GetPredication(ID3D11Predicate **predicate, BOOL *predicate_value)
+	{
+		if (predicate) *predicate = nullptr;
+		if (predicate_value) *predicate_value = FALSE;
+	}
+
+	// State getters
+	template <typename T>
+	static void clear_output(T **objects, uint32_t count)
+	{
+		if (objects == nullptr) {
+			return;
+		}
+		std::fill_n(objects, count, nullptr);
+	}
+
+	template <typename T>
+	static void clear_shader_output(T **shader, ID3D11ClassInstance **, UINT *num_class_instances)
+	{
+		if (shader) *shader = nullptr;
+		if (num_class_instances) *num_class_instances = 0;
+	}
+
+	void NullDeviceContext::VSGetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers)
+	{
+		clear_output(constant_buffers, num_buffers);
+	}
+
+	void NullDeviceContext::PSGetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView **shader_resource_views)
+	{
+		clear_output(shader_resource_views, num_views);
+	}
+
+	void NullDeviceContext::PSGetShader(ID3D11PixelShader **pixel_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances)
+	{
+		clear_shader_output(pixel_shader, class_instances, num_class_instances);
+	}
+
+	void NullDeviceContext::PSGetSamplers(UINT, UINT num_samplers, ID3D11SamplerState **samplers)
+	{
+		clear_output(samplers, num_samplers);
+	}
+
+	void NullDeviceContext::VSGetShader(ID3D11VertexShader **vertex_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances)
+	{
+		clear_shader_output(vertex_shader, class_instances, num_class_instances);
+	}
+
+	void NullDeviceContext::PSGetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers)
+	{
+		clear_output(constant_buffers, num_buffers);
+	}
+
+	void NullDeviceContext::IAGetInputLayout(ID3D11InputLayout **input_layout)
+	{
+		clear_output(input_layout, 1);
+	}
+
+	void NullDeviceContext::IAGetVertexBuffers(UINT, UINT num_buffers, ID3D11Buffer **vertex_buffers, UINT *strides, UINT *offsets)
+	{
+		clear_output(vertex_buffers, num_buffers);
+		if (strides) std::fill_n(strides, num_buffers, 0u);
+		if (offsets) std::fill_n(offsets, num_buffers, 0u);
+	}
+
+	void NullDeviceContext::IAGetIndexBuffer(ID3D11Buffer **index_buffer, DXGI_FORMAT *format, UINT *offset)
+	{
+		clear_output(index_buffer, 1);
+		if (format) *format = DXGI_FORMAT_UNKNOWN;
+		if (offset) *offset = 0;
+	}
+
+	void NullDeviceContext::GSGetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers)
+	{
+		clear_output(constant_buffers, num_buffers);
+	}
+
+	void NullDeviceContext::GSGetShader(ID3D11GeometryShader **geometry_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances)
+	{
+		clear_shader_output(geometry_shader, class_instances, num_class_instances);
+	}
+
+	void NullDeviceContext::IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY *topology)
+	{
+		if (topology) *topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	}
+
+	void NullDeviceContext::VSGetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView **shader_resource_views)
+	{
+		clear_output(shader_resource_views, num_views);
+	}
+
+	void NullDeviceContext::VSGetSamplers(UINT, UINT num_samplers, ID3D11SamplerState **samplers)
+	{
+		clear_output(samplers, num_samplers);
+	}
+
+	void NullDeviceContext::GSGetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView **shader_resource_views)
+	{
+		clear_output(shader_resource_views, num_views);
+	}
+
+	void NullDeviceContext::GSGetSamplers(UINT, UINT num_samplers, ID3D11SamplerState **samplers)
+	{
+		clear_output(samplers, num_samplers);
+	}
+
+	void NullDeviceContext::OMGetRenderTargets(UINT num_views, ID3D11RenderTargetView **render_target_views, ID3D11DepthStencilView **depth_stencil_view)
+	{
+		clear_output(render_target_views, num_views);
+		clear_output(depth_stencil_view, 1);
+	}
+
+	void NullDeviceContext::OMGetRenderTargetsAndUnorderedAccessViews(UINT num_rtvs, ID3D11RenderTargetView **render_target_views, ID3D11DepthStencilView **depth_stencil_view,
+																	UINT, UINT num_uavs, ID3D11UnorderedAccessView **unordered_access_views)
+	{
+		clear_output(render_target_views, num_rtvs);
+		clear_output(depth_stencil_view, 1);
+		clear_output(unordered_access_views, num_uavs);
+	}
+
+	void NullDeviceContext::OMGetBlendState(ID3D11BlendState **blend_state, FLOAT blend_factor[4], UINT *sample_mask)
+	{
+		clear_output(blend_state, 1);
+		if (blend_factor) std::fill_n(blend_factor, 4, 1.0f);
+		if (sample_mask) *sample_mask = 0xffffffff;
+	}
+
+	void NullDeviceContext::OMGetDepthStencilState(ID3D11DepthStencilState **depth_stencil_state, UINT *stencil_ref)
+	{
+		clear_output(depth_stencil_state, 1);
+		if (stencil_ref) *stencil_ref = 0;
+	}
+
+	void NullDeviceContext::SOGetTargets(UINT num_buffers, ID3D11Buffer **so_targets)
+	{
+		clear_output(so_targets, num_buffers);
+	}
+
+	void NullDeviceContext::RSGetState(ID3D11RasterizerState **rasterizer_state)
+	{
+		clear_output(rasterizer_state, 1);
+	}
+
+	void NullDeviceContext::RSGetViewports(UINT *num_viewports, D3D11_VIEWPORT *)
+	{
+		if (num_viewports) *num_viewports = 0;
+	}
+
+	void NullDeviceContext::RSGetScissorRects(UINT *num_rects, D3D11_RECT *)
+	{
+		if (num_rects) *num_rects = 0;
+	}
+
+	void NullDeviceContext::HSGetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView **shader_resource_views)
+	{
+		clear_output(shader_resource_views, num_views);
+	}
+
+	void NullDeviceContext::HSGetShader(ID3D11HullShader **hull_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances)
+	{
+		clear_shader_output(hull_shader, class_instances, num_class_instances);
+	}
+
+	void NullDeviceContext::HSGetSamplers(UINT, UINT num_samplers, ID3D11SamplerState **samplers)
+	{
+		clear_output(samplers, num_samplers);
+	}
+
+	void NullDeviceContext::HSGetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers)
+	{
+		clear_output(constant_buffers, num_buffers);
+	}
+
+	void NullDeviceContext::DSGetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView **shader_resource_views)
+	{
+		clear_output(shader_resource_views, num_views);
+	}
+
+	void NullDeviceContext::DSGetShader(ID3D11DomainShader **domain_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances)
+	{
+		clear_shader_output(domain_shader, class_instances, num_class_instances);
+	}
+
+	void NullDeviceContext::DSGetSamplers(UINT, UINT num_samplers, ID3D11SamplerState **samplers)
+	{
+		clear_output(samplers, num_samplers);
+	}
+
+	void NullDeviceContext::DSGetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers)
+	{
+		clear_output(constant_buffers, num_buffers);
+	}
+
+	void NullDeviceContext::CSGetShaderResources(UINT, UINT num_views, ID3D11ShaderResourceView **shader_resource_views)
+	{
+		clear_output(shader_resource_views, num_views);
+	}
+
+	void NullDeviceContext::CSGetUnorderedAccessViews(UINT, UINT num_uavs, ID3D11UnorderedAccessView **unordered_access_views)
+	{
+		clear_output(unordered_access_views, num_uavs);
+	}
+
+	void NullDeviceContext::CSGetShader(ID3D11ComputeShader **compute_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances)
+	{
+		clear_shader_output(compute_shader, class_instances, num_class_instances);
+	}
+
+	void NullDeviceContext::CSGetSamplers(UINT, UINT num_samplers, ID3D11SamplerState **samplers)
+	{
+		clear_output(samplers, num_samplers);
+	}
+
+	void NullDeviceContext::CSGetConstantBuffers(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers)
+	{
+		clear_output(constant_buffers, num_buffers);
+	}
+
+	// Context
+	void NullDeviceContext::ExecuteCommandList(ID3D11CommandList *, BOOL restore_context_state)
+	{
+		record(NullDeviceCall::ExecuteCommandList);
+		if (!restore_context_state) {
+			compute_bindings = {};
+		}
+	}
+
+	void NullDeviceContext::ClearState()
+	{
+		record(NullDeviceCall::Other);
+		compute_bindings = {};
+	}
+
+	void NullDeviceContext::Flush()
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	D3D11_DEVICE_CONTEXT_TYPE NullDeviceContext::GetType()
+	{
+		return context_type;
+	}
+
+	UINT NullDeviceContext::GetContextFlags()
+	{
+		return 0;
+	}
+
+	HRESULT NullDeviceContext::FinishCommandList(BOOL restore_deferred_context_state, ID3D11CommandList **command_list)
+	{
+		if (context_type != D3D11_DEVICE_CONTEXT_DEFERRED) {
+			return DXGI_ERROR_INVALID_CALL;
+		}
+		auto null_command_list = Microsoft::WRL::Make<NullCommandList>(parent_device, stats, recorded_calls);
+		recorded_calls = 0;
+		if (!restore_deferred_context_state) {
+			compute_bindings = {};
+		}
+		if (command_list == nullptr) {
+			return S_FALSE;
+		}
+		*command_list = null_command_list.Detach();
+		return S_OK;
+	}
+
+	// ID3D11DeviceContext1
+	void NullDeviceContext::CopySubresourceRegion1(ID3D11Resource *dst_resource, UINT dst_subresource, UINT dst_x, UINT dst_y, UINT dst_z,
+													ID3D11Resource *src_resource, UINT src_subresource, const D3D11_BOX *src_box, UINT)
+	{
+		CopySubresourceRegion(dst_resource, dst_subresource, dst_x, dst_y, dst_z, src_resource, src_subresource, src_box);
+	}
+
+	void NullDeviceContext::UpdateSubresource1(ID3D11Resource *dst_resource, UINT dst_subresource, const D3D11_BOX *dst_box, const void *src_data, UINT src_row_pitch, UINT src_depth_pitch,
+												UINT)
+	{
+		UpdateSubresource(dst_resource, dst_subresource, dst_box, src_data, src_row_pitch, src_depth_pitch);
+	}
+
+	void NullDeviceContext::DiscardResource(ID3D11Resource *)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	void NullDeviceContext::DiscardView(ID3D11View *)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	void NullDeviceContext::VSSetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer *const *, const UINT *, const UINT *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::HSSetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer *const *, const UINT *, const UINT *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::DSSetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer *const *, const UINT *, const UINT *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::GSSetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer *const *, const UINT *, const UINT *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::PSSetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer *const *, const UINT *, const UINT *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+	}
+
+	void NullDeviceContext::CSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *)
+	{
+		record(NullDeviceCall::SetConstantBuffers, num_buffers);
+		for (UINT buffer_index = 0; buffer_index < num_buffers && start_slot + buffer_index < compute_bindings.constant_buffers.size(); ++buffer_index)
+		{
+			compute_bindings.constant_buffers[start_slot + buffer_index] = constant_buffers != nullptr ? constant_buffers[buffer_index] : nullptr;
+			// First constant counts 16 byte constants
+			compute_bindings.constant_buffer_offsets[start_slot + buffer_index] = first_constant != nullptr ? first_constant[buffer_index] * 16 : 0;
+		}
+	}
+
+	static void clear_constant_buffer_output(ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants, uint32_t count)
+	{
+		clear_output(constant_buffers, count);
+		if (first_constant) std::fill_n(first_constant, count, 0u);
+		if (num_constants) std::fill_n(num_constants, count, 0u);
+	}
+
+	void NullDeviceContext::VSGetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants)
+	{
+		clear_constant_buffer_output(constant_buffers, first_constant, num_constants, num_buffers);
+	}
+
+	void NullDeviceContext::HSGetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants)
+	{
+		clear_constant_buffer_output(constant_buffers, first_constant, num_constants, num_buffers);
+	}
+
+	void NullDeviceContext::DSGetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants)
+	{
+		clear_constant_buffer_output(constant_buffers, first_constant, num_constants, num_buffers);
+	}
+
+	void NullDeviceContext::GSGetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants)
+	{
+		clear_constant_buffer_output(constant_buffers, first_constant, num_constants, num_buffers);
+	}
+
+	void NullDeviceContext::PSGetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants)
+	{
+		clear_constant_buffer_output(constant_buffers, first_constant, num_constants, num_buffers);
+	}
+
+	void NullDeviceContext::CSGetConstantBuffers1(UINT, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants)
+	{
+		clear_constant_buffer_output(constant_buffers, first_constant, num_constants, num_buffers);
+	}
+
+	void NullDeviceContext::SwapDeviceContextState(ID3DDeviceContextState *, ID3DDeviceContextState **previous_state)
+	{
+		clear_output(previous_state, 1);
+	}
+
+	void NullDeviceContext::ClearView(ID3D11View *, const FLOAT[4], const D3D11_RECT *, UINT)
+	{
+		record(NullDeviceCall::Clear);
+	}
+
+	void NullDeviceContext::DiscardView1(ID3D11View *, const D3D11_RECT *, UINT)
+	{
+		record(NullDeviceCall::Other);
+	}
+
+	// Null device
+	NullDevice::NullDevice()
+	{
+		immediate_context = Microsoft::WRL::Make<NullDeviceContext>(this, &stats, D3D11_DEVICE_CONTEXT_IMMEDIATE, &compute_kernel);
+	}
+
+	ComPtr<NullDevice> NullDevice::create()
+	{
+		return Microsoft::WRL::Make<NullDevice>();
+	}
+
+	NullDeviceStats &NullDevice::get_stats()
+	{
+		return stats;
+	}
+
+	ID3D11DeviceContext *NullDevice::get_immediate_context() const
+	{
+		return immediate_context.Get();
+	}
+
+	void NullDevice::set_compute_kernel(NullComputeKernel kernel)
+	{
+		compute_kernel = std::move(kernel);
+	}
+
+	// Resources and views
+	HRESULT NullDevice::CreateBuffer(const D3D11_BUFFER_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Buffer **buffer)
+	{
+		stats.record_call(NullDeviceCall::CreateBuffer);
+		if (desc == nullptr || desc->ByteWidth == 0) {
+			return E_INVALIDARG;
+		}
+		if (buffer == nullptr) {
+			return S_FALSE;
+		}
+		*buffer = Microsoft::WRL::Make<NullBuffer>(this, &stats, *desc, initial_data).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateTexture1D(const D3D11_TEXTURE1D_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Texture1D **texture_1d)
+	{
+		stats.record_call(NullDeviceCall::CreateTexture);
+		if (desc == nullptr || desc->Width == 0 || desc->ArraySize == 0) {
+			return E_INVALIDARG;
+		}
+		if (texture_1d == nullptr) {
+			return S_FALSE;
+		}
+		*texture_1d = Microsoft::WRL::Make<NullTexture1D>(this, &stats, *desc, initial_data).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Texture2D **texture_2d)
+	{
+		stats.record_call(NullDeviceCall::CreateTexture);
+		if (desc == nullptr || desc->Width == 0 || desc->Height == 0 || desc->ArraySize == 0) {
+			return E_INVALIDARG;
+		}
+		if (texture_2d == nullptr) {
+			return S_FALSE;
+		}
+		*texture_2d = Microsoft::WRL::Make<NullTexture2D>(this, &stats, *desc, initial_data).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Texture3D **texture_3d)
+	{
+		stats.record_call(NullDeviceCall::CreateTexture);
+		if (desc == nullptr || desc->Width == 0 || desc->Height == 0 || desc->Depth == 0) {
+			return E_INVALIDARG;
+		}
+		if (texture_3d == nullptr) {
+			return S_FALSE;
+		}
+		*texture_3d = Microsoft::WRL::Make<NullTexture3D>(this, &stats, *desc, initial_data).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateShaderResourceView(ID3D11Resource *resource, const D3D11_SHADER_RESOURCE_VIEW_DESC *desc, ID3D11ShaderResourceView **srv)
+	{
+		stats.record_call(NullDeviceCall::CreateView);
+		if (resource == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (srv == nullptr) {
+			return S_FALSE;
+		}
+		*srv = Microsoft::WRL::Make<NullShaderResourceView>(this, &stats, resource, desc).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateUnorderedAccessView(ID3D11Resource *resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC *desc, ID3D11UnorderedAccessView **uav)
+	{
+		stats.record_call(NullDeviceCall::CreateView);
+		if (resource == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (uav == nullptr) {
+			return S_FALSE;
+		}
+		*uav = Microsoft::WRL::Make<NullUnorderedAccessView>(this, &stats, resource, desc).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateRenderTargetView(ID3D11Resource *resource, const D3D11_RENDER_TARGET_VIEW_DESC *desc, ID3D11RenderTargetView **rtv)
+	{
+		stats.record_call(NullDeviceCall::CreateView);
+		if (resource == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (rtv == nullptr) {
+			return S_FALSE;
+		}
+		*rtv = Microsoft::WRL::Make<NullRenderTargetView>(this, &stats, resource, desc).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateDepthStencilView(ID3D11Resource *resource, const D3D11_DEPTH_STENCIL_VIEW_DESC *desc, ID3D11DepthStencilView **dsv)
+	{
+		stats.record_call(NullDeviceCall::CreateView);
+		if (resource == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (dsv == nullptr) {
+			return S_FALSE;
+		}
+		*dsv = Microsoft::WRL::Make<NullDepthStencilView>(this, &stats, resource, desc).Detach();
+		return S_OK;
+	}
+
+	// Shaders and input layout
+	HRESULT NullDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC *input_element_descs, UINT num_elements, const void *,
+										SIZE_T, ID3D11InputLayout **input_layout)
+	{
+		stats.record_call(NullDeviceCall::CreateInputLayout);
+		if (input_element_descs == nullptr && num_elements != 0) {
+			return E_INVALIDARG;
+		}
+		if (input_layout == nullptr) {
+			return S_FALSE;
+		}
+		*input_layout = Microsoft::WRL::Make<NullInputLayout>(this, &stats, input_element_descs, num_elements).Detach();
+		return S_OK;
+	}
+
+	template <typename Interface>
+	static HRESULT create_null_shader(ID3D11Device *device, NullDeviceStats *stats, const void *shader_bytecode, SIZE_T bytecode_length, Interface **shader)
+	{
+		stats->record_call(NullDeviceCall::CreateShader);
+		if (shader_bytecode == nullptr || bytecode_length == 0) {
+			return E_INVALIDARG;
+		}
+		if (shader == nullptr) {
+			return S_FALSE;
+		}
+		*shader = Microsoft::WRL::Make<NullShader<Interface>>(device, stats, bytecode_length).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateVertexShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *, ID3D11VertexShader **vertex_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, vertex_shader);
+	}
+
+	HRESULT NullDevice::CreateGeometryShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *, ID3D11GeometryShader **geometry_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, geometry_shader);
+	}
+
+	HRESULT NullDevice::CreateGeometryShaderWithStreamOutput(const void *shader_bytecode, SIZE_T bytecode_length, const D3D11_SO_DECLARATION_ENTRY *, UINT,
+															const UINT *, UINT, UINT, ID3D11ClassLinkage *,
+															ID3D11GeometryShader **geometry_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, geometry_shader);
+	}
+
+	HRESULT NullDevice::CreatePixelShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *, ID3D11PixelShader **pixel_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, pixel_shader);
+	}
+
+	HRESULT NullDevice::CreateHullShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *, ID3D11HullShader **hull_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, hull_shader);
+	}
+
+	HRESULT NullDevice::CreateDomainShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *, ID3D11DomainShader **domain_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, domain_shader);
+	}
+
+	HRESULT NullDevice::CreateComputeShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *, ID3D11ComputeShader **compute_shader)
+	{
+		return create_null_shader(this, &stats, shader_bytecode, bytecode_length, compute_shader);
+	}
+
+	HRESULT NullDevice::CreateClassLinkage(ID3D11ClassLinkage **)
+	{
+		return E_NOTIMPL;
+	}
+
+	// States
+	HRESULT NullDevice::CreateBlendState(const D3D11_BLEND_DESC *blend_state_desc, ID3D11BlendState **blend_state)
+	{
+		stats.record_call(NullDeviceCall::CreateState);
+		if (blend_state_desc == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (blend_state == nullptr) {
+			return S_FALSE;
+		}
+		*blend_state = Microsoft::WRL::Make<NullBlendState>(this, &stats, *blend_state_desc).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC *depth_stencil_desc, ID3D11DepthStencilState **depth_stencil_state)
+	{
+		stats.record_call(NullDeviceCall::CreateState);
+		if (depth_stencil_desc == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (depth_stencil_state == nullptr) {
+			return S_FALSE;
+		}
+		*depth_stencil_state = Microsoft::WRL::Make<NullDepthStencilState>(this, &stats, *depth_stencil_desc).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC *rasterizer_desc, ID3D11RasterizerState **rasterizer_state)
+	{
+		stats.record_call(NullDeviceCall::CreateState);
+		if (rasterizer_desc == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (rasterizer_state == nullptr) {
+			return S_FALSE;
+		}
+		*rasterizer_state = Microsoft::WRL::Make<NullRasterizerState>(this, &stats, *rasterizer_desc).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CreateSamplerState(const D3D11_SAMPLER_DESC *sampler_desc, ID3D11SamplerState **sampler_state)
+	{
+		stats.record_call(NullDeviceCall::CreateState);
+		if (sampler_desc == nullptr) {
+			return E_INVALIDARG;
+		}
+		if (sampler_state == nullptr) {
+			return S_FALSE;
+		}
+		*sampler_state = Microsoft::WRL::Make<NullSamplerState>(this, &stats, *sampler_desc).Detach();
+		return S_OK;
+	}
+
+	// Queries, counters and contexts
+	HRESULT NullDevice::CreateQuery(const D3D11_QUERY_DESC *, ID3D11Query **)
+	{
+		return E_NOTIMPL;
+	}
+
+	HRESULT NullDevice::CreatePredicate(const D3D11_QUERY_DESC *, ID3D11Predicate **)
+	{
+		return E_NOTIMPL;
+	}
+
+	HRESULT NullDevice::CreateCounter(const D3D11_COUNTER_DESC *, ID3D11Counter **)
+	{
+		return E_NOTIMPL;
+	}
+
+	HRESULT NullDevice::CreateDeferredContext(UINT, ID3D11DeviceContext **deferred_context)
+	{
+		if (deferred_context == nullptr) {
+			return E_INVALIDARG;
+		}
+		*deferred_context = Microsoft::WRL::Make<NullDeviceContext>(this, &stats, D3D11_DEVICE_CONTEXT_DEFERRED, &compute_kernel).Detach();
+		return S_OK;
+	}
+
+	HRESULT NullDevice::OpenSharedResource(HANDLE, REFIID, void **)
+	{
+		return E_NOTIMPL;
+	}
+
+	// Capabilities
+	HRESULT NullDevice::CheckFormatSupport(DXGI_FORMAT, UINT *format_support)
+	{
+		if (format_support == nullptr) {
+			return E_INVALIDARG;
+		}
+		*format_support = 0xffffffff;
+		return S_OK;
+	}
+
+	HRESULT NullDevice::CheckMultisampleQualityLevels(DXGI_FORMAT, UINT sample_count, UINT *num_quality_levels)
+	{
+		if (num_quality_levels == nullptr) {
+			return E_INVALIDARG;
+		}
+		*num_quality_levels = sample_count == 1 ? 1 : 0;
+		return S_OK;
+	}
+
+	void NullDevice::CheckCounterInfo(D3D11_COUNTER_INFO *counter_info)
+	{
+		if (counter_info) *counter_info = {};
+	}
+
+	HRESULT NullDevice::CheckCounter(const D3D11_COUNTER_DESC *, D3D11_COUNTER_TYPE *, UINT *, LPSTR, UINT *,
+									LPSTR, UINT *, LPSTR, UINT *)
+	{
+		return E_NOTIMPL;
+	}
+
+	HRESULT NullDevice::CheckFeatureSupport(D3D11_FEATURE feature, void *feature_support_data, UINT feature_support_data_size)
+	{
+		if (feature == D3D11_FEATURE_THREADING && feature_support_data_size == sizeof(D3D11_FEATURE_DATA_THREADING)) {
+			auto threading = static_cast<D3D11_FEATURE_DATA_THREADING *>(feature_support_data);
+			threading->DriverConcurrentCreates = TRUE;
+			threading->DriverCommandLists = TRUE;
+			return S_OK;
+		}
+		if (feature == D3D11_FEATURE_D3D11_OPTIONS && feature_support_data_size == sizeof(D3D11_FEATURE_DATA_D3D11_OPTIONS)) {
+			auto options = static_cast<D3D11_FEATURE_DATA_D3D11_OPTIONS *>(feature_support_data);
+			*options = {};
+			options->ConstantBufferOffsetting = TRUE;
+			options->ConstantBufferPartialUpdate = TRUE;
+			options->MapNoOverwriteOnDynamicConstantBuffer = TRUE;
+			return S_OK;
+		}
+		return E_NOTIMPL;
+	}
+
+	// Device
+	HRESULT NullDevice::GetPrivateData(REFGUID, UINT *, void *)
+	{
+		return DXGI_ERROR_NOT_FOUND;
+	}
+
+	HRESULT NullDevice::SetPrivateData(REFGUID, UINT, const void *)
+	{
+		return S_OK;
+	}
+
+	HRESULT NullDevice::SetPrivateDataInterface(REFGUID, const IUnknown *)
+	{
+		return S_OK;
+	}
+
+	D3D_FEATURE_LEVEL NullDevice::GetFeatureLevel()
+	{
+		return D3D_FEATURE_LEVEL_11_1;
+	}
+
+	UINT NullDevice::GetCreationFlags()
+	{
+		return 0;
+	}
+
+	HRESULT NullDevice::GetDeviceRemovedReason()
+	{
+		return S_OK;
+	}
+
+	void NullDevice::GetImmediateContext(ID3D11DeviceContext **context)
+	{
+		immediate_context.CopyTo(context);
+	}
+
+	HRESULT NullDevice::SetExceptionMode(UINT)
+	{
+		return S_OK;
+	}
+
+	UINT NullDevice::GetExceptionMode()
+	{
+		return 0;
+	}
+}
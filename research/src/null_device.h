@@ -0,0 +1,678 @@
+//
+// Created by ZZK on 2024/10/21.
+//
+
+#pragma once
+
+#include <effect.h>
+#include <atomic>
+#include <functional>
+#include <wrl/implements.h>
+#include <d3d11_1.h>
+
+namespace toy
+{
+	// Null device call category
+	enum class NullDeviceCall : uint32_t
+	{
+		CreateBuffer = 0,
+		CreateTexture,
+		CreateView,
+		CreateShader,
+		CreateInputLayout,
+		CreateState,
+		Map,
+		Unmap,
+		UpdateSubresource,
+		CopyResource,
+		SetShader,
+		SetConstantBuffers,
+		SetShaderResources,
+		SetSamplers,
+		SetUnorderedAccessViews,
+		SetInputLayout,
+		SetVertexBuffers,
+		SetIndexBuffer,
+		SetPrimitiveTopology,
+		SetRenderTargets,
+		SetRasterizerState,
+		SetDepthStencilState,
+		SetBlendState,
+		SetViewports,
+		Draw,
+		Dispatch,
+		Clear,
+		ExecuteCommandList,
+		Other,
+		Count
+	};
+
+	// Null device object category
+	enum class NullObjectType : uint32_t
+	{
+		Buffer = 0,
+		Texture,
+		ShaderResourceView,
+		UnorderedAccessView,
+		RenderTargetView,
+		DepthStencilView,
+		Shader,
+		InputLayout,
+		PipelineState,
+		SamplerState,
+		CommandList,
+		DeferredContext,
+		Count
+	};
+
+	// Call, byte and object accounting shared by a null device and everything it creates
+	struct NullDeviceStats
+	{
+		std::array<std::atomic<uint64_t>, static_cast<size_t>(NullDeviceCall::Count)> call_counts{};
+		std::array<std::atomic<uint64_t>, static_cast<size_t>(NullObjectType::Count)> objects_created{};
+		std::array<std::atomic<int64_t>, static_cast<size_t>(NullObjectType::Count)> objects_alive{};
+		std::atomic<uint64_t> slots_bound{ 0 };
+		// Subresource bytes behind maps that rename or read, no overwrite maps only append and aren't counted
+		std::atomic<uint64_t> bytes_mapped{ 0 };
+		std::atomic<uint64_t> bytes_updated{ 0 };
+		std::atomic<uint64_t> bytecode_bytes{ 0 };
+		std::atomic<uint64_t> thread_groups_dispatched{ 0 };
+		std::atomic<int64_t> buffer_bytes_alive{ 0 };
+		std::atomic<int64_t> buffer_bytes_peak{ 0 };
+		std::atomic<int64_t> texture_bytes_alive{ 0 };
+		std::atomic<int64_t> texture_bytes_peak{ 0 };
+
+		void record_call(NullDeviceCall call, uint64_t count = 1);
+
+		void record_object_created(NullObjectType object_type);
+
+		void record_object_destroyed(NullObjectType object_type);
+
+		void record_buffer_memory(int64_t size_in_bytes);
+
+		void record_texture_memory(int64_t size_in_bytes);
+
+		[[nodiscard]] uint64_t query_call_count(NullDeviceCall call) const;
+
+		[[nodiscard]] uint64_t query_objects_created(NullObjectType object_type) const;
+
+		[[nodiscard]] int64_t query_objects_alive(NullObjectType object_type) const;
+
+		// Reset call and byte counters, live objects and memory are kept
+		void reset();
+
+		void print() const;
+	};
+
+	// Subresource layout inside the cpu side storage of a null resource
+	struct NullSubresource
+	{
+		uint32_t offset = 0;
+		uint32_t element_size = 0;
+		uint32_t row_pitch = 0;
+		uint32_t depth_pitch = 0;
+		uint32_t rows = 0;
+		uint32_t slices = 0;
+		uint32_t size_in_bytes = 0;
+	};
+
+	// Cpu side storage of a null resource, mapped memory points straight into it
+	struct NullResourceStorage
+	{
+		std::vector<uint8_t> storage{};
+		std::vector<NullSubresource> subresources{};
+
+		[[nodiscard]] const NullSubresource *query_subresource(uint32_t subresource) const;
+
+		[[nodiscard]] uint8_t *query_data(uint32_t subresource);
+	};
+
+	size_t build_null_texture_layout(uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, DXGI_FORMAT format,
+									std::vector<NullSubresource> &subresources);
+
+	// Private data a null resource answers with the address of its storage, resources of other devices don't know the guid
+	inline constexpr GUID null_resource_storage_guid = { 0x6f3c1a52, 0x3d0e, 0x4b8a, { 0x9e, 0x41, 0x27, 0x5c, 0x80, 0xd2, 0x13, 0xaf } };
+
+	// Get cpu side storage behind a resource created by a null device, nullptr for any other resource
+	NullResourceStorage *query_null_resource_storage(ID3D11Resource *resource);
+
+	// Device child part shared by every null object
+	template <typename Interface, NullObjectType object_type>
+	struct NullDeviceChild : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, Interface>
+	{
+	protected:
+		ComPtr<ID3D11Device> parent_device = nullptr;
+		NullDeviceStats *stats = nullptr;
+
+	public:
+		NullDeviceChild(ID3D11Device *device, NullDeviceStats *device_stats)
+		: parent_device(device), stats(device_stats)
+		{
+			stats->record_object_created(object_type);
+		}
+
+		~NullDeviceChild()
+		{
+			stats->record_object_destroyed(object_type);
+		}
+
+		void STDMETHODCALLTYPE GetDevice(ID3D11Device **device) override
+		{
+			parent_device.CopyTo(device);
+		}
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT *, void *) override
+		{
+			return DXGI_ERROR_NOT_FOUND;
+		}
+
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void *) override
+		{
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown *) override
+		{
+			return S_OK;
+		}
+	};
+
+	// Null resource
+	template <typename Interface, typename Desc, D3D11_RESOURCE_DIMENSION resource_dimension, NullObjectType object_type>
+	struct NullResource : NullDeviceChild<Interface, object_type>, NullResourceStorage
+	{
+	protected:
+		Desc resource_desc{};
+
+	public:
+		NullResource(ID3D11Device *device, NullDeviceStats *device_stats, const Desc &desc)
+		: NullDeviceChild<Interface, object_type>(device, device_stats), resource_desc(desc)
+		{
+
+		}
+
+		~NullResource()
+		{
+			record_memory(-static_cast<int64_t>(storage.size()));
+		}
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT *data_size, void *data) override
+		{
+			if (guid != null_resource_storage_guid || data_size == nullptr) {
+				return DXGI_ERROR_NOT_FOUND;
+			}
+			NullResourceStorage *resource_storage = this;
+			if (data == nullptr) {
+				*data_size = sizeof(resource_storage);
+				return S_OK;
+			}
+			if (*data_size < sizeof(resource_storage)) {
+				return DXGI_ERROR_MORE_DATA;
+			}
+			*data_size = sizeof(resource_storage);
+			std::memcpy(data, &resource_storage, sizeof(resource_storage));
+			return S_OK;
+		}
+
+		void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION *dimension) override
+		{
+			*dimension = resource_dimension;
+		}
+
+		void STDMETHODCALLTYPE SetEvictionPriority(UINT) override
+		{
+
+		}
+
+		UINT STDMETHODCALLTYPE GetEvictionPriority() override
+		{
+			return DXGI_RESOURCE_PRIORITY_NORMAL;
+		}
+
+		void STDMETHODCALLTYPE GetDesc(Desc *desc) override
+		{
+			*desc = resource_desc;
+		}
+
+	protected:
+		void allocate_storage(size_t size_in_bytes, const D3D11_SUBRESOURCE_DATA *initial_data)
+		{
+			storage.resize(size_in_bytes);
+			record_memory(static_cast<int64_t>(size_in_bytes));
+			if (initial_data == nullptr) {
+				return;
+			}
+
+			for (uint32_t index = 0; index < static_cast<uint32_t>(subresources.size()); ++index)
+			{
+				auto &&subresource = subresources[index];
+				auto &&source = initial_data[index];
+				if (source.pSysMem == nullptr) {
+					continue;
+				}
+				const uint32_t src_row_pitch = source.SysMemPitch != 0 ? source.SysMemPitch : subresource.row_pitch;
+				const uint32_t src_depth_pitch = source.SysMemSlicePitch != 0 ? source.SysMemSlicePitch : src_row_pitch * subresource.rows;
+				const uint32_t row_size = (std::min)(src_row_pitch, subresource.row_pitch);
+				auto src_data = static_cast<const uint8_t *>(source.pSysMem);
+				for (uint32_t slice = 0; slice < subresource.slices; ++slice)
+				{
+					for (uint32_t row = 0; row < subresource.rows; ++row)
+					{
+						std::memcpy(storage.data() + subresource.offset + slice * subresource.depth_pitch + row * subresource.row_pitch,
+									src_data + slice * src_depth_pitch + row * src_row_pitch, row_size);
+					}
+				}
+			}
+		}
+
+	private:
+		void record_memory(int64_t size_in_bytes)
+		{
+			if constexpr (resource_dimension == D3D11_RESOURCE_DIMENSION_BUFFER) {
+				this->stats->record_buffer_memory(size_in_bytes);
+			} else {
+				this->stats->record_texture_memory(size_in_bytes);
+			}
+		}
+	};
+
+	struct NullBuffer final : NullResource<ID3D11Buffer, D3D11_BUFFER_DESC, D3D11_RESOURCE_DIMENSION_BUFFER, NullObjectType::Buffer>
+	{
+		NullBuffer(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_BUFFER_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data);
+	};
+
+	struct NullTexture1D final : NullResource<ID3D11Texture1D, D3D11_TEXTURE1D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE1D, NullObjectType::Texture>
+	{
+		NullTexture1D(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_TEXTURE1D_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data);
+	};
+
+	struct NullTexture2D final : NullResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE2D, NullObjectType::Texture>
+	{
+		NullTexture2D(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_TEXTURE2D_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data);
+	};
+
+	struct NullTexture3D final : NullResource<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE3D, NullObjectType::Texture>
+	{
+		NullTexture3D(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_TEXTURE3D_DESC &desc, const D3D11_SUBRESOURCE_DATA *initial_data);
+	};
+
+	// Null view, keeps its resource alive like a real view does
+	template <typename Interface, typename Desc, NullObjectType object_type>
+	struct NullView final : NullDeviceChild<Interface, object_type>
+	{
+	private:
+		ComPtr<ID3D11Resource> view_resource = nullptr;
+		Desc view_desc{};
+
+	public:
+		NullView(ID3D11Device *device, NullDeviceStats *device_stats, ID3D11Resource *resource, const Desc *desc)
+		: NullDeviceChild<Interface, object_type>(device, device_stats), view_resource(resource)
+		{
+			if (desc != nullptr) {
+				view_desc = *desc;
+			}
+		}
+
+		void STDMETHODCALLTYPE GetResource(ID3D11Resource **resource) override
+		{
+			view_resource.CopyTo(resource);
+		}
+
+		void STDMETHODCALLTYPE GetDesc(Desc *desc) override
+		{
+			*desc = view_desc;
+		}
+	};
+
+	using NullShaderResourceView = NullView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC, NullObjectType::ShaderResourceView>;
+	using NullUnorderedAccessView = NullView<ID3D11UnorderedAccessView, D3D11_UNORDERED_ACCESS_VIEW_DESC, NullObjectType::UnorderedAccessView>;
+	using NullRenderTargetView = NullView<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC, NullObjectType::RenderTargetView>;
+	using NullDepthStencilView = NullView<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC, NullObjectType::DepthStencilView>;
+
+	// Null shader, only the bytecode size is kept
+	template <typename Interface>
+	struct NullShader final : NullDeviceChild<Interface, NullObjectType::Shader>
+	{
+	private:
+		size_t bytecode_size = 0;
+
+	public:
+		NullShader(ID3D11Device *device, NullDeviceStats *device_stats, size_t bytecode_length)
+		: NullDeviceChild<Interface, NullObjectType::Shader>(device, device_stats), bytecode_size(bytecode_length)
+		{
+			this->stats->bytecode_bytes.fetch_add(bytecode_length, std::memory_order_relaxed);
+		}
+
+		[[nodiscard]] size_t query_bytecode_size() const
+		{
+			return bytecode_size;
+		}
+	};
+
+	// Null pipeline and sampler state
+	template <typename Interface, typename Desc, NullObjectType object_type>
+	struct NullState final : NullDeviceChild<Interface, object_type>
+	{
+	private:
+		Desc state_desc{};
+
+	public:
+		NullState(ID3D11Device *device, NullDeviceStats *device_stats, const Desc &desc)
+		: NullDeviceChild<Interface, object_type>(device, device_stats), state_desc(desc)
+		{
+
+		}
+
+		void STDMETHODCALLTYPE GetDesc(Desc *desc) override
+		{
+			*desc = state_desc;
+		}
+	};
+
+	using NullBlendState = NullState<ID3D11BlendState, D3D11_BLEND_DESC, NullObjectType::PipelineState>;
+	using NullDepthStencilState = NullState<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC, NullObjectType::PipelineState>;
+	using NullRasterizerState = NullState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC, NullObjectType::PipelineState>;
+	using NullSamplerState = NullState<ID3D11SamplerState, D3D11_SAMPLER_DESC, NullObjectType::SamplerState>;
+
+	// Null input layout, keeps a copy of its element list for inspection
+	struct NullInputLayout final : NullDeviceChild<ID3D11InputLayout, NullObjectType::InputLayout>
+	{
+	private:
+		std::vector<D3D11_INPUT_ELEMENT_DESC> input_elements{};
+		std::vector<std::string> semantic_names{};
+
+	public:
+		NullInputLayout(ID3D11Device *device, NullDeviceStats *device_stats, const D3D11_INPUT_ELEMENT_DESC *input_element_descs, uint32_t num_elements);
+
+		[[nodiscard]] std::span<const D3D11_INPUT_ELEMENT_DESC> query_input_elements() const;
+	};
+
+	// Null command list, records how many calls the deferred context captured
+	struct NullCommandList final : NullDeviceChild<ID3D11CommandList, NullObjectType::CommandList>
+	{
+	private:
+		uint64_t recorded_calls = 0;
+
+	public:
+		NullCommandList(ID3D11Device *device, NullDeviceStats *device_stats, uint64_t call_count);
+
+		UINT STDMETHODCALLTYPE GetContextFlags() override;
+
+		[[nodiscard]] uint64_t query_recorded_calls() const;
+	};
+
+	struct NullDevice;
+
+	// Compute stage of a null device context at a dispatch, views and buffers are not referenced
+	struct NullComputeDispatch
+	{
+		ID3D11DeviceContext *device_context = nullptr;
+		ID3D11ComputeShader *compute_shader = nullptr;
+		std::array<uint32_t, 3> thread_group_counts{};
+		std::array<ID3D11Buffer *, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> constant_buffers{};
+		// Byte offset of each bound constant buffer range, non zero only for CSSetConstantBuffers1
+		std::array<uint32_t, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> constant_buffer_offsets{};
+		std::array<ID3D11ShaderResourceView *, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> shader_resource_views{};
+		std::array<ID3D11UnorderedAccessView *, D3D11_1_UAV_SLOT_COUNT> unordered_access_views{};
+	};
+
+	// Stands in for the gpu on every dispatch when set, so the cpu side of gpu driven passes can be checked headless
+	// Runs when the dispatch is recorded, also on deferred contexts
+	using NullComputeKernel = std::function<void(const NullComputeDispatch &)>;
+
+	// Null device context, every call is counted and nothing reaches a gpu
+	struct NullDeviceContext final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+																Microsoft::WRL::ChainInterfaces<ID3D11DeviceContext1, ID3D11DeviceContext, ID3D11DeviceChild>>
+	{
+	private:
+		// The immediate context does not keep its device alive, deferred contexts do
+		ID3D11Device *parent_device = nullptr;
+		ComPtr<ID3D11Device> parent_device_ref = nullptr;
+		NullDeviceStats *stats = nullptr;
+		D3D11_DEVICE_CONTEXT_TYPE context_type = D3D11_DEVICE_CONTEXT_IMMEDIATE;
+		uint64_t recorded_calls = 0;
+		const NullComputeKernel *compute_kernel = nullptr;
+		NullComputeDispatch compute_bindings{};
+
+	public:
+		NullDeviceContext(ID3D11Device *device, NullDeviceStats *device_stats, D3D11_DEVICE_CONTEXT_TYPE type, const NullComputeKernel *device_compute_kernel);
+
+		~NullDeviceContext();
+
+		// ID3D11DeviceChild
+		void STDMETHODCALLTYPE GetDevice(ID3D11Device **device) override;
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT *data_size, void *data) override;
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT data_size, const void *data) override;
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown *data) override;
+
+		// Shader stages
+		void STDMETHODCALLTYPE VSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers) override;
+		void STDMETHODCALLTYPE PSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views) override;
+		void STDMETHODCALLTYPE PSSetShader(ID3D11PixelShader *pixel_shader, ID3D11ClassInstance *const *class_instances, UINT num_class_instances) override;
+		void STDMETHODCALLTYPE PSSetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState *const *samplers) override;
+		void STDMETHODCALLTYPE VSSetShader(ID3D11VertexShader *vertex_shader, ID3D11ClassInstance *const *class_instances, UINT num_class_instances) override;
+		void STDMETHODCALLTYPE PSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers) override;
+		void STDMETHODCALLTYPE GSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers) override;
+		void STDMETHODCALLTYPE GSSetShader(ID3D11GeometryShader *geometry_shader, ID3D11ClassInstance *const *class_instances, UINT num_class_instances) override;
+		void STDMETHODCALLTYPE VSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views) override;
+		void STDMETHODCALLTYPE VSSetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState *const *samplers) override;
+		void STDMETHODCALLTYPE GSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views) override;
+		void STDMETHODCALLTYPE GSSetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState *const *samplers) override;
+		void STDMETHODCALLTYPE HSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views) override;
+		void STDMETHODCALLTYPE HSSetShader(ID3D11HullShader *hull_shader, ID3D11ClassInstance *const *class_instances, UINT num_class_instances) override;
+		void STDMETHODCALLTYPE HSSetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState *const *samplers) override;
+		void STDMETHODCALLTYPE HSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers) override;
+		void STDMETHODCALLTYPE DSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views) override;
+		void STDMETHODCALLTYPE DSSetShader(ID3D11DomainShader *domain_shader, ID3D11ClassInstance *const *class_instances, UINT num_class_instances) override;
+		void STDMETHODCALLTYPE DSSetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState *const *samplers) override;
+		void STDMETHODCALLTYPE DSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers) override;
+		void STDMETHODCALLTYPE CSSetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView *const *shader_resource_views) override;
+		void STDMETHODCALLTYPE CSSetUnorderedAccessViews(UINT start_slot, UINT num_uavs, ID3D11UnorderedAccessView *const *unordered_access_views, const UINT *uav_initial_counts) override;
+		void STDMETHODCALLTYPE CSSetShader(ID3D11ComputeShader *compute_shader, ID3D11ClassInstance *const *class_instances, UINT num_class_instances) override;
+		void STDMETHODCALLTYPE CSSetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState *const *samplers) override;
+		void STDMETHODCALLTYPE CSSetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers) override;
+
+		// Draw and dispatch
+		void STDMETHODCALLTYPE DrawIndexed(UINT index_count, UINT start_index_location, INT base_vertex_location) override;
+		void STDMETHODCALLTYPE Draw(UINT vertex_count, UINT start_vertex_location) override;
+		void STDMETHODCALLTYPE DrawIndexedInstanced(UINT index_count_per_instance, UINT instance_count, UINT start_index_location, INT base_vertex_location, UINT start_instance_location) override;
+		void STDMETHODCALLTYPE DrawInstanced(UINT vertex_count_per_instance, UINT instance_count, UINT start_vertex_location, UINT start_instance_location) override;
+		void STDMETHODCALLTYPE DrawAuto() override;
+		void STDMETHODCALLTYPE DrawIndexedInstancedIndirect(ID3D11Buffer *buffer_for_args, UINT aligned_byte_offset_for_args) override;
+		void STDMETHODCALLTYPE DrawInstancedIndirect(ID3D11Buffer *buffer_for_args, UINT aligned_byte_offset_for_args) override;
+		void STDMETHODCALLTYPE Dispatch(UINT thread_group_count_x, UINT thread_group_count_y, UINT thread_group_count_z) override;
+		void STDMETHODCALLTYPE DispatchIndirect(ID3D11Buffer *buffer_for_args, UINT aligned_byte_offset_for_args) override;
+
+		// Resource access
+		HRESULT STDMETHODCALLTYPE Map(ID3D11Resource *resource, UINT subresource, D3D11_MAP map_type, UINT map_flags, D3D11_MAPPED_SUBRESOURCE *mapped_resource) override;
+		void STDMETHODCALLTYPE Unmap(ID3D11Resource *resource, UINT subresource) override;
+		void STDMETHODCALLTYPE CopySubresourceRegion(ID3D11Resource *dst_resource, UINT dst_subresource, UINT dst_x, UINT dst_y, UINT dst_z,
+													ID3D11Resource *src_resource, UINT src_subresource, const D3D11_BOX *src_box) override;
+		void STDMETHODCALLTYPE CopyResource(ID3D11Resource *dst_resource, ID3D11Resource *src_resource) override;
+		void STDMETHODCALLTYPE UpdateSubresource(ID3D11Resource *dst_resource, UINT dst_subresource, const D3D11_BOX *dst_box, const void *src_data, UINT src_row_pitch, UINT src_depth_pitch) override;
+		void STDMETHODCALLTYPE CopyStructureCount(ID3D11Buffer *dst_buffer, UINT dst_aligned_byte_offset, ID3D11UnorderedAccessView *src_view) override;
+		void STDMETHODCALLTYPE ClearRenderTargetView(ID3D11RenderTargetView *render_target_view, const FLOAT color_rgba[4]) override;
+		void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView *unordered_access_view, const UINT values[4]) override;
+		void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView *unordered_access_view, const FLOAT values[4]) override;
+		void STDMETHODCALLTYPE ClearDepthStencilView(ID3D11DepthStencilView *depth_stencil_view, UINT clear_flags, FLOAT depth, UINT8 stencil) override;
+		void STDMETHODCALLTYPE GenerateMips(ID3D11ShaderResourceView *shader_resource_view) override;
+		void STDMETHODCALLTYPE SetResourceMinLOD(ID3D11Resource *resource, FLOAT min_lod) override;
+		FLOAT STDMETHODCALLTYPE GetResourceMinLOD(ID3D11Resource *resource) override;
+		void STDMETHODCALLTYPE ResolveSubresource(ID3D11Resource *dst_resource, UINT dst_subresource, ID3D11Resource *src_resource, UINT src_subresource, DXGI_FORMAT format) override;
+
+		// Input assembler, rasterizer and output merger
+		void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout *input_layout) override;
+		void STDMETHODCALLTYPE IASetVertexBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *vertex_buffers, const UINT *strides, const UINT *offsets) override;
+		void STDMETHODCALLTYPE IASetIndexBuffer(ID3D11Buffer *index_buffer, DXGI_FORMAT format, UINT offset) override;
+		void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+		void STDMETHODCALLTYPE OMSetRenderTargets(UINT num_views, ID3D11RenderTargetView *const *render_target_views, ID3D11DepthStencilView *depth_stencil_view) override;
+		void STDMETHODCALLTYPE OMSetRenderTargetsAndUnorderedAccessViews(UINT num_rtvs, ID3D11RenderTargetView *const *render_target_views, ID3D11DepthStencilView *depth_stencil_view,
+																		UINT uav_start_slot, UINT num_uavs, ID3D11UnorderedAccessView *const *unordered_access_views, const UINT *uav_initial_counts) override;
+		void STDMETHODCALLTYPE OMSetBlendState(ID3D11BlendState *blend_state, const FLOAT blend_factor[4], UINT sample_mask) override;
+		void STDMETHODCALLTYPE OMSetDepthStencilState(ID3D11DepthStencilState *depth_stencil_state, UINT stencil_ref) override;
+		void STDMETHODCALLTYPE SOSetTargets(UINT num_buffers, ID3D11Buffer *const *so_targets, const UINT *offsets) override;
+		void STDMETHODCALLTYPE RSSetState(ID3D11RasterizerState *rasterizer_state) override;
+		void STDMETHODCALLTYPE RSSetViewports(UINT num_viewports, const D3D11_VIEWPORT *viewports) override;
+		void STDMETHODCALLTYPE RSSetScissorRects(UINT num_rects, const D3D11_RECT *rects) override;
+
+		// Queries and predication
+		void STDMETHODCALLTYPE Begin(ID3D11Asynchronous *async) override;
+		void STDMETHODCALLTYPE End(ID3D11Asynchronous *async) override;
+		HRESULT STDMETHODCALLTYPE GetData(ID3D11Asynchronous *async, void *data, UINT data_size, UINT get_data_flags) override;
+		void STDMETHODCALLTYPE SetPredication(ID3D11Predicate *predicate, BOOL predicate_value) override;
+		void STDMETHODCALLTYPE GetPredication(ID3D11Predicate **predicate, BOOL *predicate_value) override;
+
+		// State getters, the null context does not track bindings so they all return empty state
+		void STDMETHODCALLTYPE VSGetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers) override;
+		void STDMETHODCALLTYPE PSGetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView **shader_resource_views) override;
+		void STDMETHODCALLTYPE PSGetShader(ID3D11PixelShader **pixel_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances) override;
+		void STDMETHODCALLTYPE PSGetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState **samplers) override;
+		void STDMETHODCALLTYPE VSGetShader(ID3D11VertexShader **vertex_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances) override;
+		void STDMETHODCALLTYPE PSGetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers) override;
+		void STDMETHODCALLTYPE IAGetInputLayout(ID3D11InputLayout **input_layout) override;
+		void STDMETHODCALLTYPE IAGetVertexBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **vertex_buffers, UINT *strides, UINT *offsets) override;
+		void STDMETHODCALLTYPE IAGetIndexBuffer(ID3D11Buffer **index_buffer, DXGI_FORMAT *format, UINT *offset) override;
+		void STDMETHODCALLTYPE GSGetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers) override;
+		void STDMETHODCALLTYPE GSGetShader(ID3D11GeometryShader **geometry_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances) override;
+		void STDMETHODCALLTYPE IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY *topology) override;
+		void STDMETHODCALLTYPE VSGetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView **shader_resource_views) override;
+		void STDMETHODCALLTYPE VSGetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState **samplers) override;
+		void STDMETHODCALLTYPE GSGetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView **shader_resource_views) override;
+		void STDMETHODCALLTYPE GSGetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState **samplers) override;
+		void STDMETHODCALLTYPE OMGetRenderTargets(UINT num_views, ID3D11RenderTargetView **render_target_views, ID3D11DepthStencilView **depth_stencil_view) override;
+		void STDMETHODCALLTYPE OMGetRenderTargetsAndUnorderedAccessViews(UINT num_rtvs, ID3D11RenderTargetView **render_target_views, ID3D11DepthStencilView **depth_stencil_view,
+																		UINT uav_start_slot, UINT num_uavs, ID3D11UnorderedAccessView **unordered_access_views) override;
+		void STDMETHODCALLTYPE OMGetBlendState(ID3D11BlendState **blend_state, FLOAT blend_factor[4], UINT *sample_mask) override;
+		void STDMETHODCALLTYPE OMGetDepthStencilState(ID3D11DepthStencilState **depth_stencil_state, UINT *stencil_ref) override;
+		void STDMETHODCALLTYPE SOGetTargets(UINT num_buffers, ID3D11Buffer **so_targets) override;
+		void STDMETHODCALLTYPE RSGetState(ID3D11RasterizerState **rasterizer_state) override;
+		void STDMETHODCALLTYPE RSGetViewports(UINT *num_viewports, D3D11_VIEWPORT *viewports) override;
+		void STDMETHODCALLTYPE RSGetScissorRects(UINT *num_rects, D3D11_RECT *rects) override;
+		void STDMETHODCALLTYPE HSGetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView **shader_resource_views) override;
+		void STDMETHODCALLTYPE HSGetShader(ID3D11HullShader **hull_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances) override;
+		void STDMETHODCALLTYPE HSGetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState **samplers) override;
+		void STDMETHODCALLTYPE HSGetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers) override;
+		void STDMETHODCALLTYPE DSGetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView **shader_resource_views) override;
+		void STDMETHODCALLTYPE DSGetShader(ID3D11DomainShader **domain_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances) override;
+		void STDMETHODCALLTYPE DSGetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState **samplers) override;
+		void STDMETHODCALLTYPE DSGetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers) override;
+		void STDMETHODCALLTYPE CSGetShaderResources(UINT start_slot, UINT num_views, ID3D11ShaderResourceView **shader_resource_views) override;
+		void STDMETHODCALLTYPE CSGetUnorderedAccessViews(UINT start_slot, UINT num_uavs, ID3D11UnorderedAccessView **unordered_access_views) override;
+		void STDMETHODCALLTYPE CSGetShader(ID3D11ComputeShader **compute_shader, ID3D11ClassInstance **class_instances, UINT *num_class_instances) override;
+		void STDMETHODCALLTYPE CSGetSamplers(UINT start_slot, UINT num_samplers, ID3D11SamplerState **samplers) override;
+		void STDMETHODCALLTYPE CSGetConstantBuffers(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers) override;
+
+		// Context
+		void STDMETHODCALLTYPE ExecuteCommandList(ID3D11CommandList *command_list, BOOL restore_context_state) override;
+		void STDMETHODCALLTYPE ClearState() override;
+		void STDMETHODCALLTYPE Flush() override;
+		D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE GetType() override;
+		UINT STDMETHODCALLTYPE GetContextFlags() override;
+		HRESULT STDMETHODCALLTYPE FinishCommandList(BOOL restore_deferred_context_state, ID3D11CommandList **command_list) override;
+
+		// ID3D11DeviceContext1
+		void STDMETHODCALLTYPE CopySubresourceRegion1(ID3D11Resource *dst_resource, UINT dst_subresource, UINT dst_x, UINT dst_y, UINT dst_z,
+													ID3D11Resource *src_resource, UINT src_subresource, const D3D11_BOX *src_box, UINT copy_flags) override;
+		void STDMETHODCALLTYPE UpdateSubresource1(ID3D11Resource *dst_resource, UINT dst_subresource, const D3D11_BOX *dst_box, const void *src_data, UINT src_row_pitch, UINT src_depth_pitch,
+												UINT copy_flags) override;
+		void STDMETHODCALLTYPE DiscardResource(ID3D11Resource *resource) override;
+		void STDMETHODCALLTYPE DiscardView(ID3D11View *resource_view) override;
+		void STDMETHODCALLTYPE VSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *num_constants) override;
+		void STDMETHODCALLTYPE HSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *num_constants) override;
+		void STDMETHODCALLTYPE DSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *num_constants) override;
+		void STDMETHODCALLTYPE GSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *num_constants) override;
+		void STDMETHODCALLTYPE PSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *num_constants) override;
+		void STDMETHODCALLTYPE CSSetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer *const *constant_buffers, const UINT *first_constant, const UINT *num_constants) override;
+		void STDMETHODCALLTYPE VSGetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants) override;
+		void STDMETHODCALLTYPE HSGetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants) override;
+		void STDMETHODCALLTYPE DSGetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants) override;
+		void STDMETHODCALLTYPE GSGetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants) override;
+		void STDMETHODCALLTYPE PSGetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants) override;
+		void STDMETHODCALLTYPE CSGetConstantBuffers1(UINT start_slot, UINT num_buffers, ID3D11Buffer **constant_buffers, UINT *first_constant, UINT *num_constants) override;
+		void STDMETHODCALLTYPE SwapDeviceContextState(ID3DDeviceContextState *state, ID3DDeviceContextState **previous_state) override;
+		void STDMETHODCALLTYPE ClearView(ID3D11View *view, const FLOAT color[4], const D3D11_RECT *rects, UINT num_rects) override;
+		void STDMETHODCALLTYPE DiscardView1(ID3D11View *resource_view, const D3D11_RECT *rects, UINT num_rects) override;
+
+	private:
+		void record(NullDeviceCall call, uint32_t slot_count = 0);
+
+		void run_compute_kernel(uint32_t thread_group_count_x, uint32_t thread_group_count_y, uint32_t thread_group_count_z);
+	};
+
+	// Null device, implements ID3D11Device on top of cpu memory so effects can run headless
+	struct NullDevice final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, ID3D11Device>
+	{
+	private:
+		NullDeviceStats stats{};
+		NullComputeKernel compute_kernel = {};
+		ComPtr<NullDeviceContext> immediate_context = nullptr;
+
+	public:
+		NullDevice();
+
+		static ComPtr<NullDevice> create();
+
+		NullDeviceStats &get_stats();
+
+		ID3D11DeviceContext *get_immediate_context() const;
+
+		// Set before recording starts, contexts read it without synchronization
+		void set_compute_kernel(NullComputeKernel kernel);
+
+		// Resources and views
+		HRESULT STDMETHODCALLTYPE CreateBuffer(const D3D11_BUFFER_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Buffer **buffer) override;
+		HRESULT STDMETHODCALLTYPE CreateTexture1D(const D3D11_TEXTURE1D_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Texture1D **texture_1d) override;
+		HRESULT STDMETHODCALLTYPE CreateTexture2D(const D3D11_TEXTURE2D_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Texture2D **texture_2d) override;
+		HRESULT STDMETHODCALLTYPE CreateTexture3D(const D3D11_TEXTURE3D_DESC *desc, const D3D11_SUBRESOURCE_DATA *initial_data, ID3D11Texture3D **texture_3d) override;
+		HRESULT STDMETHODCALLTYPE CreateShaderResourceView(ID3D11Resource *resource, const D3D11_SHADER_RESOURCE_VIEW_DESC *desc, ID3D11ShaderResourceView **srv) override;
+		HRESULT STDMETHODCALLTYPE CreateUnorderedAccessView(ID3D11Resource *resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC *desc, ID3D11UnorderedAccessView **uav) override;
+		HRESULT STDMETHODCALLTYPE CreateRenderTargetView(ID3D11Resource *resource, const D3D11_RENDER_TARGET_VIEW_DESC *desc, ID3D11RenderTargetView **rtv) override;
+		HRESULT STDMETHODCALLTYPE CreateDepthStencilView(ID3D11Resource *resource, const D3D11_DEPTH_STENCIL_VIEW_DESC *desc, ID3D11DepthStencilView **dsv) override;
+
+		// Shaders and input layout
+		HRESULT STDMETHODCALLTYPE CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC *input_element_descs, UINT num_elements, const void *shader_bytecode_with_input_signature,
+													SIZE_T bytecode_length, ID3D11InputLayout **input_layout) override;
+		HRESULT STDMETHODCALLTYPE CreateVertexShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *class_linkage, ID3D11VertexShader **vertex_shader) override;
+		HRESULT STDMETHODCALLTYPE CreateGeometryShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *class_linkage, ID3D11GeometryShader **geometry_shader) override;
+		HRESULT STDMETHODCALLTYPE CreateGeometryShaderWithStreamOutput(const void *shader_bytecode, SIZE_T bytecode_length, const D3D11_SO_DECLARATION_ENTRY *so_declaration, UINT num_entries,
+																	const UINT *buffer_strides, UINT num_strides, UINT rasterized_stream, ID3D11ClassLinkage *class_linkage,
+																	ID3D11GeometryShader **geometry_shader) override;
+		HRESULT STDMETHODCALLTYPE CreatePixelShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *class_linkage, ID3D11PixelShader **pixel_shader) override;
+		HRESULT STDMETHODCALLTYPE CreateHullShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *class_linkage, ID3D11HullShader **hull_shader) override;
+		HRESULT STDMETHODCALLTYPE CreateDomainShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *class_linkage, ID3D11DomainShader **domain_shader) override;
+		HRESULT STDMETHODCALLTYPE CreateComputeShader(const void *shader_bytecode, SIZE_T bytecode_length, ID3D11ClassLinkage *class_linkage, ID3D11ComputeShader **compute_shader) override;
+		HRESULT STDMETHODCALLTYPE CreateClassLinkage(ID3D11ClassLinkage **linkage) override;
+
+		// States
+		HRESULT STDMETHODCALLTYPE CreateBlendState(const D3D11_BLEND_DESC *blend_state_desc, ID3D11BlendState **blend_state) override;
+		HRESULT STDMETHODCALLTYPE CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC *depth_stencil_desc, ID3D11DepthStencilState **depth_stencil_state) override;
+		HRESULT STDMETHODCALLTYPE CreateRasterizerState(const D3D11_RASTERIZER_DESC *rasterizer_desc, ID3D11RasterizerState **rasterizer_state) override;
+		HRESULT STDMETHODCALLTYPE CreateSamplerState(const D3D11_SAMPLER_DESC *sampler_desc, ID3D11SamplerState **sampler_state) override;
+
+		// Queries, counters and contexts
+		HRESULT STDMETHODCALLTYPE CreateQuery(const D3D11_QUERY_DESC *query_desc, ID3D11Query **query) override;
+		HRESULT STDMETHODCALLTYPE CreatePredicate(const D3D11_QUERY_DESC *predicate_desc, ID3D11Predicate **predicate) override;
+		HRESULT STDMETHODCALLTYPE CreateCounter(const D3D11_COUNTER_DESC *counter_desc, ID3D11Counter **counter) override;
+		HRESULT STDMETHODCALLTYPE CreateDeferredContext(UINT context_flags, ID3D11DeviceContext **deferred_context) override;
+		HRESULT STDMETHODCALLTYPE OpenSharedResource(HANDLE resource_handle, REFIID returned_interface, void **resource) override;
+
+		// Capabilities
+		HRESULT STDMETHODCALLTYPE CheckFormatSupport(DXGI_FORMAT format, UINT *format_support) override;
+		HRESULT STDMETHODCALLTYPE CheckMultisampleQualityLevels(DXGI_FORMAT format, UINT sample_count, UINT *num_quality_levels) override;
+		void STDMETHODCALLTYPE CheckCounterInfo(D3D11_COUNTER_INFO *counter_info) override;
+		HRESULT STDMETHODCALLTYPE CheckCounter(const D3D11_COUNTER_DESC *desc, D3D11_COUNTER_TYPE *type, UINT *active_counters, LPSTR name, UINT *name_length,
+												LPSTR units, UINT *units_length, LPSTR description, UINT *description_length) override;
+		HRESULT STDMETHODCALLTYPE CheckFeatureSupport(D3D11_FEATURE feature, void *feature_support_data, UINT feature_support_data_size) override;
+
+		// Device
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT *data_size, void *data) override;
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT data_size, const void *data) override;
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown *data) override;
+		D3D_FEATURE_LEVEL STDMETHODCALLTYPE GetFeatureLevel() override;
+		UINT STDMETHODCALLTYPE GetCreationFlags() override;
+		HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason() override;
+		void STDMETHODCALLTYPE GetImmediateContext(ID3D11DeviceContext **context) override;
+		HRESULT STDMETHODCALLTYPE SetExceptionMode(UINT raise_flags) override;
+		UINT STDMETHODCALLTYPE GetExceptionMode() override;
+	};
+}
@@ -3,8 +3,716 @@
 //
 
 #include <pass.h>
+#include <algorithm>
 
 namespace toy
 {
+	static uint32_t query_usage_bind_flag(PassResourceUsage resource_usage)
+	{
+		switch (resource_usage)
+		{
+			case PassResourceUsage::ShaderResource: return D3D11_BIND_SHADER_RESOURCE;
+			case PassResourceUsage::UnorderedAccess: return D3D11_BIND_UNORDERED_ACCESS;
+			case PassResourceUsage::RenderTarget: return D3D11_BIND_RENDER_TARGET;
+			case PassResourceUsage::DepthStencil: return D3D11_BIND_DEPTH_STENCIL;
+			case PassResourceUsage::DepthStencilReadOnly: return D3D11_BIND_DEPTH_STENCIL;
+			default: return 0;
+		}
+	}
 
-}
\ No newline at end of file
+	static void sort_and_unique(std::vector<uint32_t> &values)
+	{
+		std::sort(values.begin(), values.end());
+		values.erase(std::unique(values.begin(), values.end()), values.end());
+	}
+
+	// Pass
+	Pass::Pass(std::string_view name, PassExecuteCallback callback)
+	: pass_name(name), execute_callback(std::move(callback))
+	{
+
+	}
+
+	Pass &Pass::read(uint32_t resource_id)
+	{
+		resource_accesses.emplace_back(resource_id, PassResourceUsage::ShaderResource);
+		return *this;
+	}
+
+	Pass &Pass::read_depth_stencil(uint32_t resource_id)
+	{
+		resource_accesses.emplace_back(resource_id, PassResourceUsage::DepthStencilReadOnly);
+		return *this;
+	}
+
+	Pass &Pass::read_write(uint32_t resource_id)
+	{
+		resource_accesses.emplace_back(resource_id, PassResourceUsage::UnorderedAccess);
+		return *this;
+	}
+
+	Pass &Pass::write_render_target(uint32_t resource_id)
+	{
+		resource_accesses.emplace_back(resource_id, PassResourceUsage::RenderTarget);
+		return *this;
+	}
+
+	Pass &Pass::write_depth_stencil(uint32_t resource_id)
+	{
+		resource_accesses.emplace_back(resource_id, PassResourceUsage::DepthStencil);
+		return *this;
+	}
+
+	Pass &Pass::set_side_effect(bool side_effect)
+	{
+		has_side_effect = side_effect;
+		return *this;
+	}
+
+	const std::string &Pass::get_name() const
+	{
+		return pass_name;
+	}
+
+	std::span<const PassResourceAccess> Pass::get_resource_accesses() const
+	{
+		return resource_accesses;
+	}
+
+	std::span<const uint32_t> Pass::get_dependencies() const
+	{
+		return dependencies;
+	}
+
+	uint32_t Pass::get_dependency_level() const
+	{
+		return dependency_level;
+	}
+
+	bool Pass::culled() const
+	{
+		return is_culled;
+	}
+
+	void Pass::execute(ID3D11DeviceContext *device_context, const RenderGraph &render_graph) const
+	{
+		if (execute_callback) {
+			execute_callback(device_context, render_graph);
+		}
+	}
+
+	bool Pass::is_read_usage(PassResourceUsage resource_usage)
+	{
+		return resource_usage == PassResourceUsage::ShaderResource || resource_usage == PassResourceUsage::UnorderedAccess ||
+				resource_usage == PassResourceUsage::DepthStencilReadOnly;
+	}
+
+	bool Pass::is_write_usage(PassResourceUsage resource_usage)
+	{
+		return resource_usage == PassResourceUsage::UnorderedAccess || resource_usage == PassResourceUsage::RenderTarget ||
+				resource_usage == PassResourceUsage::DepthStencil;
+	}
+
+	// Render graph
+	RenderGraph::RenderGraph(ID3D11Device *input_device)
+	: device(input_device)
+	{
+
+	}
+
+	uint32_t RenderGraph::create_resource(std::string_view name, const RenderGraphResourceDesc &resource_desc)
+	{
+		VirtualResource virtual_resource{};
+		virtual_resource.resource_name = name;
+		virtual_resource.resource_desc = resource_desc;
+		virtual_resources.emplace_back(std::move(virtual_resource));
+		is_compiled = false;
+		return static_cast<uint32_t>(virtual_resources.size() - 1);
+	}
+
+	uint32_t RenderGraph::import_resource(std::string_view name, const RenderGraphImportedResource &imported_resource)
+	{
+		VirtualResource virtual_resource{};
+		virtual_resource.resource_name = name;
+		virtual_resource.imported_resource = imported_resource;
+		virtual_resource.is_imported = true;
+		virtual_resources.emplace_back(std::move(virtual_resource));
+		is_compiled = false;
+		return static_cast<uint32_t>(virtual_resources.size() - 1);
+	}
+
+	Pass &RenderGraph::add_pass(std::string_view name, PassExecuteCallback callback)
+	{
+		is_compiled = false;
+		return passes.emplace_back(name, std::move(callback));
+	}
+
+	void RenderGraph::set_transient_allocator(TransientResourceAllocator *allocator)
+	{
+		transient_allocator = allocator;
+		is_compiled = false;
+	}
+
+	void RenderGraph::compile()
+	{
+		graph_stats = {};
+		graph_stats.pass_count = static_cast<uint32_t>(passes.size());
+		graph_stats.resource_count = static_cast<uint32_t>(virtual_resources.size());
+
+		build_dependencies();
+		cull_passes();
+		build_schedule();
+		place_transient_resources();
+		is_compiled = true;
+	}
+
+	void RenderGraph::execute(ID3D11DeviceContext *device_context)
+	{
+		if (!is_compiled) {
+			compile();
+		}
+		create_physical_resources();
+
+		for (auto &&pass_id : schedule)
+		{
+			passes[pass_id].execute(device_context, *this);
+		}
+	}
+
+	void RenderGraph::execute_parallel(ID3D11DeviceContext *immediate_context, JobSystem &job_system, uint32_t passes_per_command_list)
+	{
+		if (!is_compiled) {
+			compile();
+		}
+		create_physical_resources();
+
+		// Contexts are taken per recording job, a pass that waits on the job system can start another job on the same thread
+		const uint32_t thread_count = job_system.get_thread_count();
+		while (deferred_contexts.size() < thread_count)
+		{
+			ComPtr<ID3D11DeviceContext> deferred_context = nullptr;
+			if (device == nullptr || FAILED(device->CreateDeferredContext(0, deferred_context.GetAddressOf()))) {
+				std::cout << std::format("Failed to create deferred context, render graph falls back to serial recording\n");
+				for (auto &&pass_id : schedule)
+				{
+					passes[pass_id].execute(immediate_context, *this);
+				}
+				return;
+			}
+			deferred_contexts.emplace_back(std::move(deferred_context));
+		}
+
+		// Recording has no ordering constraint, every batch is an independent job
+		passes_per_command_list = (std::max)(passes_per_command_list, 1U);
+		const auto schedule_size = static_cast<uint32_t>(schedule.size());
+		const uint32_t command_list_count = (schedule_size + passes_per_command_list - 1) / passes_per_command_list;
+		command_lists.assign(command_list_count, nullptr);
+		JobCounter job_counter{};
+		for (uint32_t command_list_index = 0; command_list_index < command_list_count; ++command_list_index)
+		{
+			job_system.submit([this, command_list_index, passes_per_command_list, schedule_size]()
+			{
+				auto deferred_context = acquire_deferred_context();
+				if (deferred_context == nullptr) {
+					return;
+				}
+				const uint32_t schedule_begin = command_list_index * passes_per_command_list;
+				const uint32_t schedule_end = (std::min)(schedule_begin + passes_per_command_list, schedule_size);
+				for (uint32_t position = schedule_begin; position < schedule_end; ++position)
+				{
+					passes[schedule[position]].execute(deferred_context.Get(), *this);
+				}
+				deferred_context->FinishCommandList(FALSE, command_lists[command_list_index].GetAddressOf());
+				// Finishing leaves the deferred context with default state
+				ResourceBindingState::reset(deferred_context.Get());
+				release_deferred_context(std::move(deferred_context));
+			}, &job_counter);
+		}
+		job_system.wait(job_counter);
+
+		// Stitch in schedule order, a batch that got no context is recorded here in its place
+		for (uint32_t command_list_index = 0; command_list_index < command_list_count; ++command_list_index)
+		{
+			if (command_lists[command_list_index] != nullptr) {
+				immediate_context->ExecuteCommandList(command_lists[command_list_index].Get(), FALSE);
+				continue;
+			}
+			const uint32_t schedule_begin = command_list_index * passes_per_command_list;
+			const uint32_t schedule_end = (std::min)(schedule_begin + passes_per_command_list, schedule_size);
+			for (uint32_t position = schedule_begin; position < schedule_end; ++position)
+			{
+				passes[schedule[position]].execute(immediate_context, *this);
+			}
+		}
+		// Executing without restoring state leaves the immediate context with default state
+		ResourceBindingState::reset(immediate_context);
+		command_lists.clear();
+	}
+
+	ComPtr<ID3D11DeviceContext> RenderGraph::acquire_deferred_context()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ deferred_context_mutex };
+			if (!deferred_contexts.empty()) {
+				auto deferred_context = std::move(deferred_contexts.back());
+				deferred_contexts.pop_back();
+				return deferred_context;
+			}
+		}
+		// Every idle context is in use by a job further up this thread's stack or on another thread
+		ComPtr<ID3D11DeviceContext> deferred_context = nullptr;
+		if (FAILED(device->CreateDeferredContext(0, deferred_context.GetAddressOf()))) {
+			std::cout << std::format("Failed to create deferred context, the batch is recorded on the immediate context\n");
+			return nullptr;
+		}
+		return deferred_context;
+	}
+
+	void RenderGraph::release_deferred_context(ComPtr<ID3D11DeviceContext> deferred_context)
+	{
+		std::lock_guard<std::mutex> lock{ deferred_context_mutex };
+		deferred_contexts.emplace_back(std::move(deferred_context));
+	}
+
+	void RenderGraph::clear()
+	{
+		passes.clear();
+		virtual_resources.clear();
+		schedule.clear();
+		graph_stats = {};
+		is_compiled = false;
+	}
+
+	ID3D11ShaderResourceView *RenderGraph::query_srv(uint32_t resource_id) const
+	{
+		if (resource_id < virtual_resources.size() && virtual_resources[resource_id].is_imported) {
+			return virtual_resources[resource_id].imported_resource.srv;
+		}
+		auto physical_resource = query_physical_resource(resource_id);
+		return physical_resource != nullptr ? physical_resource->srv.Get() : nullptr;
+	}
+
+	ID3D11UnorderedAccessView *RenderGraph::query_uav(uint32_t resource_id) const
+	{
+		if (resource_id < virtual_resources.size() && virtual_resources[resource_id].is_imported) {
+			return virtual_resources[resource_id].imported_resource.uav;
+		}
+		auto physical_resource = query_physical_resource(resource_id);
+		return physical_resource != nullptr ? physical_resource->uav.Get() : nullptr;
+	}
+
+	ID3D11RenderTargetView *RenderGraph::query_rtv(uint32_t resource_id) const
+	{
+		if (resource_id < virtual_resources.size() && virtual_resources[resource_id].is_imported) {
+			return virtual_resources[resource_id].imported_resource.rtv;
+		}
+		auto physical_resource = query_physical_resource(resource_id);
+		return physical_resource != nullptr ? physical_resource->rtv.Get() : nullptr;
+	}
+
+	ID3D11DepthStencilView *RenderGraph::query_dsv(uint32_t resource_id) const
+	{
+		if (resource_id < virtual_resources.size() && virtual_resources[resource_id].is_imported) {
+			return virtual_resources[resource_id].imported_resource.dsv;
+		}
+		auto physical_resource = query_physical_resource(resource_id);
+		return physical_resource != nullptr ? physical_resource->dsv.Get() : nullptr;
+	}
+
+	ID3D11Resource *RenderGraph::query_resource(uint32_t resource_id) const
+	{
+		if (resource_id < virtual_resources.size() && virtual_resources[resource_id].is_imported) {
+			return virtual_resources[resource_id].imported_resource.resource;
+		}
+		auto physical_resource = query_physical_resource(resource_id);
+		return physical_resource != nullptr ? physical_resource->resource.Get() : nullptr;
+	}
+
+	TransientResourcePlacement RenderGraph::query_placement(uint32_t resource_id) const
+	{
+		if (transient_allocator == nullptr || resource_id >= virtual_resources.size() || virtual_resources[resource_id].placement_index == invalid_id) {
+			return {};
+		}
+		return transient_allocator->query_placement(virtual_resources[resource_id].placement_index);
+	}
+
+	uint64_t RenderGraph::query_resource_size_in_bytes(const RenderGraphResourceDesc &resource_desc)
+	{
+		if (resource_desc.resource_type == RenderGraphResourceType::Buffer) {
+			return static_cast<uint64_t>(resource_desc.width) * resource_desc.structure_byte_stride;
+		}
+
+		const uint64_t element_size = query_format_size_in_bytes(resource_desc.format);
+		uint64_t width = resource_desc.width;
+		uint64_t height = resource_desc.height;
+		uint64_t depth = resource_desc.resource_type == RenderGraphResourceType::Texture3D ? resource_desc.depth : 1;
+		uint64_t size_in_bytes = 0;
+		for (uint32_t mip_level = 0; mip_level < (std::max)(resource_desc.mip_levels, 1U); ++mip_level)
+		{
+			size_in_bytes += width * height * depth * element_size;
+			width = (std::max)(width >> 1, uint64_t{ 1 });
+			height = (std::max)(height >> 1, uint64_t{ 1 });
+			depth = (std::max)(depth >> 1, uint64_t{ 1 });
+		}
+		return size_in_bytes;
+	}
+
+	const Pass &RenderGraph::query_pass(uint32_t pass_id) const
+	{
+		return passes[pass_id];
+	}
+
+	std::span<const uint32_t> RenderGraph::get_schedule() const
+	{
+		return schedule;
+	}
+
+	const RenderGraphStats &RenderGraph::get_stats() const
+	{
+		return graph_stats;
+	}
+
+	void RenderGraph::print() const
+	{
+		std::cout << std::format("Render graph: {} passes, {} culled, {} dependencies, {} dependency levels\n",
+								graph_stats.pass_count, graph_stats.culled_pass_count, graph_stats.dependency_count, graph_stats.max_dependency_level + 1);
+		std::cout << std::format("Render graph: {} resources, {} transient placed in {} physical resources\n",
+								graph_stats.resource_count, graph_stats.transient_resource_count, graph_stats.physical_resource_count);
+		std::cout << std::format("Render graph: transient {} bytes, physical {} bytes, heap placed {} bytes\n",
+								graph_stats.transient_bytes, graph_stats.physical_bytes, graph_stats.placed_bytes);
+	}
+
+	void RenderGraph::build_dependencies()
+	{
+		// Passes are declared in submission order, so every edge points from an earlier pass to a later one
+		// Read after write and write after write are data dependencies, write after read only orders the passes
+		std::vector<uint32_t> last_writers(virtual_resources.size(), invalid_id);
+		std::vector<std::vector<uint32_t>> readers(virtual_resources.size());
+		for (uint32_t pass_id = 0; pass_id < passes.size(); ++pass_id)
+		{
+			auto &&pass = passes[pass_id];
+			pass.data_dependencies.clear();
+			pass.dependencies.clear();
+			pass.dependency_level = 0;
+			pass.is_culled = false;
+
+			for (auto &&resource_access : pass.resource_accesses)
+			{
+				const uint32_t resource_id = resource_access.resource_id;
+				if (resource_id >= virtual_resources.size()) {
+					continue;
+				}
+				const uint32_t last_writer = last_writers[resource_id];
+				if (last_writer != invalid_id && last_writer != pass_id) {
+					pass.data_dependencies.emplace_back(last_writer);
+				}
+				if (Pass::is_write_usage(resource_access.resource_usage)) {
+					for (auto &&reader : readers[resource_id])
+					{
+						if (reader != pass_id) {
+							pass.dependencies.emplace_back(reader);
+						}
+					}
+				}
+			}
+
+			for (auto &&resource_access : pass.resource_accesses)
+			{
+				const uint32_t resource_id = resource_access.resource_id;
+				if (resource_id >= virtual_resources.size()) {
+					continue;
+				}
+				if (Pass::is_write_usage(resource_access.resource_usage)) {
+					last_writers[resource_id] = pass_id;
+					readers[resource_id].clear();
+				} else {
+					readers[resource_id].emplace_back(pass_id);
+				}
+			}
+
+			sort_and_unique(pass.data_dependencies);
+			pass.dependencies.insert(pass.dependencies.end(), pass.data_dependencies.begin(), pass.data_dependencies.end());
+			sort_and_unique(pass.dependencies);
+		}
+	}
+
+	void RenderGraph::cull_passes()
+	{
+		// Passes stay alive when they have side effects or write imported resources, and so does everything they consume
+		std::vector<uint8_t> alive_flags(passes.size(), 0);
+		std::vector<uint32_t> pending_passes{};
+		pending_passes.reserve(passes.size());
+		for (uint32_t pass_id = 0; pass_id < passes.size(); ++pass_id)
+		{
+			auto &&pass = passes[pass_id];
+			bool is_root = pass.has_side_effect;
+			for (auto &&resource_access : pass.resource_accesses)
+			{
+				if (resource_access.resource_id < virtual_resources.size() && virtual_resources[resource_access.resource_id].is_imported &&
+					Pass::is_write_usage(resource_access.resource_usage)) {
+					is_root = true;
+				}
+			}
+			if (is_root) {
+				alive_flags[pass_id] = 1;
+				pending_passes.emplace_back(pass_id);
+			}
+		}
+
+		while (!pending_passes.empty())
+		{
+			const uint32_t pass_id = pending_passes.back();
+			pending_passes.pop_back();
+			for (auto &&dependency : passes[pass_id].data_dependencies)
+			{
+				if (alive_flags[dependency] == 0) {
+					alive_flags[dependency] = 1;
+					pending_passes.emplace_back(dependency);
+				}
+			}
+		}
+
+		for (uint32_t pass_id = 0; pass_id < passes.size(); ++pass_id)
+		{
+			passes[pass_id].is_culled = alive_flags[pass_id] == 0;
+			if (passes[pass_id].is_culled) {
+				++graph_stats.culled_pass_count;
+			}
+		}
+	}
+
+	void RenderGraph::build_schedule()
+	{
+		// Declaration order is already topological, culled passes are dropped along with edges to them
+		schedule.clear();
+		schedule.reserve(passes.size());
+		for (uint32_t pass_id = 0; pass_id < passes.size(); ++pass_id)
+		{
+			auto &&pass = passes[pass_id];
+			if (pass.is_culled) {
+				continue;
+			}
+			std::erase_if(pass.dependencies, [this](uint32_t dependency) { return passes[dependency].is_culled; });
+			for (auto &&dependency : pass.dependencies)
+			{
+				pass.dependency_level = (std::max)(pass.dependency_level, passes[dependency].dependency_level + 1);
+			}
+			graph_stats.dependency_count += static_cast<uint32_t>(pass.dependencies.size());
+			graph_stats.max_dependency_level = (std::max)(graph_stats.max_dependency_level, pass.dependency_level);
+			schedule.emplace_back(pass_id);
+		}
+	}
+
+	void RenderGraph::place_transient_resources()
+	{
+		// Lifetimes in schedule positions, bind flags are the union of every usage
+		for (auto &&virtual_resource : virtual_resources)
+		{
+			virtual_resource.bind_flags = 0;
+			virtual_resource.first_use = UINT32_MAX;
+			virtual_resource.last_use = 0;
+			virtual_resource.physical_index = invalid_id;
+			virtual_resource.placement_index = invalid_id;
+		}
+		for (uint32_t position = 0; position < schedule.size(); ++position)
+		{
+			for (auto &&resource_access : passes[schedule[position]].resource_accesses)
+			{
+				if (resource_access.resource_id >= virtual_resources.size()) {
+					continue;
+				}
+				auto &&virtual_resource = virtual_resources[resource_access.resource_id];
+				virtual_resource.bind_flags |= query_usage_bind_flag(resource_access.resource_usage);
+				virtual_resource.first_use = (std::min)(virtual_resource.first_use, position);
+				virtual_resource.last_use = (std::max)(virtual_resource.last_use, position);
+			}
+		}
+
+		std::vector<uint32_t> acquire_order{};
+		acquire_order.reserve(virtual_resources.size());
+		for (uint32_t resource_id = 0; resource_id < virtual_resources.size(); ++resource_id)
+		{
+			auto &&virtual_resource = virtual_resources[resource_id];
+			if (!virtual_resource.is_imported && virtual_resource.first_use != UINT32_MAX) {
+				acquire_order.emplace_back(resource_id);
+			}
+		}
+		std::vector<uint32_t> release_order = acquire_order;
+		std::sort(acquire_order.begin(), acquire_order.end(), [this](uint32_t lhs, uint32_t rhs) { return virtual_resources[lhs].first_use < virtual_resources[rhs].first_use; });
+		std::sort(release_order.begin(), release_order.end(), [this](uint32_t lhs, uint32_t rhs) { return virtual_resources[lhs].last_use < virtual_resources[rhs].last_use; });
+		graph_stats.transient_resource_count = static_cast<uint32_t>(acquire_order.size());
+
+		// Sweep the schedule, a physical resource returns to the free list after the last pass using it
+		// D3D11 cannot place resources in shared heaps, so aliasing reuses whole resources with identical descriptions
+		std::vector<uint32_t> free_physical_indices(physical_resources.size());
+		for (uint32_t physical_index = 0; physical_index < physical_resources.size(); ++physical_index)
+		{
+			free_physical_indices[physical_index] = static_cast<uint32_t>(physical_resources.size()) - 1 - physical_index;
+		}
+		size_t acquire_cursor = 0;
+		size_t release_cursor = 0;
+		uint32_t used_physical_count = 0;
+		for (uint32_t position = 0; position < schedule.size(); ++position)
+		{
+			for (; acquire_cursor < acquire_order.size() && virtual_resources[acquire_order[acquire_cursor]].first_use == position; ++acquire_cursor)
+			{
+				auto &&virtual_resource = virtual_resources[acquire_order[acquire_cursor]];
+				auto free_physical = std::find_if(free_physical_indices.rbegin(), free_physical_indices.rend(), [this, &virtual_resource](uint32_t physical_index)
+				{
+					auto &&physical_resource = physical_resources[physical_index];
+					return physical_resource.resource_desc == virtual_resource.resource_desc && physical_resource.bind_flags == virtual_resource.bind_flags;
+				});
+				if (free_physical != free_physical_indices.rend()) {
+					virtual_resource.physical_index = *free_physical;
+					free_physical_indices.erase(std::next(free_physical).base());
+				} else {
+					PhysicalResource physical_resource{};
+					physical_resource.resource_desc = virtual_resource.resource_desc;
+					physical_resource.bind_flags = virtual_resource.bind_flags;
+					physical_resources.emplace_back(std::move(physical_resource));
+					virtual_resource.physical_index = static_cast<uint32_t>(physical_resources.size() - 1);
+				}
+				++used_physical_count;
+			}
+			for (; release_cursor < release_order.size() && virtual_resources[release_order[release_cursor]].last_use == position; ++release_cursor)
+			{
+				free_physical_indices.emplace_back(virtual_resources[release_order[release_cursor]].physical_index);
+			}
+		}
+
+		std::vector<uint32_t> physical_indices{};
+		physical_indices.reserve(acquire_order.size());
+		for (auto &&resource_id : acquire_order)
+		{
+			physical_indices.emplace_back(virtual_resources[resource_id].physical_index);
+			graph_stats.transient_bytes += query_resource_size_in_bytes(virtual_resources[resource_id].resource_desc);
+		}
+		sort_and_unique(physical_indices);
+		graph_stats.physical_resource_count = static_cast<uint32_t>(physical_indices.size());
+		for (auto &&physical_index : physical_indices)
+		{
+			graph_stats.physical_bytes += query_resource_size_in_bytes(physical_resources[physical_index].resource_desc);
+		}
+
+		if (transient_allocator != nullptr) {
+			pack_transient_resources(acquire_order);
+		}
+	}
+
+	void RenderGraph::pack_transient_resources(std::span<const uint32_t> transient_resource_ids)
+	{
+		// Byte level aliasing for backends that can place resources in a heap, independent of the description match above
+		transient_allocator->clear();
+		for (auto &&resource_id : transient_resource_ids)
+		{
+			auto &&virtual_resource = virtual_resources[resource_id];
+			TransientResourceRequest request{};
+			request.size_in_bytes = query_resource_size_in_bytes(virtual_resource.resource_desc);
+			request.first_use = virtual_resource.first_use;
+			request.last_use = virtual_resource.last_use;
+			virtual_resource.placement_index = transient_allocator->add_request(request);
+		}
+		transient_allocator->allocate();
+		graph_stats.placed_bytes = transient_allocator->get_stats().heap_bytes;
+	}
+
+	void RenderGraph::create_physical_resources()
+	{
+		for (auto &&virtual_resource : virtual_resources)
+		{
+			if (virtual_resource.physical_index == invalid_id) {
+				continue;
+			}
+			auto &&physical_resource = physical_resources[virtual_resource.physical_index];
+			if (physical_resource.resource == nullptr && FAILED(create_physical_resource(physical_resource))) {
+				std::cout << std::format("Failed to create render graph resource {}\n", virtual_resource.resource_name);
+			}
+		}
+	}
+
+	HRESULT RenderGraph::create_physical_resource(PhysicalResource &physical_resource)
+	{
+		if (device == nullptr) {
+			return E_POINTER;
+		}
+
+		auto &&resource_desc = physical_resource.resource_desc;
+		const uint32_t bind_flags = physical_resource.bind_flags;
+		HRESULT hr = S_OK;
+		if (resource_desc.resource_type == RenderGraphResourceType::Texture2D) {
+			D3D11_TEXTURE2D_DESC texture_desc{};
+			texture_desc.Width = resource_desc.width;
+			texture_desc.Height = resource_desc.height;
+			texture_desc.MipLevels = resource_desc.mip_levels;
+			texture_desc.ArraySize = 1;
+			texture_desc.Format = resource_desc.format;
+			texture_desc.SampleDesc.Count = 1;
+			texture_desc.Usage = D3D11_USAGE_DEFAULT;
+			texture_desc.BindFlags = bind_flags;
+			ComPtr<ID3D11Texture2D> texture = nullptr;
+			hr = device->CreateTexture2D(&texture_desc, nullptr, texture.GetAddressOf());
+			physical_resource.resource = texture;
+		} else if (resource_desc.resource_type == RenderGraphResourceType::Texture3D) {
+			D3D11_TEXTURE3D_DESC texture_desc{};
+			texture_desc.Width = resource_desc.width;
+			texture_desc.Height = resource_desc.height;
+			texture_desc.Depth = resource_desc.depth;
+			texture_desc.MipLevels = resource_desc.mip_levels;
+			texture_desc.Format = resource_desc.format;
+			texture_desc.Usage = D3D11_USAGE_DEFAULT;
+			texture_desc.BindFlags = bind_flags;
+			ComPtr<ID3D11Texture3D> texture = nullptr;
+			hr = device->CreateTexture3D(&texture_desc, nullptr, texture.GetAddressOf());
+			physical_resource.resource = texture;
+		} else {
+			// Structured buffer when the format is unknown, typed buffer otherwise
+			const bool is_structured = resource_desc.format == DXGI_FORMAT_UNKNOWN;
+			D3D11_BUFFER_DESC buffer_desc{};
+			buffer_desc.ByteWidth = resource_desc.width * resource_desc.structure_byte_stride;
+			buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+			buffer_desc.BindFlags = bind_flags;
+			buffer_desc.MiscFlags = is_structured ? D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : 0;
+			buffer_desc.StructureByteStride = is_structured ? resource_desc.structure_byte_stride : 0;
+			ComPtr<ID3D11Buffer> buffer = nullptr;
+			hr = device->CreateBuffer(&buffer_desc, nullptr, buffer.GetAddressOf());
+			physical_resource.resource = buffer;
+		}
+		if (FAILED(hr)) {
+			return hr;
+		}
+
+		const bool is_buffer = resource_desc.resource_type == RenderGraphResourceType::Buffer;
+		auto resource = physical_resource.resource.Get();
+		if (bind_flags & D3D11_BIND_SHADER_RESOURCE) {
+			D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc{};
+			srv_desc.Format = resource_desc.format;
+			srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+			srv_desc.Buffer.FirstElement = 0;
+			srv_desc.Buffer.NumElements = resource_desc.width;
+			hr = device->CreateShaderResourceView(resource, is_buffer ? &srv_desc : nullptr, physical_resource.srv.GetAddressOf());
+		}
+		if (SUCCEEDED(hr) && (bind_flags & D3D11_BIND_UNORDERED_ACCESS)) {
+			D3D11_UNORDERED_ACCESS_VIEW_DESC uav_desc{};
+			uav_desc.Format = resource_desc.format;
+			uav_desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+			uav_desc.Buffer.FirstElement = 0;
+			uav_desc.Buffer.NumElements = resource_desc.width;
+			hr = device->CreateUnorderedAccessView(resource, is_buffer ? &uav_desc : nullptr, physical_resource.uav.GetAddressOf());
+		}
+		if (SUCCEEDED(hr) && !is_buffer && (bind_flags & D3D11_BIND_RENDER_TARGET)) {
+			hr = device->CreateRenderTargetView(resource, nullptr, physical_resource.rtv.GetAddressOf());
+		}
+		if (SUCCEEDED(hr) && !is_buffer && (bind_flags & D3D11_BIND_DEPTH_STENCIL)) {
+			hr = device->CreateDepthStencilView(resource, nullptr, physical_resource.dsv.GetAddressOf());
+		}
+		return hr;
+	}
+
+	const RenderGraph::PhysicalResource *RenderGraph::query_physical_resource(uint32_t resource_id) const
+	{
+		if (resource_id >= virtual_resources.size() || virtual_resources[resource_id].physical_index == invalid_id) {
+			return nullptr;
+		}
+		return &physical_resources[virtual_resources[resource_id].physical_index];
+	}
+}
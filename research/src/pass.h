@@ -5,12 +5,242 @@
 #pragma once
 
 #include <effect.h>
-#include <DirectXMath.h>
+#include <transient_allocator.h>
+#include <job_system.h>
+#include <functional>
 
 namespace toy
 {
+	struct RenderGraph;
+
+	// Render graph resource type
+	enum class RenderGraphResourceType
+	{
+		Texture2D = 0,
+		Texture3D,
+		Buffer
+	};
+
+	// Render graph resource description, width is the element count for buffers
+	struct RenderGraphResourceDesc
+	{
+		RenderGraphResourceType resource_type = RenderGraphResourceType::Texture2D;
+		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		uint32_t width = 1;
+		uint32_t height = 1;
+		uint32_t depth = 1;
+		uint32_t mip_levels = 1;
+		uint32_t structure_byte_stride = 0;
+
+		bool operator==(const RenderGraphResourceDesc &other) const = default;
+	};
+
+	// Resource owned outside the graph, writes to it keep the writing pass alive
+	struct RenderGraphImportedResource
+	{
+		ID3D11Resource *resource = nullptr;
+		ID3D11ShaderResourceView *srv = nullptr;
+		ID3D11UnorderedAccessView *uav = nullptr;
+		ID3D11RenderTargetView *rtv = nullptr;
+		ID3D11DepthStencilView *dsv = nullptr;
+	};
+
+	// How a pass touches a resource
+	enum class PassResourceUsage
+	{
+		ShaderResource = 0,
+		UnorderedAccess,
+		RenderTarget,
+		DepthStencil,
+		DepthStencilReadOnly
+	};
+
+	struct PassResourceAccess
+	{
+		uint32_t resource_id = 0;
+		PassResourceUsage resource_usage = PassResourceUsage::ShaderResource;
+	};
+
+	using PassExecuteCallback = std::function<void(ID3D11DeviceContext *, const RenderGraph &)>;
+
+	// Render graph node, declares the resources it reads and writes and records its work in the callback
 	struct Pass
 	{
+	private:
+		std::string pass_name = {};
+		std::vector<PassResourceAccess> resource_accesses = {};
+		PassExecuteCallback execute_callback = {};
+		bool has_side_effect = false;
+
+		// Compile results
+		std::vector<uint32_t> data_dependencies = {};
+		std::vector<uint32_t> dependencies = {};
+		uint32_t dependency_level = 0;
+		bool is_culled = false;
+
+		friend struct RenderGraph;
+
+	public:
+		Pass(std::string_view name, PassExecuteCallback callback);
+
+		Pass &read(uint32_t resource_id);
+
+		Pass &read_depth_stencil(uint32_t resource_id);
+
+		Pass &read_write(uint32_t resource_id);
+
+		Pass &write_render_target(uint32_t resource_id);
+
+		Pass &write_depth_stencil(uint32_t resource_id);
+
+		// Passes with side effects are never culled, e.g. readbacks or presentation
+		Pass &set_side_effect(bool side_effect);
+
+		[[nodiscard]] const std::string &get_name() const;
+
+		[[nodiscard]] std::span<const PassResourceAccess> get_resource_accesses() const;
+
+		[[nodiscard]] std::span<const uint32_t> get_dependencies() const;
+
+		[[nodiscard]] uint32_t get_dependency_level() const;
+
+		[[nodiscard]] bool culled() const;
+
+		void execute(ID3D11DeviceContext *device_context, const RenderGraph &render_graph) const;
+
+		static bool is_read_usage(PassResourceUsage resource_usage);
+
+		static bool is_write_usage(PassResourceUsage resource_usage);
+	};
+
+	struct RenderGraphStats
+	{
+		uint32_t pass_count = 0;
+		uint32_t culled_pass_count = 0;
+		uint32_t resource_count = 0;
+		uint32_t transient_resource_count = 0;
+		uint32_t physical_resource_count = 0;
+		uint64_t transient_bytes = 0;
+		uint64_t physical_bytes = 0;
+		uint64_t placed_bytes = 0;
+		uint32_t dependency_count = 0;
+		uint32_t max_dependency_level = 0;
+	};
+
+	// Pass graph, compile culls unused passes, orders the rest and places transient resources by lifetime
+	struct RenderGraph
+	{
+	private:
+		struct VirtualResource
+		{
+			std::string resource_name = {};
+			RenderGraphResourceDesc resource_desc{};
+			RenderGraphImportedResource imported_resource{};
+			bool is_imported = false;
+
+			// Compile results
+			uint32_t bind_flags = 0;
+			uint32_t first_use = UINT32_MAX;
+			uint32_t last_use = 0;
+			uint32_t physical_index = UINT32_MAX;
+			uint32_t placement_index = UINT32_MAX;
+		};
+
+		struct PhysicalResource
+		{
+			RenderGraphResourceDesc resource_desc{};
+			uint32_t bind_flags = 0;
+			ComPtr<ID3D11Resource> resource = nullptr;
+			ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+			ComPtr<ID3D11UnorderedAccessView> uav = nullptr;
+			ComPtr<ID3D11RenderTargetView> rtv = nullptr;
+			ComPtr<ID3D11DepthStencilView> dsv = nullptr;
+		};
+
+		ComPtr<ID3D11Device> device = nullptr;
+		std::vector<Pass> passes = {};
+		std::vector<VirtualResource> virtual_resources = {};
+		std::vector<PhysicalResource> physical_resources = {};
+		std::vector<uint32_t> schedule = {};
+		// Idle deferred contexts, a recording job holds one for the whole batch
+		std::vector<ComPtr<ID3D11DeviceContext>> deferred_contexts = {};
+		std::mutex deferred_context_mutex;
+		std::vector<ComPtr<ID3D11CommandList>> command_lists = {};
+		TransientResourceAllocator *transient_allocator = nullptr;
+		RenderGraphStats graph_stats{};
+		bool is_compiled = false;
+
+	public:
+		static constexpr uint32_t invalid_id = UINT32_MAX;
+
+		explicit RenderGraph(ID3D11Device *input_device);
+
+		uint32_t create_resource(std::string_view name, const RenderGraphResourceDesc &resource_desc);
+
+		uint32_t import_resource(std::string_view name, const RenderGraphImportedResource &imported_resource);
+
+		// The returned reference is only valid until the next add_pass
+		Pass &add_pass(std::string_view name, PassExecuteCallback callback);
+
+		// Transient resources are also packed by lifetime into the allocator's heap on compile
+		void set_transient_allocator(TransientResourceAllocator *allocator);
+
+		void compile();
+
+		// Create missing physical resources then run every scheduled pass in order
+		void execute(ID3D11DeviceContext *device_context);
+
+		// Record scheduled passes on the job system, one deferred context and one command list per batch of passes
+		// Command lists are executed on the immediate context in schedule order, so dependencies hold on the gpu timeline
+		// Passes may share a constant buffer pool but not an effect, effects keep per object cpu state
+		void execute_parallel(ID3D11DeviceContext *immediate_context, JobSystem &job_system, uint32_t passes_per_command_list = 1);
+
+		// Drop passes and virtual resources, physical resources are kept for the next frame
+		void clear();
+
+		[[nodiscard]] ID3D11ShaderResourceView *query_srv(uint32_t resource_id) const;
+
+		[[nodiscard]] ID3D11UnorderedAccessView *query_uav(uint32_t resource_id) const;
+
+		[[nodiscard]] ID3D11RenderTargetView *query_rtv(uint32_t resource_id) const;
+
+		[[nodiscard]] ID3D11DepthStencilView *query_dsv(uint32_t resource_id) const;
+
+		[[nodiscard]] ID3D11Resource *query_resource(uint32_t resource_id) const;
+
+		// Heap placement of a transient resource, only valid with a transient allocator
+		[[nodiscard]] TransientResourcePlacement query_placement(uint32_t resource_id) const;
+
+		static uint64_t query_resource_size_in_bytes(const RenderGraphResourceDesc &resource_desc);
+
+		[[nodiscard]] const Pass &query_pass(uint32_t pass_id) const;
+
+		[[nodiscard]] std::span<const uint32_t> get_schedule() const;
+
+		[[nodiscard]] const RenderGraphStats &get_stats() const;
+
+		void print() const;
+
+	private:
+		void build_dependencies();
+
+		void cull_passes();
+
+		void build_schedule();
+
+		void place_transient_resources();
+
+		void pack_transient_resources(std::span<const uint32_t> transient_resource_ids);
+
+		void create_physical_resources();
+
+		HRESULT create_physical_resource(PhysicalResource &physical_resource);
+
+		[[nodiscard]] const PhysicalResource *query_physical_resource(uint32_t resource_id) const;
+
+		// An idle deferred context or a new one, nullptr when the device can't create one
+		ComPtr<ID3D11DeviceContext> acquire_deferred_context();
 
+		void release_deferred_context(ComPtr<ID3D11DeviceContext> deferred_context);
 	};
 }
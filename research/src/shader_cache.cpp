@@ -0,0 +1,788 @@
+//
+// Created by ZZK on 2024/10/23.
+//
+
+#include <shader_cache.h>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <wrl/implements.h>
+
+namespace toy
+{
+	// 64 bit FNV-1a
+	static uint64_t hash_bytecode(const uint8_t *data, size_t size_in_bytes, uint64_t basis)
+	{
+		uint64_t hash = basis;
+		for (size_t i = 0; i < size_in_bytes; ++i)
+		{
+			hash ^= data[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	size_t ShaderObjectKeyHasher::operator()(const ShaderObjectKey &shader_object_key) const
+	{
+		uint64_t digest_low = 0;
+		std::memcpy(&digest_low, shader_object_key.digest.data(), sizeof(digest_low));
+		return static_cast<size_t>(digest_low ^ (reinterpret_cast<uintptr_t>(shader_object_key.device) >> 4) ^ static_cast<uint64_t>(shader_object_key.shader_type));
+	}
+
+	ShaderObjectCache &ShaderObjectCache::get()
+	{
+		static ShaderObjectCache shader_object_cache{};
+		return shader_object_cache;
+	}
+
+	ShaderObjectKey ShaderObjectCache::make_key(ID3D11Device *device, const DxcShaderResult &shader_result, ShaderType shader_type)
+	{
+		ShaderObjectKey shader_object_key{};
+		shader_object_key.device = device;
+		shader_object_key.shader_type = shader_type;
+		shader_object_key.bytecode_size = shader_result.shader_blob->GetBufferSize();
+		if (shader_result.has_shader_hash) {
+			std::memcpy(shader_object_key.digest.data(), shader_result.shader_hash.HashDigest, shader_object_key.digest.size());
+		} else {
+			auto bytecode = static_cast<const uint8_t *>(shader_result.shader_blob->GetBufferPointer());
+			const uint64_t digest_low = hash_bytecode(bytecode, shader_object_key.bytecode_size, 0xcbf29ce484222325ULL);
+			const uint64_t digest_high = hash_bytecode(bytecode, shader_object_key.bytecode_size, 0x84222325cbf29ce4ULL);
+			std::memcpy(shader_object_key.digest.data(), &digest_low, sizeof(digest_low));
+			std::memcpy(shader_object_key.digest.data() + sizeof(digest_low), &digest_high, sizeof(digest_high));
+		}
+		return shader_object_key;
+	}
+
+	template <typename Interface, typename CreateShader>
+	HRESULT ShaderObjectCache::query_or_create(ID3D11Device *device, const DxcShaderResult &shader_result, ShaderType shader_type, Interface **shader, CreateShader &&create_shader)
+	{
+		if (device == nullptr || shader_result.shader_blob == nullptr || shader == nullptr) {
+			return E_INVALIDARG;
+		}
+
+		const auto shader_object_key = make_key(device, shader_result, shader_type);
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		++cache_stats.lookups;
+		if (auto shader_object = shader_objects.find(shader_object_key); shader_object != shader_objects.end()) {
+			++cache_stats.hits;
+			return shader_object->second->QueryInterface(IID_PPV_ARGS(shader));
+		}
+
+		ComPtr<Interface> shader_object = nullptr;
+		const HRESULT hr = create_shader(shader_result.shader_blob->GetBufferPointer(), shader_result.shader_blob->GetBufferSize(), shader_object.GetAddressOf());
+		if (FAILED(hr)) {
+			std::cout << std::format("Failed to create shader object\n");
+			return hr;
+		}
+		++cache_stats.shaders_created;
+		cache_stats.bytecode_bytes_created += shader_object_key.bytecode_size;
+		shader_objects.emplace(shader_object_key, shader_object);
+		*shader = shader_object.Detach();
+		return hr;
+	}
+
+	HRESULT ShaderObjectCache::create_vertex_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11VertexShader **vertex_shader)
+	{
+		return query_or_create(device, shader_result, ShaderType::VertexShader, vertex_shader, [device](const void *bytecode, size_t bytecode_size, ID3D11VertexShader **shader)
+		{
+			return device->CreateVertexShader(bytecode, bytecode_size, nullptr, shader);
+		});
+	}
+
+	HRESULT ShaderObjectCache::create_hull_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11HullShader **hull_shader)
+	{
+		return query_or_create(device, shader_result, ShaderType::HullShader, hull_shader, [device](const void *bytecode, size_t bytecode_size, ID3D11HullShader **shader)
+		{
+			return device->CreateHullShader(bytecode, bytecode_size, nullptr, shader);
+		});
+	}
+
+	HRESULT ShaderObjectCache::create_domain_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11DomainShader **domain_shader)
+	{
+		return query_or_create(device, shader_result, ShaderType::DomainShader, domain_shader, [device](const void *bytecode, size_t bytecode_size, ID3D11DomainShader **shader)
+		{
+			return device->CreateDomainShader(bytecode, bytecode_size, nullptr, shader);
+		});
+	}
+
+	HRESULT ShaderObjectCache::create_geometry_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11GeometryShader **geometry_shader)
+	{
+		return query_or_create(device, shader_result, ShaderType::GeometryShader, geometry_shader, [device](const void *bytecode, size_t bytecode_size, ID3D11GeometryShader **shader)
+		{
+			return device->CreateGeometryShader(bytecode, bytecode_size, nullptr, shader);
+		});
+	}
+
+	HRESULT ShaderObjectCache::create_pixel_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11PixelShader **pixel_shader)
+	{
+		return query_or_create(device, shader_result, ShaderType::PixelShader, pixel_shader, [device](const void *bytecode, size_t bytecode_size, ID3D11PixelShader **shader)
+		{
+			return device->CreatePixelShader(bytecode, bytecode_size, nullptr, shader);
+		});
+	}
+
+	HRESULT ShaderObjectCache::create_compute_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11ComputeShader **compute_shader)
+	{
+		return query_or_create(device, shader_result, ShaderType::ComputeShader, compute_shader, [device](const void *bytecode, size_t bytecode_size, ID3D11ComputeShader **shader)
+		{
+			return device->CreateComputeShader(bytecode, bytecode_size, nullptr, shader);
+		});
+	}
+
+	uint32_t ShaderObjectCache::trim()
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		uint32_t released_count = 0;
+		for (auto shader_object = shader_objects.begin(); shader_object != shader_objects.end();)
+		{
+			// The reference count after AddRef is 2 when the cache holds the only reference
+			shader_object->second->AddRef();
+			if (shader_object->second->Release() == 1) {
+				shader_object = shader_objects.erase(shader_object);
+				++released_count;
+			} else {
+				++shader_object;
+			}
+		}
+		return released_count;
+	}
+
+	void ShaderObjectCache::clear()
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		shader_objects.clear();
+	}
+
+	size_t ShaderObjectCache::size() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		return shader_objects.size();
+	}
+
+	ShaderObjectCacheStats ShaderObjectCache::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		return cache_stats;
+	}
+
+	void ShaderObjectCache::print() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		std::cout << std::format("Shader object cache: {} shaders, {} lookups, {} hits, {} shaders created from {} bytes of bytecode\n",
+								shader_objects.size(), cache_stats.lookups, cache_stats.hits, cache_stats.shaders_created, cache_stats.bytecode_bytes_created);
+	}
+
+	// Input layout cache
+	static constexpr uint32_t make_fourcc(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	template <typename T>
+	static void append_bytes(std::vector<uint8_t> &bytes, const T &value)
+	{
+		auto value_bytes = reinterpret_cast<const uint8_t *>(&value);
+		bytes.insert(bytes.end(), value_bytes, value_bytes + sizeof(T));
+	}
+
+	size_t InputLayoutKeyHasher::operator()(const InputLayoutKey &input_layout_key) const
+	{
+		return static_cast<size_t>(input_layout_key.element_hash ^ (input_layout_key.signature_hash * 0x9e3779b97f4a7c15ULL) ^ (reinterpret_cast<uintptr_t>(input_layout_key.device) >> 4));
+	}
+
+	InputLayoutCache &InputLayoutCache::get()
+	{
+		static InputLayoutCache input_layout_cache{};
+		return input_layout_cache;
+	}
+
+	std::vector<uint8_t> InputLayoutCache::normalize_input_elements(std::span<const D3D11_INPUT_ELEMENT_DESC> input_elements)
+	{
+		struct NormalizedElement
+		{
+			std::string semantic_name = {};
+			D3D11_INPUT_ELEMENT_DESC element_desc{};
+		};
+
+		std::vector<NormalizedElement> normalized_elements{};
+		normalized_elements.reserve(input_elements.size());
+		std::array<uint32_t, D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT> slot_ends{};
+		for (auto &&input_element : input_elements)
+		{
+			NormalizedElement normalized_element{ input_element.SemanticName != nullptr ? input_element.SemanticName : "", input_element };
+			std::ranges::transform(normalized_element.semantic_name, normalized_element.semantic_name.begin(), [](char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+			normalized_element.element_desc.SemanticName = nullptr;
+
+			// Appended elements start where the previous element of the slot ended
+			auto &&element_desc = normalized_element.element_desc;
+			if (element_desc.InputSlot < slot_ends.size()) {
+				if (element_desc.AlignedByteOffset == D3D11_APPEND_ALIGNED_ELEMENT) {
+					element_desc.AlignedByteOffset = slot_ends[element_desc.InputSlot];
+				}
+				slot_ends[element_desc.InputSlot] = element_desc.AlignedByteOffset + query_format_size_in_bytes(element_desc.Format);
+			}
+			normalized_elements.emplace_back(std::move(normalized_element));
+		}
+		std::ranges::sort(normalized_elements, [](const NormalizedElement &lhs, const NormalizedElement &rhs)
+		{
+			if (lhs.element_desc.InputSlot != rhs.element_desc.InputSlot) {
+				return lhs.element_desc.InputSlot < rhs.element_desc.InputSlot;
+			}
+			return lhs.element_desc.AlignedByteOffset < rhs.element_desc.AlignedByteOffset;
+		});
+
+		std::vector<uint8_t> normalized_desc{};
+		for (auto &&normalized_element : normalized_elements)
+		{
+			auto &&element_desc = normalized_element.element_desc;
+			normalized_desc.insert(normalized_desc.end(), normalized_element.semantic_name.begin(), normalized_element.semantic_name.end());
+			normalized_desc.emplace_back(0);
+			append_bytes(normalized_desc, element_desc.SemanticIndex);
+			append_bytes(normalized_desc, static_cast<uint32_t>(element_desc.Format));
+			append_bytes(normalized_desc, element_desc.InputSlot);
+			append_bytes(normalized_desc, element_desc.AlignedByteOffset);
+			append_bytes(normalized_desc, static_cast<uint32_t>(element_desc.InputSlotClass));
+			append_bytes(normalized_desc, element_desc.InstanceDataStepRate);
+		}
+		return normalized_desc;
+	}
+
+	std::span<const uint8_t> InputLayoutCache::query_input_signature(const void *vs_bytecode, size_t bytecode_size)
+	{
+		// Container header: fourcc, 16 byte digest, version, total size, part count, then the part offsets
+		static constexpr size_t container_header_size = 32;
+		auto bytecode = static_cast<const uint8_t *>(vs_bytecode);
+		const std::span<const uint8_t> whole_bytecode{ bytecode, bytecode_size };
+		auto read_uint32 = [bytecode](size_t offset)
+		{
+			uint32_t value = 0;
+			std::memcpy(&value, bytecode + offset, sizeof(value));
+			return value;
+		};
+		if (bytecode == nullptr || bytecode_size < container_header_size || read_uint32(0) != make_fourcc('D', 'X', 'B', 'C')) {
+			return whole_bytecode;
+		}
+
+		const uint32_t part_count = read_uint32(28);
+		if (container_header_size + static_cast<size_t>(part_count) * 4 > bytecode_size) {
+			return whole_bytecode;
+		}
+		for (uint32_t part_index = 0; part_index < part_count; ++part_index)
+		{
+			const size_t part_offset = read_uint32(container_header_size + part_index * 4);
+			if (part_offset + 8 > bytecode_size) {
+				continue;
+			}
+			const uint32_t part_fourcc = read_uint32(part_offset);
+			const size_t part_size = read_uint32(part_offset + 4);
+			if ((part_fourcc == make_fourcc('I', 'S', 'G', '1') || part_fourcc == make_fourcc('I', 'S', 'G', 'N')) && part_offset + 8 + part_size <= bytecode_size) {
+				return whole_bytecode.subspan(part_offset + 8, part_size);
+			}
+		}
+		return whole_bytecode;
+	}
+
+	HRESULT InputLayoutCache::create_input_layout(ID3D11Device *device, std::span<const D3D11_INPUT_ELEMENT_DESC> input_elements, const void *vs_bytecode, size_t bytecode_size,
+												  ID3D11InputLayout **input_layout)
+	{
+		if (device == nullptr || input_elements.empty() || vs_bytecode == nullptr || input_layout == nullptr) {
+			return E_INVALIDARG;
+		}
+
+		auto normalized_elements = normalize_input_elements(input_elements);
+		auto input_signature = query_input_signature(vs_bytecode, bytecode_size);
+		InputLayoutKey input_layout_key{};
+		input_layout_key.element_hash = hash_bytecode(normalized_elements.data(), normalized_elements.size(), 0xcbf29ce484222325ULL);
+		input_layout_key.signature_hash = hash_bytecode(input_signature.data(), input_signature.size(), 0xcbf29ce484222325ULL);
+		input_layout_key.device = device;
+
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		++cache_stats.lookups;
+		auto [entry_begin, entry_end] = input_layouts.equal_range(input_layout_key);
+		for (auto entry = entry_begin; entry != entry_end; ++entry)
+		{
+			if (entry->second.normalized_elements == normalized_elements && std::ranges::equal(entry->second.input_signature, input_signature)) {
+				++cache_stats.hits;
+				*input_layout = entry->second.input_layout.Get();
+				(*input_layout)->AddRef();
+				return S_OK;
+			}
+		}
+
+		ComPtr<ID3D11InputLayout> created_input_layout = nullptr;
+		const HRESULT hr = device->CreateInputLayout(input_elements.data(), static_cast<uint32_t>(input_elements.size()), vs_bytecode, bytecode_size, created_input_layout.GetAddressOf());
+		if (FAILED(hr)) {
+			std::cout << std::format("Failed to create input layout\n");
+			return hr;
+		}
+		++cache_stats.layouts_created;
+		input_layouts.emplace(input_layout_key, InputLayoutEntry{ std::move(normalized_elements), { input_signature.begin(), input_signature.end() }, created_input_layout });
+		*input_layout = created_input_layout.Detach();
+		return hr;
+	}
+
+	uint32_t InputLayoutCache::trim()
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		uint32_t released_count = 0;
+		for (auto entry = input_layouts.begin(); entry != input_layouts.end();)
+		{
+			// The reference count after AddRef is 2 when the cache holds the only reference
+			entry->second.input_layout->AddRef();
+			if (entry->second.input_layout->Release() == 1) {
+				entry = input_layouts.erase(entry);
+				++released_count;
+			} else {
+				++entry;
+			}
+		}
+		return released_count;
+	}
+
+	void InputLayoutCache::clear()
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		input_layouts.clear();
+	}
+
+	size_t InputLayoutCache::size() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		return input_layouts.size();
+	}
+
+	InputLayoutCacheStats InputLayoutCache::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		return cache_stats;
+	}
+
+	void InputLayoutCache::print() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		std::cout << std::format("Input layout cache: {} layouts, {} lookups, {} hits, {} layouts created\n",
+								input_layouts.size(), cache_stats.lookups, cache_stats.hits, cache_stats.layouts_created);
+	}
+
+	// Shader bytecode cache
+	static constexpr uint32_t s_shader_bytecode_magic = 0x43425354; // "TSBC"
+	static constexpr uint32_t s_shader_bytecode_version = 2;
+
+	struct ShaderBytecodeFileHeader
+	{
+		uint32_t magic = s_shader_bytecode_magic;
+		uint32_t version = s_shader_bytecode_version;
+		ShaderBytecodeKey shader_bytecode_key{};
+		DxcShaderHash shader_hash{};
+		uint32_t has_shader_hash = 0;
+		uint32_t is_validated = 0;
+		uint32_t dependency_count = 0;
+		uint32_t padding = 0;
+		uint64_t bytecode_size = 0;
+		uint64_t reflection_size = 0;
+	};
+
+	// Read only blob of cached bytecode, shares ownership of the entry instead of copying it
+	struct ShaderBytecodeBlob final : Microsoft::WRL::RuntimeClass<Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>, IDxcBlob>
+	{
+	private:
+		std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry = nullptr;
+
+	public:
+		explicit ShaderBytecodeBlob(std::shared_ptr<const ShaderBytecodeEntry> input_entry)
+		: shader_bytecode_entry(std::move(input_entry))
+		{
+
+		}
+
+		LPVOID STDMETHODCALLTYPE GetBufferPointer() override
+		{
+			return const_cast<uint8_t *>(shader_bytecode_entry->bytecode.data());
+		}
+
+		SIZE_T STDMETHODCALLTYPE GetBufferSize() override
+		{
+			return shader_bytecode_entry->bytecode.size();
+		}
+	};
+
+	size_t ShaderBytecodeKeyHasher::operator()(const ShaderBytecodeKey &shader_bytecode_key) const
+	{
+		return static_cast<size_t>(shader_bytecode_key.source_hash ^ (shader_bytecode_key.arguments_hash * 0x9e3779b97f4a7c15ULL));
+	}
+
+	ShaderBytecodeCache &ShaderBytecodeCache::get()
+	{
+		static ShaderBytecodeCache shader_bytecode_cache{};
+		return shader_bytecode_cache;
+	}
+
+	void ShaderBytecodeCache::set_directory(std::string_view directory)
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		disk_directory = directory;
+		if (!disk_directory.empty()) {
+			std::error_code error_code{};
+			std::filesystem::create_directories(disk_directory, error_code);
+		}
+	}
+
+	ShaderBytecodeKey ShaderBytecodeCache::make_key(std::span<const uint8_t> source_data, std::span<const wchar_t *const> compilation_arguments)
+	{
+		ShaderBytecodeKey shader_bytecode_key{};
+		shader_bytecode_key.source_hash = hash_bytecode(source_data.data(), source_data.size(), 0xcbf29ce484222325ULL);
+		// Arguments are hashed with their terminators so {"-D", "AB"} and {"-DA", "B"} differ
+		uint64_t arguments_hash = 0xcbf29ce484222325ULL;
+		for (auto argument : compilation_arguments)
+		{
+			const size_t argument_size = (std::char_traits<wchar_t>::length(argument) + 1) * sizeof(wchar_t);
+			arguments_hash = hash_bytecode(reinterpret_cast<const uint8_t *>(argument), argument_size, arguments_hash);
+		}
+		shader_bytecode_key.arguments_hash = arguments_hash;
+		return shader_bytecode_key;
+	}
+
+	bool ShaderBytecodeCache::hash_file(const std::wstring &file_path, uint64_t &content_hash)
+	{
+		std::ifstream source_file{ std::filesystem::path(file_path), std::ios::binary };
+		if (!source_file) {
+			return false;
+		}
+		const std::vector<uint8_t> file_data{ std::istreambuf_iterator<char>(source_file), std::istreambuf_iterator<char>() };
+		content_hash = hash_bytecode(file_data.data(), file_data.size(), 0xcbf29ce484222325ULL);
+		return true;
+	}
+
+	ComPtr<IDxcBlob> ShaderBytecodeCache::create_bytecode_blob(std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry)
+	{
+		if (shader_bytecode_entry == nullptr) {
+			return nullptr;
+		}
+		return Microsoft::WRL::Make<ShaderBytecodeBlob>(std::move(shader_bytecode_entry));
+	}
+
+	bool ShaderBytecodeCache::is_up_to_date(const ShaderBytecodeEntry &shader_bytecode_entry)
+	{
+		return std::ranges::all_of(shader_bytecode_entry.dependencies, [](const ShaderDependency &shader_dependency)
+		{
+			uint64_t content_hash = 0;
+			return hash_file(shader_dependency.file_path, content_hash) && content_hash == shader_dependency.content_hash;
+		});
+	}
+
+	std::shared_ptr<const ShaderBytecodeEntry> ShaderBytecodeCache::query(const ShaderBytecodeKey &shader_bytecode_key)
+	{
+		std::unique_lock<std::mutex> lock{ cache_mutex };
+		++cache_stats.lookups;
+		if (auto entry_iter = entries.find(shader_bytecode_key); entry_iter != entries.end()) {
+			auto shader_bytecode_entry = entry_iter->second;
+			lock.unlock();
+			if (is_up_to_date(*shader_bytecode_entry)) {
+				std::lock_guard<std::mutex> stats_lock{ cache_mutex };
+				++cache_stats.memory_hits;
+				return shader_bytecode_entry;
+			}
+			std::lock_guard<std::mutex> stale_lock{ cache_mutex };
+			entries.erase(shader_bytecode_key);
+			++cache_stats.stale_entries;
+			++cache_stats.misses;
+			return nullptr;
+		}
+		lock.unlock();
+
+		ShaderBytecodeEntry shader_bytecode_entry{};
+		const bool is_on_disk = read_from_disk(shader_bytecode_key, shader_bytecode_entry);
+		const bool is_fresh = is_on_disk && is_up_to_date(shader_bytecode_entry);
+		lock.lock();
+		if (!is_fresh) {
+			cache_stats.stale_entries += is_on_disk ? 1 : 0;
+			++cache_stats.misses;
+			return nullptr;
+		}
+		++cache_stats.disk_hits;
+		auto [entry_iter, is_new_entry] = entries.try_emplace(shader_bytecode_key, std::make_shared<const ShaderBytecodeEntry>(std::move(shader_bytecode_entry)));
+		return entry_iter->second;
+	}
+
+	std::shared_ptr<const ShaderBytecodeEntry> ShaderBytecodeCache::insert(const ShaderBytecodeKey &shader_bytecode_key, ShaderBytecodeEntry shader_bytecode_entry)
+	{
+		auto shared_entry = std::make_shared<const ShaderBytecodeEntry>(std::move(shader_bytecode_entry));
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		entries.insert_or_assign(shader_bytecode_key, shared_entry);
+		if (!disk_directory.empty() && write_to_disk(shader_bytecode_key, *shared_entry)) {
+			cache_stats.bytes_written += shared_entry->bytecode.size() + shared_entry->reflection.size();
+		}
+		return shared_entry;
+	}
+
+	void ShaderBytecodeCache::invalidate(const ShaderBytecodeKey &shader_bytecode_key)
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		entries.erase(shader_bytecode_key);
+		++cache_stats.invalidations;
+		if (!disk_directory.empty()) {
+			std::error_code error_code{};
+			std::filesystem::remove(query_file_path(shader_bytecode_key), error_code);
+		}
+	}
+
+	void ShaderBytecodeCache::clear()
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		entries.clear();
+	}
+
+	size_t ShaderBytecodeCache::size() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		return entries.size();
+	}
+
+	ShaderBytecodeCacheStats ShaderBytecodeCache::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		return cache_stats;
+	}
+
+	void ShaderBytecodeCache::print() const
+	{
+		std::lock_guard<std::mutex> lock{ cache_mutex };
+		size_t bytecode_bytes = 0;
+		size_t reflection_bytes = 0;
+		for (auto &&[shader_bytecode_key, shader_bytecode_entry] : entries)
+		{
+			bytecode_bytes += shader_bytecode_entry->bytecode.size();
+			reflection_bytes += shader_bytecode_entry->reflection.size();
+		}
+		std::cout << std::format("Shader bytecode cache: {} entries, {} lookups, {} memory hits, {} disk hits, {} misses, {} stale, {} invalidated, {} bytes written\n",
+								entries.size(), cache_stats.lookups, cache_stats.memory_hits, cache_stats.disk_hits, cache_stats.misses,
+								cache_stats.stale_entries, cache_stats.invalidations, cache_stats.bytes_written);
+		std::cout << std::format("Shader bytecode cache resident: {} bytecode bytes, {} reflection bytes\n", bytecode_bytes, reflection_bytes);
+	}
+
+	std::string ShaderBytecodeCache::query_file_path(const ShaderBytecodeKey &shader_bytecode_key) const
+	{
+		return std::format("{}/{:016x}{:016x}.sbc", disk_directory, shader_bytecode_key.source_hash, shader_bytecode_key.arguments_hash);
+	}
+
+	// | header | dependencies: content hash, path size, utf-8 path | bytecode | reflection |
+	std::vector<uint8_t> ShaderBytecodeCache::serialize_entry(const ShaderBytecodeKey &shader_bytecode_key, const ShaderBytecodeEntry &shader_bytecode_entry)
+	{
+		ShaderBytecodeFileHeader header{};
+		header.shader_bytecode_key = shader_bytecode_key;
+		header.shader_hash = shader_bytecode_entry.shader_hash;
+		header.has_shader_hash = shader_bytecode_entry.has_shader_hash ? 1 : 0;
+		header.is_validated = shader_bytecode_entry.is_validated ? 1 : 0;
+		header.dependency_count = static_cast<uint32_t>(shader_bytecode_entry.dependencies.size());
+		header.bytecode_size = shader_bytecode_entry.bytecode.size();
+		header.reflection_size = shader_bytecode_entry.reflection.size();
+
+		std::vector<uint8_t> entry_data(sizeof(header));
+		std::memcpy(entry_data.data(), &header, sizeof(header));
+		auto append = [&entry_data](const void *data, size_t size_in_bytes)
+		{
+			auto bytes = static_cast<const uint8_t *>(data);
+			entry_data.insert(entry_data.end(), bytes, bytes + size_in_bytes);
+		};
+		for (auto &&shader_dependency : shader_bytecode_entry.dependencies)
+		{
+			const std::u8string dependency_path = std::filesystem::path(shader_dependency.file_path).u8string();
+			const auto path_size = static_cast<uint32_t>(dependency_path.size());
+			append(&shader_dependency.content_hash, sizeof(shader_dependency.content_hash));
+			append(&path_size, sizeof(path_size));
+			append(dependency_path.data(), path_size);
+		}
+		append(shader_bytecode_entry.bytecode.data(), shader_bytecode_entry.bytecode.size());
+		append(shader_bytecode_entry.reflection.data(), shader_bytecode_entry.reflection.size());
+		return entry_data;
+	}
+
+	bool ShaderBytecodeCache::deserialize_entry(std::span<const uint8_t> entry_data, const ShaderBytecodeKey &shader_bytecode_key, ShaderBytecodeEntry &shader_bytecode_entry)
+	{
+		size_t read_offset = 0;
+		auto read = [&entry_data, &read_offset](void *data, size_t size_in_bytes)
+		{
+			if (size_in_bytes > entry_data.size() - read_offset) {
+				return false;
+			}
+			std::memcpy(data, entry_data.data() + read_offset, size_in_bytes);
+			read_offset += size_in_bytes;
+			return true;
+		};
+		// The file name is only a hash, the header holds the full key
+		ShaderBytecodeFileHeader header{};
+		if (!read(&header, sizeof(header)) || header.magic != s_shader_bytecode_magic || header.version != s_shader_bytecode_version ||
+			!(header.shader_bytecode_key == shader_bytecode_key)) {
+			return false;
+		}
+		shader_bytecode_entry.shader_hash = header.shader_hash;
+		shader_bytecode_entry.has_shader_hash = header.has_shader_hash != 0;
+		shader_bytecode_entry.is_validated = header.is_validated != 0;
+		shader_bytecode_entry.dependencies.resize(header.dependency_count);
+		for (auto &&shader_dependency : shader_bytecode_entry.dependencies)
+		{
+			uint32_t path_size = 0;
+			if (!read(&shader_dependency.content_hash, sizeof(shader_dependency.content_hash)) || !read(&path_size, sizeof(path_size)) ||
+				path_size > entry_data.size() - read_offset) {
+				return false;
+			}
+			std::u8string dependency_path(path_size, u8'\0');
+			read(dependency_path.data(), path_size);
+			shader_dependency.file_path = std::filesystem::path(dependency_path).wstring();
+		}
+		if (header.bytecode_size + header.reflection_size != entry_data.size() - read_offset) {
+			return false;
+		}
+		shader_bytecode_entry.bytecode.resize(header.bytecode_size);
+		shader_bytecode_entry.reflection.resize(header.reflection_size);
+		return read(shader_bytecode_entry.bytecode.data(), header.bytecode_size) && read(shader_bytecode_entry.reflection.data(), header.reflection_size);
+	}
+
+	bool ShaderBytecodeCache::write_to_disk(const ShaderBytecodeKey &shader_bytecode_key, const ShaderBytecodeEntry &shader_bytecode_entry) const
+	{
+		// Written aside and renamed so a concurrent reader never sees a partial file
+		const std::string file_path = query_file_path(shader_bytecode_key);
+		const std::string temporary_path = std::format("{}.{:x}.tmp", file_path, reinterpret_cast<uintptr_t>(&shader_bytecode_entry));
+		{
+			std::ofstream bytecode_file{ temporary_path, std::ios::binary | std::ios::trunc };
+			if (!bytecode_file) {
+				std::cout << std::format("Failed to write shader bytecode {}\n", file_path);
+				return false;
+			}
+			const auto entry_data = serialize_entry(shader_bytecode_key, shader_bytecode_entry);
+			bytecode_file.write(reinterpret_cast<const char *>(entry_data.data()), static_cast<std::streamsize>(entry_data.size()));
+			if (!bytecode_file) {
+				return false;
+			}
+		}
+		std::error_code error_code{};
+		std::filesystem::rename(temporary_path, file_path, error_code);
+		if (error_code) {
+			std::filesystem::remove(temporary_path, error_code);
+			return false;
+		}
+		return true;
+	}
+
+	bool ShaderBytecodeCache::read_from_disk(const ShaderBytecodeKey &shader_bytecode_key, ShaderBytecodeEntry &shader_bytecode_entry) const
+	{
+		std::string file_path{};
+		{
+			std::lock_guard<std::mutex> lock{ cache_mutex };
+			if (disk_directory.empty()) {
+				return false;
+			}
+			file_path = query_file_path(shader_bytecode_key);
+		}
+		std::ifstream bytecode_file{ file_path, std::ios::binary };
+		if (!bytecode_file) {
+			return false;
+		}
+		const std::vector<uint8_t> entry_data{ std::istreambuf_iterator<char>(bytecode_file), std::istreambuf_iterator<char>() };
+		return deserialize_entry(entry_data, shader_bytecode_key, shader_bytecode_entry);
+	}
+
+	// Shader validation queue
+	ShaderValidationQueue::~ShaderValidationQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ queue_mutex };
+			is_stopping = true;
+			pending_validations.clear();
+		}
+		pending_condition.notify_all();
+		if (validation_thread.joinable()) {
+			validation_thread.join();
+		}
+	}
+
+	ShaderValidationQueue &ShaderValidationQueue::get()
+	{
+		static ShaderValidationQueue shader_validation_queue{};
+		return shader_validation_queue;
+	}
+
+	void ShaderValidationQueue::enqueue(const ShaderBytecodeKey &shader_bytecode_key, std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ queue_mutex };
+			const bool is_queued = std::ranges::any_of(pending_validations, [&shader_bytecode_key](const PendingValidation &pending_validation)
+			{
+				return pending_validation.shader_bytecode_key == shader_bytecode_key;
+			});
+			if (is_queued || is_stopping) {
+				return;
+			}
+			pending_validations.emplace_back(shader_bytecode_key, std::move(shader_bytecode_entry));
+			++validation_stats.queued;
+			if (!validation_thread.joinable()) {
+				validation_thread = std::thread(&ShaderValidationQueue::validate_pending_shaders, this);
+			}
+		}
+		pending_condition.notify_one();
+	}
+
+	void ShaderValidationQueue::wait()
+	{
+		std::unique_lock<std::mutex> lock{ queue_mutex };
+		idle_condition.wait(lock, [this]() { return (pending_validations.empty() && running_validations == 0) || is_stopping; });
+	}
+
+	void ShaderValidationQueue::validate_pending_shaders()
+	{
+		std::unique_lock<std::mutex> lock{ queue_mutex };
+		while (true)
+		{
+			pending_condition.wait(lock, [this]() { return !pending_validations.empty() || is_stopping; });
+			if (is_stopping) {
+				break;
+			}
+			auto pending_validation = std::move(pending_validations.front());
+			pending_validations.pop_front();
+			++running_validations;
+			lock.unlock();
+
+			// The validator signs the container in place, so it works on a copy the queue owns
+			auto validated_entry = std::make_shared<ShaderBytecodeEntry>(*pending_validation.shader_bytecode_entry);
+			auto bytecode_blob = ShaderBytecodeCache::create_bytecode_blob(validated_entry);
+			std::string error_log{};
+			const HRESULT hr = DxcInStance::get().validate_bytecode(bytecode_blob.Get(), error_log);
+			const bool is_valid = SUCCEEDED(hr);
+			bytecode_blob = nullptr;
+			if (hr == E_NOINTERFACE) {
+				// Nothing could be checked, the entry stays unvalidated for a later run
+			} else if (is_valid) {
+				validated_entry->is_validated = true;
+				ShaderBytecodeCache::get().insert(pending_validation.shader_bytecode_key, std::move(*validated_entry));
+			} else {
+				std::cout << std::format("Shader {:016x}{:016x} failed validation and was dropped from the bytecode cache\n{}\n",
+										pending_validation.shader_bytecode_key.source_hash, pending_validation.shader_bytecode_key.arguments_hash, error_log);
+				ShaderBytecodeCache::get().invalidate(pending_validation.shader_bytecode_key);
+			}
+
+			lock.lock();
+			--running_validations;
+			if (hr != E_NOINTERFACE) {
+				++(is_valid ? validation_stats.passed : validation_stats.failed);
+			}
+			if (pending_validations.empty() && running_validations == 0) {
+				idle_condition.notify_all();
+			}
+		}
+		idle_condition.notify_all();
+	}
+
+	ShaderValidationStats ShaderValidationQueue::get_stats() const
+	{
+		std::lock_guard<std::mutex> lock{ queue_mutex };
+		return validation_stats;
+	}
+
+	void ShaderValidationQueue::print() const
+	{
+		std::lock_guard<std::mutex> lock{ queue_mutex };
+		std::cout << std::format("Shader validation queue: {} queued, {} passed, {} failed, {} pending\n",
+								validation_stats.queued, validation_stats.passed, validation_stats.failed, pending_validations.size() + running_validations);
+	}
+}
@@ -0,0 +1,331 @@
+//
+// Created by ZZK on 2024/10/23.
+//
+
+#pragma once
+
+#include <effect.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace toy
+{
+	// Shader object key, the dxc shader hash or a bytecode digest when the hash is unavailable
+	struct ShaderObjectKey
+	{
+		std::array<uint8_t, 16> digest{};
+		ID3D11Device *device = nullptr;
+		size_t bytecode_size = 0;
+		ShaderType shader_type = ShaderType::VertexShader;
+
+		bool operator==(const ShaderObjectKey &other) const = default;
+	};
+
+	struct ShaderObjectKeyHasher
+	{
+		size_t operator()(const ShaderObjectKey &shader_object_key) const;
+	};
+
+	struct ShaderObjectCacheStats
+	{
+		uint64_t lookups = 0;
+		uint64_t hits = 0;
+		uint64_t shaders_created = 0;
+		uint64_t bytecode_bytes_created = 0;
+	};
+
+	// Shader objects shared by every effect that compiles to the same bytecode
+	// The cache keeps one reference to each shader, effects add their own through ComPtr
+	struct ShaderObjectCache
+	{
+	private:
+		std::unordered_map<ShaderObjectKey, ComPtr<ID3D11DeviceChild>, ShaderObjectKeyHasher> shader_objects;
+		ShaderObjectCacheStats cache_stats{};
+		mutable std::mutex cache_mutex;
+
+	private:
+		ShaderObjectCache() = default;
+
+	public:
+		~ShaderObjectCache() = default;
+
+		ShaderObjectCache(const ShaderObjectCache &) = delete;
+		ShaderObjectCache &operator=(const ShaderObjectCache &) = delete;
+		ShaderObjectCache(ShaderObjectCache &&) = delete;
+		ShaderObjectCache &operator=(ShaderObjectCache &&) = delete;
+
+		static ShaderObjectCache &get();
+
+		HRESULT create_vertex_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11VertexShader **vertex_shader);
+
+		HRESULT create_hull_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11HullShader **hull_shader);
+
+		HRESULT create_domain_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11DomainShader **domain_shader);
+
+		HRESULT create_geometry_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11GeometryShader **geometry_shader);
+
+		HRESULT create_pixel_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11PixelShader **pixel_shader);
+
+		HRESULT create_compute_shader(ID3D11Device *device, const DxcShaderResult &shader_result, ID3D11ComputeShader **compute_shader);
+
+		// Release shaders no effect references anymore, returns the number released
+		uint32_t trim();
+
+		void clear();
+
+		[[nodiscard]] size_t size() const;
+
+		[[nodiscard]] ShaderObjectCacheStats get_stats() const;
+
+		void print() const;
+
+		static ShaderObjectKey make_key(ID3D11Device *device, const DxcShaderResult &shader_result, ShaderType shader_type);
+
+	private:
+		template <typename Interface, typename CreateShader>
+		HRESULT query_or_create(ID3D11Device *device, const DxcShaderResult &shader_result, ShaderType shader_type, Interface **shader, CreateShader &&create_shader);
+	};
+
+	// Input layout key, hashes of the normalized element list and of the VS input signature chunk
+	struct InputLayoutKey
+	{
+		uint64_t element_hash = 0;
+		uint64_t signature_hash = 0;
+		ID3D11Device *device = nullptr;
+
+		bool operator==(const InputLayoutKey &other) const = default;
+	};
+
+	struct InputLayoutKeyHasher
+	{
+		size_t operator()(const InputLayoutKey &input_layout_key) const;
+	};
+
+	struct InputLayoutCacheStats
+	{
+		uint64_t lookups = 0;
+		uint64_t hits = 0;
+		uint64_t layouts_created = 0;
+	};
+
+	// Input layouts shared by every VS with the same element list and input signature
+	// Entries keep the normalized description they were created from, so a hash collision creates a new layout instead of a wrong one
+	struct InputLayoutCache
+	{
+	private:
+		struct InputLayoutEntry
+		{
+			std::vector<uint8_t> normalized_elements = {};
+			std::vector<uint8_t> input_signature = {};
+			ComPtr<ID3D11InputLayout> input_layout = nullptr;
+		};
+
+		std::unordered_multimap<InputLayoutKey, InputLayoutEntry, InputLayoutKeyHasher> input_layouts;
+		InputLayoutCacheStats cache_stats{};
+		mutable std::mutex cache_mutex;
+
+	private:
+		InputLayoutCache() = default;
+
+	public:
+		~InputLayoutCache() = default;
+
+		InputLayoutCache(const InputLayoutCache &) = delete;
+		InputLayoutCache &operator=(const InputLayoutCache &) = delete;
+		InputLayoutCache(InputLayoutCache &&) = delete;
+		InputLayoutCache &operator=(InputLayoutCache &&) = delete;
+
+		static InputLayoutCache &get();
+
+		// Same arguments as ID3D11Device::CreateInputLayout
+		HRESULT create_input_layout(ID3D11Device *device, std::span<const D3D11_INPUT_ELEMENT_DESC> input_elements, const void *vs_bytecode, size_t bytecode_size,
+									ID3D11InputLayout **input_layout);
+
+		// Release layouts no effect references anymore, returns the number released
+		uint32_t trim();
+
+		void clear();
+
+		[[nodiscard]] size_t size() const;
+
+		[[nodiscard]] InputLayoutCacheStats get_stats() const;
+
+		void print() const;
+
+		// Semantics upper cased, appended offsets resolved and elements sorted by slot and offset, element order doesn't change a layout
+		static std::vector<uint8_t> normalize_input_elements(std::span<const D3D11_INPUT_ELEMENT_DESC> input_elements);
+
+		// Input signature chunk of a dxbc or dxil container, the whole bytecode when the container has none
+		static std::span<const uint8_t> query_input_signature(const void *vs_bytecode, size_t bytecode_size);
+	};
+
+	// Compile key, digests of the source text and of everything passed to the compiler along with it
+	struct ShaderBytecodeKey
+	{
+		uint64_t source_hash = 0;
+		uint64_t arguments_hash = 0;
+
+		bool operator==(const ShaderBytecodeKey &other) const = default;
+	};
+
+	struct ShaderBytecodeKeyHasher
+	{
+		size_t operator()(const ShaderBytecodeKey &shader_bytecode_key) const;
+	};
+
+	// File the include handler opened during the compile, the entry is stale once its contents change
+	struct ShaderDependency
+	{
+		std::wstring file_path = {};
+		uint64_t content_hash = 0;
+	};
+
+	// Compiler outputs the runtime needs, enough to build a DxcShaderResult without loading dxcompiler
+	struct ShaderBytecodeEntry
+	{
+		std::vector<uint8_t> bytecode = {};
+		std::vector<uint8_t> reflection = {};
+		DxcShaderHash shader_hash{};
+		bool has_shader_hash = false;
+		// False when compiled with -Vd until the validation queue passed it
+		bool is_validated = true;
+		std::vector<ShaderDependency> dependencies = {};
+	};
+
+	struct ShaderBytecodeCacheStats
+	{
+		uint64_t lookups = 0;
+		uint64_t memory_hits = 0;
+		uint64_t disk_hits = 0;
+		uint64_t misses = 0;
+		uint64_t stale_entries = 0;
+		uint64_t invalidations = 0;
+		uint64_t bytes_written = 0;
+	};
+
+	// Compiled bytecode by source and arguments, in memory and optionally in a directory shared by later runs
+	// A hit never touches dxcompiler, so DxcInStance only loads the compiler on a miss
+	// The compiler build isn't part of the key, clear the directory after updating dxc
+	struct ShaderBytecodeCache
+	{
+	private:
+		std::unordered_map<ShaderBytecodeKey, std::shared_ptr<const ShaderBytecodeEntry>, ShaderBytecodeKeyHasher> entries;
+		std::string disk_directory = {};
+		ShaderBytecodeCacheStats cache_stats{};
+		mutable std::mutex cache_mutex;
+
+	private:
+		ShaderBytecodeCache() = default;
+
+	public:
+		~ShaderBytecodeCache() = default;
+
+		ShaderBytecodeCache(const ShaderBytecodeCache &) = delete;
+		ShaderBytecodeCache &operator=(const ShaderBytecodeCache &) = delete;
+		ShaderBytecodeCache(ShaderBytecodeCache &&) = delete;
+		ShaderBytecodeCache &operator=(ShaderBytecodeCache &&) = delete;
+
+		static ShaderBytecodeCache &get();
+
+		// An empty directory keeps the cache in memory only
+		void set_directory(std::string_view directory);
+
+		// Memory first, then disk, nullptr on a miss or when an included file changed since the compile
+		std::shared_ptr<const ShaderBytecodeEntry> query(const ShaderBytecodeKey &shader_bytecode_key);
+
+		std::shared_ptr<const ShaderBytecodeEntry> insert(const ShaderBytecodeKey &shader_bytecode_key, ShaderBytecodeEntry shader_bytecode_entry);
+
+		// Drop the entry from memory and disk, the next lookup compiles again
+		void invalidate(const ShaderBytecodeKey &shader_bytecode_key);
+
+		void clear();
+
+		[[nodiscard]] size_t size() const;
+
+		[[nodiscard]] ShaderBytecodeCacheStats get_stats() const;
+
+		void print() const;
+
+		static ShaderBytecodeKey make_key(std::span<const uint8_t> source_data, std::span<const wchar_t *const> compilation_arguments);
+
+		// False when the file can't be read
+		static bool hash_file(const std::wstring &file_path, uint64_t &content_hash);
+
+		// IDxcBlob over the entry's bytecode, keeps the entry alive without copying it
+		static ComPtr<IDxcBlob> create_bytecode_blob(std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry);
+
+		// Same bytes on disk and on the compile server socket
+		static std::vector<uint8_t> serialize_entry(const ShaderBytecodeKey &shader_bytecode_key, const ShaderBytecodeEntry &shader_bytecode_entry);
+
+		// False when the bytes are truncated or hold another key
+		static bool deserialize_entry(std::span<const uint8_t> entry_data, const ShaderBytecodeKey &shader_bytecode_key, ShaderBytecodeEntry &shader_bytecode_entry);
+
+	private:
+		static bool is_up_to_date(const ShaderBytecodeEntry &shader_bytecode_entry);
+
+		[[nodiscard]] std::string query_file_path(const ShaderBytecodeKey &shader_bytecode_key) const;
+
+		bool write_to_disk(const ShaderBytecodeKey &shader_bytecode_key, const ShaderBytecodeEntry &shader_bytecode_entry) const;
+
+		bool read_from_disk(const ShaderBytecodeKey &shader_bytecode_key, ShaderBytecodeEntry &shader_bytecode_entry) const;
+	};
+
+	struct ShaderValidationStats
+	{
+		uint64_t queued = 0;
+		uint64_t passed = 0;
+		uint64_t failed = 0;
+	};
+
+	// Validates shaders compiled with -Vd on a background thread, off the compile latency
+	// A passing shader replaces its cache entry with the signed bytecode, a failing one is reported and invalidated
+	// Shaders already created from failing bytecode stay in use until they are recompiled
+	struct ShaderValidationQueue
+	{
+	private:
+		struct PendingValidation
+		{
+			ShaderBytecodeKey shader_bytecode_key{};
+			std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry = nullptr;
+		};
+
+		std::deque<PendingValidation> pending_validations = {};
+		uint32_t running_validations = 0;
+		bool is_stopping = false;
+		std::thread validation_thread;
+		std::condition_variable pending_condition;
+		std::condition_variable idle_condition;
+		ShaderValidationStats validation_stats{};
+		mutable std::mutex queue_mutex;
+
+	private:
+		ShaderValidationQueue() = default;
+
+	public:
+		// Pending validations are dropped, their entries stay unvalidated and are queued again when next used
+		~ShaderValidationQueue();
+
+		ShaderValidationQueue(const ShaderValidationQueue &) = delete;
+		ShaderValidationQueue &operator=(const ShaderValidationQueue &) = delete;
+		ShaderValidationQueue(ShaderValidationQueue &&) = delete;
+		ShaderValidationQueue &operator=(ShaderValidationQueue &&) = delete;
+
+		static ShaderValidationQueue &get();
+
+		// Entries already waiting are queued once
+		void enqueue(const ShaderBytecodeKey &shader_bytecode_key, std::shared_ptr<const ShaderBytecodeEntry> shader_bytecode_entry);
+
+		// Block until every queued shader is validated
+		void wait();
+
+		[[nodiscard]] ShaderValidationStats get_stats() const;
+
+		void print() const;
+
+	private:
+		void validate_pending_shaders();
+	};
+}
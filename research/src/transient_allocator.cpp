@@ -0,0 +1,187 @@
+//
+// Created by ZZK on 2024/10/24.
+//
+
+#include <transient_allocator.h>
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <utility>
+
+namespace toy
+{
+	static uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	// Fake transient memory backend
+	uint32_t FakeTransientMemoryBackend::create_heap(uint64_t size_in_bytes)
+	{
+		heap_sizes.emplace_back(size_in_bytes);
+		bytes_alive += size_in_bytes;
+		bytes_peak = (std::max)(bytes_peak, bytes_alive);
+		return static_cast<uint32_t>(heap_sizes.size() - 1);
+	}
+
+	void FakeTransientMemoryBackend::release_heap(uint32_t heap_index)
+	{
+		if (heap_index < heap_sizes.size()) {
+			bytes_alive -= heap_sizes[heap_index];
+			heap_sizes[heap_index] = 0;
+		}
+	}
+
+	uint64_t FakeTransientMemoryBackend::query_bytes_alive() const
+	{
+		return bytes_alive;
+	}
+
+	uint64_t FakeTransientMemoryBackend::query_bytes_peak() const
+	{
+		return bytes_peak;
+	}
+
+	// Transient resource allocator
+	TransientResourceAllocator::TransientResourceAllocator(TransientMemoryBackend *backend)
+	: memory_backend(backend)
+	{
+
+	}
+
+	TransientResourceAllocator::~TransientResourceAllocator()
+	{
+		if (memory_backend != nullptr && heap_index != UINT32_MAX) {
+			memory_backend->release_heap(heap_index);
+		}
+	}
+
+	uint32_t TransientResourceAllocator::add_request(const TransientResourceRequest &request)
+	{
+		requests.emplace_back(request);
+		return static_cast<uint32_t>(requests.size() - 1);
+	}
+
+	void TransientResourceAllocator::allocate()
+	{
+		const uint32_t request_count = static_cast<uint32_t>(requests.size());
+		placements.assign(request_count, TransientResourcePlacement{});
+		placement_order.resize(request_count);
+		for (uint32_t request_id = 0; request_id < request_count; ++request_id)
+		{
+			placement_order[request_id] = request_id;
+		}
+		std::sort(placement_order.begin(), placement_order.end(), [this](uint32_t lhs, uint32_t rhs)
+		{
+			if (requests[lhs].size_in_bytes != requests[rhs].size_in_bytes) {
+				return requests[lhs].size_in_bytes > requests[rhs].size_in_bytes;
+			}
+			return requests[lhs].first_use < requests[rhs].first_use;
+		});
+
+		allocator_stats.request_count = request_count;
+		allocator_stats.naive_bytes = 0;
+		uint64_t packed_size = 0;
+		for (uint32_t order_index = 0; order_index < request_count; ++order_index)
+		{
+			const uint32_t request_id = placement_order[order_index];
+			auto &&request = requests[request_id];
+			allocator_stats.naive_bytes += align_up(request.size_in_bytes, request.alignment);
+
+			// Address ranges already taken by requests whose lifetimes intersect this one
+			overlapping_ranges.clear();
+			for (uint32_t placed_index = 0; placed_index < order_index; ++placed_index)
+			{
+				auto &&placed_request = requests[placement_order[placed_index]];
+				if (placed_request.first_use <= request.last_use && request.first_use <= placed_request.last_use) {
+					const uint64_t begin = placements[placement_order[placed_index]].offset_in_bytes;
+					overlapping_ranges.emplace_back(begin, begin + placed_request.size_in_bytes);
+				}
+			}
+			std::sort(overlapping_ranges.begin(), overlapping_ranges.end(), [](const PlacedRange &lhs, const PlacedRange &rhs) { return lhs.begin < rhs.begin; });
+
+			// Best fit, the smallest gap that holds the request, otherwise past the last range
+			uint64_t best_offset = UINT64_MAX;
+			uint64_t best_gap = UINT64_MAX;
+			uint64_t cursor = 0;
+			for (auto &&overlapping_range : overlapping_ranges)
+			{
+				const uint64_t offset = align_up(cursor, request.alignment);
+				if (overlapping_range.begin > offset && overlapping_range.begin - offset >= request.size_in_bytes) {
+					const uint64_t gap = overlapping_range.begin - offset;
+					if (gap < best_gap) {
+						best_gap = gap;
+						best_offset = offset;
+					}
+				}
+				cursor = (std::max)(cursor, overlapping_range.end);
+			}
+			if (best_offset == UINT64_MAX) {
+				best_offset = align_up(cursor, request.alignment);
+			}
+
+			placements[request_id].offset_in_bytes = best_offset;
+			packed_size = (std::max)(packed_size, best_offset + request.size_in_bytes);
+		}
+
+		if (memory_backend != nullptr && packed_size > heap_size) {
+			if (heap_index != UINT32_MAX) {
+				memory_backend->release_heap(heap_index);
+			}
+			heap_index = memory_backend->create_heap(packed_size);
+			heap_size = packed_size;
+			++allocator_stats.heap_creations;
+		}
+		for (auto &&placement : placements)
+		{
+			placement.heap_index = heap_index;
+		}
+
+		allocator_stats.heap_bytes = packed_size;
+		allocator_stats.peak_live_bytes = compute_peak_live_bytes();
+	}
+
+	void TransientResourceAllocator::clear()
+	{
+		requests.clear();
+		placements.clear();
+	}
+
+	const TransientResourcePlacement &TransientResourceAllocator::query_placement(uint32_t request_id) const
+	{
+		return placements[request_id];
+	}
+
+	const TransientAllocatorStats &TransientResourceAllocator::get_stats() const
+	{
+		return allocator_stats;
+	}
+
+	void TransientResourceAllocator::print() const
+	{
+		std::cout << std::format("Transient allocator: {} requests, naive {} bytes, packed {} bytes, live peak {} bytes, {} heap creations\n",
+								allocator_stats.request_count, allocator_stats.naive_bytes, allocator_stats.heap_bytes, allocator_stats.peak_live_bytes,
+								allocator_stats.heap_creations);
+	}
+
+	uint64_t TransientResourceAllocator::compute_peak_live_bytes() const
+	{
+		// Lower bound for any packing, the most bytes alive at a single schedule position
+		std::vector<std::pair<uint32_t, int64_t>> events{};
+		events.reserve(requests.size() * 2);
+		for (auto &&request : requests)
+		{
+			events.emplace_back(request.first_use * 2, static_cast<int64_t>(request.size_in_bytes));
+			events.emplace_back(request.last_use * 2 + 1, -static_cast<int64_t>(request.size_in_bytes));
+		}
+		std::sort(events.begin(), events.end());
+		int64_t live_bytes = 0;
+		int64_t peak_bytes = 0;
+		for (auto &&[position, delta] : events)
+		{
+			live_bytes += delta;
+			peak_bytes = (std::max)(peak_bytes, live_bytes);
+		}
+		return static_cast<uint64_t>(peak_bytes);
+	}
+}
@@ -0,0 +1,111 @@
+//
+// Created by ZZK on 2024/10/24.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace toy
+{
+	// Transient resource lifetime in schedule positions, both ends inclusive
+	struct TransientResourceRequest
+	{
+		uint64_t size_in_bytes = 0;
+		uint64_t alignment = 65536;
+		uint32_t first_use = 0;
+		uint32_t last_use = 0;
+	};
+
+	struct TransientResourcePlacement
+	{
+		uint32_t heap_index = UINT32_MAX;
+		uint64_t offset_in_bytes = 0;
+	};
+
+	struct TransientAllocatorStats
+	{
+		uint32_t request_count = 0;
+		uint64_t naive_bytes = 0;
+		uint64_t peak_live_bytes = 0;
+		uint64_t heap_bytes = 0;
+		uint32_t heap_creations = 0;
+	};
+
+	// Backing memory provider, a heap is one contiguous range transient resources are placed into
+	struct TransientMemoryBackend
+	{
+		virtual ~TransientMemoryBackend() = default;
+
+		virtual uint32_t create_heap(uint64_t size_in_bytes) = 0;
+
+		virtual void release_heap(uint32_t heap_index) = 0;
+	};
+
+	// Backend without any gpu memory, only records heap sizes so packing can be checked anywhere
+	struct FakeTransientMemoryBackend final : TransientMemoryBackend
+	{
+	private:
+		std::vector<uint64_t> heap_sizes = {};
+		uint64_t bytes_alive = 0;
+		uint64_t bytes_peak = 0;
+
+	public:
+		FakeTransientMemoryBackend() = default;
+		~FakeTransientMemoryBackend() override = default;
+
+		uint32_t create_heap(uint64_t size_in_bytes) override;
+
+		void release_heap(uint32_t heap_index) override;
+
+		[[nodiscard]] uint64_t query_bytes_alive() const;
+
+		[[nodiscard]] uint64_t query_bytes_peak() const;
+	};
+
+	// Packs transient resources with disjoint lifetimes into one shared heap
+	// Requests are placed largest first at the best fitting gap among the placements alive at the same time
+	struct TransientResourceAllocator
+	{
+	private:
+		struct PlacedRange
+		{
+			uint64_t begin = 0;
+			uint64_t end = 0;
+		};
+
+		TransientMemoryBackend *memory_backend = nullptr;
+		std::vector<TransientResourceRequest> requests = {};
+		std::vector<TransientResourcePlacement> placements = {};
+		std::vector<uint32_t> placement_order = {};
+		std::vector<PlacedRange> overlapping_ranges = {};
+		TransientAllocatorStats allocator_stats{};
+		uint32_t heap_index = UINT32_MAX;
+		uint64_t heap_size = 0;
+
+	public:
+		explicit TransientResourceAllocator(TransientMemoryBackend *backend);
+		~TransientResourceAllocator();
+
+		TransientResourceAllocator(const TransientResourceAllocator &) = delete;
+		TransientResourceAllocator &operator=(const TransientResourceAllocator &) = delete;
+
+		uint32_t add_request(const TransientResourceRequest &request);
+
+		// Place every request, the heap is recreated only when the packed size grows
+		void allocate();
+
+		// Drop requests, the heap is kept for the next frame
+		void clear();
+
+		[[nodiscard]] const TransientResourcePlacement &query_placement(uint32_t request_id) const;
+
+		[[nodiscard]] const TransientAllocatorStats &get_stats() const;
+
+		void print() const;
+
+	private:
+		uint64_t compute_peak_live_bytes() const;
+	};
+}
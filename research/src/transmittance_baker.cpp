@@ -0,0 +1,442 @@
+//
+// Created by ZZK on 2024/10/28.
+//
+
+#include <transmittance_baker.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TOY_TRANSMITTANCE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TOY_TARGET_AVX2
+#else
+#define TOY_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define TOY_TRANSMITTANCE_SIMD 0
+#endif
+
+namespace toy
+{
+	static constexpr uint32_t s_transmittance_lut_magic = 0x54554c54; // "TLUT"
+	static constexpr uint32_t s_transmittance_lut_version = 1;
+
+	struct TransmittanceLutHeader
+	{
+		uint32_t magic = s_transmittance_lut_magic;
+		uint32_t version = s_transmittance_lut_version;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t step_count = TransmittanceBaker::step_count;
+		uint32_t format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		AtomsphereParams params{};
+	};
+
+	struct AtomsphereParamsVariable
+	{
+		std::string_view variable_name = {};
+		uint32_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	static constexpr std::array<AtomsphereParamsVariable, 11> s_atomsphere_params_variables{ {
+		{ "gScatterRayleigh", offsetof(AtomsphereParams, scatter_rayleigh), sizeof(float) * 3 },
+		{ "gHDensityRayleigh", offsetof(AtomsphereParams, h_density_rayleigh), sizeof(float) },
+		{ "gScatterMie", offsetof(AtomsphereParams, scatter_mie), sizeof(float) },
+		{ "gAsymmetryMie", offsetof(AtomsphereParams, asymmetry_mie), sizeof(float) },
+		{ "gAbsorbMie", offsetof(AtomsphereParams, absorb_mie), sizeof(float) },
+		{ "gHDensityMie", offsetof(AtomsphereParams, h_density_mie), sizeof(float) },
+		{ "gAbsorbOzone", offsetof(AtomsphereParams, absorb_ozone), sizeof(float) * 3 },
+		{ "gOzoneCenterHeight", offsetof(AtomsphereParams, ozone_center_height), sizeof(float) },
+		{ "gOzoneThickness", offsetof(AtomsphereParams, ozone_thickness), sizeof(float) },
+		{ "gPlanetRadius", offsetof(AtomsphereParams, planet_radius), sizeof(float) },
+		{ "gAtomsphereRadius", offsetof(AtomsphereParams, atomsphere_radius), sizeof(float) },
+	} };
+
+	// Ray of one lut texel, set up exactly like the head of the CS
+	struct TransmittanceRay
+	{
+		float origin[2] = { 0.0f, 0.0f };
+		float end[2] = { 0.0f, 0.0f };
+		float t = 0.0f;
+	};
+
+	static float hlsl_lerp(float a, float b, float s)
+	{
+		return a + s * (b - a);
+	}
+
+	static TransmittanceRay setup_transmittance_ray(const AtomsphereParams &params, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	{
+		const float theta = std::asin(hlsl_lerp(-1.0f, 1.0f, (static_cast<float>(y) + 0.5f) / static_cast<float>(height)));
+		const float h = hlsl_lerp(0.0f, params.atomsphere_radius - params.planet_radius, (static_cast<float>(x) + 0.5f) / static_cast<float>(width));
+		const float o[2] = { 0.0f, params.planet_radius + h };
+		const float d[2] = { std::cos(theta), std::sin(theta) };
+		float t = 0.0f;
+		if (!TransmittanceBaker::find_closest_intersection_with_circle(o, d, params.planet_radius, t)) {
+			TransmittanceBaker::find_closest_intersection_with_circle(o, d, params.atomsphere_radius, t);
+		}
+		return { { o[0], o[1] }, { o[0] + t * d[0], o[1] + t * d[1] }, t };
+	}
+
+	bool TransmittanceBaker::find_closest_intersection_with_circle(const float o[2], const float d[2], float radius, float &t)
+	{
+		const float A = d[0] * d[0] + d[1] * d[1];
+		const float B = 2.0f * (o[0] * d[0] + o[1] * d[1]);
+		const float C = o[0] * o[0] + o[1] * o[1] - radius * radius;
+		const float delta = B * B - 4.0f * A * C;
+		if (delta < 0.0f) {
+			t = 0.0f;
+			return false;
+		}
+		const float sqrt_delta = (C <= 0.0f) ? std::sqrt(delta) : -std::sqrt(delta);
+		t = (-B + sqrt_delta) / (2.0f * A);
+		return (C <= 0.0f) || (B <= 0.0f);
+	}
+
+	void TransmittanceBaker::get_sigma_t(const AtomsphereParams &params, float height, float sigma_t[3])
+	{
+		const float rayleigh_density = std::exp(-height / params.h_density_rayleigh);
+		const float mie = (params.scatter_mie + params.absorb_mie) * std::exp(-height / params.h_density_mie);
+		const float ozone_density = (std::max)(0.0f, 1.0f - 0.5f * std::abs(height - params.ozone_center_height) / params.ozone_thickness);
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			sigma_t[channel] = params.scatter_rayleigh[channel] * rayleigh_density + mie + params.absorb_ozone[channel] * ozone_density;
+		}
+	}
+
+	std::array<float, 4> TransmittanceBaker::bake_texel(const AtomsphereParams &params, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	{
+		const TransmittanceRay ray = setup_transmittance_ray(params, x, y, width, height);
+		float sum[3] = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t step = 0; step < step_count; ++step)
+		{
+			const float s = (static_cast<float>(step) + 0.5f) / static_cast<float>(step_count);
+			const float px = hlsl_lerp(ray.origin[0], ray.end[0], s);
+			const float py = hlsl_lerp(ray.origin[1], ray.end[1], s);
+			const float sample_height = std::sqrt(px * px + py * py) - params.planet_radius;
+			float sigma_t[3];
+			get_sigma_t(params, sample_height, sigma_t);
+			sum[0] += sigma_t[0];
+			sum[1] += sigma_t[1];
+			sum[2] += sigma_t[2];
+		}
+
+		const float step_length = ray.t / static_cast<float>(step_count);
+		return { std::exp(-sum[0] * step_length), std::exp(-sum[1] * step_length), std::exp(-sum[2] * step_length), 1.0f };
+	}
+
+	void TransmittanceBaker::bake_row_scalar(const AtomsphereParams &params, uint32_t y, uint32_t width, uint32_t height, std::array<float, 4> *row)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			row[x] = bake_texel(params, x, y, width, height);
+		}
+	}
+
+#if TOY_TRANSMITTANCE_SIMD
+	// Cephes style expf, within 2 ulp of std::exp, inputs below the float range flush to zero like std::exp
+	TOY_TARGET_AVX2 static __m256 exp_avx2(__m256 x)
+	{
+		const __m256 min_input = _mm256_set1_ps(-87.33654f);
+		const __m256 underflow_mask = _mm256_cmp_ps(x, min_input, _CMP_LT_OQ);
+		x = _mm256_min_ps(_mm256_max_ps(x, min_input), _mm256_set1_ps(88.0f));
+
+		const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+		r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+
+		__m256 p = _mm256_set1_ps(1.9875691500e-4f);
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+		p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+		p = _mm256_add_ps(p, _mm256_set1_ps(1.0f));
+
+		const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+		const __m256 result = _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+		return _mm256_andnot_ps(underflow_mask, result);
+	}
+
+	TOY_TARGET_AVX2 static void bake_lanes_avx2(const AtomsphereParams &params, const TransmittanceRay *rays, std::array<float, 4> *texels, uint32_t lane_count)
+	{
+		alignas(32) float origin_x[8], origin_y[8], delta_x[8], delta_y[8], step_length[8];
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			// Tail lanes repeat the last texel and are dropped on store
+			const TransmittanceRay &ray = rays[(std::min)(lane, lane_count - 1)];
+			origin_x[lane] = ray.origin[0];
+			origin_y[lane] = ray.origin[1];
+			delta_x[lane] = ray.end[0] - ray.origin[0];
+			delta_y[lane] = ray.end[1] - ray.origin[1];
+			step_length[lane] = ray.t / static_cast<float>(TransmittanceBaker::step_count);
+		}
+
+		const __m256 ox = _mm256_load_ps(origin_x);
+		const __m256 oy = _mm256_load_ps(origin_y);
+		const __m256 dx = _mm256_load_ps(delta_x);
+		const __m256 dy = _mm256_load_ps(delta_y);
+		const __m256 planet_radius = _mm256_set1_ps(params.planet_radius);
+		const __m256 h_density_rayleigh = _mm256_set1_ps(params.h_density_rayleigh);
+		const __m256 h_density_mie = _mm256_set1_ps(params.h_density_mie);
+		const __m256 extinction_mie = _mm256_set1_ps(params.scatter_mie + params.absorb_mie);
+		const __m256 ozone_center_height = _mm256_set1_ps(params.ozone_center_height);
+		const __m256 ozone_thickness = _mm256_set1_ps(params.ozone_thickness);
+		const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		__m256 scatter_rayleigh[3], absorb_ozone[3], sum[3];
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			scatter_rayleigh[channel] = _mm256_set1_ps(params.scatter_rayleigh[channel]);
+			absorb_ozone[channel] = _mm256_set1_ps(params.absorb_ozone[channel]);
+			sum[channel] = zero;
+		}
+
+		for (uint32_t step = 0; step < TransmittanceBaker::step_count; ++step)
+		{
+			const __m256 s = _mm256_set1_ps((static_cast<float>(step) + 0.5f) / static_cast<float>(TransmittanceBaker::step_count));
+			const __m256 px = _mm256_fmadd_ps(s, dx, ox);
+			const __m256 py = _mm256_fmadd_ps(s, dy, oy);
+			const __m256 sample_height = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_fmadd_ps(px, px, _mm256_mul_ps(py, py))), planet_radius);
+			const __m256 negative_height = _mm256_xor_ps(sample_height, sign_mask);
+
+			const __m256 rayleigh_density = exp_avx2(_mm256_div_ps(negative_height, h_density_rayleigh));
+			const __m256 mie = _mm256_mul_ps(extinction_mie, exp_avx2(_mm256_div_ps(negative_height, h_density_mie)));
+			const __m256 ozone_distance = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(sample_height, ozone_center_height));
+			const __m256 ozone_density = _mm256_max_ps(zero, _mm256_sub_ps(one, _mm256_div_ps(_mm256_mul_ps(half, ozone_distance), ozone_thickness)));
+			for (uint32_t channel = 0; channel < 3; ++channel)
+			{
+				const __m256 sigma_t = _mm256_fmadd_ps(scatter_rayleigh[channel], rayleigh_density, _mm256_fmadd_ps(absorb_ozone[channel], ozone_density, mie));
+				sum[channel] = _mm256_add_ps(sum[channel], sigma_t);
+			}
+		}
+
+		const __m256 lengths = _mm256_load_ps(step_length);
+		alignas(32) float results[3][8];
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			_mm256_store_ps(results[channel], exp_avx2(_mm256_xor_ps(_mm256_mul_ps(sum[channel], lengths), sign_mask)));
+		}
+		for (uint32_t lane = 0; lane < lane_count; ++lane)
+		{
+			texels[lane] = { results[0][lane], results[1][lane], results[2][lane], 1.0f };
+		}
+	}
+#endif
+
+	void TransmittanceBaker::bake_row_simd(const AtomsphereParams &params, uint32_t y, uint32_t width, uint32_t height, std::array<float, 4> *row)
+	{
+#if TOY_TRANSMITTANCE_SIMD
+		TransmittanceRay rays[8];
+		for (uint32_t x = 0; x < width; x += 8)
+		{
+			const uint32_t lane_count = (std::min)(width - x, 8U);
+			for (uint32_t lane = 0; lane < lane_count; ++lane)
+			{
+				rays[lane] = setup_transmittance_ray(params, x + lane, y, width, height);
+			}
+			bake_lanes_avx2(params, rays, row + x, lane_count);
+		}
+#else
+		bake_row_scalar(params, y, width, height, row);
+#endif
+	}
+
+	bool TransmittanceBaker::is_simd_supported()
+	{
+#if TOY_TRANSMITTANCE_SIMD && defined(_MSC_VER)
+		int cpu_info[4]{};
+		__cpuid(cpu_info, 0);
+		if (cpu_info[0] < 7) {
+			return false;
+		}
+		__cpuid(cpu_info, 1);
+		const bool has_fma = (cpu_info[2] & (1 << 12)) != 0;
+		const bool has_os_xsave = (cpu_info[2] & (1 << 27)) != 0;
+		const bool has_avx = (cpu_info[2] & (1 << 28)) != 0;
+		if (!has_fma || !has_os_xsave || !has_avx || (_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+		__cpuidex(cpu_info, 7, 0);
+		return (cpu_info[1] & (1 << 5)) != 0;
+#elif TOY_TRANSMITTANCE_SIMD
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	TransmittanceLut TransmittanceBaker::bake(const AtomsphereParams &params, uint32_t width, uint32_t height, JobSystem &job_system, bool allow_simd)
+	{
+		TransmittanceLut lut{ width, height };
+		lut.texels.resize(static_cast<size_t>(width) * height);
+		const bool use_simd = allow_simd && is_simd_supported();
+		job_system.parallel_for(height, 1, [&](uint32_t y)
+		{
+			auto row = lut.texels.data() + static_cast<size_t>(y) * width;
+			if (use_simd) {
+				bake_row_simd(params, y, width, height, row);
+			} else {
+				bake_row_scalar(params, y, width, height, row);
+			}
+		});
+		return lut;
+	}
+
+	float TransmittanceBaker::query_max_relative_error(const TransmittanceLut &lut, const TransmittanceLut &reference)
+	{
+		if (lut.width != reference.width || lut.height != reference.height) {
+			return INFINITY;
+		}
+		// Values near zero are compared absolutely, relative error there only measures denormal noise
+		float max_relative_error = 0.0f;
+		for (size_t texel_index = 0; texel_index < lut.texels.size(); ++texel_index)
+		{
+			for (uint32_t channel = 0; channel < 4; ++channel)
+			{
+				const float value = lut.texels[texel_index][channel];
+				const float reference_value = reference.texels[texel_index][channel];
+				const float relative_error = std::abs(value - reference_value) / (std::max)(std::abs(reference_value), 1e-6f);
+				max_relative_error = (std::max)(max_relative_error, relative_error);
+			}
+		}
+		return max_relative_error;
+	}
+
+	bool TransmittanceBaker::save(const TransmittanceLut &lut, const AtomsphereParams &params, std::string_view file_path)
+	{
+		std::ofstream lut_file{ std::string(file_path), std::ios::binary | std::ios::trunc };
+		if (!lut_file) {
+			std::cout << std::format("Failed to open transmittance lut {} for writing\n", file_path);
+			return false;
+		}
+		TransmittanceLutHeader header{};
+		header.width = lut.width;
+		header.height = lut.height;
+		header.params = params;
+		lut_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		lut_file.write(reinterpret_cast<const char *>(lut.texels.data()), static_cast<std::streamsize>(lut.texels.size() * sizeof(lut.texels[0])));
+		return static_cast<bool>(lut_file);
+	}
+
+	bool TransmittanceBaker::load(std::string_view file_path, const AtomsphereParams &params, TransmittanceLut &lut)
+	{
+		std::ifstream lut_file{ std::string(file_path), std::ios::binary };
+		if (!lut_file) {
+			return false;
+		}
+		TransmittanceLutHeader header{};
+		lut_file.read(reinterpret_cast<char *>(&header), sizeof(header));
+		if (!lut_file || header.magic != s_transmittance_lut_magic || header.version != s_transmittance_lut_version ||
+			header.step_count != step_count || header.format != DXGI_FORMAT_R32G32B32A32_FLOAT) {
+			std::cout << std::format("Transmittance lut {} has an unknown layout\n", file_path);
+			return false;
+		}
+		if (std::memcmp(&header.params, &params, sizeof(AtomsphereParams)) != 0) {
+			std::cout << std::format("Transmittance lut {} was baked with other atmosphere params\n", file_path);
+			return false;
+		}
+
+		// A file cut short would leave texels unread
+		std::error_code error_code{};
+		const uint64_t texel_bytes = static_cast<uint64_t>(header.width) * header.height * sizeof(lut.texels[0]);
+		const uint64_t file_size = std::filesystem::file_size(std::string(file_path), error_code);
+		if (error_code || header.width == 0 || header.height == 0 || file_size < sizeof(header) + texel_bytes) {
+			std::cout << std::format("Transmittance lut {} is shorter than its {}x{} texels\n", file_path, header.width, header.height);
+			return false;
+		}
+
+		lut.width = header.width;
+		lut.height = header.height;
+		lut.texels.resize(static_cast<size_t>(header.width) * header.height);
+		lut_file.read(reinterpret_cast<char *>(lut.texels.data()), static_cast<std::streamsize>(lut.texels.size() * sizeof(lut.texels[0])));
+		return static_cast<bool>(lut_file);
+	}
+
+	HRESULT TransmittanceBaker::create_texture(ID3D11Device *device, const TransmittanceLut &lut, ID3D11Texture2D **texture, ID3D11ShaderResourceView **srv)
+	{
+		D3D11_TEXTURE2D_DESC texture_desc{};
+		texture_desc.Width = lut.width;
+		texture_desc.Height = lut.height;
+		texture_desc.MipLevels = 1;
+		texture_desc.ArraySize = 1;
+		texture_desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		texture_desc.SampleDesc.Count = 1;
+		texture_desc.Usage = D3D11_USAGE_IMMUTABLE;
+		texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		const D3D11_SUBRESOURCE_DATA texture_data{ lut.texels.data(), static_cast<uint32_t>(lut.width * sizeof(lut.texels[0])), 0 };
+		HRESULT hr = device->CreateTexture2D(&texture_desc, &texture_data, texture);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		return device->CreateShaderResourceView(*texture, nullptr, srv);
+	}
+
+	ComPtr<ID3D11ShaderResourceView> TransmittanceBaker::query_or_dispatch(ID3D11DeviceContext *device_context, ComputeEffect &transmittance_effect, const AtomsphereParams &params,
+																		   std::string_view baked_file_path, uint32_t width, uint32_t height, bool *is_loaded)
+	{
+		ComPtr<ID3D11Device> device = nullptr;
+		device_context->GetDevice(device.GetAddressOf());
+		ComPtr<ID3D11Texture2D> texture = nullptr;
+		ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+		TransmittanceLut lut{};
+		const bool is_baked = !baked_file_path.empty() && load(baked_file_path, params, lut) && lut.width == width && lut.height == height &&
+							  SUCCEEDED(create_texture(device.Get(), lut, texture.GetAddressOf(), srv.GetAddressOf()));
+		if (is_loaded != nullptr) {
+			*is_loaded = is_baked;
+		}
+		if (is_baked) {
+			return srv;
+		}
+
+		D3D11_TEXTURE2D_DESC texture_desc{};
+		texture_desc.Width = width;
+		texture_desc.Height = height;
+		texture_desc.MipLevels = 1;
+		texture_desc.ArraySize = 1;
+		texture_desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		texture_desc.SampleDesc.Count = 1;
+		texture_desc.Usage = D3D11_USAGE_DEFAULT;
+		texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		texture = nullptr;
+		srv = nullptr;
+		ComPtr<ID3D11UnorderedAccessView> uav = nullptr;
+		if (FAILED(device->CreateTexture2D(&texture_desc, nullptr, texture.GetAddressOf())) ||
+			FAILED(device->CreateShaderResourceView(texture.Get(), nullptr, srv.GetAddressOf())) ||
+			FAILED(device->CreateUnorderedAccessView(texture.Get(), nullptr, uav.GetAddressOf()))) {
+			std::cout << std::format("Failed to create transmittance lut texture\n");
+			return nullptr;
+		}
+
+		set_params(transmittance_effect, params);
+		transmittance_effect.bind_unordered_access_view("gTransmittanceMap", uav.Get());
+		transmittance_effect.emit_compute_pipeline(device_context);
+		transmittance_effect.dispatch(device_context, width, height, 1);
+
+		// Unbind so the lut can be sampled right away
+		transmittance_effect.bind_unordered_access_view("gTransmittanceMap", nullptr);
+		auto &&binding_state = ResourceBindingState::query(device_context);
+		binding_state.unbind_unordered_access_views(device_context, ShaderType::ComputeShader, binding_state.query_unordered_access_mask(ShaderType::ComputeShader, texture.Get()));
+		return srv;
+	}
+
+	void TransmittanceBaker::set_params(ComputeEffect &transmittance_effect, const AtomsphereParams &params)
+	{
+		for (auto &&params_variable : s_atomsphere_params_variables)
+		{
+			if (auto accessor = transmittance_effect.query_constant_buffer_accessor(params_variable.variable_name); accessor != nullptr) {
+				accessor->set_raw(reinterpret_cast<const uint8_t *>(&params) + params_variable.offset, 0, params_variable.size);
+			}
+		}
+	}
+}
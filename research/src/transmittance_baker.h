@@ -0,0 +1,83 @@
+//
+// Created by ZZK on 2024/10/28.
+//
+
+#pragma once
+
+#include <effect.h>
+#include <job_system.h>
+
+namespace toy
+{
+	// Mirror of cbuffer CBAtomsphereParams in medium.hlsl, same order and packing
+	struct AtomsphereParams
+	{
+		float scatter_rayleigh[3] = { 0.0f, 0.0f, 0.0f };
+		float h_density_rayleigh = 1.0f;
+
+		float scatter_mie = 0.0f;
+		float asymmetry_mie = 0.0f;
+		float absorb_mie = 0.0f;
+		float h_density_mie = 1.0f;
+
+		float absorb_ozone[3] = { 0.0f, 0.0f, 0.0f };
+		float ozone_center_height = 0.0f;
+
+		float ozone_thickness = 1.0f;
+		float planet_radius = 0.0f;
+		float atomsphere_radius = 0.0f;
+		float padding = 0.0f;
+	};
+
+	static_assert(sizeof(AtomsphereParams) == 64, "AtomsphereParams must match the CBAtomsphereParams layout");
+
+	struct TransmittanceLut
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<std::array<float, 4>> texels = {};
+	};
+
+	// Offline baker of the transmittance lut written by transmittance.hlsl
+	// Rows run in parallel, texels of a row are marched 8 at a time in SoA with an avx2 exp when the cpu supports it
+	struct TransmittanceBaker
+	{
+	public:
+		static constexpr uint32_t step_count = 1000;
+
+		static TransmittanceLut bake(const AtomsphereParams &params, uint32_t width, uint32_t height, JobSystem &job_system, bool allow_simd = true);
+
+		// Scalar mirror of one CS thread, the reference the simd path is checked against
+		static std::array<float, 4> bake_texel(const AtomsphereParams &params, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+		static bool is_simd_supported();
+
+		// Largest relative difference over all channels, used to check a bake against the reference
+		static float query_max_relative_error(const TransmittanceLut &lut, const TransmittanceLut &reference);
+
+		// The file carries the params it was baked with, loading fails when they differ so the caller falls back to the dispatch
+		static bool save(const TransmittanceLut &lut, const AtomsphereParams &params, std::string_view file_path);
+
+		static bool load(std::string_view file_path, const AtomsphereParams &params, TransmittanceLut &lut);
+
+		static HRESULT create_texture(ID3D11Device *device, const TransmittanceLut &lut, ID3D11Texture2D **texture, ID3D11ShaderResourceView **srv);
+
+		// Runtime setup of the lut, the baked file when it matches params and size, a dispatch of transmittance.hlsl otherwise
+		// is_loaded tells which one happened
+		static ComPtr<ID3D11ShaderResourceView> query_or_dispatch(ID3D11DeviceContext *device_context, ComputeEffect &transmittance_effect, const AtomsphereParams &params,
+																  std::string_view baked_file_path, uint32_t width, uint32_t height, bool *is_loaded = nullptr);
+
+		// Params go into the effect's CBAtomsphereParams variable by variable
+		static void set_params(ComputeEffect &transmittance_effect, const AtomsphereParams &params);
+
+		// Mirrors of the hlsl helpers
+		static bool find_closest_intersection_with_circle(const float o[2], const float d[2], float radius, float &t);
+
+		static void get_sigma_t(const AtomsphereParams &params, float height, float sigma_t[3]);
+
+	private:
+		static void bake_row_scalar(const AtomsphereParams &params, uint32_t y, uint32_t width, uint32_t height, std::array<float, 4> *row);
+
+		static void bake_row_simd(const AtomsphereParams &params, uint32_t y, uint32_t width, uint32_t height, std::array<float, 4> *row);
+	};
+}
@@ -0,0 +1,366 @@
+//
+// Created by ZZK on 2024/10/30.
+//
+
+#include <vertex_packer.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TOY_VERTEX_PACKER_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TOY_TARGET_F16C
+#else
+#define TOY_TARGET_F16C __attribute__((target("f16c")))
+#endif
+#else
+#define TOY_VERTEX_PACKER_SIMD 0
+#endif
+
+namespace toy
+{
+	// Octahedral inputs are divided by at least this, so a zero vector encodes to +z instead of nan
+	static constexpr float s_min_octahedral_length = 1e-20f;
+
+	static uint32_t query_source_stride(const VertexSourceAttribute &source_attribute)
+	{
+		return source_attribute.stride_in_bytes != 0 ? source_attribute.stride_in_bytes : source_attribute.component_count * 4;
+	}
+
+	// Up to four components of one vertex, missing ones read as (0, 0, 0, 1)
+	static void load_source_vertex(const VertexSourceAttribute &source_attribute, uint32_t vertex_index, float value[4])
+	{
+		value[0] = 0.0f;
+		value[1] = 0.0f;
+		value[2] = 0.0f;
+		value[3] = 1.0f;
+		auto source = static_cast<const uint8_t *>(source_attribute.data) + static_cast<size_t>(vertex_index) * query_source_stride(source_attribute);
+		std::memcpy(value, source, (std::min)(source_attribute.component_count, 4u) * 4);
+	}
+
+	// Same operand order as maxps and minps, so nan clamps to the lower bound on both paths
+	static float clamp_like_sse(float value, float lower, float upper)
+	{
+		value = value > lower ? value : lower;
+		return value < upper ? value : upper;
+	}
+
+	static int32_t round_to_int(float value)
+	{
+		return static_cast<int32_t>(std::lrint(value));
+	}
+
+#if TOY_VERTEX_PACKER_SIMD
+	TOY_TARGET_F16C static void pack_attribute_sse(const VertexAttribute &vertex_attribute, const VertexSourceAttribute &source_attribute, uint32_t vertex_count,
+												   uint32_t stream_stride, uint8_t *stream)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 neg_one = _mm_set1_ps(-1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		auto destination = stream + vertex_attribute.aligned_byte_offset;
+		float value[4]{};
+
+		switch (vertex_attribute.encoding)
+		{
+			case VertexAttributeEncoding::Float16:
+			{
+				for (uint32_t vertex_index = 0; vertex_index < vertex_count; ++vertex_index)
+				{
+					load_source_vertex(source_attribute, vertex_index, value);
+					const __m128i encoded = _mm_cvtps_ph(_mm_loadu_ps(value), _MM_FROUND_TO_NEAREST_INT);
+					alignas(16) uint8_t bytes[16]{};
+					_mm_store_si128(reinterpret_cast<__m128i *>(bytes), encoded);
+					std::memcpy(destination + static_cast<size_t>(vertex_index) * stream_stride, bytes, vertex_attribute.size_in_bytes);
+				}
+				break;
+			}
+			case VertexAttributeEncoding::Snorm8:
+			{
+				const __m128 scale = _mm_set1_ps(127.0f);
+				for (uint32_t vertex_index = 0; vertex_index < vertex_count; ++vertex_index)
+				{
+					load_source_vertex(source_attribute, vertex_index, value);
+					const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(value), neg_one), one);
+					const __m128i quantized = _mm_cvtps_epi32(_mm_mul_ps(clamped, scale));
+					const __m128i packed = _mm_packs_epi16(_mm_packs_epi32(quantized, quantized), _mm_setzero_si128());
+					const int32_t encoded = _mm_cvtsi128_si32(packed);
+					std::memcpy(destination + static_cast<size_t>(vertex_index) * stream_stride, &encoded, 4);
+				}
+				break;
+			}
+			case VertexAttributeEncoding::BiasedUnorm10:
+			{
+				const __m128 scale = _mm_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f);
+				for (uint32_t vertex_index = 0; vertex_index < vertex_count; ++vertex_index)
+				{
+					load_source_vertex(source_attribute, vertex_index, value);
+					const __m128 biased = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(value), half), half);
+					const __m128 clamped = _mm_min_ps(_mm_max_ps(biased, zero), one);
+					alignas(16) int32_t quantized[4]{};
+					_mm_store_si128(reinterpret_cast<__m128i *>(quantized), _mm_cvtps_epi32(_mm_mul_ps(clamped, scale)));
+					const uint32_t encoded = static_cast<uint32_t>(quantized[0]) | (static_cast<uint32_t>(quantized[1]) << 10) |
+											 (static_cast<uint32_t>(quantized[2]) << 20) | (static_cast<uint32_t>(quantized[3]) << 30);
+					std::memcpy(destination + static_cast<size_t>(vertex_index) * stream_stride, &encoded, 4);
+				}
+				break;
+			}
+			case VertexAttributeEncoding::Octahedral16:
+			{
+				const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+				const __m128 sign_mask = _mm_set1_ps(-0.0f);
+				const __m128 min_length = _mm_set1_ps(s_min_octahedral_length);
+				const __m128 scale = _mm_set1_ps(32767.0f);
+				const uint32_t lane_vertex_count = vertex_count / 4 * 4;
+				for (uint32_t vertex_index = 0; vertex_index < lane_vertex_count; vertex_index += 4)
+				{
+					// Four vertices transposed into SoA
+					alignas(16) float lanes[4][4]{};
+					for (uint32_t lane = 0; lane < 4; ++lane)
+					{
+						load_source_vertex(source_attribute, vertex_index + lane, lanes[lane]);
+					}
+					__m128 x = _mm_load_ps(lanes[0]);
+					__m128 y = _mm_load_ps(lanes[1]);
+					__m128 z = _mm_load_ps(lanes[2]);
+					__m128 w = _mm_load_ps(lanes[3]);
+					_MM_TRANSPOSE4_PS(x, y, z, w);
+
+					const __m128 length = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_and_ps(x, abs_mask), _mm_and_ps(y, abs_mask)), _mm_and_ps(z, abs_mask)), min_length);
+					const __m128 px = _mm_div_ps(x, length);
+					const __m128 py = _mm_div_ps(y, length);
+					// Lower hemisphere folds over the diagonals
+					const __m128 fx = _mm_or_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(one, _mm_and_ps(py, abs_mask))), _mm_and_ps(sign_mask, px));
+					const __m128 fy = _mm_or_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(one, _mm_and_ps(px, abs_mask))), _mm_and_ps(sign_mask, py));
+					const __m128 lower = _mm_cmplt_ps(z, zero);
+					const __m128 ox = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, px));
+					const __m128 oy = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, py));
+
+					const __m128i ix = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(ox, neg_one), one), scale));
+					const __m128i iy = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(oy, neg_one), one), scale));
+					alignas(16) int16_t encoded[8]{};
+					_mm_store_si128(reinterpret_cast<__m128i *>(encoded), _mm_packs_epi32(_mm_unpacklo_epi32(ix, iy), _mm_unpackhi_epi32(ix, iy)));
+					for (uint32_t lane = 0; lane < 4; ++lane)
+					{
+						std::memcpy(destination + static_cast<size_t>(vertex_index + lane) * stream_stride, encoded + lane * 2, 4);
+					}
+				}
+				for (uint32_t vertex_index = lane_vertex_count; vertex_index < vertex_count; ++vertex_index)
+				{
+					load_source_vertex(source_attribute, vertex_index, value);
+					int16_t encoded[2]{};
+					VertexPacker::encode_octahedral(value, encoded);
+					std::memcpy(destination + static_cast<size_t>(vertex_index) * stream_stride, encoded, 4);
+				}
+				break;
+			}
+			default:
+			{
+				for (uint32_t vertex_index = 0; vertex_index < vertex_count; ++vertex_index)
+				{
+					load_source_vertex(source_attribute, vertex_index, value);
+					std::memcpy(destination + static_cast<size_t>(vertex_index) * stream_stride, value, (std::min)(vertex_attribute.size_in_bytes, 16u));
+				}
+				break;
+			}
+		}
+	}
+#endif
+
+	// Vertex packer
+	bool VertexPacker::pack(const VertexFormat &vertex_format, std::span<const VertexSourceAttribute> source_attributes, uint32_t vertex_count,
+							std::vector<std::vector<uint8_t>> &streams, bool allow_simd, D3D11_INPUT_CLASSIFICATION input_slot_class)
+	{
+		streams.resize(vertex_format.get_stream_count());
+		for (uint32_t stream_index = 0; stream_index < vertex_format.get_stream_count(); ++stream_index)
+		{
+			if (vertex_format.stream_classes[stream_index] == input_slot_class) {
+				streams[stream_index].assign(static_cast<size_t>(vertex_format.stream_strides[stream_index]) * vertex_count, 0);
+			}
+		}
+
+		const bool use_simd = allow_simd && is_simd_supported();
+		for (auto &&vertex_attribute : vertex_format.attributes)
+		{
+			if (vertex_attribute.input_slot_class != input_slot_class) {
+				continue;
+			}
+			auto source_iter = std::ranges::find_if(source_attributes, [&](const VertexSourceAttribute &source_attribute)
+			{
+				return source_attribute.semantic_name == vertex_attribute.semantic_name && source_attribute.semantic_index == vertex_attribute.semantic_index;
+			});
+			if (source_iter == source_attributes.end() || source_iter->data == nullptr || source_iter->component_count == 0) {
+				std::cout << std::format("Vertex attribute {}{} has no source data\n", vertex_attribute.semantic_name, vertex_attribute.semantic_index);
+				return false;
+			}
+
+			const uint32_t stream_stride = vertex_format.stream_strides[vertex_attribute.input_slot];
+			auto stream = streams[vertex_attribute.input_slot].data();
+			if (use_simd) {
+				pack_attribute_simd(vertex_attribute, *source_iter, vertex_count, stream_stride, stream);
+			} else {
+				pack_attribute_scalar(vertex_attribute, *source_iter, vertex_count, stream_stride, stream);
+			}
+		}
+		return true;
+	}
+
+	bool VertexPacker::is_simd_supported()
+	{
+#if TOY_VERTEX_PACKER_SIMD && defined(_MSC_VER)
+		int cpu_info[4]{};
+		__cpuid(cpu_info, 1);
+		return (cpu_info[2] & (1 << 29)) != 0;
+#elif TOY_VERTEX_PACKER_SIMD
+		return __builtin_cpu_supports("f16c");
+#else
+		return false;
+#endif
+	}
+
+	uint16_t VertexPacker::encode_float16(float value)
+	{
+		// Round to nearest even like vcvtps2ph, every nan encodes to the same quiet nan
+		const uint32_t bits = std::bit_cast<uint32_t>(value);
+		const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		uint32_t abs_bits = bits & 0x7fffffff;
+		if (abs_bits >= 0x7f800000) {
+			return sign | (abs_bits > 0x7f800000 ? 0x7e00 : 0x7c00);
+		}
+		if (abs_bits >= 0x477ff000) {
+			return sign | 0x7c00;
+		}
+		if (abs_bits < 0x38800000) {
+			// Adding 0.5 leaves the float ulp at 2^-24, the half denormal step, so the fpu does the rounding
+			const float denormal = std::bit_cast<float>(abs_bits) + 0.5f;
+			return sign | static_cast<uint16_t>(std::bit_cast<uint32_t>(denormal) - 0x3f000000);
+		}
+		const uint32_t mantissa_odd = (abs_bits >> 13) & 1;
+		abs_bits -= 112u << 23;
+		abs_bits += 0xfff + mantissa_odd;
+		return sign | static_cast<uint16_t>(abs_bits >> 13);
+	}
+
+	int8_t VertexPacker::encode_snorm8(float value)
+	{
+		return static_cast<int8_t>(round_to_int(clamp_like_sse(value, -1.0f, 1.0f) * 127.0f));
+	}
+
+	uint32_t VertexPacker::encode_biased_unorm10(const float value[4])
+	{
+		static constexpr float scales[4] = { 1023.0f, 1023.0f, 1023.0f, 3.0f };
+		static constexpr uint32_t shifts[4] = { 0, 10, 20, 30 };
+		uint32_t encoded = 0;
+		for (uint32_t component = 0; component < 4; ++component)
+		{
+			const float biased = clamp_like_sse(value[component] * 0.5f + 0.5f, 0.0f, 1.0f);
+			encoded |= static_cast<uint32_t>(round_to_int(biased * scales[component])) << shifts[component];
+		}
+		return encoded;
+	}
+
+	void VertexPacker::encode_octahedral(const float value[3], int16_t encoded[2])
+	{
+		const float length = (std::max)(std::abs(value[0]) + std::abs(value[1]) + std::abs(value[2]), s_min_octahedral_length);
+		float x = value[0] / length;
+		float y = value[1] / length;
+		if (value[2] < 0.0f) {
+			const float folded_x = std::copysign(1.0f - std::abs(y), x);
+			const float folded_y = std::copysign(1.0f - std::abs(x), y);
+			x = folded_x;
+			y = folded_y;
+		}
+		encoded[0] = static_cast<int16_t>(round_to_int(clamp_like_sse(x, -1.0f, 1.0f) * 32767.0f));
+		encoded[1] = static_cast<int16_t>(round_to_int(clamp_like_sse(y, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	float VertexPacker::decode_float16(uint16_t value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1f;
+		const uint32_t mantissa = value & 0x3ff;
+		if (exponent == 0) {
+			const float denormal = static_cast<float>(mantissa) * 0x1p-24f;
+			return sign != 0 ? -denormal : denormal;
+		}
+		if (exponent == 0x1f) {
+			return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+		}
+		return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+
+	void VertexPacker::decode_octahedral(const int16_t encoded[2], float value[3])
+	{
+		// snorm decode clamps -32768 to -1 like the input assembler
+		const float x = (std::max)(static_cast<float>(encoded[0]) / 32767.0f, -1.0f);
+		const float y = (std::max)(static_cast<float>(encoded[1]) / 32767.0f, -1.0f);
+		float n[3] = { x, y, 1.0f - std::abs(x) - std::abs(y) };
+		if (n[2] < 0.0f) {
+			n[0] = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			n[1] = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		}
+		const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		value[0] = n[0] / length;
+		value[1] = n[1] / length;
+		value[2] = n[2] / length;
+	}
+
+	void VertexPacker::pack_attribute_scalar(const VertexAttribute &vertex_attribute, const VertexSourceAttribute &source_attribute, uint32_t vertex_count,
+											 uint32_t stream_stride, uint8_t *stream)
+	{
+		auto destination = stream + vertex_attribute.aligned_byte_offset;
+		float value[4]{};
+		for (uint32_t vertex_index = 0; vertex_index < vertex_count; ++vertex_index)
+		{
+			load_source_vertex(source_attribute, vertex_index, value);
+			auto vertex_destination = destination + static_cast<size_t>(vertex_index) * stream_stride;
+			switch (vertex_attribute.encoding)
+			{
+				case VertexAttributeEncoding::Float16:
+				{
+					const uint16_t encoded[4] = { encode_float16(value[0]), encode_float16(value[1]), encode_float16(value[2]), encode_float16(value[3]) };
+					std::memcpy(vertex_destination, encoded, vertex_attribute.size_in_bytes);
+					break;
+				}
+				case VertexAttributeEncoding::Snorm8:
+				{
+					const int8_t encoded[4] = { encode_snorm8(value[0]), encode_snorm8(value[1]), encode_snorm8(value[2]), encode_snorm8(value[3]) };
+					std::memcpy(vertex_destination, encoded, 4);
+					break;
+				}
+				case VertexAttributeEncoding::BiasedUnorm10:
+				{
+					const uint32_t encoded = encode_biased_unorm10(value);
+					std::memcpy(vertex_destination, &encoded, 4);
+					break;
+				}
+				case VertexAttributeEncoding::Octahedral16:
+				{
+					int16_t encoded[2]{};
+					encode_octahedral(value, encoded);
+					std::memcpy(vertex_destination, encoded, 4);
+					break;
+				}
+				default:
+				{
+					std::memcpy(vertex_destination, value, (std::min)(vertex_attribute.size_in_bytes, 16u));
+					break;
+				}
+			}
+		}
+	}
+
+	void VertexPacker::pack_attribute_simd(const VertexAttribute &vertex_attribute, const VertexSourceAttribute &source_attribute, uint32_t vertex_count,
+										   uint32_t stream_stride, uint8_t *stream)
+	{
+#if TOY_VERTEX_PACKER_SIMD
+		pack_attribute_sse(vertex_attribute, source_attribute, vertex_count, stream_stride, stream);
+#else
+		pack_attribute_scalar(vertex_attribute, source_attribute, vertex_count, stream_stride, stream);
+#endif
+	}
+}
@@ -0,0 +1,55 @@
+//
+// Created by ZZK on 2024/10/30.
+//
+
+#pragma once
+
+#include <effect.h>
+
+namespace toy
+{
+	// One attribute of a source mesh, component_count 32-bit values per vertex, zero stride means tightly packed
+	// Float data for compressed attributes, integer attributes are copied as they are
+	struct VertexSourceAttribute
+	{
+		std::string_view semantic_name = {};
+		uint32_t semantic_index = 0;
+		const void *data = nullptr;
+		uint32_t component_count = 0;
+		uint32_t stride_in_bytes = 0;
+	};
+
+	// Converts float source meshes into the streams of a VertexFormat, missing components read as (0, 0, 0, 1) like the input assembler
+	// Vertices are encoded one vector at a time with sse2 and f16c, octahedral vectors four at a time in SoA
+	struct VertexPacker
+	{
+	public:
+		// One byte vector per stream of the format, false when an attribute of the format has no source
+		// Only streams of the given class are filled, per instance streams are packed by a second call with the instance count
+		static bool pack(const VertexFormat &vertex_format, std::span<const VertexSourceAttribute> source_attributes, uint32_t vertex_count,
+						 std::vector<std::vector<uint8_t>> &streams, bool allow_simd = true, D3D11_INPUT_CLASSIFICATION input_slot_class = D3D11_INPUT_PER_VERTEX_DATA);
+
+		static bool is_simd_supported();
+
+		// Scalar encoders, the reference the simd path matches bit for bit
+		static uint16_t encode_float16(float value);
+
+		static int8_t encode_snorm8(float value);
+
+		static uint32_t encode_biased_unorm10(const float value[4]);
+
+		static void encode_octahedral(const float value[3], int16_t encoded[2]);
+
+		// Decoders mirroring vertex_compression.hlsl, used to measure the encoding error
+		static float decode_float16(uint16_t value);
+
+		static void decode_octahedral(const int16_t encoded[2], float value[3]);
+
+	private:
+		static void pack_attribute_scalar(const VertexAttribute &vertex_attribute, const VertexSourceAttribute &source_attribute, uint32_t vertex_count,
+										  uint32_t stream_stride, uint8_t *stream);
+
+		static void pack_attribute_simd(const VertexAttribute &vertex_attribute, const VertexSourceAttribute &source_attribute, uint32_t vertex_count,
+										uint32_t stream_stride, uint8_t *stream);
+	};
+}
@@ -0,0 +1,70 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <compile_arena.h>
+
+// Compile arena traffic shaped like dxc, blocks freed out of stack order and one block per compile kept into the next
+
+namespace toy
+{
+	static constexpr size_t s_chunk_size = size_t{ 4 } << 20;
+	static constexpr uint32_t s_blocks_per_compile = 2000;
+	static constexpr size_t s_block_size = 4096;
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	auto compile_arena = Microsoft::WRL::Make<CompileArena>(s_chunk_size);
+	// The compiler object outlives every compile
+	void *compiler_block = compile_arena->Alloc(256);
+
+	// Blocks are freed oldest first so none of them is the top block, the last one survives until the next compile
+	void *surviving_block = nullptr;
+	CompileArenaStats total_stats{};
+	constexpr uint32_t compile_count = 200;
+	for (uint32_t compile_index = 0; compile_index < compile_count; ++compile_index)
+	{
+		compile_arena->begin_compile();
+		compile_arena->Free(surviving_block);
+		std::vector<void *> blocks(s_blocks_per_compile);
+		for (auto &&block : blocks)
+		{
+			block = compile_arena->Alloc(s_block_size);
+		}
+		for (uint32_t block_index = 0; block_index + 1 < s_blocks_per_compile; ++block_index)
+		{
+			compile_arena->Free(blocks[block_index]);
+		}
+		surviving_block = blocks.back();
+		const auto compile_stats = compile_arena->end_compile();
+		total_stats.rewinds += compile_stats.rewinds;
+		total_stats.retained_compiles += compile_stats.retained_compiles;
+		total_stats.heap_bytes += compile_stats.heap_bytes;
+	}
+	test_report.check(total_stats.retained_compiles == compile_count && total_stats.rewinds == 0, "Every compile with a surviving block is reported as retained");
+	test_report.check(total_stats.heap_bytes == 0, "Surviving blocks never push the arena to the heap");
+	test_report.check(compile_arena->query_reserved_bytes() <= 4 * s_chunk_size,
+					  std::format("Arena holds {} bytes after {} compiles, a surviving block only pins its own chunk", compile_arena->query_reserved_bytes(), compile_count));
+
+	// Once the survivor goes the compile rewinds and the chunks it pinned are reused
+	const size_t reserved_bytes = compile_arena->query_reserved_bytes();
+	compile_arena->begin_compile();
+	compile_arena->Free(surviving_block);
+	for (uint32_t block_index = 0; block_index < s_blocks_per_compile; ++block_index)
+	{
+		compile_arena->Free(compile_arena->Alloc(s_block_size));
+	}
+	const auto last_stats = compile_arena->end_compile();
+	test_report.check(last_stats.rewinds == 1 && last_stats.retained_compiles == 0, "Compile freeing everything rewinds");
+	test_report.check(compile_arena->query_reserved_bytes() == reserved_bytes, "Rewound compile reserves no new chunk");
+	test_report.check(compile_arena->DidAlloc(compiler_block) == 1, "Compiler block stays in the arena");
+	compile_arena->Free(compiler_block);
+	compile_arena->HeapMinimize();
+	test_report.check(compile_arena->query_reserved_bytes() <= s_chunk_size, "Empty chunks are dropped");
+	return test_report.finish();
+}
@@ -0,0 +1,111 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <compile_server.h>
+#include <chrono>
+#include <thread>
+
+// Client and server in one process over a temp socket, round trip, deduplication, relative includes and a server that never answers
+
+namespace toy
+{
+	static constexpr std::string_view s_compute_source = R"(
+RWStructuredBuffer<uint> g_Output : register(u0);
+
+[numthreads(64, 1, 1)]
+void CS(uint3 dispatch_thread_id : SV_DispatchThreadID)
+{
+	g_Output[dispatch_thread_id.x] = dispatch_thread_id.x;
+}
+)";
+
+	static constexpr std::array<const wchar_t *, 4> s_compile_arguments{ L"-E", L"CS", L"-T", L"cs_6_0" };
+
+	static CompileServerStatus compile_on_server(std::string_view socket_path, uint32_t timeout_ms, std::string_view source, std::span<const wchar_t *const> compilation_arguments,
+												 ShaderBytecodeEntry &shader_bytecode_entry)
+	{
+		const DxcBuffer source_buffer{
+			.Ptr = source.data(),
+			.Size = source.size(),
+			.Encoding = DXC_CP_UTF8,
+		};
+		std::string error_log{};
+		return CompileClient::compile(socket_path, timeout_ms, source_buffer, compilation_arguments, shader_bytecode_entry, error_log);
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	const auto shader_directory = test::write_shader_file("compile_server_common.hlsli", "#define COMPILE_SERVER_THREADS 64\n").parent_path();
+	const auto socket_path = (shader_directory / std::format("compile_server_{:08x}.sock", std::random_device{}())).string();
+
+	CompileServer compile_server{ { socket_path, 2, "", "" } };
+	if (!test_report.check(compile_server.start(), "Server listens on the temp socket")) {
+		return test_report.finish();
+	}
+	std::thread server_thread{ [&compile_server]() { compile_server.run(); } };
+
+	ShaderBytecodeEntry shader_bytecode_entry{};
+	test_report.check(compile_on_server(socket_path, 5000, s_compute_source, s_compile_arguments, shader_bytecode_entry) == CompileServerStatus::Compiled &&
+					  !shader_bytecode_entry.bytecode.empty() && !shader_bytecode_entry.reflection.empty(), "Round trip returns bytecode and reflection");
+
+	// The same request from many clients at once compiles once
+	const std::string shared_source = std::string(s_compute_source) + "// shared\n";
+	constexpr uint32_t client_count = 8;
+	std::atomic<uint32_t> compiled_count{ 0 };
+	std::vector<std::thread> client_threads{};
+	for (uint32_t client_index = 0; client_index < client_count; ++client_index)
+	{
+		client_threads.emplace_back([&]()
+		{
+			ShaderBytecodeEntry client_entry{};
+			if (compile_on_server(socket_path, 5000, shared_source, s_compile_arguments, client_entry) == CompileServerStatus::Compiled) {
+				compiled_count.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+	}
+	for (auto &&client_thread : client_threads)
+	{
+		client_thread.join();
+	}
+	const auto server_stats = compile_server.get_stats();
+	test_report.check(compiled_count == client_count, "Every concurrent client gets the bytecode");
+	test_report.check(server_stats.compiles == 2 && server_stats.deduplicated + server_stats.cache_hits == client_count - 1, "Concurrent identical requests compile once");
+
+	// Include directories relative to the client's working directory
+	std::error_code error_code{};
+	const auto working_directory = std::filesystem::current_path(error_code);
+	std::filesystem::current_path(shader_directory.parent_path(), error_code);
+	const std::wstring relative_directory = shader_directory.filename().wstring();
+	const std::array<const wchar_t *, 6> include_arguments{ L"-E", L"CS", L"-T", L"cs_6_0", L"-I", relative_directory.c_str() };
+	const std::string include_source = std::string("#include \"compile_server_common.hlsli\"\n") + std::string(s_compute_source);
+	ShaderBytecodeEntry include_entry{};
+	test_report.check(compile_on_server(socket_path, 5000, include_source, include_arguments, include_entry) == CompileServerStatus::Compiled, "Relative include directory resolves");
+	std::filesystem::current_path(working_directory, error_code);
+
+	// A server that accepts nothing is given up on once the timeout passes, the compile then runs in process
+	CompileServer wedged_server{ { socket_path + ".wedged", 1, "", "" } };
+	test_report.check(wedged_server.start(), "Wedged server listens without accepting");
+	const auto wait_begin = std::chrono::steady_clock::now();
+	ShaderBytecodeEntry wedged_entry{};
+	test_report.check(compile_on_server(socket_path + ".wedged", 200, s_compute_source, s_compile_arguments, wedged_entry) == CompileServerStatus::Unavailable,
+					  "Silent server is reported unavailable");
+	test_report.check(std::chrono::steady_clock::now() - wait_begin < std::chrono::seconds(5), "Client gives up after its timeout");
+
+	DxcInStance::get().set_compile_server(socket_path + ".wedged", 200);
+	const auto fallback_result = DxcInStance::get().create_shader_from_source(std::string(s_compute_source) + "// fallback\n", ShaderType::ComputeShader,
+																			   ShaderTargetProfile::ShaderModel_6_0);
+	test_report.check(fallback_result.shader_blob != nullptr, "Compile falls back to the in process compiler");
+	DxcInStance::get().set_compile_server("");
+
+	compile_server.stop();
+	server_thread.join();
+	compile_server.print();
+	return test_report.finish();
+}
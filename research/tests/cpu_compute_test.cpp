@@ -0,0 +1,164 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <cpu_compute.h>
+#include <null_device.h>
+
+// Cpu compute kernels on null device resources, on plain cpu memory, and on a resource no null device created
+
+namespace toy
+{
+	static constexpr uint32_t s_element_count = 256;
+
+	static constexpr std::string_view s_scale_source = R"(
+cbuffer CBScale : register(b0)
+{
+	float g_Scale;
+	float3 g_ScalePadding;
+}
+
+StructuredBuffer<float> g_Input : register(t0);
+RWStructuredBuffer<float> g_Output : register(u0);
+
+[numthreads(64, 1, 1)]
+void CS(uint3 dispatch_thread_id : SV_DispatchThreadID)
+{
+	g_Output[dispatch_thread_id.x] = g_Input[dispatch_thread_id.x] * g_Scale;
+}
+)";
+
+	// Reports a buffer dimension without being a NullBuffer, as a resource of a real device would
+	struct ForeignBuffer final : NullDeviceChild<ID3D11Buffer, NullObjectType::Buffer>
+	{
+		using NullDeviceChild::NullDeviceChild;
+
+		void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION *dimension) override
+		{
+			*dimension = D3D11_RESOURCE_DIMENSION_BUFFER;
+		}
+
+		void STDMETHODCALLTYPE SetEvictionPriority(UINT) override
+		{
+
+		}
+
+		UINT STDMETHODCALLTYPE GetEvictionPriority() override
+		{
+			return DXGI_RESOURCE_PRIORITY_NORMAL;
+		}
+
+		void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC *desc) override
+		{
+			*desc = {};
+		}
+	};
+
+	static ComPtr<ID3D11Buffer> create_structured_buffer(ID3D11Device *device, const float *initial_data)
+	{
+		D3D11_BUFFER_DESC buffer_desc{};
+		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+		buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		buffer_desc.ByteWidth = s_element_count * sizeof(float);
+		buffer_desc.StructureByteStride = sizeof(float);
+		const D3D11_SUBRESOURCE_DATA subresource_data{ initial_data, 0, 0 };
+		ComPtr<ID3D11Buffer> buffer = nullptr;
+		device->CreateBuffer(&buffer_desc, initial_data != nullptr ? &subresource_data : nullptr, buffer.GetAddressOf());
+		return buffer;
+	}
+
+	static bool is_scaled(std::span<const float> input, std::span<const float> output, float scale)
+	{
+		if (output.size() < input.size()) {
+			return false;
+		}
+		for (size_t index = 0; index < input.size(); ++index)
+		{
+			if (output[index] != input[index] * scale) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	auto null_device = NullDevice::create();
+
+	const auto cs_path = test::write_shader_file("cpu_compute_scale_cs.hlsl", s_scale_source).wstring();
+	ComputePipelineStateObject pipeline_state_object{};
+	pipeline_state_object.cs_path = cs_path;
+	ComputeEffect scale_effect{ pipeline_state_object, null_device.Get() };
+	constexpr float scale = 3.0f;
+	scale_effect.query_constant_buffer_accessor("g_Scale")->set_float(scale);
+
+	JobSystem job_system{ 2 };
+	CpuComputeExecutor cpu_compute_executor{ job_system };
+	std::atomic<uint32_t> unresolved_group_count{ 0 };
+	const bool is_registered = cpu_compute_executor.register_kernel(scale_effect, ThreadGroupConf{ 64, 1, 1 }, [&](const CpuComputeGroup &compute_group)
+	{
+		auto scale_constants = compute_group.bindings.query_constant_buffer_as<float>("CBScale");
+		auto input = compute_group.bindings.query_shader_resource("g_Input");
+		auto output = compute_group.bindings.query_unordered_access("g_Output");
+		if (scale_constants == nullptr || !input.is_valid() || !output.is_valid()) {
+			unresolved_group_count.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		auto input_data = input.view_as<const float>();
+		auto output_data = output.view_as<float>();
+		for (uint32_t thread_x = 0; thread_x < 64; ++thread_x)
+		{
+			const uint32_t element_index = compute_group.query_dispatch_thread_id(thread_x, 0, 0)[0];
+			if (element_index < input_data.size() && element_index < output_data.size()) {
+				output_data[element_index] = input_data[element_index] * *scale_constants;
+			}
+		}
+	});
+	test_report.check(is_registered, "Kernel matches the reflected thread group");
+
+	std::vector<float> input_data(s_element_count);
+	for (uint32_t element_index = 0; element_index < s_element_count; ++element_index)
+	{
+		input_data[element_index] = static_cast<float>(element_index);
+	}
+
+	// Views of null device resources resolve to their cpu storage
+	auto input_buffer = create_structured_buffer(null_device.Get(), input_data.data());
+	auto output_buffer = create_structured_buffer(null_device.Get(), nullptr);
+	ComPtr<ID3D11ShaderResourceView> input_srv = nullptr;
+	ComPtr<ID3D11UnorderedAccessView> output_uav = nullptr;
+	null_device->CreateShaderResourceView(input_buffer.Get(), nullptr, input_srv.GetAddressOf());
+	null_device->CreateUnorderedAccessView(output_buffer.Get(), nullptr, output_uav.GetAddressOf());
+	scale_effect.bind_shader_resource_view("g_Input", input_srv.Get());
+	scale_effect.bind_unordered_access_view("g_Output", output_uav.Get());
+	cpu_compute_executor.dispatch(scale_effect, s_element_count, 1, 1);
+	auto output_storage = query_null_resource_storage(output_buffer.Get());
+	test_report.check(output_storage != nullptr && unresolved_group_count == 0 &&
+					  is_scaled(input_data, { reinterpret_cast<const float *>(output_storage->storage.data()), s_element_count }, scale),
+					  "Kernel scales null device buffers");
+
+	// A resource that only claims to be a buffer has no storage, the kernel sees an unbound view
+	auto foreign_buffer = Microsoft::WRL::Make<ForeignBuffer>(null_device.Get(), &null_device->get_stats());
+	ComPtr<ID3D11ShaderResourceView> foreign_srv = nullptr;
+	null_device->CreateShaderResourceView(foreign_buffer.Get(), nullptr, foreign_srv.GetAddressOf());
+	test_report.check(query_null_resource_storage(foreign_buffer.Get()) == nullptr, "Foreign buffer is not taken for a null resource");
+	scale_effect.bind_shader_resource_view("g_Input", foreign_srv.Get());
+	cpu_compute_executor.dispatch(scale_effect, s_element_count, 1, 1);
+	test_report.check(unresolved_group_count == s_element_count / 64, "Every group sees the foreign view unresolved");
+
+	// Plain cpu memory needs no d3d11 resource at all
+	std::vector<float> output_data(s_element_count, 0.0f);
+	cpu_compute_executor.bind_cpu_resource("g_Input", { reinterpret_cast<uint8_t *>(input_data.data()), s_element_count * sizeof(float), sizeof(float), 0, 0 });
+	cpu_compute_executor.bind_cpu_resource("g_Output", { reinterpret_cast<uint8_t *>(output_data.data()), s_element_count * sizeof(float), sizeof(float), 0, 0 });
+	cpu_compute_executor.dispatch(scale_effect, s_element_count, 1, 1);
+	test_report.check(is_scaled(input_data, output_data, scale), "Kernel scales plain cpu memory");
+	cpu_compute_executor.print();
+	return test_report.finish();
+}
@@ -0,0 +1,204 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <dispatch_arguments.h>
+#include <constant_buffer_pool.h>
+#include <null_device.h>
+
+// Item counts to dispatch arguments to indirect dispatch on the null device, the builder shader is emulated by a kernel
+// that reads the same bindings and constants the gpu would
+
+namespace toy
+{
+	static constexpr uint32_t s_consumer_thread_group_size = 64;
+
+	static constexpr std::string_view s_consumer_source = R"(
+cbuffer CBConsumer : register(b0)
+{
+	uint3 g_DispatchGroupOffset;
+	uint g_ItemCount;
+}
+
+[numthreads(64, 1, 1)]
+void CS(uint3 group_id : SV_GroupID)
+{
+}
+)";
+
+	struct ConsumerDispatch
+	{
+		std::array<uint32_t, 3> thread_group_counts{};
+		std::array<uint32_t, 3> group_offset{};
+		uint32_t item_count = 0;
+		uint64_t covered_group_count = 0;
+	};
+
+	static NullResourceStorage *query_view_storage(ID3D11View *view)
+	{
+		if (view == nullptr) {
+			return nullptr;
+		}
+		ComPtr<ID3D11Resource> resource = nullptr;
+		view->GetResource(resource.GetAddressOf());
+		return query_null_resource_storage(resource.Get());
+	}
+
+	static const uint8_t *query_constant_buffer_data(const NullComputeDispatch &compute_dispatch, uint32_t slot)
+	{
+		auto constant_buffer_storage = query_null_resource_storage(compute_dispatch.constant_buffers[slot]);
+		return constant_buffer_storage != nullptr ? constant_buffer_storage->storage.data() + compute_dispatch.constant_buffer_offsets[slot] : nullptr;
+	}
+
+	// Mirror of the count to groups shader, reads CBDispatchArguments from b0, item counts from t0 and writes u0
+	static void run_count_to_groups(const NullComputeDispatch &compute_dispatch, NullResourceStorage &argument_storage)
+	{
+		auto item_count_storage = query_view_storage(compute_dispatch.shader_resource_views[0]);
+		auto constant_data = query_constant_buffer_data(compute_dispatch, 0);
+		if (item_count_storage == nullptr || constant_data == nullptr) {
+			return;
+		}
+		std::array<uint32_t, 4> builder_conf{};
+		std::memcpy(builder_conf.data(), constant_data, sizeof(builder_conf));
+		const uint32_t thread_count = compute_dispatch.thread_group_counts[0] * 64;
+		const auto argument_count = static_cast<uint32_t>(argument_storage.storage.size() / 12);
+		for (uint32_t dispatch_index = 0; dispatch_index < thread_count && dispatch_index < builder_conf[0] && dispatch_index < argument_count; ++dispatch_index)
+		{
+			uint32_t item_count = 0;
+			std::memcpy(&item_count, item_count_storage->storage.data() + dispatch_index * 4, sizeof(item_count));
+			const uint32_t thread_group_count = item_count / builder_conf[1] + (item_count % builder_conf[1] != 0 ? 1 : 0);
+			const uint32_t row_count = (std::min)(thread_group_count / builder_conf[2] + (thread_group_count % builder_conf[2] != 0 ? 1 : 0), builder_conf[2]);
+			const std::array<uint32_t, 3> arguments = row_count > 1 ? std::array<uint32_t, 3>{ builder_conf[2], row_count, 1 } : std::array<uint32_t, 3>{ thread_group_count, 1, 1 };
+			std::memcpy(argument_storage.storage.data() + dispatch_index * 12, arguments.data(), sizeof(arguments));
+		}
+	}
+
+	// Groups of the consumer that land on an item, found through the linear group index convention
+	static ConsumerDispatch run_consumer(const NullComputeDispatch &compute_dispatch)
+	{
+		ConsumerDispatch consumer_dispatch{};
+		consumer_dispatch.thread_group_counts = compute_dispatch.thread_group_counts;
+		auto constant_data = query_constant_buffer_data(compute_dispatch, 0);
+		if (constant_data == nullptr) {
+			return consumer_dispatch;
+		}
+		std::memcpy(consumer_dispatch.group_offset.data(), constant_data, sizeof(consumer_dispatch.group_offset));
+		std::memcpy(&consumer_dispatch.item_count, constant_data + 12, sizeof(consumer_dispatch.item_count));
+		const uint64_t needed_group_count = (static_cast<uint64_t>(consumer_dispatch.item_count) + s_consumer_thread_group_size - 1) / s_consumer_thread_group_size;
+		for (uint32_t group_y = 0; group_y < compute_dispatch.thread_group_counts[1]; ++group_y)
+		{
+			for (uint32_t group_x = 0; group_x < compute_dispatch.thread_group_counts[0]; ++group_x)
+			{
+				const uint32_t linear_group_index = DispatchArgumentsBuilder::query_linear_group_index(
+					{ group_x + consumer_dispatch.group_offset[0], group_y + consumer_dispatch.group_offset[1], consumer_dispatch.group_offset[2] });
+				consumer_dispatch.covered_group_count += linear_group_index < needed_group_count ? 1 : 0;
+			}
+		}
+		return consumer_dispatch;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	auto null_device = NullDevice::create();
+	auto device_context = null_device->get_immediate_context();
+
+	const std::vector<uint32_t> item_counts{ 0, 1, 64, 65, 1'000'000, 64 * 65535, 64 * 65535 + 1, 100'000'000 };
+	DispatchArgumentsBuffer arguments_buffer{};
+	test_report.check(SUCCEEDED(arguments_buffer.create(null_device.Get(), static_cast<uint32_t>(item_counts.size()))), "Arguments buffer is created");
+	auto argument_storage = query_null_resource_storage(arguments_buffer.get_argument_buffer());
+	ComPtr<ID3D11Resource> item_count_resource = nullptr;
+	arguments_buffer.get_item_count_uav()->GetResource(item_count_resource.GetAddressOf());
+	device_context->UpdateSubresource(item_count_resource.Get(), 0, nullptr, item_counts.data(), 0, 0);
+
+	// The builder is the only pass writing the argument buffer, everything else is the consumer
+	std::vector<ConsumerDispatch> consumer_dispatches{};
+	null_device->set_compute_kernel([&](const NullComputeDispatch &compute_dispatch)
+	{
+		if (query_view_storage(compute_dispatch.unordered_access_views[0]) == argument_storage) {
+			run_count_to_groups(compute_dispatch, *argument_storage);
+		} else {
+			consumer_dispatches.emplace_back(run_consumer(compute_dispatch));
+		}
+	});
+
+	DispatchArgumentsBuilder arguments_builder{ null_device.Get() };
+	test_report.check(arguments_builder.is_valid(), "Count to groups shader compiles");
+	arguments_builder.build(device_context, arguments_buffer, s_consumer_thread_group_size);
+	test_report.check(consumer_dispatches.empty(), "Building arguments dispatches only the builder");
+
+	for (uint32_t dispatch_index = 0; dispatch_index < item_counts.size(); ++dispatch_index)
+	{
+		const auto expected_arguments = DispatchArgumentsBuilder::compute_dispatch_arguments(item_counts[dispatch_index], s_consumer_thread_group_size);
+		DispatchArguments arguments{};
+		std::memcpy(&arguments, argument_storage->storage.data() + DispatchArgumentsBuffer::query_argument_offset(dispatch_index), sizeof(arguments));
+		test_report.check(arguments.thread_group_count_x == expected_arguments.thread_group_count_x && arguments.thread_group_count_y == expected_arguments.thread_group_count_y &&
+						  arguments.thread_group_count_z == expected_arguments.thread_group_count_z,
+						  std::format("Arguments of {} items match the cpu reference", item_counts[dispatch_index]));
+		test_report.check(arguments.thread_group_count_x <= D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION && arguments.thread_group_count_y <= D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION,
+						  std::format("Arguments of {} items stay under the group limit", item_counts[dispatch_index]));
+	}
+
+	// Every item is reached exactly once group wise, including counts that spill into y
+	const auto cs_path = test::write_shader_file("dispatch_consumer_cs.hlsl", s_consumer_source).wstring();
+	ComputePipelineStateObject pipeline_state_object{};
+	pipeline_state_object.cs_path = cs_path;
+	ComputeEffect consumer_effect{ pipeline_state_object, null_device.Get() };
+	auto item_count_accessor = consumer_effect.query_constant_buffer_accessor("g_ItemCount");
+	test_report.check(item_count_accessor != nullptr, "Consumer reflects g_ItemCount");
+	if (item_count_accessor == nullptr) {
+		return test_report.finish();
+	}
+
+	// A split dispatch leaves the offset of its last chunk in the cbuffer, indirect dispatches must not inherit it
+	constexpr uint32_t split_group_count = 100'000;
+	item_count_accessor->set_uint(split_group_count * s_consumer_thread_group_size);
+	consumer_effect.emit_compute_pipeline(device_context);
+	consumer_effect.dispatch(device_context, split_group_count * s_consumer_thread_group_size, 1, 1);
+	uint64_t split_covered_group_count = 0;
+	for (auto &&consumer_dispatch : consumer_dispatches)
+	{
+		split_covered_group_count += consumer_dispatch.covered_group_count;
+	}
+	test_report.check(consumer_dispatches.size() == 2 && split_covered_group_count == split_group_count, "Split dispatch covers every group once in two chunks");
+	consumer_dispatches.clear();
+
+	// Pooled cbuffers move to a new ring slot per chunk, every chunk must read its own offset
+	ConstantBufferPool constant_buffer_pool{ null_device.Get() };
+	ComputeEffect pooled_consumer_effect{ EffectPrototype::create(pipeline_state_object, null_device.Get()), null_device.Get(), &constant_buffer_pool };
+	constexpr uint32_t pooled_split_group_count = 200'000;
+	pooled_consumer_effect.query_constant_buffer_accessor("g_ItemCount")->set_uint(pooled_split_group_count * s_consumer_thread_group_size);
+	pooled_consumer_effect.emit_compute_pipeline(device_context);
+	pooled_consumer_effect.dispatch(device_context, pooled_split_group_count * s_consumer_thread_group_size, 1, 1);
+	uint64_t pooled_covered_group_count = 0;
+	bool is_every_offset_distinct = true;
+	for (size_t dispatch_index = 0; dispatch_index < consumer_dispatches.size(); ++dispatch_index)
+	{
+		pooled_covered_group_count += consumer_dispatches[dispatch_index].covered_group_count;
+		is_every_offset_distinct = is_every_offset_distinct && consumer_dispatches[dispatch_index].group_offset[0] == dispatch_index * (pooled_split_group_count / 4);
+	}
+	test_report.check(consumer_dispatches.size() == 4 && is_every_offset_distinct, "Pooled split dispatch binds the offset of every chunk");
+	test_report.check(pooled_covered_group_count == pooled_split_group_count, "Pooled split dispatch covers every group once");
+	consumer_dispatches.clear();
+
+	for (uint32_t dispatch_index = 0; dispatch_index < item_counts.size(); ++dispatch_index)
+	{
+		item_count_accessor->set_uint(item_counts[dispatch_index]);
+		consumer_effect.emit_compute_pipeline(device_context);
+		consumer_effect.dispatch_indirect(device_context, arguments_buffer.get_argument_buffer(), DispatchArgumentsBuffer::query_argument_offset(dispatch_index));
+	}
+	test_report.check(consumer_dispatches.size() == item_counts.size(), "One consumer dispatch per argument entry");
+	for (auto &&consumer_dispatch : consumer_dispatches)
+	{
+		const uint64_t needed_group_count = (static_cast<uint64_t>(consumer_dispatch.item_count) + s_consumer_thread_group_size - 1) / s_consumer_thread_group_size;
+		test_report.check(consumer_dispatch.covered_group_count == needed_group_count,
+						  std::format("Indirect dispatch of {} items covers {} groups, expected {}", consumer_dispatch.item_count, consumer_dispatch.covered_group_count, needed_group_count));
+		test_report.check(consumer_dispatch.group_offset == std::array<uint32_t, 3>{ 0, 0, 0 }, std::format("Indirect dispatch of {} items runs without a group offset", consumer_dispatch.item_count));
+	}
+	return test_report.finish();
+}
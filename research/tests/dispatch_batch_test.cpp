@@ -0,0 +1,156 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <dispatch_batch.h>
+#include <null_device.h>
+#include <map>
+
+// Dispatch batching on the null device, a kernel reads the group table and item snapshots the batch uploads
+
+namespace toy
+{
+	static constexpr std::string_view s_item_constant_buffer_source = R"(
+cbuffer CBItem : register(b0)
+{
+	uint g_ItemValue;
+	uint3 g_ItemPadding;
+}
+)";
+
+	static constexpr std::string_view s_batched_source = R"(
+ByteAddressBuffer g_DispatchBatchItems : register(t0);
+StructuredBuffer<uint4> g_DispatchBatchGroups : register(t1);
+
+[numthreads(64, 1, 1)]
+void CS(uint3 group_id : SV_GroupID)
+{
+}
+)";
+
+	static constexpr std::string_view s_plain_source = R"(
+[numthreads(64, 1, 1)]
+void CS(uint3 group_id : SV_GroupID)
+{
+}
+)";
+
+	struct RecordedDispatches
+	{
+		uint32_t dispatch_count = 0;
+		// Item value to the groups that ran with it, and the sum of their x group ids
+		std::map<uint32_t, uint64_t> group_counts = {};
+		std::map<uint32_t, uint64_t> group_x_sums = {};
+	};
+
+	static NullResourceStorage *query_view_storage(ID3D11View *view)
+	{
+		if (view == nullptr) {
+			return nullptr;
+		}
+		ComPtr<ID3D11Resource> resource = nullptr;
+		view->GetResource(resource.GetAddressOf());
+		return query_null_resource_storage(resource.Get());
+	}
+
+	static void record_dispatch(const NullComputeDispatch &compute_dispatch, RecordedDispatches &recorded_dispatches)
+	{
+		++recorded_dispatches.dispatch_count;
+		auto item_storage = query_view_storage(compute_dispatch.shader_resource_views[0]);
+		auto group_storage = query_view_storage(compute_dispatch.shader_resource_views[1]);
+		if (item_storage != nullptr && group_storage != nullptr) {
+			for (uint32_t group_x = 0; group_x < compute_dispatch.thread_group_counts[0]; ++group_x)
+			{
+				std::array<uint32_t, 4> group_entry{};
+				std::memcpy(group_entry.data(), group_storage->storage.data() + group_x * sizeof(group_entry), sizeof(group_entry));
+				uint32_t item_value = 0;
+				std::memcpy(&item_value, item_storage->storage.data() + group_entry[0] * 16, sizeof(item_value));
+				++recorded_dispatches.group_counts[item_value];
+				recorded_dispatches.group_x_sums[item_value] += group_entry[1];
+			}
+			return;
+		}
+
+		// Plain shaders read the cbuffer the effect emitted
+		auto constant_buffer_storage = query_null_resource_storage(compute_dispatch.constant_buffers[0]);
+		if (constant_buffer_storage != nullptr) {
+			uint32_t item_value = 0;
+			std::memcpy(&item_value, constant_buffer_storage->storage.data() + compute_dispatch.constant_buffer_offsets[0], sizeof(item_value));
+			recorded_dispatches.group_counts[item_value] += static_cast<uint64_t>(compute_dispatch.thread_group_counts[0]) * compute_dispatch.thread_group_counts[1] *
+															compute_dispatch.thread_group_counts[2];
+		}
+	}
+
+	static std::unique_ptr<ComputeEffect> create_compute_effect(ID3D11Device *device, std::string_view file_name, std::string_view source)
+	{
+		const auto cs_path = test::write_shader_file(file_name, std::string(s_item_constant_buffer_source) + std::string(source)).wstring();
+		ComputePipelineStateObject pipeline_state_object{};
+		pipeline_state_object.cs_path = cs_path;
+		return std::make_unique<ComputeEffect>(pipeline_state_object, device);
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	auto null_device = NullDevice::create();
+	auto device_context = null_device->get_immediate_context();
+	RecordedDispatches recorded_dispatches{};
+	null_device->set_compute_kernel([&](const NullComputeDispatch &compute_dispatch) { record_dispatch(compute_dispatch, recorded_dispatches); });
+
+	// A shader without the batch buffers cannot tell items apart, every dispatch goes straight to the effect
+	auto plain_effect = create_compute_effect(null_device.Get(), "dispatch_batch_plain_cs.hlsl", s_plain_source);
+	ComputeDispatchBatch plain_batch{ *plain_effect, null_device.Get(), "CBItem" };
+	test_report.check(!plain_batch.is_valid(), "Batch without g_DispatchBatchItems and g_DispatchBatchGroups is invalid");
+	auto plain_value_accessor = plain_effect->query_constant_buffer_accessor("g_ItemValue");
+	for (uint32_t item_value = 1; item_value <= 3; ++item_value)
+	{
+		plain_value_accessor->set_uint(item_value);
+		plain_batch.add(device_context, 64 * item_value, 1, 1);
+	}
+	plain_batch.flush(device_context);
+	test_report.check(recorded_dispatches.dispatch_count == 3, "Plain shader is dispatched once per add");
+	test_report.check(recorded_dispatches.group_counts[1] == 1 && recorded_dispatches.group_counts[2] == 2 && recorded_dispatches.group_counts[3] == 3,
+					  "Plain dispatches run with their own cbuffer values");
+
+	// Small dispatches of a batch aware shader become one dispatch
+	recorded_dispatches = {};
+	auto batched_effect = create_compute_effect(null_device.Get(), "dispatch_batch_batched_cs.hlsl", s_batched_source);
+	ComputeDispatchBatch dispatch_batch{ *batched_effect, null_device.Get(), "CBItem" };
+	test_report.check(dispatch_batch.is_valid(), "Batch with both buffers is valid");
+	auto batched_value_accessor = batched_effect->query_constant_buffer_accessor("g_ItemValue");
+	for (uint32_t item_value = 0; item_value < 100; ++item_value)
+	{
+		batched_value_accessor->set_uint(item_value);
+		dispatch_batch.add(device_context, 64 * 3, 1, 1);
+	}
+	dispatch_batch.flush(device_context);
+	bool is_every_item_covered = recorded_dispatches.group_counts.size() == 100;
+	for (auto &&[item_value, group_count] : recorded_dispatches.group_counts)
+	{
+		is_every_item_covered = is_every_item_covered && group_count == 3 && recorded_dispatches.group_x_sums[item_value] == 3;
+	}
+	test_report.check(recorded_dispatches.dispatch_count == 1, "Hundred micro dispatches are issued as one");
+	test_report.check(is_every_item_covered, "Every batched item runs its own three groups");
+
+	// A dispatch larger than a batch is issued alone over several flushes instead of being dropped
+	recorded_dispatches = {};
+	constexpr uint64_t oversized_group_count = 150'000;
+	batched_value_accessor->set_uint(7);
+	dispatch_batch.add(device_context, 64, 1, 1);
+	batched_value_accessor->set_uint(8);
+	dispatch_batch.add(device_context, 64 * oversized_group_count, 1, 1);
+	dispatch_batch.flush(device_context);
+	dispatch_batch.print();
+	test_report.check(recorded_dispatches.dispatch_count == 4, "Pending batch is flushed and the oversized dispatch spans three flushes");
+	test_report.check(recorded_dispatches.group_counts[7] == 1, "Pending item runs before the oversized dispatch");
+	test_report.check(recorded_dispatches.group_counts[8] == oversized_group_count &&
+					  recorded_dispatches.group_x_sums[8] == oversized_group_count * (oversized_group_count - 1) / 2,
+					  "Oversized dispatch runs every group once");
+	test_report.check(dispatch_batch.get_stats().oversized_dispatches == 1, "Oversized dispatch is counted");
+	return test_report.finish();
+}
@@ -0,0 +1,56 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <null_device.h>
+
+// Prototypes of shaders that fail to load or compile are rejected instead of reflecting empty results
+
+namespace toy
+{
+	static constexpr std::string_view s_valid_source = R"(
+RWStructuredBuffer<uint> g_Output : register(u0);
+
+[numthreads(64, 1, 1)]
+void CS(uint3 dispatch_thread_id : SV_DispatchThreadID)
+{
+	g_Output[dispatch_thread_id.x] = dispatch_thread_id.x;
+}
+)";
+
+	static ComputePipelineStateObject make_compute_pipeline_state_object(std::wstring_view cs_path)
+	{
+		ComputePipelineStateObject pipeline_state_object{};
+		pipeline_state_object.cs_path = cs_path;
+		return pipeline_state_object;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	auto null_device = NullDevice::create();
+	auto device_context = null_device->get_immediate_context();
+
+	const auto valid_path = test::write_shader_file("effect_prototype_valid_cs.hlsl", s_valid_source).wstring();
+	test_report.check(EffectPrototype::create(make_compute_pipeline_state_object(valid_path), null_device.Get()) != nullptr, "Valid shader gives a prototype");
+
+	const auto missing_path = (std::filesystem::path(valid_path).parent_path() / "effect_prototype_missing_cs.hlsl").wstring();
+	test_report.check(EffectPrototype::create(make_compute_pipeline_state_object(missing_path), null_device.Get()) == nullptr, "Missing source gives no prototype");
+
+	// Cut before the entry point, as a file read while another process rewrites it
+	const auto truncated_path = test::write_shader_file("effect_prototype_truncated_cs.hlsl", s_valid_source.substr(0, s_valid_source.find("[numthreads"))).wstring();
+	test_report.check(EffectPrototype::create(make_compute_pipeline_state_object(truncated_path), null_device.Get()) == nullptr, "Truncated source gives no prototype");
+
+	// Effects built straight from a pipeline state object keep an invalid prototype and do nothing
+	ComputeEffect missing_effect{ make_compute_pipeline_state_object(missing_path), null_device.Get() };
+	test_report.check(!missing_effect.get_prototype()->is_valid(), "Effect of a missing shader holds an invalid prototype");
+	missing_effect.emit_compute_pipeline(device_context);
+	missing_effect.dispatch(device_context, 256, 1, 1);
+	test_report.check(missing_effect.query_constant_buffer_accessor("g_DispatchGroupOffset") == nullptr, "Invalid effect reflects nothing");
+	return test_report.finish();
+}
@@ -0,0 +1,45 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <lut_cache.h>
+#include <null_device.h>
+
+// Lut cache eviction on the null device, a view the caller still holds outlives its lru entry
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	auto null_device = NullDevice::create();
+	auto &&device_stats = null_device->get_stats();
+	LutCache lut_cache{ null_device.Get(), "", 2 };
+
+	const std::vector<uint8_t> texel_data(4 * 4 * 4, 0x7f);
+	auto make_key = [](uint64_t params_hash) { return LutCacheKey{ params_hash, {}, 4, 4, DXGI_FORMAT_R8G8B8A8_UNORM }; };
+
+	// The first lut stays bound while two more presets push it out of the lru
+	auto bound_srv = lut_cache.insert(make_key(1), texel_data);
+	test_report.check(bound_srv != nullptr, "Cpu lut is inserted");
+	lut_cache.insert(make_key(2), texel_data);
+	lut_cache.insert(make_key(3), texel_data);
+	test_report.check(lut_cache.get_stats().evictions == 1, "Third lut evicts the first");
+	test_report.check(lut_cache.query(make_key(1)) == nullptr, "Evicted lut is no longer resident");
+	test_report.check(device_stats.query_objects_alive(NullObjectType::ShaderResourceView) == 3 &&
+					  device_stats.query_objects_alive(NullObjectType::Texture) == 3,
+					  "Held view keeps the evicted lut alive");
+
+	ComPtr<ID3D11Resource> bound_resource = nullptr;
+	bound_srv->GetResource(bound_resource.GetAddressOf());
+	test_report.check(query_null_resource_storage(bound_resource.Get()) != nullptr, "Held view still reaches its texture");
+
+	bound_resource.Reset();
+	bound_srv.Reset();
+	test_report.check(device_stats.query_objects_alive(NullObjectType::ShaderResourceView) == 2 &&
+					  device_stats.query_objects_alive(NullObjectType::Texture) == 2,
+					  "Releasing the held view frees the evicted lut");
+	lut_cache.print();
+	return test_report.finish();
+}
@@ -0,0 +1,238 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <mesh_baker.h>
+#include <null_device.h>
+#include <random>
+
+// Cache and fetch optimizations of the mesh optimizer, and obj meshes baked into a reflected vertex format and parsed back
+
+namespace toy
+{
+	static constexpr std::string_view s_mesh_vertex_source = R"(
+struct VertexIn
+{
+	float3 pos : POSITION;
+	float2 tex : TEXCOORD;
+	float3 normal : NORMAL;
+};
+
+float4 VS(VertexIn vertex_in) : SV_POSITION
+{
+	return float4(vertex_in.pos + vertex_in.normal * vertex_in.tex.x, 1.0f);
+}
+)";
+
+	// Unit cube, quads with shared positions but distinct normals per face, so 24 vertices
+	static constexpr std::string_view s_cube_source = R"(# cube
+v -1 -1 -1
+v 1 -1 -1
+v 1 1 -1
+v -1 1 -1
+v -1 -1 1
+v 1 -1 1
+v 1 1 1
+v -1 1 1
+vt 0 0
+vt 1 0
+vt 1 1
+vt 0 1
+vn 0 0 -1
+vn 0 0 1
+vn -1 0 0
+vn 1 0 0
+vn 0 -1 0
+vn 0 1 0
+f 1/1/1 4/4/1 3/3/1 2/2/1
+f 5/1/2 6/2/2 7/3/2 8/4/2
+f 1/1/3 5/2/3 8/3/3 4/4/3
+f 2/1/4 3/4/4 7/3/4 6/2/4
+f -8/1/5 -7/2/5 -3/3/5 -4/4/5
+f 4/1/6 8/2/6 7/3/6 3/4/6
+)";
+
+	// Grid of side * side quads with the triangles shuffled, the worst case for the post-transform cache
+	struct GridMesh
+	{
+		std::vector<float> positions = {};
+		std::vector<float> texcoords = {};
+		std::vector<float> normals = {};
+		std::vector<uint32_t> indices = {};
+		uint32_t vertex_count = 0;
+
+		explicit GridMesh(uint32_t side, uint32_t seed)
+		{
+			const uint32_t row = side + 1;
+			vertex_count = row * row;
+			for (uint32_t y = 0; y < row; ++y)
+			{
+				for (uint32_t x = 0; x < row; ++x)
+				{
+					positions.insert(positions.end(), { static_cast<float>(x), static_cast<float>(y), 0.0f });
+					texcoords.insert(texcoords.end(), { static_cast<float>(x) / static_cast<float>(side), static_cast<float>(y) / static_cast<float>(side) });
+					normals.insert(normals.end(), { 0.0f, 0.0f, 1.0f });
+				}
+			}
+			std::vector<std::array<uint32_t, 3>> triangles{};
+			for (uint32_t y = 0; y < side; ++y)
+			{
+				for (uint32_t x = 0; x < side; ++x)
+				{
+					const uint32_t corner = y * row + x;
+					triangles.push_back({ corner, corner + 1, corner + row });
+					triangles.push_back({ corner + 1, corner + row + 1, corner + row });
+				}
+			}
+			std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ seed });
+			for (auto &&triangle : triangles)
+			{
+				indices.insert(indices.end(), triangle.begin(), triangle.end());
+			}
+		}
+
+		[[nodiscard]] RawMesh get_raw_mesh() const
+		{
+			RawMesh raw_mesh{};
+			raw_mesh.attributes = { { "POSITION", 0, positions.data(), 3, 0 }, { "TEXCOORD", 0, texcoords.data(), 2, 0 }, { "NORMAL", 0, normals.data(), 3, 0 } };
+			raw_mesh.indices = indices;
+			raw_mesh.vertex_count = vertex_count;
+			return raw_mesh;
+		}
+	};
+
+	static std::vector<uint32_t> read_indices(const MeshFileView &mesh_file_view)
+	{
+		std::vector<uint32_t> indices(mesh_file_view.header->index_count);
+		for (size_t index = 0; index < indices.size(); ++index)
+		{
+			if (mesh_file_view.header->index_format == DXGI_FORMAT_R16_UINT) {
+				uint16_t short_index = 0;
+				std::memcpy(&short_index, mesh_file_view.index_data.data() + index * 2, 2);
+				indices[index] = short_index;
+			} else {
+				std::memcpy(&indices[index], mesh_file_view.index_data.data() + index * 4, 4);
+			}
+		}
+		return indices;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+
+	// Cache order never costs misses
+	GridMesh grid_mesh{ 48, 20241103 };
+	auto cache_indices = grid_mesh.indices;
+	const auto cache_before = MeshOptimizer::analyze_vertex_cache(cache_indices, grid_mesh.vertex_count);
+	MeshOptimizer::optimize_vertex_cache(cache_indices, grid_mesh.vertex_count);
+	const auto cache_after = MeshOptimizer::analyze_vertex_cache(cache_indices, grid_mesh.vertex_count);
+	test_report.check(cache_after.acmr <= cache_before.acmr && cache_after.triangle_count == cache_before.triangle_count,
+					  std::format("ACMR does not grow, {:.3f} -> {:.3f}", cache_before.acmr, cache_after.acmr));
+	auto sorted_before = grid_mesh.indices;
+	auto sorted_after = cache_indices;
+	std::ranges::sort(sorted_before);
+	std::ranges::sort(sorted_after);
+	test_report.check(sorted_before == sorted_after, "Cache order keeps every index");
+
+	// Fetch order renumbers by first use and drops the vertices no triangle references
+	const uint32_t unused_vertex_count = 5;
+	const uint32_t fetch_vertex_count = grid_mesh.vertex_count + unused_vertex_count;
+	auto fetch_indices = cache_indices;
+	std::vector<uint32_t> remap{};
+	const uint32_t fetch_kept = MeshOptimizer::optimize_vertex_fetch(fetch_indices, fetch_vertex_count, remap);
+	bool is_remapped = remap.size() == fetch_vertex_count && fetch_kept == grid_mesh.vertex_count;
+	for (size_t index = 0; index < fetch_indices.size() && is_remapped; ++index)
+	{
+		is_remapped = fetch_indices[index] == remap[cache_indices[index]];
+	}
+	test_report.check(is_remapped, "Every index goes through the remap");
+	uint32_t next_vertex = 0;
+	bool is_first_use_order = true;
+	for (auto index : fetch_indices)
+	{
+		if (index > next_vertex) {
+			is_first_use_order = false;
+		}
+		next_vertex = index == next_vertex ? next_vertex + 1 : next_vertex;
+	}
+	test_report.check(is_first_use_order && next_vertex == fetch_kept, "Vertices are numbered in first use order");
+	std::vector<uint32_t> remap_targets{};
+	uint32_t dropped_count = 0;
+	for (auto target : remap)
+	{
+		if (target == UINT32_MAX) {
+			++dropped_count;
+		} else {
+			remap_targets.emplace_back(target);
+		}
+	}
+	std::ranges::sort(remap_targets);
+	test_report.check(dropped_count == unused_vertex_count && std::ranges::adjacent_find(remap_targets) == remap_targets.end() &&
+					  !remap_targets.empty() && remap_targets.back() == fetch_kept - 1, "Unused vertices are dropped and the rest map one to one");
+
+	// Vertex format of the shader, normals octahedral and texcoords half
+	auto null_device = NullDevice::create();
+	const auto vs_path = test::write_shader_file("mesh_baker_vs.hlsl", s_mesh_vertex_source).wstring();
+	GraphicsPipelineStateObject pipeline_state_object{};
+	pipeline_state_object.vs_path = vs_path;
+	pipeline_state_object.vertex_layout.layout_policy = VertexLayoutPolicy::HotCold;
+	pipeline_state_object.vertex_layout.compressions = { { "NORMAL", VertexAttributeEncoding::Octahedral16 }, { "TEXCOORD", VertexAttributeEncoding::Float16 } };
+	auto prototype = EffectPrototype::create(pipeline_state_object, null_device.Get());
+	if (!test_report.check(prototype != nullptr && prototype->get_vertex_format().get_stream_count() == 2, "Vertex shader reflects two streams")) {
+		return test_report.finish();
+	}
+	const auto &vertex_format = prototype->get_vertex_format();
+
+	// Obj corners split on normals and polygons fan into triangles
+	ObjMesh cube_mesh{};
+	test_report.check(ObjMesh::parse(s_cube_source, cube_mesh) && cube_mesh.vertex_count == 24 && cube_mesh.indices.size() == 36 &&
+					  cube_mesh.texcoords.size() == 48 && cube_mesh.normals.size() == 72, "Cube obj parses into 24 vertices and 12 triangles");
+	ObjMesh broken_mesh{};
+	test_report.check(!ObjMesh::parse("v 0 0 0\nf 1 2 3\n", broken_mesh), "Face past the last position is refused");
+
+	// Small meshes bake with 16-bit indices and parse back into the same format
+	MeshBakeStats bake_stats{};
+	const auto cube_file = MeshBaker::bake(cube_mesh.get_raw_mesh(), vertex_format, &bake_stats);
+	MeshFileView cube_view{};
+	test_report.check(MeshFileView::parse(cube_file, cube_view) && cube_view.is_compatible(vertex_format), "Baked cube parses and matches the format");
+	if (cube_view.header != nullptr) {
+		test_report.check(cube_view.header->index_format == DXGI_FORMAT_R16_UINT && cube_view.header->vertex_count == 24 &&
+						  cube_view.header->index_count == 36 && cube_view.index_data.size() == 72, "Cube uses 16-bit indices");
+		test_report.check(cube_view.header->bounds_min[0] == -1.0f && cube_view.header->bounds_max[2] == 1.0f, "Cube bounds are kept");
+		const auto position_attribute = vertex_format.query_attribute("POSITION");
+		const auto cube_indices = read_indices(cube_view);
+		bool is_position_kept = position_attribute != nullptr;
+		for (size_t index = 0; index < cube_indices.size() && is_position_kept; ++index)
+		{
+			// Every corner of the cube sits at +-1 on each axis
+			float position[3]{};
+			std::memcpy(position, cube_view.stream_data[position_attribute->input_slot].data() +
+								  static_cast<size_t>(cube_indices[index]) * cube_view.header->streams[position_attribute->input_slot].stride_in_bytes +
+								  position_attribute->aligned_byte_offset, sizeof(position));
+			is_position_kept = std::abs(position[0]) == 1.0f && std::abs(position[1]) == 1.0f && std::abs(position[2]) == 1.0f;
+		}
+		test_report.check(is_position_kept, "Cube indices reference packed corner positions");
+	}
+
+	GraphicsPipelineStateObject interleaved_pipeline_state_object = pipeline_state_object;
+	interleaved_pipeline_state_object.vertex_layout.layout_policy = VertexLayoutPolicy::Interleaved;
+	auto interleaved_prototype = EffectPrototype::create(interleaved_pipeline_state_object, null_device.Get());
+	test_report.check(interleaved_prototype != nullptr && !cube_view.is_compatible(interleaved_prototype->get_vertex_format()),
+					  "Baked cube does not match another layout");
+	test_report.check(!MeshFileView::parse(std::span(cube_file).first(cube_file.size() - 1), cube_view), "Truncated mesh file is refused");
+
+	// Past 65536 vertices the indices widen to 32 bit
+	GridMesh large_mesh{ 260, 7 };
+	const auto large_file = MeshBaker::bake(large_mesh.get_raw_mesh(), vertex_format, &bake_stats);
+	MeshFileView large_view{};
+	test_report.check(MeshFileView::parse(large_file, large_view) && large_view.header->index_format == DXGI_FORMAT_R32_UINT &&
+					  large_view.header->vertex_count == large_mesh.vertex_count && large_view.is_compatible(vertex_format), "Large grid uses 32-bit indices");
+	test_report.check(bake_stats.after.acmr <= bake_stats.before.acmr, std::format("Bake lowers ACMR, {:.3f} -> {:.3f}", bake_stats.before.acmr, bake_stats.after.acmr));
+	return test_report.finish();
+}
@@ -0,0 +1,58 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <null_device.h>
+#include <pass.h>
+#include <map>
+#include <thread>
+
+// Parallel recording where passes wait on the job system themselves, a waiting thread may pick up another recording job
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	auto null_device = NullDevice::create();
+	auto immediate_context = null_device->get_immediate_context();
+	JobSystem job_system{ 2 };
+
+	// The pass that currently records on each context, a nested job that lands on the same context overwrites it
+	std::mutex owner_mutex{};
+	std::map<ID3D11DeviceContext *, uint32_t> context_owners = {};
+	std::atomic<uint32_t> interleaved_pass_count{ 0 };
+	std::atomic<uint32_t> executed_pass_count{ 0 };
+
+	constexpr uint32_t pass_count = 64;
+	RenderGraph render_graph{ null_device.Get() };
+	for (uint32_t pass_index = 0; pass_index < pass_count; ++pass_index)
+	{
+		render_graph.add_pass("nested_wait", [&, pass_index](ID3D11DeviceContext *device_context, const RenderGraph &)
+		{
+			{
+				std::lock_guard<std::mutex> lock{ owner_mutex };
+				context_owners[device_context] = pass_index;
+			}
+			job_system.parallel_for(4, 1, [](uint32_t) { std::this_thread::sleep_for(std::chrono::microseconds(200)); });
+			device_context->Draw(3, 0);
+			{
+				std::lock_guard<std::mutex> lock{ owner_mutex };
+				if (context_owners[device_context] != pass_index) {
+					interleaved_pass_count.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+			executed_pass_count.fetch_add(1, std::memory_order_relaxed);
+		}).set_side_effect(true);
+	}
+	render_graph.compile();
+
+	auto &&device_stats = null_device->get_stats();
+	device_stats.reset();
+	render_graph.execute_parallel(immediate_context, job_system, 1);
+	test_report.check(executed_pass_count == pass_count, "Every pass is recorded once");
+	test_report.check(interleaved_pass_count == 0, std::format("No pass shares its context with another recording job, {} did", interleaved_pass_count.load()));
+	test_report.check(device_stats.query_call_count(NullDeviceCall::ExecuteCommandList) == pass_count, "One command list per pass reaches the immediate context");
+	return test_report.finish();
+}
@@ -0,0 +1,143 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <null_device.h>
+
+// Srv/uav hazards between two compute effects on the same null device context are unbound with ranged calls
+
+namespace toy
+{
+	// The history texture sits in two adjacent srv slots between unrelated ones
+	static constexpr std::string_view s_reader_source = R"(
+Texture2D<float4> gUnrelatedA : register(t0);
+Texture2D<float4> gUnrelatedB : register(t1);
+Texture2D<float4> gHistory : register(t2);
+Texture2D<float4> gHistoryMip : register(t3);
+Texture2D<float4> gUnrelatedC : register(t4);
+RWTexture2D<float4> gReaderOutput : register(u0);
+
+[numthreads(8, 8, 1)]
+void CS(uint3 thread_idx : SV_DispatchThreadID)
+{
+}
+)";
+
+	static constexpr std::string_view s_writer_source = R"(
+RWTexture2D<float4> gHistoryOutput : register(u1);
+
+[numthreads(8, 8, 1)]
+void CS(uint3 thread_idx : SV_DispatchThreadID)
+{
+}
+)";
+
+	static ComPtr<ID3D11Texture2D> create_texture(ID3D11Device *device)
+	{
+		D3D11_TEXTURE2D_DESC texture_desc{};
+		texture_desc.Width = 16;
+		texture_desc.Height = 16;
+		texture_desc.MipLevels = 1;
+		texture_desc.ArraySize = 1;
+		texture_desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		texture_desc.SampleDesc.Count = 1;
+		texture_desc.Usage = D3D11_USAGE_DEFAULT;
+		texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		ComPtr<ID3D11Texture2D> texture = nullptr;
+		device->CreateTexture2D(&texture_desc, nullptr, texture.GetAddressOf());
+		return texture;
+	}
+
+	static ComPtr<ID3D11ShaderResourceView> create_srv(ID3D11Device *device, ID3D11Resource *resource)
+	{
+		ComPtr<ID3D11ShaderResourceView> srv = nullptr;
+		device->CreateShaderResourceView(resource, nullptr, srv.GetAddressOf());
+		return srv;
+	}
+
+	static ComPtr<ID3D11UnorderedAccessView> create_uav(ID3D11Device *device, ID3D11Resource *resource)
+	{
+		ComPtr<ID3D11UnorderedAccessView> uav = nullptr;
+		device->CreateUnorderedAccessView(resource, nullptr, uav.GetAddressOf());
+		return uav;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	auto null_device = NullDevice::create();
+	auto device_context = null_device->get_immediate_context();
+	auto &&stats = null_device->get_stats();
+
+	const auto reader_cs_path = test::write_shader_file("resource_hazard_reader_cs.hlsl", s_reader_source).wstring();
+	const auto writer_cs_path = test::write_shader_file("resource_hazard_writer_cs.hlsl", s_writer_source).wstring();
+	ComputePipelineStateObject reader_pipeline_state_object{};
+	reader_pipeline_state_object.cs_path = reader_cs_path;
+	ComputeEffect reader_effect{ reader_pipeline_state_object, null_device.Get() };
+	ComputePipelineStateObject writer_pipeline_state_object{};
+	writer_pipeline_state_object.cs_path = writer_cs_path;
+	ComputeEffect writer_effect{ writer_pipeline_state_object, null_device.Get() };
+
+	auto history_texture = create_texture(null_device.Get());
+	auto reader_output_texture = create_texture(null_device.Get());
+	std::array<ComPtr<ID3D11Texture2D>, 3> unrelated_textures{};
+	std::array<ComPtr<ID3D11ShaderResourceView>, 3> unrelated_srvs{};
+	for (size_t texture_index = 0; texture_index < unrelated_textures.size(); ++texture_index)
+	{
+		unrelated_textures[texture_index] = create_texture(null_device.Get());
+		unrelated_srvs[texture_index] = create_srv(null_device.Get(), unrelated_textures[texture_index].Get());
+	}
+	auto history_srv = create_srv(null_device.Get(), history_texture.Get());
+	auto history_mip_srv = create_srv(null_device.Get(), history_texture.Get());
+	auto history_uav = create_uav(null_device.Get(), history_texture.Get());
+	auto reader_output_uav = create_uav(null_device.Get(), reader_output_texture.Get());
+
+	reader_effect.bind_shader_resource_view("gUnrelatedA", unrelated_srvs[0].Get());
+	reader_effect.bind_shader_resource_view("gUnrelatedB", unrelated_srvs[1].Get());
+	reader_effect.bind_shader_resource_view("gHistory", history_srv.Get());
+	reader_effect.bind_shader_resource_view("gHistoryMip", history_mip_srv.Get());
+	reader_effect.bind_shader_resource_view("gUnrelatedC", unrelated_srvs[2].Get());
+	reader_effect.bind_unordered_access_view("gReaderOutput", reader_output_uav.Get());
+	writer_effect.bind_unordered_access_view("gHistoryOutput", history_uav.Get());
+
+	NullComputeDispatch last_dispatch{};
+	null_device->set_compute_kernel([&](const NullComputeDispatch &compute_dispatch)
+	{
+		last_dispatch = compute_dispatch;
+	});
+
+	// The reader leaves the history texture in t2 and t3, the writer then binds it as u1
+	reader_effect.emit_compute_pipeline(device_context);
+	reader_effect.dispatch(device_context, 16, 16, 1);
+	auto &&binding_state = ResourceBindingState::query(device_context);
+	const uint64_t hazards_before = binding_state.query_hazards_resolved();
+	const uint64_t unbind_calls_before = binding_state.query_unbind_calls();
+	stats.reset();
+	writer_effect.emit_compute_pipeline(device_context);
+	test_report.check(stats.query_call_count(NullDeviceCall::SetShaderResources) == 1, "Both conflicting srv slots are unbound with one ranged call");
+	test_report.check(binding_state.query_unbind_calls() - unbind_calls_before == 1 && binding_state.query_hazards_resolved() - hazards_before == 2,
+					  "Binding state counts one call for two slots");
+
+	writer_effect.dispatch(device_context, 16, 16, 1);
+	test_report.check(last_dispatch.shader_resource_views[2] == nullptr && last_dispatch.shader_resource_views[3] == nullptr,
+					  "History srvs are gone when the writer dispatches");
+	test_report.check(last_dispatch.shader_resource_views[0] == unrelated_srvs[0].Get() && last_dispatch.shader_resource_views[1] == unrelated_srvs[1].Get() &&
+					  last_dispatch.shader_resource_views[4] == unrelated_srvs[2].Get(), "Unrelated srvs stay bound");
+	test_report.check(last_dispatch.unordered_access_views[1] == history_uav.Get() && last_dispatch.unordered_access_views[0] == reader_output_uav.Get(),
+					  "Writer uav is bound next to the unrelated reader uav");
+
+	// Reading the history again takes it out of u1 and leaves u0 alone
+	stats.reset();
+	reader_effect.emit_compute_pipeline(device_context);
+	reader_effect.dispatch(device_context, 16, 16, 1);
+	test_report.check(binding_state.query_unordered_access_mask(ShaderType::ComputeShader, history_texture.Get()) == 0, "History uav slot is released");
+	test_report.check(last_dispatch.unordered_access_views[1] == nullptr && last_dispatch.unordered_access_views[0] == reader_output_uav.Get() &&
+					  last_dispatch.shader_resource_views[2] == history_srv.Get() && last_dispatch.shader_resource_views[3] == history_mip_srv.Get(),
+					  "Reader sees the history as srvs only");
+	return test_report.finish();
+}
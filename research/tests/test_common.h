@@ -0,0 +1,72 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string_view>
+
+namespace toy::test
+{
+	// Shader sources are written to the temp directory and compiled by the fake dxcompiler, includes are not resolved
+	inline std::filesystem::path write_shader_file(std::string_view file_name, std::string_view source)
+	{
+		const auto shader_directory = std::filesystem::temp_directory_path() / "dxc_research_tests";
+		std::filesystem::create_directories(shader_directory);
+		const auto shader_path = shader_directory / file_name;
+		// Processes running at the same time share the directory, the file is written aside and renamed so no compile reads it half written
+		const auto staging_path = shader_directory / std::format("{}.{:08x}.tmp", file_name, std::random_device{}());
+		{
+			std::ofstream shader_file{ staging_path, std::ios::binary | std::ios::trunc };
+			shader_file.write(source.data(), static_cast<std::streamsize>(source.size()));
+		}
+		std::error_code error_code{};
+		std::filesystem::rename(staging_path, shader_path, error_code);
+		if (error_code) {
+			std::filesystem::remove(staging_path, error_code);
+		}
+		return shader_path;
+	}
+
+	// Failed checks are printed and counted, the test exits with the failure count
+	struct TestReport
+	{
+	private:
+		uint32_t check_count = 0;
+		uint32_t failure_count = 0;
+
+	public:
+		bool check(bool condition, std::string_view description)
+		{
+			++check_count;
+			if (!condition) {
+				++failure_count;
+				std::cout << std::format("FAILED: {}\n", description);
+			}
+			return condition;
+		}
+
+		// Megabytes of 10^6 bytes rounded to one decimal, the precision figures are quoted with
+		bool check_megabytes(uint64_t size_in_bytes, double expected_megabytes, std::string_view description)
+		{
+			const double megabytes = static_cast<double>(size_in_bytes) / 1.0e6;
+			const bool is_equal = megabytes > expected_megabytes - 0.05 && megabytes < expected_megabytes + 0.05;
+			if (!is_equal) {
+				std::cout << std::format("{}: {:.2f} MB, expected {:.1f} MB\n", description, megabytes, expected_megabytes);
+			}
+			return check(is_equal, description);
+		}
+
+		[[nodiscard]] int finish() const
+		{
+			std::cout << std::format("{} of {} checks passed\n", check_count - failure_count, check_count);
+			return static_cast<int>(failure_count);
+		}
+	};
+}
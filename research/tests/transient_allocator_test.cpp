@@ -0,0 +1,131 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <pass.h>
+#include <chrono>
+
+// Transient packing on the fake memory backend, reproduces the figures quoted when the allocator was added
+
+namespace toy
+{
+	static uint32_t create_texture(RenderGraph &render_graph, std::string_view name, uint32_t width, uint32_t height, DXGI_FORMAT format)
+	{
+		RenderGraphResourceDesc resource_desc{};
+		resource_desc.width = width;
+		resource_desc.height = height;
+		resource_desc.format = format;
+		return render_graph.create_resource(name, resource_desc);
+	}
+
+	// Deferred style frame at 1080p, transmittance lut, shadow map, g-buffer, lighting, 5 level bloom and tonemap
+	static void build_deferred_frame(RenderGraph &render_graph)
+	{
+		render_graph.clear();
+		const uint32_t back_buffer = render_graph.import_resource("back_buffer", {});
+		const uint32_t transmittance = create_texture(render_graph, "transmittance", 256, 64, DXGI_FORMAT_R32G32B32A32_FLOAT);
+		const uint32_t gbuffer_albedo = create_texture(render_graph, "gbuffer_albedo", 1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+		const uint32_t gbuffer_normal = create_texture(render_graph, "gbuffer_normal", 1920, 1080, DXGI_FORMAT_R16G16B16A16_FLOAT);
+		const uint32_t gbuffer_material = create_texture(render_graph, "gbuffer_material", 1920, 1080, DXGI_FORMAT_R8G8B8A8_UNORM);
+		const uint32_t depth = create_texture(render_graph, "depth", 1920, 1080, DXGI_FORMAT_R32_TYPELESS);
+		const uint32_t shadow = create_texture(render_graph, "shadow", 2048, 2048, DXGI_FORMAT_R32_TYPELESS);
+		const uint32_t hdr = create_texture(render_graph, "hdr", 1920, 1080, DXGI_FORMAT_R16G16B16A16_FLOAT);
+
+		render_graph.add_pass("transmittance", {}).read_write(transmittance);
+		render_graph.add_pass("shadow", {}).write_depth_stencil(shadow);
+		render_graph.add_pass("gbuffer", {}).write_render_target(gbuffer_albedo).write_render_target(gbuffer_normal).write_render_target(gbuffer_material)
+				.write_depth_stencil(depth);
+		render_graph.add_pass("lighting", {}).read(gbuffer_albedo).read(gbuffer_normal).read(gbuffer_material).read(depth).read(shadow).read(transmittance)
+				.write_render_target(hdr);
+
+		uint32_t bloom_source = hdr;
+		uint32_t bloom_width = 960;
+		uint32_t bloom_height = 540;
+		for (uint32_t bloom_level = 0; bloom_level < 5; ++bloom_level)
+		{
+			const uint32_t bloom = create_texture(render_graph, "bloom", bloom_width, bloom_height, DXGI_FORMAT_R16G16B16A16_FLOAT);
+			render_graph.add_pass("bloom_downsample", {}).read(bloom_source).write_render_target(bloom);
+			bloom_source = bloom;
+			bloom_width /= 2;
+			bloom_height /= 2;
+		}
+		render_graph.add_pass("tonemap", {}).read(hdr).read(bloom_source).write_render_target(back_buffer);
+	}
+
+	// Chain of 4000 mixed size targets, each pass reads the previous target and the one eight back
+	static void build_synthetic_chain(RenderGraph &render_graph)
+	{
+		render_graph.clear();
+		const uint32_t back_buffer = render_graph.import_resource("back_buffer", {});
+		std::vector<uint32_t> chain_resources{};
+		for (uint32_t chain_index = 0; chain_index < 4000; ++chain_index)
+		{
+			const uint32_t chain_resource = create_texture(render_graph, "chain", 256u << (chain_index % 4), 256u << (chain_index % 3), DXGI_FORMAT_R16G16B16A16_FLOAT);
+			chain_resources.emplace_back(chain_resource);
+			auto &&chain_pass = render_graph.add_pass("chain", {});
+			if (chain_index > 0) {
+				chain_pass.read(chain_resources[chain_index - 1]);
+			}
+			if (chain_index > 7) {
+				chain_pass.read(chain_resources[chain_index - 8]);
+			}
+			chain_pass.write_render_target(chain_resource);
+		}
+		render_graph.add_pass("present", {}).read(chain_resources.back()).write_render_target(back_buffer);
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	FakeTransientMemoryBackend memory_backend{};
+	TransientResourceAllocator transient_allocator{ &memory_backend };
+
+	// Graphs compile without a device, placement only talks to the fake backend
+	RenderGraph render_graph{ nullptr };
+	render_graph.set_transient_allocator(&transient_allocator);
+	for (uint32_t frame_index = 0; frame_index < 2; ++frame_index)
+	{
+		build_deferred_frame(render_graph);
+		render_graph.compile();
+		transient_allocator.print();
+	}
+	auto &&frame_stats = transient_allocator.get_stats();
+	test_report.check_megabytes(frame_stats.naive_bytes, 80.9, "Deferred frame naive bytes");
+	test_report.check_megabytes(frame_stats.heap_bytes, 75.3, "Deferred frame packed bytes");
+	test_report.check_megabytes(frame_stats.peak_live_bytes, 75.1, "Deferred frame live peak");
+	test_report.check(frame_stats.peak_live_bytes <= frame_stats.heap_bytes, "Packing is never below the live peak");
+	test_report.check(frame_stats.heap_creations == 1, "Second frame reuses the heap");
+	test_report.check(memory_backend.query_bytes_alive() == frame_stats.heap_bytes, "Backend holds exactly the packed heap");
+
+	build_synthetic_chain(render_graph);
+	const auto compile_begin = std::chrono::steady_clock::now();
+	render_graph.compile();
+	const double compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compile_begin).count();
+	transient_allocator.print();
+	std::cout << std::format("Compile of the 4000 target chain with packing took {:.1f} ms\n", compile_ms);
+	auto &&chain_stats = transient_allocator.get_stats();
+	test_report.check(chain_stats.naive_bytes > 18'250'000'000ULL && chain_stats.naive_bytes < 18'350'000'000ULL, "Synthetic chain naive bytes are 18.3 GB");
+	test_report.check_megabytes(chain_stats.heap_bytes, 55.1, "Synthetic chain packed bytes");
+	test_report.check_megabytes(chain_stats.peak_live_bytes, 47.7, "Synthetic chain live peak");
+	test_report.check(render_graph.get_stats().placed_bytes == chain_stats.heap_bytes, "Graph reports the packed heap");
+
+	// Every pair of placements that share a schedule position must not share bytes
+	bool is_disjoint = true;
+	for (uint32_t resource_id = 1; resource_id + 1 < 4000 && is_disjoint; ++resource_id)
+	{
+		const auto placement = render_graph.query_placement(resource_id);
+		const auto next_placement = render_graph.query_placement(resource_id + 1);
+		const uint64_t size_in_bytes = RenderGraph::query_resource_size_in_bytes(RenderGraphResourceDesc{
+			.format = DXGI_FORMAT_R16G16B16A16_FLOAT, .width = 256u << ((resource_id - 1) % 4), .height = 256u << ((resource_id - 1) % 3) });
+		const uint64_t next_size_in_bytes = RenderGraph::query_resource_size_in_bytes(RenderGraphResourceDesc{
+			.format = DXGI_FORMAT_R16G16B16A16_FLOAT, .width = 256u << (resource_id % 4), .height = 256u << (resource_id % 3) });
+		is_disjoint = placement.offset_in_bytes + size_in_bytes <= next_placement.offset_in_bytes ||
+					  next_placement.offset_in_bytes + next_size_in_bytes <= placement.offset_in_bytes;
+	}
+	test_report.check(is_disjoint, "Consecutive chain targets don't overlap in the heap");
+	return test_report.finish();
+}
@@ -0,0 +1,130 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <transmittance_baker.h>
+#include <null_device.h>
+
+// Transmittance baking against the scalar mirror of the CS, the baked file round trip and the runtime choice between file and dispatch
+
+namespace toy
+{
+	// Same bindings as transmittance.hlsl, the fake dxcompiler does not resolve its includes
+	static constexpr std::string_view s_transmittance_source = R"(
+cbuffer CBAtomsphereParams : register(b0)
+{
+	float3 gScatterRayleigh;
+	float  gHDensityRayleigh;
+	float  gScatterMie;
+	float  gAsymmetryMie;
+	float  gAbsorbMie;
+	float  gHDensityMie;
+	float3 gAbsorbOzone;
+	float  gOzoneCenterHeight;
+	float  gOzoneThickness;
+	float  gPlanetRadius;
+	float  gAtomsphereRadius;
+	float  gPadding;
+}
+
+RWTexture2D<float4> gTransmittanceMap : register(u0);
+
+[numthreads(16, 16, 1)]
+void CS(uint3 thread_idx : SV_DispatchThreadID)
+{
+}
+)";
+
+	static AtomsphereParams make_earth_params()
+	{
+		AtomsphereParams params{};
+		params.scatter_rayleigh[0] = 5.802e-6f;
+		params.scatter_rayleigh[1] = 13.558e-6f;
+		params.scatter_rayleigh[2] = 33.1e-6f;
+		params.h_density_rayleigh = 8000.0f;
+		params.scatter_mie = 3.996e-6f;
+		params.asymmetry_mie = 0.8f;
+		params.absorb_mie = 4.4e-6f;
+		params.h_density_mie = 1200.0f;
+		params.absorb_ozone[0] = 0.65e-6f;
+		params.absorb_ozone[1] = 1.881e-6f;
+		params.absorb_ozone[2] = 0.085e-6f;
+		params.ozone_center_height = 25000.0f;
+		params.ozone_thickness = 30000.0f;
+		params.planet_radius = 6360000.0f;
+		params.atomsphere_radius = 6460000.0f;
+		return params;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	DxcInStance::get().set_compiler_path(FAKE_DXCOMPILER_PATH);
+	JobSystem job_system{ 2 };
+	const auto params = make_earth_params();
+	constexpr uint32_t width = 64;
+	constexpr uint32_t height = 32;
+
+	// Reference straight from the per texel mirror of the CS
+	TransmittanceLut reference_lut{ width, height };
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			reference_lut.texels.emplace_back(TransmittanceBaker::bake_texel(params, x, y, width, height));
+		}
+	}
+	const auto scalar_lut = TransmittanceBaker::bake(params, width, height, job_system, false);
+	const auto simd_lut = TransmittanceBaker::bake(params, width, height, job_system, true);
+	test_report.check(TransmittanceBaker::query_max_relative_error(scalar_lut, reference_lut) == 0.0f, "Scalar bake matches the texel mirror exactly");
+	const float simd_error = TransmittanceBaker::query_max_relative_error(simd_lut, reference_lut);
+	test_report.check(simd_error < 1e-4f, std::format("Bake with simd {} stays within 1e-4 of the mirror, max relative error {}",
+													  TransmittanceBaker::is_simd_supported() ? "enabled" : "unsupported", simd_error));
+
+	// Baked file round trip, other params and a short file are refused
+	const auto lut_path = (test::write_shader_file("transmittance_baker_cs.hlsl", s_transmittance_source).parent_path() / "transmittance_baker_test.lut").string();
+	test_report.check(TransmittanceBaker::save(simd_lut, params, lut_path), "Lut is saved");
+	TransmittanceLut loaded_lut{};
+	test_report.check(TransmittanceBaker::load(lut_path, params, loaded_lut) && TransmittanceBaker::query_max_relative_error(loaded_lut, simd_lut) == 0.0f,
+					  "Lut loads back unchanged");
+	auto other_params = params;
+	other_params.planet_radius += 1.0f;
+	test_report.check(!TransmittanceBaker::load(lut_path, other_params, loaded_lut), "Lut baked with other params is refused");
+	const auto short_lut_path = lut_path + ".short";
+	std::filesystem::copy_file(lut_path, short_lut_path, std::filesystem::copy_options::overwrite_existing);
+	std::filesystem::resize_file(short_lut_path, std::filesystem::file_size(lut_path) - sizeof(std::array<float, 4>));
+	test_report.check(!TransmittanceBaker::load(short_lut_path, params, loaded_lut), "Lut shorter than its texels is refused");
+
+	// The runtime takes the baked file when it matches and dispatches the shader otherwise
+	auto null_device = NullDevice::create();
+	auto device_context = null_device->get_immediate_context();
+	std::vector<float> dispatched_planet_radii{};
+	null_device->set_compute_kernel([&](const NullComputeDispatch &compute_dispatch)
+	{
+		auto constant_buffer_storage = query_null_resource_storage(compute_dispatch.constant_buffers[0]);
+		float planet_radius = 0.0f;
+		if (constant_buffer_storage != nullptr) {
+			std::memcpy(&planet_radius, constant_buffer_storage->storage.data() + compute_dispatch.constant_buffer_offsets[0] + offsetof(AtomsphereParams, planet_radius),
+						sizeof(planet_radius));
+		}
+		dispatched_planet_radii.emplace_back(planet_radius);
+	});
+	const auto cs_path = (std::filesystem::path(lut_path).parent_path() / "transmittance_baker_cs.hlsl").wstring();
+	ComputePipelineStateObject pipeline_state_object{};
+	pipeline_state_object.cs_path = cs_path;
+	ComputeEffect transmittance_effect{ pipeline_state_object, null_device.Get() };
+
+	bool is_loaded = false;
+	auto baked_srv = TransmittanceBaker::query_or_dispatch(device_context, transmittance_effect, params, lut_path, width, height, &is_loaded);
+	test_report.check(baked_srv != nullptr && is_loaded && dispatched_planet_radii.empty(), "Matching baked lut is loaded without a dispatch");
+	auto dispatched_srv = TransmittanceBaker::query_or_dispatch(device_context, transmittance_effect, other_params, lut_path, width, height, &is_loaded);
+	test_report.check(dispatched_srv != nullptr && !is_loaded && dispatched_planet_radii.size() == 1, "Other params dispatch the shader");
+	test_report.check(!dispatched_planet_radii.empty() && dispatched_planet_radii.back() == other_params.planet_radius, "Dispatch reads the params it was given");
+	TransmittanceBaker::query_or_dispatch(device_context, transmittance_effect, params, lut_path, width * 2, height, &is_loaded);
+	test_report.check(!is_loaded, "Baked lut of another size is not used");
+	return test_report.finish();
+}
@@ -0,0 +1,162 @@
+//
+// Created by ZZK on 2024/11/03.
+//
+
+#include <test_common.h>
+#include <vertex_packer.h>
+#include <cmath>
+#include <numbers>
+#include <random>
+
+// Simd and scalar packing of every compressed encoding byte for byte, and the angular error of octahedral normals
+
+namespace toy
+{
+	// Not a multiple of four, so the octahedral path runs its scalar tail too
+	static constexpr uint32_t s_vertex_count = 4099;
+
+	// 32-bit octahedral normals round to the nearest of 65535^2 grid points, about 0.004 degrees at worst
+	static constexpr double s_max_octahedral_error_degrees = 0.005;
+
+	// One interleaved stream holding an attribute per compressed encoding
+	static VertexFormat make_compressed_format()
+	{
+		VertexFormat vertex_format{};
+		const auto add_attribute = [&](std::string_view semantic_name, DXGI_FORMAT format, uint32_t size_in_bytes, uint32_t component_count,
+									   VertexAttributeEncoding encoding)
+		{
+			VertexAttribute vertex_attribute{};
+			vertex_attribute.semantic_name = semantic_name;
+			vertex_attribute.format = format;
+			vertex_attribute.aligned_byte_offset = vertex_format.attributes.empty() ? 0 :
+				vertex_format.attributes.back().aligned_byte_offset + vertex_format.attributes.back().size_in_bytes;
+			vertex_attribute.size_in_bytes = size_in_bytes;
+			vertex_attribute.component_count = component_count;
+			vertex_attribute.encoding = encoding;
+			vertex_format.attributes.emplace_back(std::move(vertex_attribute));
+		};
+		add_attribute("TEXCOORD", DXGI_FORMAT_R16G16_FLOAT, 4, 2, VertexAttributeEncoding::Float16);
+		add_attribute("BINORMAL", DXGI_FORMAT_R16G16B16A16_FLOAT, 8, 4, VertexAttributeEncoding::Float16);
+		add_attribute("TANGENT", DXGI_FORMAT_R10G10B10A2_UNORM, 4, 4, VertexAttributeEncoding::BiasedUnorm10);
+		add_attribute("COLOR", DXGI_FORMAT_R8G8B8A8_SNORM, 4, 4, VertexAttributeEncoding::Snorm8);
+		add_attribute("NORMAL", DXGI_FORMAT_R16G16_SNORM, 4, 3, VertexAttributeEncoding::Octahedral16);
+		vertex_format.stream_strides.emplace_back(vertex_format.attributes.back().aligned_byte_offset + vertex_format.attributes.back().size_in_bytes);
+		vertex_format.stream_classes.emplace_back(D3D11_INPUT_PER_VERTEX_DATA);
+		return vertex_format;
+	}
+
+	static double query_angle_degrees(const float a[3], const float b[3])
+	{
+		const double length_a = std::sqrt(static_cast<double>(a[0]) * a[0] + static_cast<double>(a[1]) * a[1] + static_cast<double>(a[2]) * a[2]);
+		const double length_b = std::sqrt(static_cast<double>(b[0]) * b[0] + static_cast<double>(b[1]) * b[1] + static_cast<double>(b[2]) * b[2]);
+		const double cross[3] = {
+			static_cast<double>(a[1]) * b[2] - static_cast<double>(a[2]) * b[1],
+			static_cast<double>(a[2]) * b[0] - static_cast<double>(a[0]) * b[2],
+			static_cast<double>(a[0]) * b[1] - static_cast<double>(a[1]) * b[0]
+		};
+		const double sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]) / (length_a * length_b);
+		const double cosine = (static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2]) / (length_a * length_b);
+		return std::atan2(sine, cosine) * 180.0 / std::numbers::pi;
+	}
+}
+
+int main()
+{
+	using namespace toy;
+
+	test::TestReport test_report{};
+	std::mt19937 random_engine{ 20241103 };
+	std::uniform_real_distribution<float> unit_distribution{ -1.0f, 1.0f };
+	std::uniform_real_distribution<float> exponent_distribution{ -30.0f, 20.0f };
+
+	// Float16 sources span denormals, normals and overflow, the others run past their clamp range and hit exact halves
+	std::vector<float> texcoords(s_vertex_count * 2);
+	std::vector<float> binormals(s_vertex_count * 4);
+	std::vector<float> tangents(s_vertex_count * 4);
+	std::vector<float> colors(s_vertex_count * 4);
+	// Normals keep a padding float per vertex to go through a strided source
+	std::vector<float> normals(s_vertex_count * 4);
+	for (auto &&texcoord : texcoords)
+	{
+		texcoord = std::copysign(std::exp2(exponent_distribution(random_engine)), unit_distribution(random_engine));
+	}
+	for (auto &&binormal : binormals)
+	{
+		binormal = std::copysign(std::exp2(exponent_distribution(random_engine)), unit_distribution(random_engine));
+	}
+	for (uint32_t index = 0; index < s_vertex_count * 4; ++index)
+	{
+		tangents[index] = index % 7 == 0 ? (static_cast<float>(index % 2047) + 0.5f) / 1023.0f - 1.0f : unit_distribution(random_engine) * 1.25f;
+		colors[index] = index % 5 == 0 ? (static_cast<float>(index % 255) - 127.0f + 0.5f) / 127.0f : unit_distribution(random_engine) * 1.25f;
+	}
+	for (uint32_t vertex_index = 0; vertex_index < s_vertex_count; ++vertex_index)
+	{
+		auto normal = normals.data() + vertex_index * 4;
+		if (vertex_index % 97 == 0) {
+			// Axis aligned, on the octahedron edges and the zero vector
+			normal[0] = static_cast<float>(vertex_index % 3 == 0);
+			normal[1] = vertex_index % 2 == 0 ? -1.0f : 0.0f;
+			normal[2] = vertex_index % 5 == 0 ? 0.0f : -1.0f;
+			if (vertex_index == 0) {
+				normal[0] = normal[1] = normal[2] = 0.0f;
+			}
+		} else {
+			normal[0] = unit_distribution(random_engine);
+			normal[1] = unit_distribution(random_engine);
+			normal[2] = unit_distribution(random_engine);
+		}
+		normal[3] = 42.0f;
+	}
+
+	const VertexSourceAttribute source_attributes[] = {
+		{ "TEXCOORD", 0, texcoords.data(), 2, 0 },
+		{ "BINORMAL", 0, binormals.data(), 4, 0 },
+		{ "TANGENT", 0, tangents.data(), 4, 0 },
+		{ "COLOR", 0, colors.data(), 4, 0 },
+		{ "NORMAL", 0, normals.data(), 3, 16 }
+	};
+	const auto vertex_format = make_compressed_format();
+	const uint32_t stream_stride = vertex_format.stream_strides[0];
+
+	std::vector<std::vector<uint8_t>> scalar_streams{};
+	std::vector<std::vector<uint8_t>> simd_streams{};
+	test_report.check(VertexPacker::pack(vertex_format, source_attributes, s_vertex_count, scalar_streams, false), "Scalar pack succeeds");
+	test_report.check(VertexPacker::pack(vertex_format, source_attributes, s_vertex_count, simd_streams, true), "Simd pack succeeds");
+	test_report.check(scalar_streams.size() == 1 && scalar_streams[0].size() == static_cast<size_t>(stream_stride) * s_vertex_count, "Stream holds every vertex");
+
+	for (auto &&vertex_attribute : vertex_format.attributes)
+	{
+		uint32_t mismatch_count = 0;
+		for (uint32_t vertex_index = 0; vertex_index < s_vertex_count && simd_streams.size() == 1; ++vertex_index)
+		{
+			const size_t offset = static_cast<size_t>(vertex_index) * stream_stride + vertex_attribute.aligned_byte_offset;
+			if (std::memcmp(scalar_streams[0].data() + offset, simd_streams[0].data() + offset, vertex_attribute.size_in_bytes) != 0) {
+				++mismatch_count;
+			}
+		}
+		test_report.check(mismatch_count == 0, std::format("{} packs the same bytes with simd {}, {} vertices differ", vertex_attribute.semantic_name,
+														   VertexPacker::is_simd_supported() ? "enabled" : "unsupported", mismatch_count));
+	}
+
+	// Decoded normals stay within the octahedral bound of their source direction
+	const auto normal_attribute = vertex_format.query_attribute("NORMAL");
+	double max_error_degrees = 0.0;
+	for (uint32_t vertex_index = 1; vertex_index < s_vertex_count; ++vertex_index)
+	{
+		int16_t encoded[2]{};
+		std::memcpy(encoded, scalar_streams[0].data() + static_cast<size_t>(vertex_index) * stream_stride + normal_attribute->aligned_byte_offset, sizeof(encoded));
+		float decoded[3]{};
+		VertexPacker::decode_octahedral(encoded, decoded);
+		max_error_degrees = (std::max)(max_error_degrees, query_angle_degrees(normals.data() + vertex_index * 4, decoded));
+	}
+	test_report.check(max_error_degrees < s_max_octahedral_error_degrees,
+					  std::format("Octahedral normals stay within {} degrees, max error {:.5f}", s_max_octahedral_error_degrees, max_error_degrees));
+
+	int16_t zero_encoded[2]{};
+	float zero_decoded[3]{};
+	const float zero_normal[3] = { 0.0f, 0.0f, 0.0f };
+	VertexPacker::encode_octahedral(zero_normal, zero_encoded);
+	VertexPacker::decode_octahedral(zero_encoded, zero_decoded);
+	test_report.check(zero_decoded[2] == 1.0f, "Zero vector encodes to +z instead of nan");
+	return test_report.finish();
+}
@@ -0,0 +1,24 @@
+#ifndef _VERTEX_COMPRESSION_
+#define _VERTEX_COMPRESSION_
+
+// Decoders of the compressed vertex attribute encodings, see VertexAttributeEncoding
+
+// BiasedUnorm10, R10G10B10A2_UNORM holding v * 0.5 + 0.5
+float4 decode_biased_unorm(float4 v)
+{
+    return v * 2.0f - 1.0f;
+}
+
+// Octahedral16, R16G16_SNORM, the input assembler fills z with 0
+float3 decode_octahedral(float2 e)
+{
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+    {
+        float2 s = float2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        n.xy = (1.0f - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
+#endif